@@ -27,6 +27,7 @@ LOCAL_MODULE_TARGET_ARCH_WARN := arm mips mips64 x86 x86_64 arm64
 
 LOCAL_SRC_FILES:= \
 	driver/rsdAllocation.cpp \
+	driver/rsdAllocationPool.cpp \
 	driver/rsdBcc.cpp \
 	driver/rsdCore.cpp \
 	driver/rsdElement.cpp \
@@ -139,12 +140,14 @@ LOCAL_SRC_FILES:= \
 	rsAnimation.cpp \
 	rsComponent.cpp \
 	rsContext.cpp \
+	rsCopy.cpp \
 	rsClosure.cpp \
 	rsCppUtils.cpp \
 	rsDevice.cpp \
 	rsDriverLoader.cpp \
 	rsElement.cpp \
 	rsFBOCache.cpp \
+	rsFifoRing.cpp \
 	rsFifoSocket.cpp \
 	rsFileA3D.cpp \
 	rsFont.cpp \
@@ -245,11 +248,13 @@ LOCAL_SRC_FILES:= \
 	rsAnimation.cpp \
 	rsComponent.cpp \
 	rsContext.cpp \
+	rsCopy.cpp \
 	rsClosure.cpp \
 	rsDevice.cpp \
 	rsDriverLoader.cpp \
 	rsElement.cpp \
 	rsFBOCache.cpp \
+	rsFifoRing.cpp \
 	rsFifoSocket.cpp \
 	rsFileA3D.cpp \
 	rsFont.cpp \
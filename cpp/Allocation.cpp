@@ -262,6 +262,42 @@ void Allocation::copy1DRangeTo(uint32_t off, size_t count, void *data) {
     }
 }
 
+void Allocation::copy1DRangeFromAsync(uint32_t off, size_t count, const void *data,
+                                      RsUploadReleaseCallback release, void *usrData) {
+    // Padded copies go through a temporary anyway, so they gain nothing
+    // from the async path.
+    if (!RS::dispatch->Allocation1DDataAsync ||
+        (mAutoPadding && (mType->getElement()->getVectorSize() == 3))) {
+        copy1DRangeFrom(off, count, data);
+        if (release) {
+            release(usrData);
+        }
+        return;
+    }
+
+    // The caller is told the buffer is free on every path, even when the
+    // copy is refused.
+    if(count < 1) {
+        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "Count must be >= 1.");
+        if (release) {
+            release(usrData);
+        }
+        return;
+    }
+    if((off + count) > mCurrentCount) {
+        ALOGE("Overflow, Available count %u, got %zu at offset %u.", mCurrentCount, count, off);
+        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "Invalid copy specified");
+        if (release) {
+            release(usrData);
+        }
+        return;
+    }
+    tryDispatch(mRS, RS::dispatch->Allocation1DDataAsync(mRS->getContext(), getIDSafe(), off,
+                                                         mSelectedLOD, count, data,
+                                                         count * mType->getElement()->getSizeBytes(),
+                                                         release, usrData));
+}
+
 void Allocation::copy1DRangeFrom(uint32_t off, size_t count, sp<const Allocation> data,
                                  uint32_t dataOff) {
 
@@ -310,6 +346,33 @@ void Allocation::copy2DRangeFrom(uint32_t xoff, uint32_t yoff, uint32_t w, uint3
     }
 }
 
+void Allocation::copy2DRangeFromAsync(uint32_t xoff, uint32_t yoff, uint32_t w, uint32_t h,
+                                      const void *data, RsUploadReleaseCallback release,
+                                      void *usrData) {
+    if (!RS::dispatch->Allocation2DDataAsync ||
+        (mAutoPadding && (mType->getElement()->getVectorSize() == 3))) {
+        copy2DRangeFrom(xoff, yoff, w, h, data);
+        if (release) {
+            release(usrData);
+        }
+        return;
+    }
+
+    if (mAdaptedAllocation == nullptr &&
+        (((xoff + w) > mCurrentDimX) || ((yoff + h) > mCurrentDimY))) {
+        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "Updated region larger than allocation.");
+        if (release) {
+            release(usrData);
+        }
+        return;
+    }
+    tryDispatch(mRS, RS::dispatch->Allocation2DDataAsync(mRS->getContext(), getIDSafe(), xoff,
+                                                         yoff, mSelectedLOD, mSelectedFace,
+                                                         w, h, data, w * h * mType->getElement()->getSizeBytes(),
+                                                         w * mType->getElement()->getSizeBytes(),
+                                                         release, usrData));
+}
+
 void Allocation::copy2DRangeFrom(uint32_t xoff, uint32_t yoff, uint32_t w, uint32_t h,
                                  sp<const Allocation> data, uint32_t dataXoff, uint32_t dataYoff) {
     validate2DRange(xoff, yoff, w, h);
@@ -165,7 +165,9 @@ bool RS::init(const char * name, int targetApi, uint32_t flags) {
     }
 
     if (flags & ~(RS_CONTEXT_SYNCHRONOUS | RS_CONTEXT_LOW_LATENCY |
-                  RS_CONTEXT_LOW_POWER | RS_CONTEXT_WAIT_FOR_ATTACH)) {
+                  RS_CONTEXT_LOW_POWER | RS_CONTEXT_WAIT_FOR_ATTACH |
+                  RS_CONTEXT_SHARED_MEMORY_FIFO | RS_CONTEXT_BATCH_COMMANDS |
+                  RS_CONTEXT_BACKGROUND_COMPILE)) {
         ALOGE("Invalid flags passed");
         return false;
     }
@@ -282,3 +284,10 @@ void RS::setMessageHandler(MessageHandlerFunc_t func) {
 void RS::finish() {
     RS::dispatch->ContextFinish(mContext);
 }
+
+void RS::flush() {
+    // Older drivers do not batch, so there is nothing to flush.
+    if (RS::dispatch->ContextFlush) {
+        RS::dispatch->ContextFlush(mContext);
+    }
+}
@@ -36,6 +36,51 @@ void Script::forEach(uint32_t slot, sp<const Allocation> ain, sp<const Allocatio
     tryDispatch(mRS, RS::dispatch->ScriptForEach(mRS->getContext(), getID(), slot, in_id, out_id, usr, usrLen, nullptr, 0));
 }
 
+void Script::forEach(uint32_t slot, const sp<const Allocation> *ins, size_t inLen,
+                     const sp<const Allocation> *outs, size_t outLen,
+                     const void *usr, size_t usrLen, const RsScriptCall *sc) const {
+    if (RS::dispatch->ScriptForEachMultiOut == nullptr) {
+        mRS->throwError(RS_ERROR_RUNTIME_ERROR, "Kernels with several outputs are not supported by the driver.");
+        return;
+    }
+    if ((outs == nullptr) || (outLen == 0)) {
+        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "At least one output is required.");
+        return;
+    }
+    RsAllocation *in_ids = inLen ? new RsAllocation[inLen] : nullptr;
+    for (size_t i = 0; i < inLen; i++) {
+        in_ids[i] = (RsAllocation)BaseObj::getObjID(ins[i]);
+    }
+    RsAllocation *out_ids = new RsAllocation[outLen];
+    for (size_t i = 0; i < outLen; i++) {
+        out_ids[i] = (RsAllocation)BaseObj::getObjID(outs[i]);
+    }
+    tryDispatch(mRS, RS::dispatch->ScriptForEachMultiOut(mRS->getContext(), getID(), slot,
+                                                         in_ids, inLen, out_ids, outLen,
+                                                         usr, usrLen, sc, sc ? sizeof(*sc) : 0));
+    delete[] in_ids;
+    delete[] out_ids;
+}
+
+void Script::reduce(uint32_t slot, const sp<const Allocation> *ins, size_t inLen,
+                    sp<const Allocation> out, const RsScriptCall *sc) const {
+    if (RS::dispatch->ScriptReduce == nullptr) {
+        mRS->throwError(RS_ERROR_RUNTIME_ERROR, "Reduction kernels are not supported by the driver.");
+        return;
+    }
+    if ((ins == nullptr) || (inLen == 0) || (out == nullptr)) {
+        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "Reductions require at least one input and an output.");
+        return;
+    }
+    RsAllocation *in_ids = new RsAllocation[inLen];
+    for (size_t i = 0; i < inLen; i++) {
+        in_ids[i] = (RsAllocation)BaseObj::getObjID(ins[i]);
+    }
+    void *out_id = BaseObj::getObjID(out);
+    tryDispatch(mRS, RS::dispatch->ScriptReduce(mRS->getContext(), getID(), slot, in_ids, inLen,
+                                                out_id, sc, sc ? sizeof(*sc) : 0));
+    delete[] in_ids;
+}
 
 Script::Script(void *id, sp<RS> rs) : BaseObj(id, rs) {
 }
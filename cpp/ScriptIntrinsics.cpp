@@ -235,13 +235,22 @@ void ScriptIntrinsicBlur::forEach(sp<Allocation> out) {
 }
 
 void ScriptIntrinsicBlur::setRadius(float radius) {
-    if (radius > 0.f && radius <= 25.f) {
+    if (radius > 0.f && radius <= 1000.f) {
         Script::setVar(0, &radius, sizeof(float));
     } else {
-        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "Blur radius out of 0-25 pixel bound");
+        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "Blur radius out of 0-1000 pixel bound");
     }
 }
 
+void ScriptIntrinsicBlur::setMode(RsBlurMode mode) {
+    if (mode != RS_BLUR_MODE_DEFAULT && mode != RS_BLUR_MODE_BOX) {
+        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "Invalid blur mode");
+        return;
+    }
+    int32_t m = mode;
+    Script::setVar(2, &m, sizeof(m));
+}
+
 
 
 sp<ScriptIntrinsicColorMatrix> ScriptIntrinsicColorMatrix::create(sp<RS> rs) {
@@ -469,6 +478,10 @@ void ScriptIntrinsicHistogram::setDotCoefficients(float r, float g, float b, flo
 
 }
 
+void ScriptIntrinsicHistogram::setAccumulate(bool accumulate) {
+    Script::setVar(2, (int32_t)accumulate);
+}
+
 void ScriptIntrinsicHistogram::forEach(sp<Allocation> ain) {
     if (ain->getType()->getElement()->getVectorSize() <
         mOut->getType()->getElement()->getVectorSize()) {
@@ -606,6 +619,16 @@ void ScriptIntrinsicResize::setInput(sp<Allocation> ain) {
     Script::setVar(0, ain);
 }
 
+void ScriptIntrinsicResize::setMode(RsResizeMode mode) {
+    if (mode != RS_RESIZE_MODE_BICUBIC && mode != RS_RESIZE_MODE_AREA &&
+        mode != RS_RESIZE_MODE_LANCZOS3) {
+        mRS->throwError(RS_ERROR_INVALID_PARAMETER, "Invalid resize mode");
+        return;
+    }
+    int32_t m = mode;
+    Script::setVar(1, &m, sizeof(m));
+}
+
 
 sp<ScriptIntrinsicYuvToRGB> ScriptIntrinsicYuvToRGB::create(sp<RS> rs, sp<const Element> e) {
     if (!(e->isCompatible(Element::U8_4(rs)))) {
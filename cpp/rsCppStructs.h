@@ -82,7 +82,10 @@ class Sampler;
      RS_INIT_LOW_LATENCY = 2, ///< Prefer low latency devices over potentially higher throughput devices.
      // Bitflag 4 is reserved for the context flag low power
      RS_INIT_WAIT_FOR_ATTACH = 8,   ///< Kernel execution will hold to give time for a debugger to be attached
-     RS_INIT_MAX = 16
+     RS_INIT_SHARED_MEMORY_FIFO = 16, ///< Send commands through shared memory rather than a socket. Reduces per-call overhead.
+     RS_INIT_BATCH_COMMANDS = 32, ///< Queue asynchronous calls and send them together at the next synchronous call or flush().
+     RS_INIT_BACKGROUND_COMPILE = 64, ///< Return from script creation at once and compile in the background. Create scripts back to back to compile them in parallel.
+     RS_INIT_MAX = 128
  };
 
  /**
@@ -146,6 +149,13 @@ class Sampler;
      */
     void finish();
 
+    /**
+     * Sends any calls queued by RS_INIT_BATCH_COMMANDS to the device without
+     * waiting for them.  Call this before waiting on a message from a script
+     * that was launched asynchronously.
+     */
+    void flush();
+
     RsContext getContext() { return mContext; }
     void throwError(RSError error, const char *errMsg);
 
@@ -420,6 +430,19 @@ public:
      */
     void copy1DRangeFrom(uint32_t off, size_t count, sp<const Allocation> data, uint32_t dataOff);
 
+    /**
+     * Copy an array into part of this Allocation without waiting for the
+     * copy.  The array must stay valid until release is called, which
+     * happens on the RenderScript thread once the copy is done.
+     * @param[in] off offset of first Element to be overwritten
+     * @param[in] count number of Elements to copy
+     * @param[in] data array from which to copy
+     * @param[in] release called with usrData when data may be reused
+     * @param[in] usrData passed to release
+     */
+    void copy1DRangeFromAsync(uint32_t off, size_t count, const void *data,
+                              RsUploadReleaseCallback release, void *usrData);
+
     /**
      * Copy an array into part of this Allocation.
      * @param[in] off offset of first Element to be overwritten
@@ -452,6 +475,23 @@ public:
     void copy2DRangeFrom(uint32_t xoff, uint32_t yoff, uint32_t w, uint32_t h,
                          const void *data);
 
+    /**
+     * Copy from a tightly packed array into a rectangular region in this
+     * Allocation without waiting for the copy.  The array must stay valid
+     * until release is called, which happens on the RenderScript thread once
+     * the copy is done.
+     * @param[in] xoff X offset of region to update in this Allocation
+     * @param[in] yoff Y offset of region to update in this Allocation
+     * @param[in] w Width of region to update
+     * @param[in] h Height of region to update
+     * @param[in] data Array from which to copy
+     * @param[in] release called with usrData when data may be reused
+     * @param[in] usrData passed to release
+     */
+    void copy2DRangeFromAsync(uint32_t xoff, uint32_t yoff, uint32_t w, uint32_t h,
+                              const void *data, RsUploadReleaseCallback release,
+                              void *usrData);
+
     /**
      * Copy from this Allocation into a rectangular region in an array. The
      * array is assumed to be tightly packed.
@@ -1400,6 +1440,25 @@ protected:
     Script(void *id, sp<RS> rs);
     void forEach(uint32_t slot, sp<const Allocation> in, sp<const Allocation> out,
             const void *v, size_t) const;
+    /**
+     * Runs kernel slot over the inLen allocations in ins, writing the outLen
+     * allocations in outs.  All of them must have the same dimensions, and
+     * outLen is at most 8.
+     */
+    void forEach(uint32_t slot, const sp<const Allocation> *ins, size_t inLen,
+            const sp<const Allocation> *outs, size_t outLen,
+            const void *v, size_t, const RsScriptCall *sc = nullptr) const;
+    /**
+     * Runs reduction kernel slot over the inLen allocations in ins, which
+     * must have the same dimensions, and stores the result in the first cell
+     * of out.
+     */
+    void reduce(uint32_t slot, const sp<const Allocation> *ins, size_t inLen,
+            sp<const Allocation> out, const RsScriptCall *sc = nullptr) const;
+    void reduce(uint32_t slot, sp<const Allocation> in, sp<const Allocation> out,
+            const RsScriptCall *sc = nullptr) const {
+        reduce(slot, &in, 1, out, sc);
+    }
     void bindAllocation(sp<Allocation> va, uint32_t slot) const;
     void setVar(uint32_t index, const void *, size_t len) const;
     void setVar(uint32_t index, sp<const BaseObj> o) const;
@@ -1641,10 +1700,19 @@ class ScriptIntrinsicBlur : public ScriptIntrinsic {
      */
     void forEach(sp<Allocation> out);
     /**
-     * Sets the radius of the blur. The supported range is 0 < radius <= 25.
+     * Sets the radius of the blur. The supported range is 0 < radius <= 1000.
+     * Radii above 25 always use RS_BLUR_MODE_BOX.
      * @param[in] radius radius of the blur
      */
     void setRadius(float radius);
+    /**
+     * Selects how the blur is computed. RS_BLUR_MODE_DEFAULT applies the
+     * Gaussian weights directly, at a cost proportional to the radius.
+     * RS_BLUR_MODE_BOX approximates them with three box filters, at a cost
+     * independent of the radius.
+     * @param[in] mode RS_BLUR_MODE_DEFAULT or RS_BLUR_MODE_BOX
+     */
+    void setMode(RsBlurMode mode);
 };
 
 /**
@@ -1812,6 +1880,18 @@ class ScriptIntrinsicHistogram : public ScriptIntrinsic {
      * @param[in] a Alpha coefficient
      */
     void setDotCoefficients(float r, float g, float b, float a);
+    /**
+     * Set whether each launch adds its counts to the current contents of
+     * the output allocation instead of replacing them. This allows a
+     * histogram to be built up across several input allocations, such as
+     * the frames of a video. The default is false.
+     *
+     * When accumulating, the caller is responsible for clearing the output
+     * allocation before the first launch.
+     *
+     * @param[in] accumulate Whether launches accumulate into the output
+     */
+    void setAccumulate(bool accumulate);
     /**
      * Process an input buffer and place the histogram into the output
      * allocation. The output allocation may be a narrower vector size
@@ -1932,6 +2012,15 @@ class ScriptIntrinsicResize : public ScriptIntrinsic {
      * @param[in] lut new lookup table
      */
     void setInput(sp<Allocation> ain);
+
+    /**
+     * Selects the filter used by forEach_bicubic. RS_RESIZE_MODE_AREA and
+     * RS_RESIZE_MODE_LANCZOS3 take every input pixel into account when
+     * downscaling, at a cost proportional to the input size.
+     * @param[in] mode RS_RESIZE_MODE_BICUBIC, RS_RESIZE_MODE_AREA or
+     *                 RS_RESIZE_MODE_LANCZOS3
+     */
+    void setMode(RsResizeMode mode);
 };
 
 /**
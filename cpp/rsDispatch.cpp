@@ -140,6 +140,8 @@ bool loadSymbols(void* handle, dispatchTable& dispatchTab, int device_api) {
         LOG_API("Couldn't initialize dispatchTab.ContextFinish");
         return false;
     }
+    // Optional: only drivers that support command batching export it.
+    dispatchTab.ContextFlush = (ContextFlushFnPtr)dlsym(handle, "rsContextFlush");
     dispatchTab.ContextDump = (ContextDumpFnPtr)dlsym(handle, "rsContextDump");
     if (dispatchTab.ContextDump == NULL) {
         LOG_API("Couldn't initialize dispatchTab.ContextDump");
@@ -190,6 +192,9 @@ bool loadSymbols(void* handle, dispatchTable& dispatchTab, int device_api) {
         LOG_API("Couldn't initialize dispatchTab.Allocation2DData");
         return false;
     }
+    // Optional: Allocation falls back to synchronous uploads without them.
+    dispatchTab.Allocation1DDataAsync = (Allocation1DDataAsyncFnPtr)dlsym(handle, "rsAllocation1DDataAsync");
+    dispatchTab.Allocation2DDataAsync = (Allocation2DDataAsyncFnPtr)dlsym(handle, "rsAllocation2DDataAsync");
     dispatchTab.Allocation3DData = (Allocation3DDataFnPtr)dlsym(handle, "rsAllocation3DData");
     if (dispatchTab.Allocation3DData == NULL) {
         LOG_API("Couldn't initialize dispatchTab.Allocation3DData");
@@ -416,6 +421,11 @@ bool loadSymbols(void* handle, dispatchTable& dispatchTab, int device_api) {
             LOG_API("Couldn't initialize dispatchTab.ScriptForEachMulti");
             return false;
         }
+        // Optional: Script::forEach with several outputs reports an error
+        // without it.
+        dispatchTab.ScriptForEachMultiOut = (ScriptForEachMultiOutFnPtr)dlsym(handle, "rsScriptForEachMultiOut");
+        // Optional: Script::reduce reports an error without it.
+        dispatchTab.ScriptReduce = (ScriptReduceFnPtr)dlsym(handle, "rsScriptReduce");
     }
 
     return true;
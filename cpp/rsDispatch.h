@@ -47,6 +47,7 @@ typedef RsAllocation (*AllocationCubeCreateFromBitmapFnPtr) (RsContext, RsType,
 typedef RsNativeWindow (*AllocationGetSurfaceFnPtr) (RsContext, RsAllocation);
 typedef void (*AllocationSetSurfaceFnPtr) (RsContext, RsAllocation, RsNativeWindow);
 typedef void (*ContextFinishFnPtr) (RsContext);
+typedef void (*ContextFlushFnPtr) (RsContext);
 typedef void (*ContextDumpFnPtr) (RsContext, int32_t);
 typedef void (*ContextSetPriorityFnPtr) (RsContext, int32_t);
 typedef void (*AssignNameFnPtr) (RsContext, RsObjectBase, const char*, size_t);
@@ -58,6 +59,8 @@ typedef void (*Allocation1DDataFnPtr) (RsContext, RsAllocation, uint32_t, uint32
 typedef void (*Allocation1DElementDataFnPtr) (RsContext, RsAllocation, uint32_t, uint32_t, const void*, size_t, size_t);
 typedef void (*AllocationElementDataFnPtr) (RsContext, RsAllocation, uint32_t, uint32_t, uint32_t, uint32_t, const void*, size_t, size_t);
 typedef void (*Allocation2DDataFnPtr) (RsContext, RsAllocation, uint32_t, uint32_t, uint32_t, RsAllocationCubemapFace, uint32_t, uint32_t, const void*, size_t, size_t);
+typedef void (*Allocation1DDataAsyncFnPtr) (RsContext, RsAllocation, uint32_t, uint32_t, uint32_t, const void*, size_t, RsUploadReleaseCallback, void*);
+typedef void (*Allocation2DDataAsyncFnPtr) (RsContext, RsAllocation, uint32_t, uint32_t, uint32_t, RsAllocationCubemapFace, uint32_t, uint32_t, const void*, size_t, size_t, RsUploadReleaseCallback, void*);
 typedef void (*Allocation3DDataFnPtr) (RsContext, RsAllocation, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, const void*, size_t, size_t);
 typedef void (*AllocationGenerateMipmapsFnPtr) (RsContext, RsAllocation);
 typedef void (*AllocationReadFnPtr) (RsContext, RsAllocation, void*, size_t);
@@ -94,6 +97,8 @@ typedef void (*ScriptGroupSetOutputFnPtr) (RsContext, RsScriptGroup, RsScriptKer
 typedef void (*ScriptGroupSetInputFnPtr) (RsContext, RsScriptGroup, RsScriptKernelID, RsAllocation);
 typedef void (*ScriptGroupExecuteFnPtr) (RsContext, RsScriptGroup);
 typedef void (*ScriptForEachMultiFnPtr) (RsContext, RsScript, uint32_t, RsAllocation *, size_t, RsAllocation, const void *, size_t, const RsScriptCall *, size_t);
+typedef void (*ScriptForEachMultiOutFnPtr) (RsContext, RsScript, uint32_t, RsAllocation *, size_t, RsAllocation *, size_t, const void *, size_t, const RsScriptCall *, size_t);
+typedef void (*ScriptReduceFnPtr) (RsContext, RsScript, uint32_t, RsAllocation *, size_t, RsAllocation, const RsScriptCall *, size_t);
 typedef void (*AllocationIoSendFnPtr) (RsContext, RsAllocation);
 typedef void (*AllocationIoReceiveFnPtr) (RsContext, RsAllocation);
 typedef void * (*AllocationGetPointerFnPtr) (RsContext, RsAllocation, uint32_t lod, RsAllocationCubemapFace face, uint32_t z, uint32_t array, size_t *stride, size_t stride_len);
@@ -131,6 +136,7 @@ struct dispatchTable {
     ClosureSetArgFnPtr ClosureSetArg;
     ClosureSetGlobalFnPtr ClosureSetGlobal;
     ContextFinishFnPtr ContextFinish;
+    ContextFlushFnPtr ContextFlush;
     ContextDumpFnPtr ContextDump;
     ContextSetPriorityFnPtr ContextSetPriority;
     AssignNameFnPtr AssignName;
@@ -142,6 +148,8 @@ struct dispatchTable {
     Allocation1DElementDataFnPtr Allocation1DElementData;
     AllocationElementDataFnPtr AllocationElementData;
     Allocation2DDataFnPtr Allocation2DData;
+    Allocation1DDataAsyncFnPtr Allocation1DDataAsync;
+    Allocation2DDataAsyncFnPtr Allocation2DDataAsync;
     Allocation3DDataFnPtr Allocation3DData;
     AllocationGenerateMipmapsFnPtr AllocationGenerateMipmaps;
     AllocationReadFnPtr AllocationRead;
@@ -178,6 +186,8 @@ struct dispatchTable {
     ScriptGroupSetInputFnPtr ScriptGroupSetInput;
     ScriptGroupExecuteFnPtr ScriptGroupExecute;
     ScriptForEachMultiFnPtr ScriptForEachMulti;
+    ScriptForEachMultiOutFnPtr ScriptForEachMultiOut;
+    ScriptReduceFnPtr ScriptReduce;
     AllocationIoSendFnPtr AllocationIoSend;
     AllocationIoReceiveFnPtr AllocationIoReceive;
     AllocationGetPointerFnPtr AllocationGetPointer;
@@ -21,6 +21,7 @@ LOCAL_SRC_FILES:= \
         rsCpuCore.cpp \
         rsCpuExecutable.cpp \
         rsCpuScript.cpp \
+        rsCpuScriptCache.cpp \
         rsCpuRuntimeMath.cpp \
         rsCpuRuntimeMathFuncs.cpp \
         rsCpuScriptGroup.cpp \
@@ -28,6 +29,8 @@ LOCAL_SRC_FILES:= \
         rsCpuIntrinsic.cpp \
         rsCpuIntrinsic3DLUT.cpp \
         rsCpuIntrinsicBLAS.cpp \
+        rsCpuBNNM.cpp \
+        rsCpuBLASBuiltin.cpp \
         rsCpuIntrinsicBlend.cpp \
         rsCpuIntrinsicBlur.cpp \
         rsCpuIntrinsicColorMatrix.cpp \
@@ -79,7 +82,8 @@ endif
 ifeq ($(ARCH_X86_HAVE_SSSE3),true)
     LOCAL_CFLAGS += -DARCH_X86_HAVE_SSSE3
     LOCAL_SRC_FILES+= \
-    rsCpuIntrinsics_x86.cpp
+    rsCpuIntrinsics_x86.cpp \
+    rsCpuIntrinsics_x86_avx2.cpp
 endif
 
 LOCAL_SHARED_LIBRARIES += libRS libcutils libutils liblog libsync libc++ libdl libz
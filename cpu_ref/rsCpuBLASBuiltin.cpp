@@ -0,0 +1,587 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsCpuCore.h"
+#include "rsCpuBLASBuiltin.h"
+
+#include <malloc.h>
+#include <string.h>
+
+namespace android {
+namespace renderscript {
+
+// One 128-bit SIMD register of each element type.  These lower to SSE2 or
+// NEON on the targets that have them and to scalar code elsewhere.
+typedef float BlasFloatVec __attribute__((vector_size(16)));
+typedef double BlasDoubleVec __attribute__((vector_size(16)));
+
+template <typename T> struct BlasVec;
+template <> struct BlasVec<float> { typedef BlasFloatVec Type; };
+template <> struct BlasVec<double> { typedef BlasDoubleVec Type; };
+
+// Runs op->run(slice, thread) for every slice in [0, count) on the worker
+// pool.  thread is the worker index, below getThreadCount(), so ops can keep
+// per-thread scratch memory.
+template <typename Op>
+static void walk_blas(void *usr, uint32_t idx) {
+    MTLaunchStruct *mtls = (MTLaunchStruct *)usr;
+    Op *op = (Op *)mtls->fep.usr;
+    uint32_t slice;
+
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &slice)) {
+        op->run(slice, idx);
+    }
+}
+
+template <typename Op>
+static void launchBlas(RsdCpuReferenceImpl *ctx, Op *op, uint32_t count) {
+    if (!count) {
+        return;
+    }
+    MTLaunchStruct mtls;
+    memset(&mtls, 0, sizeof(mtls));
+    mtls.rsc = ctx;
+    mtls.fep.usr = op;
+    mtls.mSliceCount = count;
+    ctx->launchThreads(walk_blas<Op>, &mtls);
+}
+
+static inline size_t divUp(size_t a, size_t b) {
+    return (a + b - 1) / b;
+}
+
+// ---------------------------------------------------------------------------
+// GEMM
+//
+// C is split into kMC x kNC tiles, one per slice.  For each kKC deep step of
+// the inner dimension a tile packs its block of op(A) into kMR row panels and
+// its block of op(B) into kNR column panels, then runs a kMR x kNR register
+// blocked kernel over every pair of panels.  The packed blocks live in
+// per-thread scratch and are sized to stay in the mid-level cache.
+// ---------------------------------------------------------------------------
+
+static const size_t kMR = 4;
+static const size_t kMC = 64;
+static const size_t kNC = 128;
+static const size_t kKC = 256;
+
+enum {
+    kFullMatrix,
+    kUpperTriangle,
+    kLowerTriangle
+};
+
+template <typename T>
+struct GemmOp {
+    typedef typename BlasVec<T>::Type V;
+    static const size_t kLanes = sizeof(V) / sizeof(T);
+    static const size_t kNR = 2 * kLanes;
+    static const size_t kScratch = kMC * kKC + kKC * kNC;
+
+    bool transA, transB;
+    size_t m, n, k;
+    T alpha, beta;
+    const T *a;
+    size_t lda;
+    const T *b;
+    size_t ldb;
+    T *c;
+    size_t ldc;
+    int triangle;   // Part of C to update, for SYRK.
+    size_t rowTiles;
+    T *scratch;
+
+    T opA(size_t i, size_t p) const {
+        return transA ? a[p * lda + i] : a[i * lda + p];
+    }
+    T opB(size_t p, size_t j) const {
+        return transB ? b[j * ldb + p] : b[p * ldb + j];
+    }
+    bool updates(size_t i, size_t j) const {
+        return triangle == kFullMatrix || (triangle == kUpperTriangle ? j >= i : j <= i);
+    }
+
+    void packA(T *dst, size_t i0, size_t mc, size_t p0, size_t kc) const {
+        for (size_t ir = 0; ir < mc; ir += kMR) {
+            for (size_t p = 0; p < kc; p++) {
+                for (size_t r = 0; r < kMR; r++) {
+                    *dst++ = ir + r < mc ? opA(i0 + ir + r, p0 + p) : 0;
+                }
+            }
+        }
+    }
+
+    void packB(T *dst, size_t p0, size_t kc, size_t j0, size_t nc) const {
+        for (size_t jr = 0; jr < nc; jr += kNR) {
+            for (size_t p = 0; p < kc; p++) {
+                for (size_t col = 0; col < kNR; col++) {
+                    *dst++ = jr + col < nc ? opB(p0 + p, j0 + jr + col) : 0;
+                }
+            }
+        }
+    }
+
+    static void kernel(size_t kc, const T *pa, const T *pb, T out[kMR][kNR]) {
+        V acc[kMR][2];
+        memset(acc, 0, sizeof(acc));
+        for (size_t p = 0; p < kc; p++) {
+            V b0 = *(const V *)pb;
+            V b1 = *(const V *)(pb + kLanes);
+            for (size_t r = 0; r < kMR; r++) {
+                acc[r][0] += pa[r] * b0;
+                acc[r][1] += pa[r] * b1;
+            }
+            pa += kMR;
+            pb += kNR;
+        }
+        memcpy(out, acc, sizeof(acc));
+    }
+
+    void run(uint32_t tile, uint32_t thread) {
+        const size_t i0 = (tile % rowTiles) * kMC;
+        const size_t j0 = (tile / rowTiles) * kNC;
+        const size_t mc = rsMin(kMC, m - i0);
+        const size_t nc = rsMin(kNC, n - j0);
+
+        if ((triangle == kUpperTriangle && j0 + nc <= i0) ||
+            (triangle == kLowerTriangle && j0 >= i0 + mc)) {
+            return;
+        }
+
+        if (k == 0) {
+            for (size_t i = i0; i < i0 + mc; i++) {
+                for (size_t j = j0; j < j0 + nc; j++) {
+                    if (updates(i, j)) {
+                        c[i * ldc + j] = beta == 0 ? 0 : beta * c[i * ldc + j];
+                    }
+                }
+            }
+            return;
+        }
+
+        T *pa = scratch + thread * kScratch;
+        T *pb = pa + kMC * kKC;
+        T out[kMR][kNR];
+
+        for (size_t p0 = 0; p0 < k; p0 += kKC) {
+            const size_t kc = rsMin(kKC, k - p0);
+            const bool first = p0 == 0;
+            packA(pa, i0, mc, p0, kc);
+            packB(pb, p0, kc, j0, nc);
+
+            for (size_t jr = 0; jr < nc; jr += kNR) {
+                for (size_t ir = 0; ir < mc; ir += kMR) {
+                    kernel(kc, pa + ir * kc, pb + jr * kc, out);
+
+                    const size_t rows = rsMin(kMR, mc - ir);
+                    const size_t cols = rsMin(kNR, nc - jr);
+                    for (size_t r = 0; r < rows; r++) {
+                        const size_t i = i0 + ir + r;
+                        T *dst = c + i * ldc + j0 + jr;
+                        for (size_t col = 0; col < cols; col++) {
+                            if (!updates(i, j0 + jr + col)) {
+                                continue;
+                            }
+                            T v = alpha * out[r][col];
+                            if (!first) {
+                                dst[col] += v;
+                            } else if (beta == 0) {
+                                // C is not read, so NaNs in it do not survive.
+                                dst[col] = v;
+                            } else {
+                                dst[col] = beta * dst[col] + v;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+template <typename T>
+static void gemm(RsdCpuReferenceImpl *ctx, bool transA, bool transB, size_t M, size_t N,
+                 size_t K, T alpha, const T *A, size_t lda, const T *B, size_t ldb,
+                 T beta, T *C, size_t ldc, int triangle) {
+    GemmOp<T> op;
+    op.transA = transA;
+    op.transB = transB;
+    op.m = M;
+    op.n = N;
+    op.k = K;
+    op.alpha = alpha;
+    op.beta = beta;
+    op.a = A;
+    op.lda = lda;
+    op.b = B;
+    op.ldb = ldb;
+    op.c = C;
+    op.ldc = ldc;
+    op.triangle = triangle;
+    op.rowTiles = divUp(M, kMC);
+
+    op.scratch = (T *)memalign(64, ctx->getThreadCount() * GemmOp<T>::kScratch * sizeof(T));
+    if (!op.scratch) {
+        ALOGE("Out of memory for BLAS scratch");
+        return;
+    }
+    launchBlas(ctx, &op, op.rowTiles * divUp(N, kNC));
+    free(op.scratch);
+}
+
+// Expands the stored triangle of a symmetric matrix into a full one.
+template <typename T>
+static T * expandSymmetric(const T *A, size_t lda, size_t n, bool upper) {
+    T *full = new T[n * n];
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            bool stored = upper ? j >= i : j <= i;
+            full[i * n + j] = stored ? A[i * lda + j] : A[j * lda + i];
+        }
+    }
+    return full;
+}
+
+template <typename T>
+static void symm(RsdCpuReferenceImpl *ctx, bool left, bool upper, size_t M, size_t N,
+                 T alpha, const T *A, size_t lda, const T *B, size_t ldb,
+                 T beta, T *C, size_t ldc) {
+    // Multiplying by the expanded matrix costs an O(n^2) copy in front of
+    // O(n^2 * k) work, and lets SYMM share the packed GEMM kernel.
+    if (left) {
+        T *full = expandSymmetric(A, lda, M, upper);
+        gemm(ctx, false, false, M, N, M, alpha, (const T *)full, M, B, ldb, beta, C, ldc,
+             kFullMatrix);
+        delete[] full;
+    } else {
+        T *full = expandSymmetric(A, lda, N, upper);
+        gemm(ctx, false, false, M, N, N, alpha, B, ldb, (const T *)full, N, beta, C, ldc,
+             kFullMatrix);
+        delete[] full;
+    }
+}
+
+template <typename T>
+static void syrk(RsdCpuReferenceImpl *ctx, bool upper, bool trans, size_t N, size_t K,
+                 T alpha, const T *A, size_t lda, T beta, T *C, size_t ldc) {
+    // C = alpha * A * A^T + beta * C, or A^T * A when transposed, touching
+    // only the selected triangle of C.
+    gemm(ctx, trans, !trans, N, N, K, alpha, A, lda, A, lda, beta, C, ldc,
+         upper ? kUpperTriangle : kLowerTriangle);
+}
+
+// ---------------------------------------------------------------------------
+// GEMV
+// ---------------------------------------------------------------------------
+
+static const size_t kGemvRows = 32;
+static const size_t kGemvCols = 256;
+
+template <typename T>
+struct GemvOp {
+    typedef typename BlasVec<T>::Type V;
+    static const size_t kLanes = sizeof(V) / sizeof(T);
+
+    bool transA;
+    size_t m, n;
+    T alpha, beta;
+    const T *a;
+    size_t lda;
+    const T *x;     // Contiguous.
+    T *y;
+    size_t incY;
+
+    static T dot(const T *u, const T *v, size_t len) {
+        V s0, s1;
+        memset(&s0, 0, sizeof(s0));
+        memset(&s1, 0, sizeof(s1));
+        size_t j = 0;
+        for (; j + 2 * kLanes <= len; j += 2 * kLanes) {
+            V u0, u1, v0, v1;
+            memcpy(&u0, u + j, sizeof(V));
+            memcpy(&u1, u + j + kLanes, sizeof(V));
+            memcpy(&v0, v + j, sizeof(V));
+            memcpy(&v1, v + j + kLanes, sizeof(V));
+            s0 += u0 * v0;
+            s1 += u1 * v1;
+        }
+        s0 += s1;
+        T lanes[kLanes];
+        memcpy(lanes, &s0, sizeof(V));
+        T sum = 0;
+        for (size_t l = 0; l < kLanes; l++) {
+            sum += lanes[l];
+        }
+        for (; j < len; j++) {
+            sum += u[j] * v[j];
+        }
+        return sum;
+    }
+
+    void store(size_t i, T v) {
+        T *dst = y + i * incY;
+        *dst = beta == 0 ? alpha * v : alpha * v + beta * *dst;
+    }
+
+    void run(uint32_t slice, uint32_t thread) {
+        if (!transA) {
+            // y = alpha * A * x + beta * y: one dot product per row.
+            const size_t i0 = slice * kGemvRows;
+            const size_t i1 = rsMin(i0 + kGemvRows, m);
+            for (size_t i = i0; i < i1; i++) {
+                store(i, dot(a + i * lda, x, n));
+            }
+        } else {
+            // y = alpha * A^T * x + beta * y: accumulate scaled rows of A
+            // into a block of columns, reading A row by row.
+            const size_t j0 = slice * kGemvCols;
+            const size_t nc = rsMin(kGemvCols, n - j0);
+            T acc[kGemvCols];
+            memset(acc, 0, sizeof(acc));
+            for (size_t i = 0; i < m; i++) {
+                const T xi = x[i];
+                const T *row = a + i * lda + j0;
+                for (size_t j = 0; j < nc; j++) {
+                    acc[j] += xi * row[j];
+                }
+            }
+            for (size_t j = 0; j < nc; j++) {
+                store(j0 + j, acc[j]);
+            }
+        }
+    }
+};
+
+template <typename T>
+static void gemv(RsdCpuReferenceImpl *ctx, bool transA, size_t M, size_t N, T alpha,
+                 const T *A, size_t lda, const T *X, size_t incX, T beta, T *Y, size_t incY) {
+    GemvOp<T> op;
+    op.transA = transA;
+    op.m = M;
+    op.n = N;
+    op.alpha = alpha;
+    op.beta = beta;
+    op.a = A;
+    op.lda = lda;
+    op.y = Y;
+    op.incY = incY;
+
+    const size_t lenX = transA ? M : N;
+    T *packedX = nullptr;
+    if (incX != 1) {
+        packedX = new T[lenX];
+        for (size_t ct = 0; ct < lenX; ct++) {
+            packedX[ct] = X[ct * incX];
+        }
+        X = packedX;
+    }
+    op.x = X;
+
+    launchBlas(ctx, &op, transA ? divUp(N, kGemvCols) : divUp(M, kGemvRows));
+    delete[] packedX;
+}
+
+// ---------------------------------------------------------------------------
+// TRSM
+//
+// Solving op(A) * X = alpha * B treats each column of B independently, and
+// X * op(A) = alpha * B each row, so slices take blocks of columns or rows.
+// The updates are written as row operations over contiguous memory, which
+// the compiler vectorizes.
+// ---------------------------------------------------------------------------
+
+static const size_t kTrsmCols = 64;
+static const size_t kTrsmRows = 16;
+
+template <typename T>
+struct TrsmOp {
+    bool left, transA, unitDiag;
+    bool forward;   // Whether the solve walks A from its first row.
+    size_t m, n;
+    T alpha;
+    const T *a;
+    size_t lda;
+    T *b;
+    size_t ldb;
+
+    T opA(size_t i, size_t j) const {
+        return transA ? a[j * lda + i] : a[i * lda + j];
+    }
+
+    static void scale(T *v, size_t len, T s) {
+        for (size_t j = 0; j < len; j++) {
+            v[j] *= s;
+        }
+    }
+    static void axpy(T *v, const T *u, size_t len, T s) {
+        for (size_t j = 0; j < len; j++) {
+            v[j] -= s * u[j];
+        }
+    }
+
+    void runLeft(uint32_t slice) {
+        const size_t j0 = slice * kTrsmCols;
+        const size_t w = rsMin(kTrsmCols, n - j0);
+        for (size_t step = 0; step < m; step++) {
+            const size_t i = forward ? step : m - 1 - step;
+            T *row = b + i * ldb + j0;
+            if (alpha != 1) {
+                scale(row, w, alpha);
+            }
+            // Subtract the rows of X already solved.
+            for (size_t s = 0; s < step; s++) {
+                const size_t p = forward ? s : m - 1 - s;
+                const T l = opA(i, p);
+                if (l != 0) {
+                    axpy(row, b + p * ldb + j0, w, l);
+                }
+            }
+            if (!unitDiag) {
+                scale(row, w, 1 / opA(i, i));
+            }
+        }
+    }
+
+    void runRight(uint32_t slice) {
+        const size_t r0 = slice * kTrsmRows;
+        const size_t r1 = rsMin(r0 + kTrsmRows, m);
+        for (size_t r = r0; r < r1; r++) {
+            T *x = b + r * ldb;
+            if (alpha != 1) {
+                scale(x, n, alpha);
+            }
+            for (size_t step = 0; step < n; step++) {
+                const size_t j = forward ? step : n - 1 - step;
+                if (!unitDiag) {
+                    x[j] /= opA(j, j);
+                }
+                const T xj = x[j];
+                if (xj == 0) {
+                    continue;
+                }
+                // Remove x[j]'s contribution from the entries still to be
+                // solved.
+                if (forward) {
+                    for (size_t q = j + 1; q < n; q++) {
+                        x[q] -= xj * opA(j, q);
+                    }
+                } else {
+                    for (size_t q = 0; q < j; q++) {
+                        x[q] -= xj * opA(j, q);
+                    }
+                }
+            }
+        }
+    }
+
+    void run(uint32_t slice, uint32_t thread) {
+        if (left) {
+            runLeft(slice);
+        } else {
+            runRight(slice);
+        }
+    }
+};
+
+template <typename T>
+static void trsm(RsdCpuReferenceImpl *ctx, bool left, bool upper, bool transA, bool unitDiag,
+                 size_t M, size_t N, T alpha, const T *A, size_t lda, T *B, size_t ldb) {
+    TrsmOp<T> op;
+    op.left = left;
+    op.transA = transA;
+    op.unitDiag = unitDiag;
+    // op(A) is lower triangular when exactly one of 'lower' and 'transposed'
+    // holds.  Solving from the left walks a lower op(A) forwards; solving from
+    // the right walks an upper one forwards.
+    const bool lowerOp = upper == transA;
+    op.forward = left ? lowerOp : !lowerOp;
+    op.m = M;
+    op.n = N;
+    op.alpha = alpha;
+    op.a = A;
+    op.lda = lda;
+    op.b = B;
+    op.ldb = ldb;
+
+    launchBlas(ctx, &op, left ? divUp(N, kTrsmCols) : divUp(M, kTrsmRows));
+}
+
+// ---------------------------------------------------------------------------
+// Entry points
+// ---------------------------------------------------------------------------
+
+void rsdBuiltin_sgemv(RsdCpuReferenceImpl *ctx, bool transA, int M, int N,
+                      float alpha, const float *A, int lda, const float *X, int incX,
+                      float beta, float *Y, int incY) {
+    gemv(ctx, transA, M, N, alpha, A, lda, X, incX, beta, Y, incY);
+}
+
+void rsdBuiltin_dgemv(RsdCpuReferenceImpl *ctx, bool transA, int M, int N,
+                      double alpha, const double *A, int lda, const double *X, int incX,
+                      double beta, double *Y, int incY) {
+    gemv(ctx, transA, M, N, alpha, A, lda, X, incX, beta, Y, incY);
+}
+
+void rsdBuiltin_sgemm(RsdCpuReferenceImpl *ctx, bool transA, bool transB,
+                      int M, int N, int K, float alpha, const float *A, int lda,
+                      const float *B, int ldb, float beta, float *C, int ldc) {
+    gemm(ctx, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, kFullMatrix);
+}
+
+void rsdBuiltin_dgemm(RsdCpuReferenceImpl *ctx, bool transA, bool transB,
+                      int M, int N, int K, double alpha, const double *A, int lda,
+                      const double *B, int ldb, double beta, double *C, int ldc) {
+    gemm(ctx, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, kFullMatrix);
+}
+
+void rsdBuiltin_ssymm(RsdCpuReferenceImpl *ctx, bool left, bool upper, int M, int N,
+                      float alpha, const float *A, int lda, const float *B, int ldb,
+                      float beta, float *C, int ldc) {
+    symm(ctx, left, upper, M, N, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void rsdBuiltin_dsymm(RsdCpuReferenceImpl *ctx, bool left, bool upper, int M, int N,
+                      double alpha, const double *A, int lda, const double *B, int ldb,
+                      double beta, double *C, int ldc) {
+    symm(ctx, left, upper, M, N, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void rsdBuiltin_ssyrk(RsdCpuReferenceImpl *ctx, bool upper, bool trans,
+                      int N, int K, float alpha, const float *A, int lda,
+                      float beta, float *C, int ldc) {
+    syrk(ctx, upper, trans, N, K, alpha, A, lda, beta, C, ldc);
+}
+
+void rsdBuiltin_dsyrk(RsdCpuReferenceImpl *ctx, bool upper, bool trans,
+                      int N, int K, double alpha, const double *A, int lda,
+                      double beta, double *C, int ldc) {
+    syrk(ctx, upper, trans, N, K, alpha, A, lda, beta, C, ldc);
+}
+
+void rsdBuiltin_strsm(RsdCpuReferenceImpl *ctx, bool left, bool upper,
+                      bool transA, bool unitDiag, int M, int N,
+                      float alpha, const float *A, int lda, float *B, int ldb) {
+    trsm(ctx, left, upper, transA, unitDiag, M, N, alpha, A, lda, B, ldb);
+}
+
+void rsdBuiltin_dtrsm(RsdCpuReferenceImpl *ctx, bool left, bool upper,
+                      bool transA, bool unitDiag, int M, int N,
+                      double alpha, const double *A, int lda, double *B, int ldb) {
+    trsm(ctx, left, upper, transA, unitDiag, M, N, alpha, A, lda, B, ldb);
+}
+
+}
+}
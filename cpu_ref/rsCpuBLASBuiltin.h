@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RSD_CPU_BLAS_BUILTIN_H
+#define RSD_CPU_BLAS_BUILTIN_H
+
+#include <stddef.h>
+
+namespace android {
+namespace renderscript {
+
+class RsdCpuReferenceImpl;
+
+// Self-contained implementations of the most used real BLAS routines, run
+// on the CPU driver's worker pool.  They back the BLAS intrinsic when no
+// BLAS library can be loaded.  Only row-major storage and positive vector
+// increments are supported, which is all the intrinsic ever passes.  The
+// CBLAS enums are passed as flags, as the dispatch header that declares them
+// in compatibility builds can only be included once.
+
+void rsdBuiltin_sgemv(RsdCpuReferenceImpl *ctx, bool transA, int M, int N,
+                      float alpha, const float *A, int lda, const float *X, int incX,
+                      float beta, float *Y, int incY);
+void rsdBuiltin_dgemv(RsdCpuReferenceImpl *ctx, bool transA, int M, int N,
+                      double alpha, const double *A, int lda, const double *X, int incX,
+                      double beta, double *Y, int incY);
+
+void rsdBuiltin_sgemm(RsdCpuReferenceImpl *ctx, bool transA, bool transB,
+                      int M, int N, int K, float alpha, const float *A, int lda,
+                      const float *B, int ldb, float beta, float *C, int ldc);
+void rsdBuiltin_dgemm(RsdCpuReferenceImpl *ctx, bool transA, bool transB,
+                      int M, int N, int K, double alpha, const double *A, int lda,
+                      const double *B, int ldb, double beta, double *C, int ldc);
+
+void rsdBuiltin_ssymm(RsdCpuReferenceImpl *ctx, bool left, bool upper, int M, int N,
+                      float alpha, const float *A, int lda, const float *B, int ldb,
+                      float beta, float *C, int ldc);
+void rsdBuiltin_dsymm(RsdCpuReferenceImpl *ctx, bool left, bool upper, int M, int N,
+                      double alpha, const double *A, int lda, const double *B, int ldb,
+                      double beta, double *C, int ldc);
+
+void rsdBuiltin_ssyrk(RsdCpuReferenceImpl *ctx, bool upper, bool trans,
+                      int N, int K, float alpha, const float *A, int lda,
+                      float beta, float *C, int ldc);
+void rsdBuiltin_dsyrk(RsdCpuReferenceImpl *ctx, bool upper, bool trans,
+                      int N, int K, double alpha, const double *A, int lda,
+                      double beta, double *C, int ldc);
+
+void rsdBuiltin_strsm(RsdCpuReferenceImpl *ctx, bool left, bool upper,
+                      bool transA, bool unitDiag, int M, int N,
+                      float alpha, const float *A, int lda, float *B, int ldb);
+void rsdBuiltin_dtrsm(RsdCpuReferenceImpl *ctx, bool left, bool upper,
+                      bool transA, bool unitDiag, int M, int N,
+                      double alpha, const double *A, int lda, double *B, int ldb);
+
+}
+}
+
+#endif
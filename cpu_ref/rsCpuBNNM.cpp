@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsCpuBNNM.h"
+
+#include <malloc.h>
+#include <string.h>
+
+#if defined(ARCH_ARM_HAVE_NEON) || defined(ARCH_ARM64_HAVE_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <x86intrin.h>
+#endif
+
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
+namespace android {
+namespace renderscript {
+
+// Calculations are done in 1.10.21 fixed-point format for the final output,
+// just before there's a shift down to drop the fractional parts. The output
+// values are gated to 0 to 255 to fit in a byte, but the 10-bit format
+// gives some headroom to avoid wrapping around on small overflows.
+static const int kShift = 21;
+
+// Rows of A and of B per packed panel, and bytes of k per packed chunk.
+static const size_t kPanelRows = 4;
+static const size_t kChunk = 16;
+
+// Bytes of A one output tile may pack before it stops fitting comfortably in
+// a mid-level cache alongside its panels of B.
+static const size_t kTileBytes = 128 * 1024;
+static const size_t kMaxTilePanels = 16;
+
+static inline uint8_t Requantize(const BNNMArgs *args, int32_t total) {
+    // Wrap rather than overflow, exactly as the int32 arithmetic of the
+    // reference loop does on every target.
+    int32_t output = (int32_t)(((uint32_t)total + (uint32_t)args->c_offset) *
+                               (uint32_t)args->c_mult_int + (1u << (kShift - 1)));
+    output >>= kShift;
+    if (output > 255) {
+        output = 255;
+    }
+    if (output < 0) {
+        output = 0;
+    }
+    return (uint8_t)output;
+}
+
+void rsdBNNMReference(const BNNMArgs *args) {
+    size_t i = 0, j = 0, l = 0;
+    for (j = 0; j < args->n; j++) {
+        for (i = 0; i < args->m; i++) {
+            int32_t total = 0;
+            for (l = 0; l < args->k; l++) {
+                const int32_t a_as_int = ((int32_t)args->a[(i * args->lda) + l]) - args->a_offset;
+                const int32_t b_as_int = ((int32_t)args->b[(j * args->ldb) + l]) - args->b_offset;
+                total += a_as_int * b_as_int;
+            }
+            args->c[(args->ldc * i) + j] = Requantize(args, total);
+        }
+    }
+}
+
+// Copies rows of src into panels of kPanelRows rows.  Each panel holds
+// kPadded / kChunk chunks, and each chunk holds kChunk bytes of k from each
+// of the panel's rows in turn.  Rows past the end and k past the end are
+// zero, so they add nothing to the dot products.
+static void PackPanels(uint8_t *dst, uint32_t *sums, const uint8_t *src, size_t rows,
+                       size_t ld, size_t k, size_t kPadded, size_t panels) {
+    memset(dst, 0, panels * kPanelRows * kPadded);
+    for (size_t r = 0; r < rows; r++) {
+        const uint8_t *row = src + r * ld;
+        uint8_t *out = dst + (r / kPanelRows) * kPanelRows * kPadded + (r % kPanelRows) * kChunk;
+        uint32_t sum = 0;
+        for (size_t l = 0; l < k; l += kChunk) {
+            size_t len = k - l < kChunk ? k - l : kChunk;
+            memcpy(out, row + l, len);
+            for (size_t ct = 0; ct < len; ct++) {
+                sum += row[l + ct];
+            }
+            out += kPanelRows * kChunk;
+        }
+        sums[r] = sum;
+    }
+}
+
+// Raw dot products of the four rows of panel a with the four rows of
+// panel b, out[4 * row + col], over 'chunks' chunks of k.
+#if defined(ARCH_ARM_HAVE_NEON) || defined(ARCH_ARM64_HAVE_NEON)
+
+static void DotPanels(const uint8_t *a, const uint8_t *b, size_t chunks, uint32_t *out) {
+    uint32x4_t acc[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            acc[r][c] = vdupq_n_u32(0);
+        }
+    }
+    for (size_t ct = 0; ct < chunks; ct++) {
+        uint8x16_t av[4], bv[4];
+        for (int r = 0; r < 4; r++) {
+            av[r] = vld1q_u8(a + r * kChunk);
+            bv[r] = vld1q_u8(b + r * kChunk);
+        }
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                // 255 * 255 fits in 16 bits, so the widening multiply is
+                // exact and pairs are added straight into 32-bit lanes.
+                acc[r][c] = vpadalq_u16(acc[r][c], vmull_u8(vget_low_u8(av[r]),
+                                                            vget_low_u8(bv[c])));
+                acc[r][c] = vpadalq_u16(acc[r][c], vmull_u8(vget_high_u8(av[r]),
+                                                            vget_high_u8(bv[c])));
+            }
+        }
+        a += kPanelRows * kChunk;
+        b += kPanelRows * kChunk;
+    }
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            uint64x2_t s = vpaddlq_u32(acc[r][c]);
+            out[r * 4 + c] = (uint32_t)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+        }
+    }
+}
+
+#elif defined(__SSE2__)
+
+static void DotPanels(const uint8_t *a, const uint8_t *b, size_t chunks, uint32_t *out) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            acc[r][c] = zero;
+        }
+    }
+    for (size_t ct = 0; ct < chunks; ct++) {
+        __m128i alo[4], ahi[4], blo[4], bhi[4];
+        for (int r = 0; r < 4; r++) {
+            __m128i av = _mm_load_si128((const __m128i *)(a + r * kChunk));
+            __m128i bv = _mm_load_si128((const __m128i *)(b + r * kChunk));
+            alo[r] = _mm_unpacklo_epi8(av, zero);
+            ahi[r] = _mm_unpackhi_epi8(av, zero);
+            blo[r] = _mm_unpacklo_epi8(bv, zero);
+            bhi[r] = _mm_unpackhi_epi8(bv, zero);
+        }
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                // The widened bytes are at most 255, so the signed 16-bit
+                // multiply-add is exact.
+                acc[r][c] = _mm_add_epi32(acc[r][c], _mm_madd_epi16(alo[r], blo[c]));
+                acc[r][c] = _mm_add_epi32(acc[r][c], _mm_madd_epi16(ahi[r], bhi[c]));
+            }
+        }
+        a += kPanelRows * kChunk;
+        b += kPanelRows * kChunk;
+    }
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            __m128i s = acc[r][c];
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+            out[r * 4 + c] = (uint32_t)_mm_cvtsi128_si32(s);
+        }
+    }
+}
+
+#else
+
+static void DotPanels(const uint8_t *a, const uint8_t *b, size_t chunks, uint32_t *out) {
+    memset(out, 0, 16 * sizeof(uint32_t));
+    for (size_t ct = 0; ct < chunks; ct++) {
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                uint32_t sum = 0;
+                for (size_t l = 0; l < kChunk; l++) {
+                    sum += a[r * kChunk + l] * b[c * kChunk + l];
+                }
+                out[r * 4 + c] += sum;
+            }
+        }
+        a += kPanelRows * kChunk;
+        b += kPanelRows * kChunk;
+    }
+}
+
+#endif
+
+#if defined(ARCH_X86_HAVE_SSSE3)
+
+// The library is built for SSSE3, so this carries its own target attribute
+// and is only reached through gX86Kernels once cpuid has reported AVX2.
+__attribute__((target("avx2,fma")))
+void rsdBNNMDotPanels_AVX2(const uint8_t *a, const uint8_t *b, size_t chunks, uint32_t *out) {
+    __m256i acc[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            acc[r][c] = _mm256_setzero_si256();
+        }
+    }
+    for (size_t ct = 0; ct < chunks; ct++) {
+        __m256i av[4], bv[4];
+        for (int r = 0; r < 4; r++) {
+            av[r] = _mm256_cvtepu8_epi16(_mm_load_si128((const __m128i *)(a + r * kChunk)));
+            bv[r] = _mm256_cvtepu8_epi16(_mm_load_si128((const __m128i *)(b + r * kChunk)));
+        }
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                acc[r][c] = _mm256_add_epi32(acc[r][c], _mm256_madd_epi16(av[r], bv[c]));
+            }
+        }
+        a += kPanelRows * kChunk;
+        b += kPanelRows * kChunk;
+    }
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc[r][c]),
+                                      _mm256_extracti128_si256(acc[r][c], 1));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+            out[r * 4 + c] = (uint32_t)_mm_cvtsi128_si32(s);
+        }
+    }
+}
+
+#endif
+
+bool rsdBNNMPrepare(BNNMPlan *plan, const BNNMArgs *args) {
+    memset(plan, 0, sizeof(BNNMPlan));
+    plan->args = args;
+    plan->kPadded = (args->k + kChunk - 1) / kChunk * kChunk;
+    plan->aPanels = (args->m + kPanelRows - 1) / kPanelRows;
+    plan->bPanels = (args->n + kPanelRows - 1) / kPanelRows;
+
+    size_t tilePanels = kTileBytes / (kPanelRows * plan->kPadded + 1);
+    if (tilePanels < 1) {
+        tilePanels = 1;
+    }
+    if (tilePanels > kMaxTilePanels) {
+        tilePanels = kMaxTilePanels;
+    }
+    plan->tilePanels = tilePanels;
+    plan->rowTiles = (plan->aPanels + tilePanels - 1) / tilePanels;
+    plan->colTiles = (plan->bPanels + tilePanels - 1) / tilePanels;
+
+    size_t aBytes = plan->aPanels * kPanelRows * plan->kPadded;
+    size_t bBytes = plan->bPanels * kPanelRows * plan->kPadded;
+    plan->packedA = (uint8_t *)memalign(64, aBytes ? aBytes : kChunk);
+    plan->packedB = (uint8_t *)memalign(64, bBytes ? bBytes : kChunk);
+    plan->aSums = new uint32_t[args->m + 1];
+    plan->bSums = new uint32_t[args->n + 1];
+    if (!plan->packedA || !plan->packedB) {
+        rsdBNNMRelease(plan);
+        return false;
+    }
+
+    PackPanels(plan->packedA, plan->aSums, args->a, args->m, args->lda, args->k,
+               plan->kPadded, plan->aPanels);
+    PackPanels(plan->packedB, plan->bSums, args->b, args->n, args->ldb, args->k,
+               plan->kPadded, plan->bPanels);
+    return true;
+}
+
+void rsdBNNMRunTile(const BNNMPlan *plan, size_t tile) {
+    const BNNMArgs *args = plan->args;
+    const size_t panelBytes = kPanelRows * plan->kPadded;
+    const size_t chunks = plan->kPadded / kChunk;
+
+    size_t aBegin = (tile % plan->rowTiles) * plan->tilePanels;
+    size_t bBegin = (tile / plan->rowTiles) * plan->tilePanels;
+    size_t aEnd = aBegin + plan->tilePanels;
+    size_t bEnd = bBegin + plan->tilePanels;
+    if (aEnd > plan->aPanels) aEnd = plan->aPanels;
+    if (bEnd > plan->bPanels) bEnd = plan->bPanels;
+
+    // Expanding (a - ao) * (b - bo) leaves the raw products plus terms that
+    // depend only on the row sums, so the inner kernel can multiply the
+    // unsigned bytes directly.  All of this is modulo 2^32, which gives the
+    // same bits as the reference loop's int32 sum.
+    const uint32_t ao = args->a_offset;
+    const uint32_t bo = args->b_offset;
+    const uint32_t bias = (uint32_t)args->k * ao * bo;
+
+#if defined(ARCH_X86_HAVE_SSSE3)
+    void (*dotPanels)(const uint8_t *, const uint8_t *, size_t, uint32_t *) =
+            gX86Kernels.bnnmDotPanels ? gX86Kernels.bnnmDotPanels : DotPanels;
+#else
+    void (*dotPanels)(const uint8_t *, const uint8_t *, size_t, uint32_t *) = DotPanels;
+#endif
+
+    uint32_t dots[16];
+    for (size_t bp = bBegin; bp < bEnd; bp++) {
+        const uint8_t *b = plan->packedB + bp * panelBytes;
+        for (size_t ap = aBegin; ap < aEnd; ap++) {
+            dotPanels(plan->packedA + ap * panelBytes, b, chunks, dots);
+
+            for (size_t r = 0; r < kPanelRows; r++) {
+                size_t i = ap * kPanelRows + r;
+                if (i >= args->m) {
+                    break;
+                }
+                uint8_t *c = args->c + i * args->ldc;
+                for (size_t col = 0; col < kPanelRows; col++) {
+                    size_t j = bp * kPanelRows + col;
+                    if (j >= args->n) {
+                        break;
+                    }
+                    uint32_t total = dots[r * 4 + col] - bo * plan->aSums[i] -
+                                     ao * plan->bSums[j] + bias;
+                    c[j] = Requantize(args, (int32_t)total);
+                }
+            }
+        }
+    }
+}
+
+void rsdBNNMRelease(BNNMPlan *plan) {
+    free(plan->packedA);
+    free(plan->packedB);
+    delete[] plan->aSums;
+    delete[] plan->bSums;
+    plan->packedA = nullptr;
+    plan->packedB = nullptr;
+    plan->aSums = nullptr;
+    plan->bSums = nullptr;
+}
+
+}
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RSD_CPU_BNNM_H
+#define RSD_CPU_BNNM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+namespace renderscript {
+
+// Arguments of the 8-bit matrix multiply behind the BLAS intrinsic's BNNM:
+//
+//   C[i][j] = clamp((((sum_l (A[i][l] - a_offset) * (B[j][l] - b_offset)) +
+//                     c_offset) * c_mult_int) >> 21, 0, 255)
+//
+// A is m x k and B is n x k, both row-major, so each output is the dot
+// product of two contiguous rows.  The shift rounds to nearest.
+struct BNNMArgs {
+    size_t m, n, k;
+    const uint8_t *a;
+    uint8_t a_offset;
+    size_t lda;
+    const uint8_t *b;
+    uint8_t b_offset;
+    size_t ldb;
+    uint8_t *c;
+    int32_t c_offset;
+    size_t ldc;
+    int32_t c_mult_int;
+};
+
+// A BNNM prepared for the blocked kernel.  A and B are repacked once into
+// panels of four rows, interleaved 16 bytes of k at a time, so the inner
+// kernel streams both operands sequentially.  The output is split into
+// tiles that can be computed independently, in any order and on any thread.
+struct BNNMPlan {
+    const BNNMArgs *args;
+    size_t kPadded;        // k rounded up to a whole number of 16-byte chunks.
+    size_t aPanels;        // Four-row panels of A.
+    size_t bPanels;        // Four-row panels of B.
+    size_t tilePanels;     // Panels of A and of B covered by one output tile.
+    size_t rowTiles;
+    size_t colTiles;
+    uint8_t *packedA;
+    uint8_t *packedB;
+    uint32_t *aSums;       // Row sums of A, for folding out b_offset.
+    uint32_t *bSums;       // Row sums of B, for folding out a_offset.
+};
+
+// The straightforward triple loop, kept as the definition of the result.
+void rsdBNNMReference(const BNNMArgs *args);
+
+// Packs the operands of args into plan.  Returns false if memory for the
+// packed copies could not be allocated.  args must outlive the plan.
+bool rsdBNNMPrepare(BNNMPlan *plan, const BNNMArgs *args);
+
+static inline size_t rsdBNNMTileCount(const BNNMPlan *plan) {
+    return plan->rowTiles * plan->colTiles;
+}
+
+// Computes output tile 'tile' of a prepared plan.  Tiles are numbered so
+// that consecutive tiles share the same panels of B.
+void rsdBNNMRunTile(const BNNMPlan *plan, size_t tile);
+
+void rsdBNNMRelease(BNNMPlan *plan);
+
+}
+}
+
+#endif
@@ -28,8 +28,14 @@
 #include <sys/syscall.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include <cpuid.h>
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
 #if !defined(RS_SERVER) && !defined(RS_COMPATIBILITY_LIB)
 #include <cutils/properties.h>
 #include "utils/StopWatch.h"
@@ -105,8 +111,25 @@ RsdCpuReferenceImpl::RsdCpuReferenceImpl(Context *rsc) {
 
     version_major = 0;
     version_minor = 0;
-    mInForEach = false;
+    mInForEach = 0;
+    mL1CacheBytes = 32 * 1024;
+    mL2CacheBytes = 512 * 1024;
+    mAffinityPolicy = AFFINITY_NONE;
+    mAffinityApplied = false;
+    mCpuCount = 0;
+    mClusterCount = 0;
+    mCpuOrder = nullptr;
+    mCpuCluster = nullptr;
     memset(&mWorkers, 0, sizeof(mWorkers));
+    pthread_mutex_init(&mLaunchLock, nullptr);
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mOuterLaunchLock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    mLaunchHead = nullptr;
+    mLaunchTail = nullptr;
+    mPendingLaunches = 0;
     memset(&mTlsStruct, 0, sizeof(mTlsStruct));
     mExit = false;
     mLinkRuntimeCallback = nullptr;
@@ -117,6 +140,23 @@ RsdCpuReferenceImpl::RsdCpuReferenceImpl(Context *rsc) {
 }
 
 
+// Bounds for the number of polls a helper makes on its ticket before parking
+// on its launch signal.  The budget doubles whenever work shows up while
+// spinning and halves whenever the helper has to park, so back-to-back
+// launches avoid the futex round-trip while idle helpers stop burning cycles.
+static const uint32_t kMinSpin = 64;
+static const uint32_t kMaxSpin = 16 * 1024;
+
+static inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
 void * RsdCpuReferenceImpl::helperThreadProc(void *vrsc) {
     RsdCpuReferenceImpl *dc = (RsdCpuReferenceImpl *)vrsc;
 
@@ -133,58 +173,445 @@ void * RsdCpuReferenceImpl::helperThreadProc(void *vrsc) {
         ALOGE("pthread_setspecific %i", status);
     }
 
-#if 0
-    typedef struct {uint64_t bits[1024 / 64]; } cpu_set_t;
-    cpu_set_t cpuset;
-    memset(&cpuset, 0, sizeof(cpuset));
-    cpuset.bits[idx / 64] |= 1ULL << (idx % 64);
-    int ret = syscall(241, rsc->mWorkers.mNativeThreadId[idx],
-              sizeof(cpuset), &cpuset);
-    ALOGE("SETAFFINITY ret = %i %s", ret, EGLUtils::strerror(ret));
-#endif
+    dc->applyAffinity(idx);
 
+    // Tell init() this helper is ready.
+    __sync_fetch_and_sub(&dc->mWorkers.mRunningCount, 1);
+
+    uint32_t ticket = 0;
     while (!dc->mExit) {
-        dc->mWorkers.mLaunchSignals[idx].wait();
-        if (dc->mWorkers.mLaunchCallback) {
-           // idx +1 is used because the calling thread is always worker 0.
-           dc->mWorkers.mLaunchCallback(dc->mWorkers.mLaunchData, idx+1);
-        }
-        __sync_fetch_and_sub(&dc->mWorkers.mRunningCount, 1);
-        dc->mWorkers.mCompleteSignal.set();
+        ticket = dc->waitForLaunch(idx, ticket);
+        // idx +1 is used because the command thread is always worker 0.
+        dc->runLaunches(idx + 1);
     }
+    __sync_fetch_and_sub(&dc->mWorkers.mRunningCount, 1);
 
     //ALOGV("RS helperThread exited %p idx=%i", dc, idx);
     return nullptr;
 }
 
+static const uint32_t kAnyCluster = 0xffffffff;
+
+static uint32_t ReadCpuValue(uint32_t cpu, const char *node, uint32_t defaultValue) {
+    char path[128];
+    uint32_t value = defaultValue;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/%s", cpu, node);
+    FILE *f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%u", &value) != 1) {
+            value = defaultValue;
+        }
+        fclose(f);
+    }
+    return value;
+}
+
+// Groups the cores into clusters (cores of one package with the same
+// cluster id, or the same maximum frequency where the kernel does not report
+// cluster ids) and orders them fastest cluster first.
+void RsdCpuReferenceImpl::readCpuTopology() {
+    uint32_t count = mCpuCount;
+    uint32_t *key = new uint32_t[count * 3];
+    uint32_t *freq = new uint32_t[count];
+
+    mCpuOrder = new uint32_t[count];
+    mCpuCluster = new uint32_t[count];
+    mClusterCount = 0;
+
+    for (uint32_t cpu = 0; cpu < count; cpu++) {
+        uint32_t package = ReadCpuValue(cpu, "topology/physical_package_id", 0);
+        uint32_t cluster = ReadCpuValue(cpu, "topology/cluster_id", kAnyCluster);
+        freq[cpu] = ReadCpuValue(cpu, "cpufreq/cpuinfo_max_freq", 0);
+
+        uint32_t c = 0;
+        for (; c < mClusterCount; c++) {
+            if (key[c * 3] == package && key[c * 3 + 1] == cluster &&
+                (cluster != kAnyCluster || key[c * 3 + 2] == freq[cpu])) {
+                break;
+            }
+        }
+        if (c == mClusterCount) {
+            key[c * 3] = package;
+            key[c * 3 + 1] = cluster;
+            key[c * 3 + 2] = freq[cpu];
+            mClusterCount++;
+        }
+        mCpuCluster[cpu] = c;
+    }
+
+    // Renumber clusters from fastest to slowest, keeping discovery order
+    // between clusters of equal speed, and list the cores in that order.
+    uint32_t *rank = new uint32_t[mClusterCount];
+    for (uint32_t c = 0; c < mClusterCount; c++) {
+        rank[c] = 0;
+        for (uint32_t o = 0; o < mClusterCount; o++) {
+            if (key[o * 3 + 2] > key[c * 3 + 2] ||
+                (key[o * 3 + 2] == key[c * 3 + 2] && o < c)) {
+                rank[c]++;
+            }
+        }
+    }
+    uint32_t n = 0;
+    for (uint32_t r = 0; r < mClusterCount; r++) {
+        for (uint32_t cpu = 0; cpu < count; cpu++) {
+            if (rank[mCpuCluster[cpu]] == r) {
+                mCpuOrder[n++] = cpu;
+            }
+        }
+    }
+    for (uint32_t cpu = 0; cpu < count; cpu++) {
+        mCpuCluster[cpu] = rank[mCpuCluster[cpu]];
+    }
+
+    delete[] rank;
+    delete[] freq;
+    delete[] key;
+}
+
+// Confines helper idx according to the current affinity policy.  Worker
+// index 0, the command thread, belongs to the application and is left alone;
+// helpers take the following cores so the first helpers land on the fastest
+// cluster.
+void RsdCpuReferenceImpl::applyAffinity(uint32_t idx) {
+    uint32_t lid = idx + 1;
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    uint32_t cluster = kAnyCluster;
+
+    switch (mAffinityPolicy) {
+    case AFFINITY_PIN:
+    case AFFINITY_CLUSTER: {
+        uint32_t cpu = mCpuOrder[lid % mCpuCount];
+        cluster = mCpuCluster[cpu];
+        for (uint32_t ct = 0; ct < mCpuCount; ct++) {
+            if (mAffinityPolicy == AFFINITY_CLUSTER ? mCpuCluster[ct] == cluster : ct == cpu) {
+                CPU_SET(ct, &cpuset);
+            }
+        }
+        break;
+    }
+    case AFFINITY_SPREAD: {
+        // Deal worker indices round-robin over the clusters, then take the
+        // next free core within the chosen cluster.
+        uint32_t target = lid % mClusterCount;
+        uint32_t nth = lid / mClusterCount;
+        uint32_t size = 0;
+        for (uint32_t ct = 0; ct < mCpuCount; ct++) {
+            size += mCpuCluster[mCpuOrder[ct]] == target;
+        }
+        nth %= size;
+        for (uint32_t ct = 0; ct < mCpuCount; ct++) {
+            uint32_t cpu = mCpuOrder[ct];
+            if (mCpuCluster[cpu] == target && nth-- == 0) {
+                CPU_SET(cpu, &cpuset);
+                break;
+            }
+        }
+        cluster = target;
+        break;
+    }
+    default:
+        // Keep the mask the helper inherited, which may be narrowed by a
+        // cpuset, unless an earlier policy replaced it.
+        mWorkers.mCluster[lid] = kAnyCluster;
+        if (!mAffinityApplied) {
+            return;
+        }
+        cpuset = mInheritedCpuSet;
+        break;
+    }
+
+    mWorkers.mCluster[lid] = cluster;
+    if (sched_setaffinity(mWorkers.mNativeThreadId[idx], sizeof(cpuset), &cpuset)) {
+        ALOGW("Failed to set affinity of RS helper %u", idx);
+    }
+}
+
+void RsdCpuReferenceImpl::setAffinityPolicy(AffinityPolicy policy) {
+    mAffinityPolicy = policy;
+    for (uint32_t ct = 0; ct < mWorkers.mCount; ct++) {
+        applyAffinity(ct);
+    }
+    mAffinityApplied = policy != AFFINITY_NONE;
+}
+
+// Returns the worker index of the calling thread.  Helpers are 1..mCount;
+// anything else acts as worker 0, which launchThreads() keeps to one thread
+// at a time.
+uint32_t RsdCpuReferenceImpl::getThreadIndex() const {
+    pid_t tid = gettid();
+    for (uint32_t ct = 0; ct < mWorkers.mCount; ct++) {
+        if (mWorkers.mNativeThreadId[ct] == tid) {
+            return ct + 1;
+        }
+    }
+    return 0;
+}
+
+// Blocks helper idx until a launcher hands it a ticket other than the one
+// it last ran, spinning briefly before parking on its launch signal.
+uint32_t RsdCpuReferenceImpl::waitForLaunch(uint32_t idx, uint32_t ticket) {
+    WorkerSlot *slot = &mWorkers.mSlots[idx];
+
+    // Advertise that we can be claimed, then look once more for a launch
+    // posted while we were finishing the previous one.  If a launcher claims
+    // us first it also bumps our ticket, so either way we do not miss it.
+    __sync_lock_test_and_set(&slot->mIdle, 1);
+    __sync_synchronize();
+    if (mPendingLaunches && __sync_bool_compare_and_swap(&slot->mIdle, 1, 0)) {
+        return slot->mTicket;
+    }
+
+    for (uint32_t ct = 0; ct < slot->mSpinLimit; ct++) {
+        if (slot->mTicket != ticket) {
+            slot->mSpinLimit = rsMin(slot->mSpinLimit * 2, kMaxSpin);
+            __sync_synchronize();
+            return slot->mTicket;
+        }
+        cpuRelax();
+    }
+
+    // Publish that we are about to sleep before the final check so that a
+    // launcher bumping the ticket concurrently is guaranteed to wake us.
+    __sync_lock_test_and_set(&slot->mParked, 1);
+    __sync_synchronize();
+    while (slot->mTicket == ticket) {
+        mWorkers.mLaunchSignals[idx].wait();
+    }
+    __sync_lock_test_and_set(&slot->mParked, 0);
+    slot->mSpinLimit = rsMax(slot->mSpinLimit / 2, kMinSpin);
+    __sync_synchronize();
+    return slot->mTicket;
+}
+
+void RsdCpuReferenceImpl::wakeWorker(uint32_t idx) {
+    WorkerSlot *slot = &mWorkers.mSlots[idx];
+    __sync_fetch_and_add(&slot->mTicket, 1);
+    if (__sync_lock_test_and_set(&slot->mParked, 0)) {
+        mWorkers.mLaunchSignals[idx].set();
+    }
+}
+
+// Picks the oldest launch that still has slices to hand out and registers
+// the calling helper with it.
+MTLaunchStruct * RsdCpuReferenceImpl::joinLaunch() {
+    pthread_mutex_lock(&mLaunchLock);
+    MTLaunchStruct *mtls = mLaunchHead;
+    while (mtls && mtls->mExhausted) {
+        mtls = mtls->mNext;
+    }
+    if (mtls) {
+        __sync_fetch_and_add(&mtls->mActiveThreads, 1);
+    }
+    pthread_mutex_unlock(&mLaunchLock);
+    return mtls;
+}
+
+void RsdCpuReferenceImpl::retireLaunch(MTLaunchStruct *mtls) {
+    if (__sync_bool_compare_and_swap(&mtls->mExhausted, 0, 1)) {
+        __sync_fetch_and_sub(&mPendingLaunches, 1);
+    }
+}
+
+void RsdCpuReferenceImpl::runLaunches(uint32_t idx) {
+    while (MTLaunchStruct *mtls = joinLaunch()) {
+        mtls->mWalker(mtls, idx);
+        retireLaunch(mtls);
+
+        // The launcher may return as soon as the count drops to zero, so
+        // nothing in mtls may be touched after the decrement.
+        Signal *launcherSignal = mtls->mLauncherSignal;
+        if (__sync_fetch_and_sub(&mtls->mActiveThreads, 1) == 1) {
+            launcherSignal->set();
+        }
+    }
+}
+
+void RsdCpuReferenceImpl::waitForLaunchCompletion(MTLaunchStruct *mtls) {
+    for (uint32_t ct = 0; ct < kMaxSpin; ct++) {
+        if (mtls->mActiveThreads == 0) {
+            __sync_synchronize();
+            return;
+        }
+        cpuRelax();
+    }
+    while (__sync_fetch_and_or(&mtls->mActiveThreads, 0) != 0) {
+        mtls->mLauncherSignal->wait();
+    }
+}
+
+static inline uint64_t PackRange(uint32_t begin, uint32_t end) {
+    return ((uint64_t)begin << 32) | end;
+}
+
+static inline uint64_t LoadRange(SliceQueue *q) {
+#if defined(__LP64__)
+    return q->mRange;
+#else
+    // 64-bit loads are not single-copy atomic on 32-bit targets.
+    return __sync_fetch_and_or(&q->mRange, 0);
+#endif
+}
+
+// Returns the next slice for thread idx, popping from its own queue first and
+// otherwise stealing the back half of another thread's remaining range.
+// Returns false once every queue of the launch is empty.
+bool RsdCpuReferenceImpl::nextSlice(MTLaunchStruct *mtls, uint32_t idx, uint32_t *slice) {
+    // Serial launches use a single queue whichever thread runs them.
+    SliceQueue *own = &mtls->mQueues[mtls->mQueueCount > 1 ? idx : 0];
+
+    while (true) {
+        uint64_t r = LoadRange(own);
+        uint32_t begin = (uint32_t)(r >> 32);
+        uint32_t end = (uint32_t)r;
+        if (begin >= end) {
+            break;
+        }
+        if (__sync_bool_compare_and_swap(&own->mRange, r, PackRange(begin + 1, end))) {
+            *slice = begin;
+            return true;
+        }
+    }
+
+    // Steal from threads in our own cluster first: their ranges sit next to
+    // ours and their caches are shared with us.
+    const volatile uint32_t *clusters = mtls->rsc->mWorkers.mCluster;
+    const uint32_t ownCluster = clusters[idx];
+    for (uint32_t ct = 1; ct < 2 * mtls->mQueueCount; ct++) {
+        uint32_t v = (idx + ct) % mtls->mQueueCount;
+        bool sameCluster = ownCluster == clusters[v] || ownCluster == kAnyCluster ||
+                           clusters[v] == kAnyCluster;
+        if (sameCluster != (ct < mtls->mQueueCount) || v == idx) {
+            continue;
+        }
+        SliceQueue *victim = &mtls->mQueues[v];
+        while (true) {
+            uint64_t r = LoadRange(victim);
+            uint32_t begin = (uint32_t)(r >> 32);
+            uint32_t end = (uint32_t)r;
+            if (begin >= end) {
+                break;
+            }
+            uint32_t mid = end - (end - begin + 1) / 2;
+            if (__sync_bool_compare_and_swap(&victim->mRange, r, PackRange(begin, mid))) {
+                // Our own queue is empty, and thieves never touch an empty
+                // queue, so the swap below can only fail if that invariant is
+                // broken.
+                uint64_t empty = LoadRange(own);
+                if (!__sync_bool_compare_and_swap(&own->mRange, empty,
+                                                  PackRange(mid + 1, end))) {
+                    rsAssert(!"Slice queue modified while empty");
+                }
+                *slice = mid;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 void RsdCpuReferenceImpl::launchThreads(WorkerCallback_t cbk, void *data) {
-    mWorkers.mLaunchData = data;
-    mWorkers.mLaunchCallback = cbk;
+    uint32_t self = getThreadIndex();
+    if (self) {
+        launchThreadsLocked(cbk, data, self);
+        return;
+    }
 
-    // fast path for very small launches
+    // Every thread that is not a helper runs as worker 0, with its per-lid
+    // scratch and its completion signal.  Launches from several such threads
+    // take turns; kernels they launch from within their own launch nest.
+    pthread_mutex_lock(&mOuterLaunchLock);
+    launchThreadsLocked(cbk, data, 0);
+    pthread_mutex_unlock(&mOuterLaunchLock);
+}
+
+void RsdCpuReferenceImpl::launchThreadsLocked(WorkerCallback_t cbk, void *data,
+                                              uint32_t self) {
     MTLaunchStruct *mtls = (MTLaunchStruct *)data;
-    if (mtls && mtls->fep.dim.y <= 1 && mtls->end.x <= mtls->start.x + mtls->mSliceSize) {
-        if (mWorkers.mLaunchCallback) {
-            mWorkers.mLaunchCallback(mWorkers.mLaunchData, 0);
-        }
+
+    // fast path for very small launches
+    if (mtls->mSliceCount <= 1 || mWorkers.mCount == 0) {
+        SliceQueue queue;
+        memset(&queue, 0, sizeof(queue));
+        queue.mRange = PackRange(0, mtls->mSliceCount);
+        mtls->mQueues = &queue;
+        mtls->mQueueCount = 1;
+        cbk(data, self);
         return;
     }
 
-    mWorkers.mRunningCount = mWorkers.mCount;
-    __sync_synchronize();
+    mtls->mWalker = cbk;
+    mtls->mActiveThreads = 0;
+    mtls->mExhausted = 0;
+    mtls->mLauncherSignal = self ? &mWorkers.mLaunchSignals[self - 1]
+                                 : &mWorkers.mCompleteSignal;
+    mtls->mNext = nullptr;
+    mtls->mQueueCount = mWorkers.mCount + 1;
+
+    // The common non-nested launch reuses the preallocated queues; launches
+    // that overlap with it get their own.
+    if (__sync_bool_compare_and_swap(&mWorkers.mQueuesInUse, 0, 1)) {
+        mtls->mQueues = mWorkers.mQueues;
+    } else {
+        mtls->mQueues = (SliceQueue *) memalign(sizeof(SliceQueue),
+                                                mtls->mQueueCount * sizeof(SliceQueue));
+    }
+    memset(mtls->mQueues, 0, mtls->mQueueCount * sizeof(SliceQueue));
 
-    for (uint32_t ct = 0; ct < mWorkers.mCount; ct++) {
-        mWorkers.mLaunchSignals[ct].set();
+    // All slices start on the launching thread; helpers steal halves of the
+    // remaining range, so the work spreads out in log(threads) steals.
+    mtls->mQueues[self].mRange = PackRange(0, mtls->mSliceCount);
+
+    pthread_mutex_lock(&mLaunchLock);
+    if (mLaunchTail) {
+        mLaunchTail->mNext = mtls;
+    } else {
+        mLaunchHead = mtls;
+    }
+    mLaunchTail = mtls;
+    __sync_fetch_and_add(&mPendingLaunches, 1);
+    pthread_mutex_unlock(&mLaunchLock);
+
+    // Only wake as many idle helpers as there are spare slices.  Helpers that
+    // are busy with another launch pick this one up when they finish.
+    uint32_t wanted = rsMin(mWorkers.mCount, mtls->mSliceCount - 1);
+    for (uint32_t ct = 0; ct < mWorkers.mCount && wanted; ct++) {
+        if (__sync_bool_compare_and_swap(&mWorkers.mSlots[ct].mIdle, 1, 0)) {
+            wakeWorker(ct);
+            wanted--;
+        }
     }
 
     // We use the calling thread as one of the workers so we can start without
     // the delay of the thread wakeup.
-    if (mWorkers.mLaunchCallback) {
-        mWorkers.mLaunchCallback(mWorkers.mLaunchData, 0);
+    cbk(data, self);
+    retireLaunch(mtls);
+
+    // Unlink the launch so no further helpers join it, then wait for the
+    // ones that did.
+    pthread_mutex_lock(&mLaunchLock);
+    MTLaunchStruct **link = &mLaunchHead;
+    MTLaunchStruct *prev = nullptr;
+    while (*link != mtls) {
+        prev = *link;
+        link = &(*link)->mNext;
+    }
+    *link = mtls->mNext;
+    if (mLaunchTail == mtls) {
+        mLaunchTail = prev;
     }
+    pthread_mutex_unlock(&mLaunchLock);
 
-    while (__sync_fetch_and_or(&mWorkers.mRunningCount, 0) != 0) {
-        mWorkers.mCompleteSignal.wait();
+    waitForLaunchCompletion(mtls);
+
+    if (mtls->mTuner) {
+        updateSliceTuner(mtls);
+    }
+
+    if (mtls->mQueues == mWorkers.mQueues) {
+        __sync_lock_release(&mWorkers.mQueuesInUse);
+    } else {
+        free(mtls->mQueues);
     }
 }
 
@@ -197,6 +624,56 @@ void RsdCpuReferenceImpl::unlockMutex() {
     pthread_mutex_unlock(&gInitMutex);
 }
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+// Ask cpuid which of the extensions used by the intrinsics the CPU has.  AVX
+// state has to be enabled by the kernel as well, which xgetbv reports.
+static uint32_t GetX86Features() {
+    unsigned int eax, ebx, ecx, edx;
+    uint32_t features = 0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    if (ecx & (1 << 9)) {
+        features |= RS_CPU_X86_SSSE3;
+    }
+    if (ecx & (1 << 19)) {
+        features |= RS_CPU_X86_SSE4_1;
+    }
+
+    // OSXSAVE, AVX and FMA
+    const unsigned int avxBits = (1 << 27) | (1 << 28) | (1 << 12);
+    if ((ecx & avxBits) != avxBits || __get_cpuid_max(0, nullptr) < 7) {
+        return features;
+    }
+    uint32_t xcr0, xcr0Hi;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0), "=d"(xcr0Hi) : "c"(0));
+    if ((xcr0 & 0x06) != 0x06) {
+        return features;
+    }
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (ebx & (1 << 5)) {
+        features |= RS_CPU_X86_AVX2;
+        // AVX-512 F and BW, with the opmask and upper register state enabled
+        const unsigned int avx512Bits = (1 << 16) | (1 << 30);
+        if ((ebx & avx512Bits) == avx512Bits && (xcr0 & 0xe0) == 0xe0) {
+            features |= RS_CPU_X86_AVX512;
+        }
+    }
+    return features;
+}
+
+// Determine if the CPU we're running on supports SIMD instructions, and pick
+// the widest intrinsic kernels it can run.
+static void GetCpuInfo() {
+    uint32_t features = GetX86Features();
+    gArchUseSIMD = (features & RS_CPU_X86_SSSE3) != 0;
+    if (gArchUseSIMD) {
+        rsdSelectX86Kernels(features);
+    }
+}
+#else
 // Determine if the CPU we're running on supports SIMD instructions.
 static void GetCpuInfo() {
     // Read the CPU flags from /proc/cpuinfo.
@@ -212,8 +689,6 @@ static void GetCpuInfo() {
     while (fgets(cpuinfostr, sizeof(cpuinfostr), cpuinfo)) {
 #if defined(ARCH_ARM_HAVE_VFP) || defined(ARCH_ARM_USE_INTRINSICS)
         gArchUseSIMD = strstr(cpuinfostr, " neon") || strstr(cpuinfostr, " asimd");
-#elif defined(ARCH_X86_HAVE_SSSE3)
-        gArchUseSIMD = strstr(cpuinfostr, " ssse3");
 #endif
         if (gArchUseSIMD) {
             break;
@@ -221,6 +696,57 @@ static void GetCpuInfo() {
     }
     fclose(cpuinfo);
 }
+#endif
+
+// Reads the size of the level-N data (or unified) cache of cpu0 from sysfs.
+// Returns 0 if the kernel does not expose it.
+static uint32_t GetCacheSize(uint32_t level) {
+    for (int index = 0; index < 8; index++) {
+        char path[128];
+        char buf[32];
+        uint32_t value = 0;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        FILE *f = fopen(path, "r");
+        if (!f) {
+            break;
+        }
+        bool match = fscanf(f, "%u", &value) == 1 && value == level;
+        fclose(f);
+        if (!match) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        f = fopen(path, "r");
+        if (!f) {
+            continue;
+        }
+        match = fgets(buf, sizeof(buf), f) && strncmp(buf, "Instruction", 11);
+        fclose(f);
+        if (!match) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        f = fopen(path, "r");
+        if (!f) {
+            continue;
+        }
+        char unit = 0;
+        int fields = fscanf(f, "%u%c", &value, &unit);
+        fclose(f);
+        if (fields >= 1) {
+            if (unit == 'K') {
+                value *= 1024;
+            } else if (unit == 'M') {
+                value *= 1024 * 1024;
+            }
+            return value;
+        }
+    }
+    return 0;
+}
 
 bool RsdCpuReferenceImpl::init(uint32_t version_major, uint32_t version_minor,
                                sym_lookup_t lfn, script_lookup_t slfn) {
@@ -249,10 +775,43 @@ bool RsdCpuReferenceImpl::init(uint32_t version_major, uint32_t version_minor,
 
     GetCpuInfo();
 
+    if (uint32_t l1 = GetCacheSize(1)) {
+        mL1CacheBytes = l1;
+    }
+    if (uint32_t l2 = GetCacheSize(2)) {
+        mL2CacheBytes = l2;
+    }
+
     int cpu = sysconf(_SC_NPROCESSORS_CONF);
     if(mRSC->props.mDebugMaxThreads) {
         cpu = mRSC->props.mDebugMaxThreads;
     }
+    if (cpu < 1) {
+        cpu = 1;
+    }
+
+    // One slice queue per thread, including the command thread.
+    mWorkers.mQueues = (SliceQueue *) memalign(sizeof(SliceQueue), cpu * sizeof(SliceQueue));
+    memset(mWorkers.mQueues, 0, cpu * sizeof(SliceQueue));
+    mWorkers.mCluster = new uint32_t[cpu];
+    for (int ct = 0; ct < cpu; ct++) {
+        mWorkers.mCluster[ct] = kAnyCluster;
+    }
+
+    mCpuCount = rsMax((int)sysconf(_SC_NPROCESSORS_CONF), 1);
+    readCpuTopology();
+    // Helpers inherit the mask of this thread.
+    if (sched_getaffinity(0, sizeof(mInheritedCpuSet), &mInheritedCpuSet)) {
+        CPU_ZERO(&mInheritedCpuSet);
+        for (uint32_t ct = 0; ct < mCpuCount; ct++) {
+            CPU_SET(ct, &mInheritedCpuSet);
+        }
+    }
+    if (mRSC->props.mDebugCpuAffinity <= AFFINITY_SPREAD) {
+        mAffinityPolicy = (AffinityPolicy)mRSC->props.mDebugCpuAffinity;
+    }
+    mAffinityApplied = mAffinityPolicy != AFFINITY_NONE;
+
     if (cpu < 2) {
         mWorkers.mCount = 0;
         return true;
@@ -266,7 +825,12 @@ bool RsdCpuReferenceImpl::init(uint32_t version_major, uint32_t version_minor,
     mWorkers.mThreadId = (pthread_t *) calloc(mWorkers.mCount, sizeof(pthread_t));
     mWorkers.mNativeThreadId = (pid_t *) calloc(mWorkers.mCount, sizeof(pid_t));
     mWorkers.mLaunchSignals = new Signal[mWorkers.mCount];
-    mWorkers.mLaunchCallback = nullptr;
+    mWorkers.mSlots = (WorkerSlot *) memalign(sizeof(WorkerSlot),
+                                              mWorkers.mCount * sizeof(WorkerSlot));
+    memset(mWorkers.mSlots, 0, mWorkers.mCount * sizeof(WorkerSlot));
+    for (uint32_t ct = 0; ct < mWorkers.mCount; ct++) {
+        mWorkers.mSlots[ct].mSpinLimit = kMinSpin;
+    }
 
     mWorkers.mCompleteSignal.init();
 
@@ -306,12 +870,10 @@ void RsdCpuReferenceImpl::setPriority(int32_t priority) {
 
 RsdCpuReferenceImpl::~RsdCpuReferenceImpl() {
     mExit = true;
-    mWorkers.mLaunchData = nullptr;
-    mWorkers.mLaunchCallback = nullptr;
     mWorkers.mRunningCount = mWorkers.mCount;
     __sync_synchronize();
     for (uint32_t ct = 0; ct < mWorkers.mCount; ct++) {
-        mWorkers.mLaunchSignals[ct].set();
+        wakeWorker(ct);
     }
     void *res;
     for (uint32_t ct = 0; ct < mWorkers.mCount; ct++) {
@@ -321,6 +883,13 @@ RsdCpuReferenceImpl::~RsdCpuReferenceImpl() {
     free(mWorkers.mThreadId);
     free(mWorkers.mNativeThreadId);
     delete[] mWorkers.mLaunchSignals;
+    free(mWorkers.mSlots);
+    free(mWorkers.mQueues);
+    delete[] mWorkers.mCluster;
+    delete[] mCpuOrder;
+    delete[] mCpuCluster;
+    pthread_mutex_destroy(&mLaunchLock);
+    pthread_mutex_destroy(&mOuterLaunchLock);
 
     // Global structure cleanup.
     lockMutex();
@@ -342,8 +911,8 @@ static inline void FepPtrSetup(const MTLaunchStruct *mtls, RsExpandKernelDriverI
         fep->inPtr[i] = (const uint8_t *)mtls->ains[i]->getPointerUnchecked(x, y, z, lod, face, a1, a2, a3, a4);
     }
 
-    if (mtls->aout[0] != nullptr) {
-        fep->outPtr[0] = (uint8_t *)mtls->aout[0]->getPointerUnchecked(x, y, z, lod, face, a1, a2, a3, a4);
+    for (uint32_t i = 0; i < fep->outLen; i++) {
+        fep->outPtr[i] = (uint8_t *)mtls->aout[i]->getPointerUnchecked(x, y, z, lod, face, a1, a2, a3, a4);
     }
 }
 
@@ -373,23 +942,58 @@ static bool SelectOuterSlice(const MTLaunchStruct *mtls, RsExpandKernelDriverInf
     return r == 0;
 }
 
+// Number of slices SelectOuterSlice() can enumerate for this launch.
+static uint32_t OuterSliceCount(const MTLaunchStruct *mtls) {
+    uint32_t count = 1;
+    count *= rsMax(mtls->end.z, mtls->start.z + 1) - mtls->start.z;
+    count *= rsMax(mtls->end.lod, mtls->start.lod + 1) - mtls->start.lod;
+    count *= rsMax(mtls->end.face, mtls->start.face + 1) - mtls->start.face;
+    for (int i = 0; i < 4; i++) {
+        count *= rsMax(mtls->end.array[i], mtls->start.array[i] + 1) - mtls->start.array[i];
+    }
+    return count;
+}
+
 
+static inline uint64_t SliceClockNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+// Accounts one finished slice to the calling thread's queue so that
+// updateSliceTuner() can refine the kernel's cost model.
+static inline void RecordSlice(MTLaunchStruct *mtls, uint32_t idx, uint64_t startNs,
+                               uint32_t cells) {
+    SliceQueue *q = &mtls->mQueues[mtls->mQueueCount > 1 ? idx : 0];
+    q->mBusyNs += SliceClockNs() - startNs;
+    q->mCells += cells;
+}
+
+// Walks launches with outer dimensions.  Slices are runs of mSliceSize rows
+// taken from the rows of every outer index in turn, so a 3D allocation with
+// few z planes still splits into enough slices to keep every thread busy.
 static void walk_general(void *usr, uint32_t idx) {
     MTLaunchStruct *mtls = (MTLaunchStruct *)usr;
     RsExpandKernelDriverInfo fep = mtls->fep;
     fep.lid = idx;
     outer_foreach_t fn = (outer_foreach_t) mtls->kernel;
-
-
-    while(1) {
-        uint32_t slice = (uint32_t)__sync_fetch_and_add(&mtls->mSliceNum, 1);
-
-        if (!SelectOuterSlice(mtls, &fep, slice)) {
-            return;
-        }
-
-        for (fep.current.y = mtls->start.y; fep.current.y < mtls->end.y;
-             fep.current.y++) {
+    const uint32_t rowsPerOuter = mtls->end.y - mtls->start.y;
+    const uint32_t totalRows = OuterSliceCount(mtls) * rowsPerOuter;
+    uint32_t outer = UINT32_MAX;
+
+    uint32_t slice;
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &slice)) {
+        uint64_t startNs = mtls->mTuner ? SliceClockNs() : 0;
+        uint32_t rowStart = slice * mtls->mSliceSize;
+        uint32_t rowEnd   = rsMin(rowStart + mtls->mSliceSize, totalRows);
+
+        for (uint32_t row = rowStart; row < rowEnd; row++) {
+            if (row / rowsPerOuter != outer) {
+                outer = row / rowsPerOuter;
+                SelectOuterSlice(mtls, &fep, outer);
+            }
+            fep.current.y = mtls->start.y + row % rowsPerOuter;
 
             FepPtrSetup(mtls, &fep, mtls->start.x,
                         fep.current.y, fep.current.z, fep.current.lod,
@@ -399,8 +1003,11 @@ static void walk_general(void *usr, uint32_t idx) {
 
             fn(&fep, mtls->start.x, mtls->end.x, mtls->fep.outStride[0]);
         }
-    }
 
+        if (mtls->mTuner) {
+            RecordSlice(mtls, idx, startNs, (rowEnd - rowStart) * (mtls->end.x - mtls->start.x));
+        }
+    }
 }
 
 static void walk_2d(void *usr, uint32_t idx) {
@@ -409,22 +1016,55 @@ static void walk_2d(void *usr, uint32_t idx) {
     fep.lid = idx;
     outer_foreach_t fn = (outer_foreach_t) mtls->kernel;
 
-    while (1) {
-        uint32_t slice  = (uint32_t)__sync_fetch_and_add(&mtls->mSliceNum, 1);
+    uint32_t slice;
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &slice)) {
+        uint64_t startNs = mtls->mTuner ? SliceClockNs() : 0;
         uint32_t yStart = mtls->start.y + slice * mtls->mSliceSize;
         uint32_t yEnd   = yStart + mtls->mSliceSize;
 
         yEnd = rsMin(yEnd, mtls->end.y);
 
-        if (yEnd <= yStart) {
-            return;
-        }
-
         for (fep.current.y = yStart; fep.current.y < yEnd; fep.current.y++) {
             FepPtrSetup(mtls, &fep, mtls->start.x, fep.current.y);
 
             fn(&fep, mtls->start.x, mtls->end.x, fep.outStride[0]);
         }
+
+        if (mtls->mTuner) {
+            RecordSlice(mtls, idx, startNs, (yEnd - yStart) * (mtls->end.x - mtls->start.x));
+        }
+    }
+}
+
+// Walks a 2D launch in tiles of mTileWidth cells by mSliceSize rows.  Slices
+// are numbered down each tile column first, so a thread working through a
+// contiguous range of slices keeps descending one column and the rows a
+// stencil kernel re-reads are still in cache.
+static void walk_2d_tiled(void *usr, uint32_t idx) {
+    MTLaunchStruct *mtls = (MTLaunchStruct *)usr;
+    RsExpandKernelDriverInfo fep = mtls->fep;
+    fep.lid = idx;
+    outer_foreach_t fn = (outer_foreach_t) mtls->kernel;
+    const uint32_t rows = mtls->end.y - mtls->start.y;
+    const uint32_t bands = (rows + mtls->mSliceSize - 1) / mtls->mSliceSize;
+
+    uint32_t slice;
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &slice)) {
+        uint64_t startNs = mtls->mTuner ? SliceClockNs() : 0;
+        uint32_t xStart = mtls->start.x + (slice / bands) * mtls->mTileWidth;
+        uint32_t xEnd   = rsMin(xStart + mtls->mTileWidth, mtls->end.x);
+        uint32_t yStart = mtls->start.y + (slice % bands) * mtls->mSliceSize;
+        uint32_t yEnd   = rsMin(yStart + mtls->mSliceSize, mtls->end.y);
+
+        for (fep.current.y = yStart; fep.current.y < yEnd; fep.current.y++) {
+            FepPtrSetup(mtls, &fep, xStart, fep.current.y);
+
+            fn(&fep, xStart, xEnd, fep.outStride[0]);
+        }
+
+        if (mtls->mTuner) {
+            RecordSlice(mtls, idx, startNs, (yEnd - yStart) * (xEnd - xStart));
+        }
     }
 }
 
@@ -434,20 +1074,213 @@ static void walk_1d(void *usr, uint32_t idx) {
     fep.lid = idx;
     outer_foreach_t fn = (outer_foreach_t) mtls->kernel;
 
-    while (1) {
-        uint32_t slice  = (uint32_t)__sync_fetch_and_add(&mtls->mSliceNum, 1);
+    uint32_t slice;
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &slice)) {
+        uint64_t startNs = mtls->mTuner ? SliceClockNs() : 0;
         uint32_t xStart = mtls->start.x + slice * mtls->mSliceSize;
         uint32_t xEnd   = xStart + mtls->mSliceSize;
 
         xEnd = rsMin(xEnd, mtls->end.x);
 
-        if (xEnd <= xStart) {
-            return;
-        }
-
         FepPtrSetup(mtls, &fep, xStart, 0);
 
         fn(&fep, xStart, xEnd, fep.outStride[0]);
+
+        if (mtls->mTuner) {
+            RecordSlice(mtls, idx, startNs, xEnd - xStart);
+        }
+    }
+}
+
+// Target run time of one slice once a kernel's cost is known.  Long enough to
+// amortize the queue operations and steals, short enough to keep the tail of
+// a launch from being dominated by one straggling slice.
+static const float kTargetSliceNs = 50000.f;
+
+// Picks how many units (rows, or cells for 1D launches) make up one slice.
+uint32_t RsdCpuReferenceImpl::selectSliceSize(const MTLaunchStruct *mtls, uint32_t units,
+                                              uint32_t cellsPerUnit,
+                                              uint32_t bytesPerUnit) const {
+    const size_t targetByteChunk = 16 * 1024;
+    const uint32_t threads = mWorkers.mCount + 1;
+    const SliceTuner *tuner = mtls->mTuner;
+    uint32_t size;
+
+    if (tuner && tuner->mNsPerCell > 0.f) {
+        // Size slices to run for about kTargetSliceNs each, but keep enough of
+        // them per thread to absorb the imbalance seen in earlier launches.
+        float unitNs = tuner->mNsPerCell * cellsPerUnit;
+        float byCost = kTargetSliceNs / unitNs;
+        uint32_t byBalance = units / (threads * tuner->mSlicesPerThread);
+        size = byCost < (float)byBalance ? (uint32_t)byCost : byBalance;
+    } else {
+        uint32_t s1 = units / (threads * 4);
+        uint32_t s2 = 0;
+
+        // This chooses our slice size to rate limit atomic ops to
+        // one per 16k bytes of reads/writes.
+        if (bytesPerUnit) {
+            s2 = targetByteChunk / bytesPerUnit;
+        } else {
+            // Launch option only case
+            // Use s1 based only on the dimensions
+            s2 = s1;
+        }
+        size = rsMin(s1, s2);
+    }
+
+    return rsMax(size, (uint32_t)1);
+}
+
+// Rows of one tile column a stencil kernel needs resident at once: the
+// neighbourhood of a 5x5 filter plus the output row, with some slack.
+static const uint32_t kTileRowsResident = 8;
+
+// Returns the tile width for a 2D launch, or 0 to walk full rows.  Tiling is
+// opt-in, through the RsScriptCall strategy or the kernel's preference.
+uint32_t RsdCpuReferenceImpl::selectTileWidth(const MTLaunchStruct *mtls,
+                                              const RsScriptCall *sc) const {
+    RsForEachStrategy strategy = RS_FOR_EACH_STRATEGY_DONT_CARE;
+    if (sc) {
+        strategy = sc->strategy;
+    }
+    if (strategy < RS_FOR_EACH_STRATEGY_TILE_SMALL && mtls->script) {
+        strategy = mtls->script->getForEachStrategy(mtls->fep.slot);
+    }
+
+    uint32_t budget;
+    switch (strategy) {
+    case RS_FOR_EACH_STRATEGY_TILE_SMALL:
+        budget = mL1CacheBytes / 2;
+        break;
+    case RS_FOR_EACH_STRATEGY_TILE_MEDIUM:
+        budget = mL1CacheBytes;
+        break;
+    case RS_FOR_EACH_STRATEGY_TILE_LARGE:
+        budget = mL2CacheBytes / 2;
+        break;
+    default:
+        return 0;
+    }
+
+    // Bytes touched per cell.  Intrinsics read bound allocations we cannot
+    // see here, so assume they read about as much as they write.
+    uint32_t bytesPerCell = 0;
+    for (uint32_t i = 0; i < mtls->fep.outLen; i++) {
+        bytesPerCell += mtls->fep.outStride[i];
+    }
+    for (uint32_t i = 0; i < mtls->fep.inLen; i++) {
+        bytesPerCell += mtls->fep.inStride[i];
+    }
+    if (!mtls->fep.inLen) {
+        bytesPerCell *= 2;
+    }
+    if (!bytesPerCell) {
+        return 0;
+    }
+
+    // Keep the width a multiple of 16 cells so the SIMD paths of the
+    // intrinsics run on whole vectors.  Once the kernel has been timed, the
+    // width its tuner settled on, or is trying, replaces the cache estimate.
+    uint32_t width = budget / (bytesPerCell * kTileRowsResident);
+    if (mtls->mTuner && mtls->mTuner->mTileWidth) {
+        width = mtls->mTuner->mTileWidth;
+    }
+    width = rsMax(width & ~15u, (uint32_t)16);
+    if (width >= mtls->end.x - mtls->start.x) {
+        return 0;
+    }
+    return width;
+}
+
+// Returns the next tile width to try in the given direction from the best
+// one, or 0 if it would leave [16, span).
+static uint32_t NextTileWidth(const SliceTuner *tuner, uint32_t span) {
+    uint32_t next = tuner->mTileStep == kTileSearchWiden ? tuner->mBestTileWidth * 2
+                                                         : (tuner->mBestTileWidth / 2) & ~15u;
+    return next >= 16 && next < span ? next : 0;
+}
+
+// Advances the tile width search with the cost of a launch walked in tiles
+// of width cells.
+static void UpdateTileWidth(SliceTuner *tuner, uint32_t width, float nsPerCell,
+                            uint32_t span) {
+    if (tuner->mTileStep == kTileSearchSettled) {
+        return;
+    }
+    if (tuner->mTileStep == kTileSearchIdle) {
+        tuner->mTileSeed = width;
+        tuner->mTileStep = kTileSearchWiden;
+    }
+
+    // Require a clear gain, as timings of one launch are noisy.  Narrower
+    // tiles are only tried when widening never paid off.
+    const bool atSeed = tuner->mBestTileWidth == tuner->mTileSeed;
+    if (!tuner->mBestTileWidth || nsPerCell < 0.97f * tuner->mBestTileNsPerCell) {
+        tuner->mBestTileWidth = width;
+        tuner->mBestTileNsPerCell = nsPerCell;
+    } else if (tuner->mTileStep == kTileSearchWiden && atSeed) {
+        tuner->mTileStep = kTileSearchNarrow;
+    } else {
+        tuner->mTileStep = kTileSearchSettled;
+    }
+
+    uint32_t next = 0;
+    if (tuner->mTileStep != kTileSearchSettled) {
+        next = NextTileWidth(tuner, span);
+        if (!next && tuner->mTileStep == kTileSearchWiden &&
+            tuner->mBestTileWidth == tuner->mTileSeed) {
+            tuner->mTileStep = kTileSearchNarrow;
+            next = NextTileWidth(tuner, span);
+        }
+    }
+    if (!next) {
+        tuner->mTileStep = kTileSearchSettled;
+        next = tuner->mBestTileWidth;
+    }
+    tuner->mTileWidth = next;
+}
+
+// Folds the slice timings of a finished launch into the kernel's cost model,
+// and for tiled launches into its tile width search.
+void RsdCpuReferenceImpl::updateSliceTuner(MTLaunchStruct *mtls) {
+    SliceTuner *tuner = mtls->mTuner;
+    uint64_t totalNs = 0;
+    uint64_t maxNs = 0;
+    uint64_t cells = 0;
+    uint32_t active = 0;
+
+    for (uint32_t ct = 0; ct < mtls->mQueueCount; ct++) {
+        const SliceQueue *q = &mtls->mQueues[ct];
+        if (q->mCells) {
+            totalNs += q->mBusyNs;
+            maxNs = rsMax(maxNs, q->mBusyNs);
+            cells += q->mCells;
+            active++;
+        }
+    }
+    if (!cells || !totalNs) {
+        return;
+    }
+
+    float nsPerCell = (float)totalNs / cells;
+    if (mtls->mTileWidth) {
+        UpdateTileWidth(tuner, mtls->mTileWidth, nsPerCell, mtls->end.x - mtls->start.x);
+    }
+    if (tuner->mNsPerCell > 0.f) {
+        tuner->mNsPerCell = 0.75f * tuner->mNsPerCell + 0.25f * nsPerCell;
+    } else {
+        tuner->mNsPerCell = nsPerCell;
+    }
+
+    // Compare the busiest thread against the mean: a large gap means the
+    // slices were too coarse to even out, a small one that we can afford
+    // fewer, larger slices.
+    float imbalance = (float)maxNs * active / totalNs;
+    if (imbalance > 1.25f && tuner->mSlicesPerThread < 64) {
+        tuner->mSlicesPerThread *= 2;
+    } else if (imbalance < 1.05f && tuner->mSlicesPerThread > 2) {
+        tuner->mSlicesPerThread /= 2;
     }
 }
 
@@ -467,60 +1300,60 @@ void RsdCpuReferenceImpl::launchThreads(const Allocation ** ains,
                      (mtls->start.array[2] != mtls->end.array[2]) ||
                      (mtls->start.array[3] != mtls->end.array[3]);
 
-    if ((mWorkers.mCount >= 1) && mtls->isThreadable && !mInForEach) {
-        const size_t targetByteChunk = 16 * 1024;
-        mInForEach = true;
+    if ((mWorkers.mCount >= 1) && mtls->isThreadable) {
+        __sync_fetch_and_add(&mInForEach, 1);
 
-        if (outerDims) {
-            // No fancy logic for chunk size
-            mtls->mSliceSize = 1;
-            launchThreads(walk_general, mtls);
-        } else if (mtls->fep.dim.y > 1) {
-            uint32_t s1 = mtls->fep.dim.y / ((mWorkers.mCount + 1) * 4);
-            uint32_t s2 = 0;
+        WorkerCallback_t walker;
+        uint32_t units;
+        uint32_t cellsPerUnit;
+        uint32_t bytesPerUnit = 0;
 
-            // This chooses our slice size to rate limit atomic ops to
-            // one per 16k bytes of reads/writes.
+        if (!outerDims && mtls->fep.dim.y > 1) {
+            mtls->mTileWidth = selectTileWidth(mtls, sc);
+        }
+
+        if (mtls->mTileWidth) {
+            // A unit is one row of one tile column, so a slice is a tile.
+            uint32_t rows = mtls->end.y - mtls->start.y;
+            uint32_t columns = (mtls->end.x - mtls->start.x + mtls->mTileWidth - 1) /
+                               mtls->mTileWidth;
+            walker = walk_2d_tiled;
+            units = rows * columns;
+            cellsPerUnit = mtls->mTileWidth;
+            bytesPerUnit = mtls->mTileWidth * mtls->fep.outStride[0];
+            mtls->mSliceSize = rsMin(selectSliceSize(mtls, units, cellsPerUnit, bytesPerUnit),
+                                     rows);
+            mtls->mSliceCount = columns * ((rows + mtls->mSliceSize - 1) / mtls->mSliceSize);
+        } else if (outerDims || mtls->fep.dim.y > 1) {
+            walker = outerDims ? walk_general : walk_2d;
+            units = mtls->end.y - mtls->start.y;
+            if (outerDims) {
+                units *= OuterSliceCount(mtls);
+            }
+            cellsPerUnit = mtls->end.x - mtls->start.x;
             if ((mtls->aout[0] != nullptr) && mtls->aout[0]->mHal.drvState.lod[0].stride) {
-                s2 = targetByteChunk / mtls->aout[0]->mHal.drvState.lod[0].stride;
+                bytesPerUnit = mtls->aout[0]->mHal.drvState.lod[0].stride;
             } else if (mtls->ains[0]) {
-                s2 = targetByteChunk / mtls->ains[0]->mHal.drvState.lod[0].stride;
-            } else {
-                // Launch option only case
-                // Use s1 based only on the dimensions
-                s2 = s1;
+                bytesPerUnit = mtls->ains[0]->mHal.drvState.lod[0].stride;
             }
-            mtls->mSliceSize = rsMin(s1, s2);
-
-            if(mtls->mSliceSize < 1) {
-                mtls->mSliceSize = 1;
-            }
-
-            launchThreads(walk_2d, mtls);
         } else {
-            uint32_t s1 = mtls->fep.dim.x / ((mWorkers.mCount + 1) * 4);
-            uint32_t s2 = 0;
-
-            // This chooses our slice size to rate limit atomic ops to
-            // one per 16k bytes of reads/writes.
+            walker = walk_1d;
+            units = mtls->end.x - mtls->start.x;
+            cellsPerUnit = 1;
             if ((mtls->aout[0] != nullptr) && mtls->aout[0]->getType()->getElementSizeBytes()) {
-                s2 = targetByteChunk / mtls->aout[0]->getType()->getElementSizeBytes();
+                bytesPerUnit = mtls->aout[0]->getType()->getElementSizeBytes();
             } else if (mtls->ains[0]) {
-                s2 = targetByteChunk / mtls->ains[0]->getType()->getElementSizeBytes();
-            } else {
-                // Launch option only case
-                // Use s1 based only on the dimensions
-                s2 = s1;
-            }
-            mtls->mSliceSize = rsMin(s1, s2);
-
-            if (mtls->mSliceSize < 1) {
-                mtls->mSliceSize = 1;
+                bytesPerUnit = mtls->ains[0]->getType()->getElementSizeBytes();
             }
+        }
 
-            launchThreads(walk_1d, mtls);
+        if (!mtls->mTileWidth) {
+            mtls->mSliceSize = selectSliceSize(mtls, units, cellsPerUnit, bytesPerUnit);
+            mtls->mSliceCount = (units + mtls->mSliceSize - 1) / mtls->mSliceSize;
         }
-        mInForEach = false;
+        launchThreads(walker, mtls);
+
+        __sync_fetch_and_sub(&mInForEach, 1);
 
     } else {
         outer_foreach_t fn = (outer_foreach_t) mtls->kernel;
@@ -544,6 +1377,192 @@ void RsdCpuReferenceImpl::launchThreads(const Allocation ** ains,
     }
 }
 
+// Reductions over more than one row hand out rows, as walk_general does.  A
+// single row is split into runs of cells instead.
+static bool ReduceByRows(const MTLaunchStruct *mtls) {
+    return OuterSliceCount(mtls) > 1 || mtls->end.y - mtls->start.y > 1;
+}
+
+// Returns the accumulator of thread idx, initializing it on first use so
+// that threads which never get a slice cost nothing to combine.
+static uint8_t * GetAccumulator(MTLaunchStruct *mtls, uint32_t idx) {
+    uint8_t *accum = mtls->mAccumulators + idx * mtls->mAccumStride;
+    if (!mtls->mAccumUsed[idx]) {
+        if (mtls->mReduce->initFunc) {
+            mtls->mReduce->initFunc(accum);
+        } else {
+            memset(accum, 0, mtls->mReduce->accumSize);
+        }
+        mtls->mAccumUsed[idx] = 1;
+    }
+    return accum;
+}
+
+static void walk_reduce(void *usr, uint32_t idx) {
+    MTLaunchStruct *mtls = (MTLaunchStruct *)usr;
+    RsExpandKernelDriverInfo fep = mtls->fep;
+    fep.lid = idx;
+    ReduceAccumulatorFunc_t fn = mtls->mReduce->accumFunc;
+    const bool byRows = ReduceByRows(mtls);
+    const uint32_t rowsPerOuter = mtls->end.y - mtls->start.y;
+    const uint32_t units = byRows ? OuterSliceCount(mtls) * rowsPerOuter
+                                  : mtls->end.x - mtls->start.x;
+    uint32_t outer = 0;
+    SelectOuterSlice(mtls, &fep, outer);
+
+    uint32_t slice;
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &slice)) {
+        uint8_t *accum = GetAccumulator(mtls, idx);
+        uint32_t unitStart = slice * mtls->mSliceSize;
+        uint32_t unitEnd   = rsMin(unitStart + mtls->mSliceSize, units);
+
+        if (!byRows) {
+            uint32_t xStart = mtls->start.x + unitStart;
+            fep.current.y = mtls->start.y;
+            FepPtrSetup(mtls, &fep, xStart,
+                        fep.current.y, fep.current.z, fep.current.lod,
+                        (RsAllocationCubemapFace)fep.current.face,
+                        fep.current.array[0], fep.current.array[1],
+                        fep.current.array[2], fep.current.array[3]);
+            fn(&fep, xStart, mtls->start.x + unitEnd, accum);
+            continue;
+        }
+
+        for (uint32_t row = unitStart; row < unitEnd; row++) {
+            if (row / rowsPerOuter != outer) {
+                outer = row / rowsPerOuter;
+                SelectOuterSlice(mtls, &fep, outer);
+            }
+            fep.current.y = mtls->start.y + row % rowsPerOuter;
+
+            FepPtrSetup(mtls, &fep, mtls->start.x,
+                        fep.current.y, fep.current.z, fep.current.lod,
+                        (RsAllocationCubemapFace)fep.current.face,
+                        fep.current.array[0], fep.current.array[1],
+                        fep.current.array[2], fep.current.array[3]);
+
+            fn(&fep, mtls->start.x, mtls->end.x, accum);
+        }
+    }
+}
+
+// Accumulators at least this large are combined on the pool when a round of
+// the tree has more than one pair.  Smaller ones combine faster than the
+// launch of a round takes.
+static const size_t kParallelCombineBytes = 16 * 1024;
+
+// One round of the combine tree: pair p folds accums[(2p + 1) * step] into
+// accums[2p * step].
+struct CombineRound {
+    const ReduceDescription *reduce;
+    uint8_t **accums;
+    uint32_t step;
+};
+
+static void walk_combine(void *usr, uint32_t idx) {
+    MTLaunchStruct *mtls = (MTLaunchStruct *)usr;
+    const CombineRound *round = (const CombineRound *)mtls->fep.usr;
+
+    uint32_t pair;
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &pair)) {
+        uint8_t **a = round->accums + 2 * pair * round->step;
+        round->reduce->combFunc(a[0], a[round->step]);
+    }
+}
+
+// Folds accums[0..count) into accums[0] as a binary tree, so a round only
+// waits on the round before it and takes log2(count) rounds in all.
+void RsdCpuReferenceImpl::combineAccumulators(const ReduceDescription *reduce,
+                                              uint8_t **accums, uint32_t count) {
+    for (uint32_t step = 1; step < count; step *= 2) {
+        uint32_t pairs = (count - step + 2 * step - 1) / (2 * step);
+
+        if (pairs > 1 && mWorkers.mCount >= 1 && reduce->accumSize >= kParallelCombineBytes) {
+            CombineRound round = { reduce, accums, step };
+            MTLaunchStruct mtls;
+            memset(&mtls, 0, sizeof(mtls));
+            mtls.rsc = this;
+            mtls.fep.usr = &round;
+            mtls.mSliceSize = 1;
+            mtls.mSliceCount = pairs;
+            mtls.isThreadable = true;
+            launchThreads(walk_combine, &mtls);
+        } else {
+            for (uint32_t p = 0; p < pairs; p++) {
+                reduce->combFunc(accums[2 * p * step], accums[(2 * p + 1) * step]);
+            }
+        }
+    }
+}
+
+// Runs the reduction set up in mtls and stores its result in the first cell
+// of aout.
+void RsdCpuReferenceImpl::launchReduce(Allocation* aout, MTLaunchStruct* mtls) {
+    const ReduceDescription *reduce = mtls->mReduce;
+    const uint32_t threads = getThreadCount();
+
+    // Any thread of the pool may run a slice, including the calling thread
+    // when it is a helper launching from within a kernel.
+    mtls->mAccumStride = (reduce->accumSize + 63) & ~(size_t)63;
+    mtls->mAccumulators = (uint8_t *) memalign(64, threads * mtls->mAccumStride);
+    mtls->mAccumUsed = new uint8_t[threads];
+    memset(mtls->mAccumUsed, 0, threads);
+
+    uint32_t units;
+    uint32_t cellsPerUnit;
+    uint32_t bytesPerUnit;
+    if (ReduceByRows(mtls)) {
+        units = OuterSliceCount(mtls) * (mtls->end.y - mtls->start.y);
+        cellsPerUnit = mtls->end.x - mtls->start.x;
+        bytesPerUnit = mtls->ains[0]->mHal.drvState.lod[0].stride;
+    } else {
+        units = mtls->end.x - mtls->start.x;
+        cellsPerUnit = 1;
+        bytesPerUnit = mtls->ains[0]->getType()->getElementSizeBytes();
+    }
+
+    bool threaded = (mWorkers.mCount >= 1) && mtls->isThreadable;
+    if (threaded) {
+        __sync_fetch_and_add(&mInForEach, 1);
+        mtls->mSliceSize = selectSliceSize(mtls, units, cellsPerUnit, bytesPerUnit);
+        mtls->mSliceCount = (units + mtls->mSliceSize - 1) / mtls->mSliceSize;
+    } else {
+        // A single slice, which launchThreads() runs on this thread.
+        mtls->mSliceSize = units;
+        mtls->mSliceCount = 1;
+    }
+    launchThreads(walk_reduce, mtls);
+
+    uint8_t **accums = new uint8_t*[threads];
+    uint32_t count = 0;
+    for (uint32_t ct = 0; ct < threads; ct++) {
+        if (mtls->mAccumUsed[ct]) {
+            accums[count++] = mtls->mAccumulators + ct * mtls->mAccumStride;
+        }
+    }
+    if (!count) {
+        accums[count++] = GetAccumulator(mtls, 0);
+    }
+    combineAccumulators(reduce, accums, count);
+
+    if (threaded) {
+        __sync_fetch_and_sub(&mInForEach, 1);
+    }
+
+    uint8_t *out = (uint8_t *)aout->mHal.drvState.lod[0].mallocPtr;
+    if (reduce->outFunc) {
+        reduce->outFunc(out, accums[0]);
+    } else {
+        memcpy(out, accums[0], reduce->accumSize);
+    }
+
+    delete[] accums;
+    delete[] mtls->mAccumUsed;
+    free(mtls->mAccumulators);
+    mtls->mAccumUsed = nullptr;
+    mtls->mAccumulators = nullptr;
+}
+
 RsdCpuScriptImpl * RsdCpuReferenceImpl::setTLS(RsdCpuScriptImpl *sc) {
     //ALOGE("setTls %p", sc);
     ScriptTLSStruct * tls = (ScriptTLSStruct *)pthread_getspecific(gThreadTLSKey);
@@ -659,7 +1678,12 @@ void* RsdCpuReferenceImpl::createScriptGroup(const ScriptGroupBase *sg) {
       return sgi;
     }
     case ScriptGroupBase::SG_V2: {
-      return new CpuScriptGroup2Impl(this, sg);
+      CpuScriptGroup2Impl *sgi = new CpuScriptGroup2Impl(this, sg);
+      if (!sgi->init()) {
+        delete sgi;
+        return nullptr;
+      }
+      return sgi;
     }
   }
   return nullptr;
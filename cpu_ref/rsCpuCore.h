@@ -17,6 +17,8 @@
 #ifndef RSD_CPU_CORE_H
 #define RSD_CPU_CORE_H
 
+#include <sched.h>
+
 #include "rsd_cpu.h"
 #include "rsSignal.h"
 #include "rsContext.h"
@@ -50,6 +52,59 @@ struct ScriptTLSStruct {
     RsdCpuScriptImpl *mImpl;
 };
 
+// A contiguous range of slice indices owned by one thread for the current
+// launch, packed as (begin << 32) | end.  The owner pops slices from the front
+// and idle threads steal the back half, both with a single compare-and-swap.
+// Padded to a cache line so owners do not false-share with their neighbours.
+struct SliceQueue {
+    volatile uint64_t mRange;
+
+    // Timing recorded by the owning thread when the launch is being tuned.
+    uint64_t mBusyNs;
+    uint64_t mCells;
+} __attribute__((aligned(64)));
+
+// Per-kernel cost model used to size the slices of its launches.  It is
+// refined from the per-slice timings of every threaded launch of the kernel
+// and is only ever used to steer scheduling, so it is updated without locks.
+struct SliceTuner {
+    float mNsPerCell;           // Smoothed cost of one cell; 0 until measured.
+    uint32_t mSlicesPerThread;  // Grown while threads finish unevenly.
+
+    // Tile width search for kernels walked in 2D tiles.  It starts from the
+    // cache-derived width, doubles or halves it while the measured cost per
+    // cell keeps dropping, then settles on the cheapest width seen.  Tile
+    // height follows from the slice size, which the cost above already sets.
+    uint32_t mTileWidth;        // Width for the next tiled launch; 0 until tiled.
+    uint32_t mTileSeed;         // Width the search started from.
+    uint32_t mBestTileWidth;
+    float mBestTileNsPerCell;
+    int32_t mTileStep;          // kTileSearch* state.
+};
+
+enum {
+    kTileSearchIdle,
+    kTileSearchWiden,
+    kTileSearchNarrow,
+    kTileSearchSettled
+};
+
+// The functions of a reduction kernel.  The accumulator is expanded like a
+// forEach kernel and folds cells [x1, x2) of the current row into accum.
+typedef void (*ReduceInitializerFunc_t)(uint8_t *accum);
+typedef void (*ReduceAccumulatorFunc_t)(const RsExpandKernelDriverInfo *info,
+                                        uint32_t x1, uint32_t x2, uint8_t *accum);
+typedef void (*ReduceCombinerFunc_t)(uint8_t *accum, const uint8_t *other);
+typedef void (*ReduceOutConverterFunc_t)(uint8_t *out, const uint8_t *accum);
+
+struct ReduceDescription {
+    ReduceInitializerFunc_t initFunc;   // nullptr starts from zeroes.
+    ReduceAccumulatorFunc_t accumFunc;
+    ReduceCombinerFunc_t combFunc;
+    ReduceOutConverterFunc_t outFunc;   // nullptr copies the accumulator out.
+    size_t accumSize;
+};
+
 struct MTLaunchStruct {
     RsExpandKernelDriverInfo fep;
 
@@ -62,9 +117,29 @@ struct MTLaunchStruct {
     Allocation * aout[RS_KERNEL_INPUT_LIMIT];
 
     uint32_t mSliceSize;
-    volatile int mSliceNum;
+    uint32_t mSliceCount;
+    SliceQueue *mQueues;
+    uint32_t mQueueCount;
+    SliceTuner *mTuner;
+    uint32_t mTileWidth;  // Cells per tile column; 0 walks full rows.
     bool isThreadable;
 
+    // Reduction launches only.  Every thread folds its slices into its own
+    // accumulator, mAccumStride bytes apart so that no two share a cache
+    // line, and sets its mAccumUsed entry once it has initialized it.
+    const ReduceDescription *mReduce;
+    uint8_t *mAccumulators;
+    size_t mAccumStride;
+    uint8_t *mAccumUsed;
+
+    // Scheduling state of an in-flight launch, owned by
+    // RsdCpuReferenceImpl::launchThreads().
+    WorkerCallback_t mWalker;
+    volatile int mActiveThreads;  // Helpers currently running mWalker.
+    volatile int mExhausted;      // Set once no queue has slices left.
+    Signal *mLauncherSignal;      // Raised when the last helper leaves.
+    MTLaunchStruct *mNext;        // Next launch on the active list.
+
     RsLaunchDimensions start;
     RsLaunchDimensions end;
 };
@@ -79,8 +154,10 @@ public:
 
     bool init(uint32_t version_major, uint32_t version_minor, sym_lookup_t, script_lookup_t);
     void setPriority(int32_t priority) override;
+    void setAffinityPolicy(AffinityPolicy policy) override;
     virtual void launchThreads(WorkerCallback_t cbk, void *data);
     static void * helperThreadProc(void *vrsc);
+    static bool nextSlice(MTLaunchStruct *mtls, uint32_t idx, uint32_t *slice);
     RsdCpuScriptImpl * setTLS(RsdCpuScriptImpl *sc);
 
     Context * getContext() {return mRSC;}
@@ -90,6 +167,10 @@ public:
 
     void launchThreads(const Allocation** ains, uint32_t inLen, Allocation* aout,
                        const RsScriptCall* sc, MTLaunchStruct* mtls);
+    void launchReduce(Allocation* aout, MTLaunchStruct* mtls);
+    uint32_t selectSliceSize(const MTLaunchStruct *mtls, uint32_t units,
+                             uint32_t cellsPerUnit, uint32_t bytesPerUnit) const;
+    uint32_t selectTileWidth(const MTLaunchStruct *mtls, const RsScriptCall *sc) const;
 
     CpuScript * createScript(const ScriptC *s, char const *resName, char const *cacheDir,
                              uint8_t const *bitcode, size_t bitcodeSize, uint32_t flags) override;
@@ -132,7 +213,7 @@ public:
     virtual const char *getBccPluginName() const {
         return mBccPluginName.string();
     }
-    bool getInForEach() override { return mInForEach; }
+    bool getInForEach() override { return mInForEach != 0; }
 
     // Set to true if we should embed global variable information in the code.
     void setEmbedGlobalInfo(bool v) override {
@@ -161,7 +242,22 @@ protected:
     uint32_t version_major;
     uint32_t version_minor;
     //bool mHasGraphics;
-    bool mInForEach;
+
+    // Number of threaded launches currently in flight.
+    volatile int mInForEach;
+
+    // Per-core data cache sizes, used to size the tiles of tiled launches.
+    uint32_t mL1CacheBytes;
+    uint32_t mL2CacheBytes;
+
+    // Per-helper launch state, padded so that each helper spins on its own
+    // cache line while waiting for work.
+    struct WorkerSlot {
+        volatile uint32_t mTicket;  // Bumped by the launcher to start a launch.
+        volatile int32_t mParked;   // Non-zero while blocked on the launch signal.
+        volatile int32_t mIdle;     // Non-zero while waiting for a ticket.
+        uint32_t mSpinLimit;        // Adaptive spin budget before parking.
+    } __attribute__((aligned(64)));
 
     struct Workers {
         volatile int mRunningCount;
@@ -171,10 +267,56 @@ protected:
         pid_t *mNativeThreadId;
         Signal mCompleteSignal;
         Signal *mLaunchSignals;
-        WorkerCallback_t mLaunchCallback;
-        void *mLaunchData;
+        WorkerSlot *mSlots;
+        SliceQueue *mQueues;
+        volatile int mQueuesInUse;
+
+        // Cluster each thread is confined to, indexed by worker index, or
+        // kAnyCluster when the thread may run anywhere.
+        volatile uint32_t *mCluster;
     };
     Workers mWorkers;
+
+    // Core topology, read once at init.  mCpuOrder lists the cores fastest
+    // cluster first; mCpuCluster maps a core to its cluster, numbered in the
+    // same order.
+    AffinityPolicy mAffinityPolicy;
+    uint32_t mCpuCount;
+    uint32_t mClusterCount;
+    uint32_t *mCpuOrder;
+    uint32_t *mCpuCluster;
+
+    // Mask the helpers started with, and whether a policy other than
+    // AFFINITY_NONE has replaced it since.
+    cpu_set_t mInheritedCpuSet;
+    bool mAffinityApplied;
+
+    void readCpuTopology();
+    void applyAffinity(uint32_t idx);
+
+    // Launches that helpers may join, oldest first.  Every launch is its own
+    // task set with its own slice queues, so kernels launched from within a
+    // kernel share the pool with the launch around them.  Threads other than
+    // the helpers all act as worker 0, so mOuterLaunchLock lets only one of
+    // them launch at a time.  It is recursive for their nested launches.
+    pthread_mutex_t mLaunchLock;
+    pthread_mutex_t mOuterLaunchLock;
+    MTLaunchStruct *mLaunchHead;
+    MTLaunchStruct *mLaunchTail;
+    volatile int mPendingLaunches;
+
+    uint32_t getThreadIndex() const;
+    void launchThreadsLocked(WorkerCallback_t cbk, void *data, uint32_t self);
+    uint32_t waitForLaunch(uint32_t idx, uint32_t ticket);
+    void wakeWorker(uint32_t idx);
+    MTLaunchStruct * joinLaunch();
+    void retireLaunch(MTLaunchStruct *mtls);
+    void runLaunches(uint32_t idx);
+    void waitForLaunchCompletion(MTLaunchStruct *mtls);
+    void updateSliceTuner(MTLaunchStruct *mtls);
+    void combineAccumulators(const ReduceDescription *reduce, uint8_t **accums,
+                             uint32_t count);
+
     bool mExit;
     sym_lookup_t mSymLookupFn;
     script_lookup_t mScriptLookupFn;
@@ -2,6 +2,7 @@
 #include "rsCppUtils.h"
 
 #include <fstream>
+#include <map>
 #include <set>
 #include <memory>
 
@@ -14,6 +15,13 @@
 #endif
 
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace android {
 namespace renderscript {
@@ -57,6 +65,52 @@ static int copyFile(const char *dstFile, const char *srcFile) {
     return 0;
 }
 
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+// Create an anonymous in-memory file holding a copy of \p srcFile.
+// Return its descriptor, or -1 if the kernel has no memfd support or the copy
+// failed.
+static int copyToMemfd(const char *srcFile, const char *resName) {
+#ifdef __NR_memfd_create
+    int src = open(srcFile, O_RDONLY | O_CLOEXEC);
+    if (src < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(src, &st) != 0) {
+        close(src);
+        return -1;
+    }
+
+    std::string memName("librs.");
+    memName.append(resName);
+    // The descriptor lives as long as the library, so keep it out of the
+    // bcc and linker processes forked in the meantime.
+    int fd = syscall(__NR_memfd_create, memName.c_str(), MFD_CLOEXEC);
+    if (fd < 0) {
+        close(src);
+        return -1;
+    }
+
+    // The copy happens within the kernel, from the page cache.
+    off_t offset = 0;
+    while (offset < st.st_size) {
+        ssize_t r = sendfile(fd, src, &offset, st.st_size - offset);
+        if (r <= 0) {
+            close(fd);
+            close(src);
+            return -1;
+        }
+    }
+    close(src);
+    return fd;
+#else
+    return -1;
+#endif
+}
+
 static std::string findSharedObjectName(const char *cacheDir,
                                         const char *resName) {
 #ifndef RS_SERVER
@@ -120,10 +174,52 @@ bool SharedLibraryUtils::createSharedLibrary(const char *driverName,
         nullptr
     };
 
+    // The old library may be a hard link into the shared script cache.
+    // Unlink it so that the linker writes a new file instead of changing the
+    // cached one in place.
+    unlink(sharedLibName.c_str());
+
     return rsuExecuteCommand(LD_EXE_PATH, args.size()-1, args.data());
 
 }
 
+// Link or copy srcPath to a temporary name next to dstPath, then rename it
+// over dstPath.
+static bool replaceFile(const char *dstPath, const char *srcPath) {
+    std::string tmpName(dstPath);
+    tmpName.append("#");
+    tmpName.append(SharedLibraryUtils::getRandomString(6).string());
+
+    if (link(srcPath, tmpName.c_str()) != 0 &&
+        copyFile(tmpName.c_str(), srcPath) != 0) {
+        unlink(tmpName.c_str());
+        return false;
+    }
+    if (rename(tmpName.c_str(), dstPath) != 0) {
+        ALOGE("Could not rename %s -> %s", tmpName.c_str(), dstPath);
+        unlink(tmpName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool SharedLibraryUtils::installSharedLibrary(const char *srcPath,
+                                              const char *cacheDir,
+                                              const char *resName) {
+    if (access(srcPath, R_OK) != 0) {
+        return false;
+    }
+    std::string sharedLibName = findSharedObjectName(cacheDir, resName);
+    return replaceFile(sharedLibName.c_str(), srcPath);
+}
+
+bool SharedLibraryUtils::publishSharedLibrary(const char *cacheDir,
+                                              const char *resName,
+                                              const char *dstPath) {
+    std::string sharedLibName = findSharedObjectName(cacheDir, resName);
+    return replaceFile(dstPath, sharedLibName.c_str());
+}
+
 #endif  // RS_COMPATIBILITY_LIB
 
 const char* RsdCpuScriptImpl::BCC_EXE_PATH = "/system/bin/bcc";
@@ -222,6 +318,15 @@ void* SharedLibraryUtils::loadSOHelper(const char *origName, const char *cacheDi
         *alreadyLoaded = true;
     }
 
+    // Prefer a copy that never touches the filesystem.  The loader tells
+    // libraries apart by inode, so each memfd yields a private set of
+    // globals.  Like the copy on disk, a memfd holds its own pages, so every
+    // instance costs the size of the library in memory.
+    loaded = loadSOFromMemfd(origName, resName);
+    if (loaded) {
+        return loaded;
+    }
+
     std::string newName(cacheDir);
 
     // Append RS_CACHE_DIR only if it is not found in cacheDir
@@ -261,12 +366,55 @@ void* SharedLibraryUtils::loadSOHelper(const char *origName, const char *cacheDi
     return loaded;
 }
 
+// Descriptors of the in-memory images behind loaded libraries.  They stay
+// open while the library is loaded, so that no two live images are ever
+// opened under the same /proc/self/fd name.
+static pthread_mutex_t gMemfdMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<void *, int> gMemfdImages;
+
+void* SharedLibraryUtils::loadSOFromMemfd(const char *origName, const char *resName) {
+    int fd = copyToMemfd(origName, resName);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    char fdName[32];
+    snprintf(fdName, sizeof(fdName), "/proc/self/fd/%d", fd);
+    void *loaded = dlopen(fdName, RTLD_NOW | RTLD_LOCAL);
+    if (!loaded) {
+        ALOGV("Could not load memfd copy of %s: %s", origName, dlerror());
+        close(fd);
+        return nullptr;
+    }
+
+    pthread_mutex_lock(&gMemfdMutex);
+    gMemfdImages[loaded] = fd;
+    pthread_mutex_unlock(&gMemfdMutex);
+    return loaded;
+}
+
+void SharedLibraryUtils::unloadSharedLibrary(void *handle) {
+    if (handle == nullptr) {
+        return;
+    }
+    dlclose(handle);
+
+    pthread_mutex_lock(&gMemfdMutex);
+    std::map<void *, int>::iterator it = gMemfdImages.find(handle);
+    if (it != gMemfdImages.end()) {
+        close(it->second);
+        gMemfdImages.erase(it);
+    }
+    pthread_mutex_unlock(&gMemfdMutex);
+}
+
 #define MAXLINE 500
 #define MAKE_STR_HELPER(S) #S
 #define MAKE_STR(S) MAKE_STR_HELPER(S)
 #define EXPORT_VAR_STR "exportVarCount: "
 #define EXPORT_FUNC_STR "exportFuncCount: "
 #define EXPORT_FOREACH_STR "exportForEachCount: "
+#define EXPORT_REDUCE_STR "exportReduceCount: "
 #define OBJECT_SLOT_STR "objectSlotCount: "
 #define PRAGMA_STR "pragmaCount: "
 #define THREADABLE_STR "isThreadable: "
@@ -297,13 +445,188 @@ static char* strgets(char *s, int size, const char **ppstr) {
     return s;
 }
 
+// Look up the information about mutable global variables provided by bcc's
+// RSGlobalInfoPass.  Returns the number of entries.
+static int getGlobalInfo(void* sharedObj, const char*** names, const void*** addresses,
+                         const size_t** sizes, const uint32_t** properties) {
+    const int *rsGlobalEntries = (const int *) dlsym(sharedObj, kRsGlobalEntries);
+    *names = (const char **) dlsym(sharedObj, kRsGlobalNames);
+    *addresses = (const void **) dlsym(sharedObj, kRsGlobalAddresses);
+    *sizes = (const size_t *) dlsym(sharedObj, kRsGlobalSizes);
+    *properties = (const uint32_t *) dlsym(sharedObj, kRsGlobalProperties);
+
+    int numEntries = 0;
+    if (rsGlobalEntries) {
+        numEntries = *rsGlobalEntries;
+        if (numEntries > 0) {
+            rsAssert(*names);
+            rsAssert(*addresses);
+            rsAssert(*sizes);
+            rsAssert(*properties);
+        }
+    } else {
+        ALOGD("Missing .rs.global_entries from shared object");
+    }
+    return numEntries;
+}
+
 ScriptExecutable* ScriptExecutable::createFromSharedObject(
     Context* RSContext, void* sharedObj, uint32_t expectedChecksum) {
+    const RsExportTable *table = (const RsExportTable *) dlsym(sharedObj, kRsExportTable);
+    if (table) {
+        return createFromExportTable(RSContext, sharedObj, table, expectedChecksum);
+    }
+
+    const char *rsInfo = (const char *) dlsym(sharedObj, kRsInfo);
+    return createFromRSInfo(RSContext, sharedObj, rsInfo, expectedChecksum);
+}
+
+ScriptExecutable* ScriptExecutable::createFromExportTable(
+    Context* RSContext, void* sharedObj, const RsExportTable* table,
+    uint32_t expectedChecksum) {
+    if (table->magic != RS_EXPORT_TABLE_MAGIC ||
+        table->version < 1 || table->version > RS_EXPORT_TABLE_VERSION) {
+        ALOGE("Unsupported export table: magic %08x, version %u",
+              table->magic, table->version);
+        return nullptr;
+    }
+
+    const char *base = (const char *) table;
+    const RsExportVar *vars = (const RsExportVar *) (base + table->varsOffset);
+    const RsExportFunc *funcs = (const RsExportFunc *) (base + table->funcsOffset);
+    const RsExportForEach *forEachs =
+            (const RsExportForEach *) (base + table->forEachsOffset);
+    const char *strings = base + table->stringsOffset;
+
+    const size_t varCount = table->varCount;
+    const size_t funcCount = table->funcCount;
+    const size_t forEachCount = table->forEachCount;
+    const size_t reduceCount = table->version >= 2 ? table->reduceCount : 0;
+    const RsExportReduce *reduces =
+            (const RsExportReduce *) (base + (reduceCount ? table->reducesOffset : 0));
+    size_t pragmaCount = 0;
+    bool isThreadable = true;
+    uint32_t checksum = 0;
+
+    void** fieldAddress = new void*[varCount];
+    bool* fieldIsObject = new bool[varCount];
+    const char** fieldName = new const char*[varCount];
+    InvokeFunc_t* invokeFunctions = new InvokeFunc_t[funcCount];
+    ForEachFunc_t* forEachFunctions = new ForEachFunc_t[forEachCount];
+    uint32_t* forEachSignatures = new uint32_t[forEachCount];
+    ReduceDescription* reduceDescriptions = new ReduceDescription[reduceCount];
+    const char** pragmaKeys = nullptr;
+    const char** pragmaValues = nullptr;
+
+    const char** globalNames;
+    const void** globalAddresses;
+    const size_t* globalSizes;
+    const uint32_t* globalProperties;
+    int numEntries;
+
+    for (size_t i = 0; i < varCount; ++i) {
+        // Not a critical error if we don't find a global variable.
+        fieldAddress[i] = vars[i].address ? (void *) (base + vars[i].address) : nullptr;
+        fieldIsObject[i] = vars[i].isObject != 0;
+        fieldName[i] = strings + vars[i].name;
+    }
+
+    for (size_t i = 0; i < funcCount; ++i) {
+        if (!funcs[i].address) {
+            ALOGE("Failed to get function address for %s()", strings + funcs[i].name);
+            goto error;
+        }
+        invokeFunctions[i] = (InvokeFunc_t) (base + funcs[i].address);
+    }
+
+    for (size_t i = 0; i < forEachCount; ++i) {
+        const char *name = strings + forEachs[i].name;
+        forEachSignatures[i] = forEachs[i].signature;
+        forEachFunctions[i] = forEachs[i].address ?
+                (ForEachFunc_t) (base + forEachs[i].address) : nullptr;
+        if (i != 0 && forEachFunctions[i] == nullptr && strcmp(name, "root")) {
+            // Ignore missing root.expand functions.
+            // root() is always specified at location 0.
+            ALOGE("Failed to find forEach function address for %s.expand", name);
+            goto error;
+        }
+    }
+
+    for (size_t i = 0; i < reduceCount; ++i) {
+        const RsExportReduce &r = reduces[i];
+        ReduceDescription &desc = reduceDescriptions[i];
+        desc.initFunc = r.initializer ?
+                (ReduceInitializerFunc_t) (base + r.initializer) : nullptr;
+        desc.accumFunc = r.accumulator ?
+                (ReduceAccumulatorFunc_t) (base + r.accumulator) : nullptr;
+        desc.combFunc = r.combiner ?
+                (ReduceCombinerFunc_t) (base + r.combiner) : nullptr;
+        desc.outFunc = r.outConverter ?
+                (ReduceOutConverterFunc_t) (base + r.outConverter) : nullptr;
+        desc.accumSize = r.accumulatorSize;
+        if (!desc.accumFunc || !desc.combFunc || !desc.accumSize) {
+            ALOGE("Invalid reduction kernel %s", strings + r.name);
+            goto error;
+        }
+    }
+
+#ifndef RS_COMPATIBILITY_LIB
+    // As with the text format, pragmas and the threadable flag do not apply
+    // to the compat lib.
+    pragmaCount = table->pragmaCount;
+    pragmaKeys = new const char*[pragmaCount];
+    pragmaValues = new const char*[pragmaCount];
+    {
+        const RsExportPragma *pragmas =
+                (const RsExportPragma *) (base + table->pragmasOffset);
+        for (size_t i = 0; i < pragmaCount; ++i) {
+            pragmaKeys[i] = strings + pragmas[i].key;
+            pragmaValues[i] = strings + pragmas[i].value;
+        }
+    }
+
+    isThreadable = table->isThreadable != 0;
+    checksum = table->checksum;
+    if (expectedChecksum != 0 && checksum != expectedChecksum) {
+        ALOGE("Found invalid checksum.  Expected %08x, got %08x\n",
+              expectedChecksum, checksum);
+        goto error;
+    }
+#endif  // RS_COMPATIBILITY_LIB
+
+    numEntries = getGlobalInfo(sharedObj, &globalNames, &globalAddresses,
+                               &globalSizes, &globalProperties);
+
+    return new ScriptExecutable(
+        RSContext, fieldAddress, fieldIsObject, fieldName, varCount,
+        invokeFunctions, funcCount,
+        forEachFunctions, forEachSignatures, forEachCount,
+        reduceDescriptions, reduceCount,
+        pragmaKeys, pragmaValues, pragmaCount,
+        globalNames, globalAddresses, globalSizes, globalProperties,
+        numEntries, isThreadable, checksum, false);
+
+error:
+    delete[] pragmaValues;
+    delete[] pragmaKeys;
+    delete[] reduceDescriptions;
+    delete[] forEachSignatures;
+    delete[] forEachFunctions;
+    delete[] invokeFunctions;
+    delete[] fieldName;
+    delete[] fieldIsObject;
+    delete[] fieldAddress;
+    return nullptr;
+}
+
+ScriptExecutable* ScriptExecutable::createFromRSInfo(
+    Context* RSContext, void* sharedObj, const char* rsInfo, uint32_t expectedChecksum) {
     char line[MAXLINE];
 
     size_t varCount = 0;
     size_t funcCount = 0;
     size_t forEachCount = 0;
+    size_t reduceCount = 0;
     size_t objectSlotCount = 0;
     size_t pragmaCount = 0;
     bool isThreadable = true;
@@ -314,17 +637,16 @@ ScriptExecutable* ScriptExecutable::createFromSharedObject(
     InvokeFunc_t* invokeFunctions = nullptr;
     ForEachFunc_t* forEachFunctions = nullptr;
     uint32_t* forEachSignatures = nullptr;
+    ReduceDescription* reduceDescriptions = nullptr;
     const char ** pragmaKeys = nullptr;
     const char ** pragmaValues = nullptr;
     uint32_t checksum = 0;
 
-    const char *rsInfo = (const char *) dlsym(sharedObj, kRsInfo);
     int numEntries = 0;
-    const int *rsGlobalEntries = (const int *) dlsym(sharedObj, kRsGlobalEntries);
-    const char **rsGlobalNames = (const char **) dlsym(sharedObj, kRsGlobalNames);
-    const void **rsGlobalAddresses = (const void **) dlsym(sharedObj, kRsGlobalAddresses);
-    const size_t *rsGlobalSizes = (const size_t *) dlsym(sharedObj, kRsGlobalSizes);
-    const uint32_t *rsGlobalProperties = (const uint32_t *) dlsym(sharedObj, kRsGlobalProperties);
+    const char **rsGlobalNames = nullptr;
+    const void **rsGlobalAddresses = nullptr;
+    const size_t *rsGlobalSizes = nullptr;
+    const uint32_t *rsGlobalProperties = nullptr;
 
     if (strgets(line, MAXLINE, &rsInfo) == nullptr) {
         return nullptr;
@@ -445,6 +767,62 @@ ScriptExecutable* ScriptExecutable::createFromSharedObject(
         }
     }
 
+    // Reductions were added after the other sections, so their count line
+    // is optional; bcc's RSEmbedInfoPass does not write it yet, which leaves
+    // reduceCount at 0.  Each reduction is described as
+    //   <accumulator size> - <initializer> - <accumulator> - <combiner> - <outconverter>
+    // with "." for a missing initializer or outconverter.
+    {
+        const char *peek = rsInfo;
+        if (strgets(line, MAXLINE, &peek) != nullptr &&
+            strncmp(line, EXPORT_REDUCE_STR, strlen(EXPORT_REDUCE_STR)) == 0) {
+            rsInfo = peek;
+            if (sscanf(line, EXPORT_REDUCE_STR "%zu", &reduceCount) != 1) {
+                ALOGE("Invalid export reduce count!: %s", line);
+                goto error;
+            }
+        }
+    }
+
+    reduceDescriptions = new ReduceDescription[reduceCount];
+
+    for (size_t i = 0; i < reduceCount; ++i) {
+        size_t accumSize = 0;
+        char initName[MAXLINE];
+        char accumName[MAXLINE];
+        char combName[MAXLINE];
+        char outName[MAXLINE];
+
+        if (strgets(line, MAXLINE, &rsInfo) == nullptr) {
+            goto error;
+        }
+        if (sscanf(line, "%zu - %" MAKE_STR(MAXLINE) "s - %" MAKE_STR(MAXLINE) "s - %"
+                   MAKE_STR(MAXLINE) "s - %" MAKE_STR(MAXLINE) "s",
+                   &accumSize, initName, accumName, combName, outName) != 5 ||
+            accumSize == 0) {
+            ALOGE("Invalid export reduce!: %s", line);
+            goto error;
+        }
+
+        // Lookup the expanded accumulator.
+        strncat(accumName, ".expand", MAXLINE-1-strlen(accumName));
+
+        ReduceDescription &desc = reduceDescriptions[i];
+        desc.accumSize = accumSize;
+        desc.initFunc = strcmp(initName, ".") ?
+                (ReduceInitializerFunc_t) dlsym(sharedObj, initName) : nullptr;
+        desc.accumFunc = (ReduceAccumulatorFunc_t) dlsym(sharedObj, accumName);
+        desc.combFunc = (ReduceCombinerFunc_t) dlsym(sharedObj, combName);
+        desc.outFunc = strcmp(outName, ".") ?
+                (ReduceOutConverterFunc_t) dlsym(sharedObj, outName) : nullptr;
+        if ((strcmp(initName, ".") && !desc.initFunc) || !desc.accumFunc ||
+            !desc.combFunc || (strcmp(outName, ".") && !desc.outFunc)) {
+            ALOGE("Failed to find reduce function addresses for %s: %s",
+                  accumName, dlerror());
+            goto error;
+        }
+    }
+
     if (strgets(line, MAXLINE, &rsInfo) == nullptr) {
         goto error;
     }
@@ -559,24 +937,14 @@ ScriptExecutable* ScriptExecutable::createFromSharedObject(
 
 #endif  // RS_COMPATIBILITY_LIB
 
-    // Read in information about mutable global variables provided by bcc's
-    // RSGlobalInfoPass
-    if (rsGlobalEntries) {
-        numEntries = *rsGlobalEntries;
-        if (numEntries > 0) {
-            rsAssert(rsGlobalNames);
-            rsAssert(rsGlobalAddresses);
-            rsAssert(rsGlobalSizes);
-            rsAssert(rsGlobalProperties);
-        }
-    } else {
-        ALOGD("Missing .rs.global_entries from shared object");
-    }
+    numEntries = getGlobalInfo(sharedObj, &rsGlobalNames, &rsGlobalAddresses,
+                               &rsGlobalSizes, &rsGlobalProperties);
 
     return new ScriptExecutable(
         RSContext, fieldAddress, fieldIsObject, fieldName, varCount,
         invokeFunctions, funcCount,
         forEachFunctions, forEachSignatures, forEachCount,
+        reduceDescriptions, reduceCount,
         pragmaKeys, pragmaValues, pragmaCount,
         rsGlobalNames, rsGlobalAddresses, rsGlobalSizes, rsGlobalProperties,
         numEntries, isThreadable, checksum);
@@ -594,6 +962,8 @@ error:
     delete[] pragmaKeys;
 #endif  // RS_COMPATIBILITY_LIB
 
+    delete[] reduceDescriptions;
+
     delete[] forEachSignatures;
     delete[] forEachFunctions;
 
@@ -32,13 +32,27 @@ public:
     static bool createSharedLibrary(const char* driverName,
                                     const char* cacheDir,
                                     const char* resName);
+
+    // Make the shared object at srcPath the library of cacheDir and resName,
+    // as a hard link where the file system allows it and a copy otherwise.
+    static bool installSharedLibrary(const char* srcPath,
+                                     const char* cacheDir,
+                                     const char* resName);
+
+    // The reverse: add the library of cacheDir and resName to a cache under
+    // dstPath.  The entry appears atomically; an existing one is replaced.
+    static bool publishSharedLibrary(const char* cacheDir,
+                                     const char* resName,
+                                     const char* dstPath);
 #endif
 
     // Load the shared library referred to by cacheDir and resName. If we have
-    // already loaded this library, we instead create a new copy (in the
-    // cache dir) and then load that. We then immediately destroy the copy.
+    // already loaded this library, we instead load a new copy of it, made in
+    // memory where the kernel supports it and in the cache dir otherwise.
+    // A copy on disk is destroyed as soon as it is loaded.
     // This is required behavior to implement script instancing for the support
-    // library, since shared objects are loaded and de-duped by name only.
+    // library, since the loader de-dupes shared objects by inode: loading the
+    // same file again would share its globals with the first instance.
 
     // For 64bit RS Support Lib, the shared lib path cannot be constructed from
     // cacheDir, so nativeLibDir is needed to load shared libs.
@@ -46,6 +60,10 @@ public:
                                    const char *nativeLibDir = nullptr,
                                    bool *alreadyLoaded = nullptr);
 
+    // Close a library from loadSharedLibrary(), along with the in-memory copy
+    // it may have been loaded from.
+    static void unloadSharedLibrary(void *handle);
+
     // Create a len length string containing random characters from [A-Za-z0-9].
     static String8 getRandomString(size_t len);
 
@@ -56,6 +74,11 @@ private:
     static void *loadSOHelper(const char *origName, const char *cacheDir,
                               const char *resName, bool* alreadyLoaded = nullptr);
 
+    // Load a private instance of origName from an anonymous in-memory copy.
+    // Returns nullptr if that is not supported, so the caller can fall back
+    // to a copy on disk.
+    static void *loadSOFromMemfd(const char *origName, const char *resName);
+
     static const char* LD_EXE_PATH;
     static const char* RS_CACHE_DIR;
 };
@@ -68,23 +91,26 @@ public:
                      InvokeFunc_t* invokeFunctions, size_t funcCount,
                      ForEachFunc_t* forEachFunctions, uint32_t* forEachSignatures,
                      size_t forEachCount,
+                     ReduceDescription* reduceDescriptions, size_t reduceCount,
                      const char** pragmaKeys, const char** pragmaValues,
                      size_t pragmaCount,
                      const char **globalNames, const void **globalAddresses,
                      const size_t *globalSizes,
                      const uint32_t *globalProperties, size_t globalEntries,
-                     bool isThreadable, uint32_t buildChecksum) :
+                     bool isThreadable, uint32_t buildChecksum,
+                     bool ownsStrings = true) :
         mFieldAddress(fieldAddress), mFieldIsObject(fieldIsObject),
         mFieldName(fieldName), mExportedVarCount(varCount),
         mInvokeFunctions(invokeFunctions), mFuncCount(funcCount),
         mForEachFunctions(forEachFunctions), mForEachSignatures(forEachSignatures),
         mForEachCount(forEachCount),
+        mReduceDescriptions(reduceDescriptions), mReduceCount(reduceCount),
         mPragmaKeys(pragmaKeys), mPragmaValues(pragmaValues),
         mPragmaCount(pragmaCount), mGlobalNames(globalNames),
         mGlobalAddresses(globalAddresses), mGlobalSizes(globalSizes),
         mGlobalProperties(globalProperties), mGlobalEntries(globalEntries),
         mIsThreadable(isThreadable), mBuildChecksum(buildChecksum),
-        mRS(RSContext) {
+        mOwnsStrings(ownsStrings), mRS(RSContext) {
     }
 
     ~ScriptExecutable() {
@@ -98,20 +124,26 @@ public:
             }
         }
 
-        for (size_t i = 0; i < mPragmaCount; ++i) {
-            delete [] mPragmaKeys[i];
-            delete [] mPragmaValues[i];
+        if (mOwnsStrings) {
+            for (size_t i = 0; i < mPragmaCount; ++i) {
+                delete [] mPragmaKeys[i];
+                delete [] mPragmaValues[i];
+            }
         }
         delete[] mPragmaValues;
         delete[] mPragmaKeys;
 
+        delete[] mReduceDescriptions;
+
         delete[] mForEachSignatures;
         delete[] mForEachFunctions;
 
         delete[] mInvokeFunctions;
 
-        for (size_t i = 0; i < mExportedVarCount; i++) {
-            delete[] mFieldName[i];
+        if (mOwnsStrings) {
+            for (size_t i = 0; i < mExportedVarCount; i++) {
+                delete[] mFieldName[i];
+            }
         }
         delete[] mFieldName;
         delete[] mFieldIsObject;
@@ -126,9 +158,22 @@ public:
             createFromSharedObject(Context* RSContext, void* sharedObj,
                                    uint32_t expectedChecksum = 0);
 
+    // The two halves of createFromSharedObject: one uses the binary export
+    // table in place, the other parses the text .rs.info of older binaries.
+    // Names in the binary table are borrowed, not copied, so the shared
+    // object must outlive the executable.
+    static ScriptExecutable*
+            createFromExportTable(Context* RSContext, void* sharedObj,
+                                  const RsExportTable* table,
+                                  uint32_t expectedChecksum = 0);
+    static ScriptExecutable*
+            createFromRSInfo(Context* RSContext, void* sharedObj,
+                             const char* rsInfo, uint32_t expectedChecksum = 0);
+
     size_t getExportedVariableCount() const { return mExportedVarCount; }
     size_t getExportedFunctionCount() const { return mFuncCount; }
     size_t getExportedForEachCount() const { return mForEachCount; }
+    size_t getExportedReduceCount() const { return mReduceCount; }
     size_t getPragmaCount() const { return mPragmaCount; }
 
     void* getFieldAddress(int slot) const { return mFieldAddress[slot]; }
@@ -141,6 +186,10 @@ public:
     ForEachFunc_t getForEachFunction(int slot) const { return mForEachFunctions[slot]; }
     uint32_t getForEachSignature(int slot) const { return mForEachSignatures[slot]; }
 
+    const ReduceDescription* getReduceDescription(int slot) const {
+        return &mReduceDescriptions[slot];
+    }
+
     const char ** getPragmaKeys() const { return mPragmaKeys; }
     const char ** getPragmaValues() const { return mPragmaValues; }
 
@@ -193,6 +242,9 @@ private:
     uint32_t* mForEachSignatures;
     size_t mForEachCount;
 
+    ReduceDescription* mReduceDescriptions;
+    size_t mReduceCount;
+
     const char ** mPragmaKeys;
     const char ** mPragmaValues;
     size_t mPragmaCount;
@@ -205,6 +257,7 @@ private:
 
     bool mIsThreadable;
     uint32_t mBuildChecksum;
+    bool mOwnsStrings;
 
     Context* mRS;
 };
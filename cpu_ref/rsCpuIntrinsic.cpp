@@ -20,12 +20,17 @@
 using namespace android;
 using namespace android::renderscript;
 
+// Intrinsics with several kernels use small slot numbers, except Blend which
+// uses its blend mode (up to BLEND_LUMINOSITY) as the slot.
+static const uint32_t kIntrinsicKernelSlots = 64;
+
 RsdCpuScriptIntrinsic::RsdCpuScriptIntrinsic(RsdCpuReferenceImpl *ctx, const Script *s,
                                              const Element *e, RsScriptIntrinsicID iid)
         : RsdCpuScriptImpl(ctx, s) {
 
     mID = iid;
     mElement.set(e);
+    allocSliceTuners(kIntrinsicKernelSlots);
 }
 
 RsdCpuScriptIntrinsic::~RsdCpuScriptIntrinsic() {
@@ -100,6 +105,7 @@ void RsdCpuScriptIntrinsic::invokeForEach(uint32_t slot,
     if (forEachMtlsSetup(ains, inLen, aout, usr, usrLen, sc, &mtls)) {
         mtls.script = this;
         mtls.fep.slot = slot;
+        mtls.mTuner = getSliceTuner(slot);
 
         mtls.kernel = (void (*)())mRootPtr;
         mtls.fep.usr = this;
@@ -112,10 +118,31 @@ void RsdCpuScriptIntrinsic::invokeForEach(uint32_t slot,
     postLaunch(slot, ains, inLen, aout, usr, usrLen, sc);
 }
 
-void RsdCpuScriptIntrinsic::forEachKernelSetup(uint32_t slot, MTLaunchStruct *mtls) {
+void RsdCpuScriptIntrinsic::invokeForEachMultiOut(uint32_t slot,
+                                                  const Allocation ** ains,
+                                                  uint32_t inLen,
+                                                  Allocation ** aouts,
+                                                  uint32_t outLen,
+                                                  const void * usr,
+                                                  uint32_t usrLen,
+                                                  const RsScriptCall *sc) {
+
+    // Intrinsics write a single output.  Going through invokeForEach keeps
+    // the overrides of the individual intrinsics in the path.
+    if (outLen > 1) {
+        mCtx->getContext()->setError(RS_ERROR_BAD_SCRIPT,
+                                     "Intrinsics do not support multiple outputs");
+        return;
+    }
+    invokeForEach(slot, ains, inLen, outLen ? aouts[0] : nullptr, usr, usrLen, sc);
+}
+
+bool RsdCpuScriptIntrinsic::forEachKernelSetup(uint32_t slot, MTLaunchStruct *mtls) {
 
     mtls->script = this;
     mtls->fep.slot = slot;
+    mtls->mTuner = getSliceTuner(slot);
     mtls->kernel = (void (*)())mRootPtr;
     mtls->fep.usr = this;
+    return true;
 }
@@ -39,7 +39,16 @@ public:
                        uint32_t usrLen,
                        const RsScriptCall *sc) override;
 
-    void forEachKernelSetup(uint32_t slot, MTLaunchStruct * mtls) override;
+    void invokeForEachMultiOut(uint32_t slot,
+                               const Allocation ** ain,
+                               uint32_t inLen,
+                               Allocation ** aouts,
+                               uint32_t outLen,
+                               const void * usr,
+                               uint32_t usrLen,
+                               const RsScriptCall *sc) override;
+
+    bool forEachKernelSetup(uint32_t slot, MTLaunchStruct * mtls) override;
     void invokeInit() override;
     void invokeFreeChildren() override;
 
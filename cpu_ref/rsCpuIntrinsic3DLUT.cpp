@@ -18,6 +18,10 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
 using namespace android;
 using namespace android::renderscript;
 
@@ -97,6 +101,16 @@ void RsdCpuScriptIntrinsic3DLUT::kernel(const RsExpandKernelDriverInfo *info,
     }
 #endif
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+    if (gArchUseSIMD && gX86Kernels.lut3d && x2 > x1) {
+        int32_t len = x2 - x1;
+        gX86Kernels.lut3d(out, in, len, bp, stride_y, stride_z, (const int32_t *)&coordMul);
+        x1 += len;
+        out += len;
+        in += len;
+    }
+#endif
+
     while (x1 < x2) {
         int4 baseCoord = convert_int4(*in) * coordMul;
         int4 coord1 = baseCoord >> (int4)15;
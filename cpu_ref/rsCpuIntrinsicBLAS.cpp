@@ -18,6 +18,8 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 #include "rsCpuBLASDispatch.h"
+#include "rsCpuBNNM.h"
+#include "rsCpuBLASBuiltin.h"
 
 using namespace android;
 using namespace android::renderscript;
@@ -48,12 +50,14 @@ protected:
 
 #ifdef RS_COMPATIBILITY_LIB
     bool isBlasLibInitialized = false;
+    bool useBuiltinBlas = false;
+    bool invokeBuiltinBLAS(const RsBlasCall *call, const Allocation ** ain);
 #endif
-    static void kernelBNNM(size_t m, size_t n, size_t k,
-                           const uint8_t* a, uint8_t a_offset, size_t lda,
-                           const uint8_t* b, uint8_t b_offset, size_t ldb,
-                           uint8_t* c, int32_t c_offset, size_t ldc,
-                           int32_t c_mult_int);
+    void kernelBNNM(size_t m, size_t n, size_t k,
+                    const uint8_t* a, uint8_t a_offset, size_t lda,
+                    const uint8_t* b, uint8_t b_offset, size_t ldb,
+                    uint8_t* c, int32_t c_offset, size_t ldc,
+                    int32_t c_mult_int);
 
 
 
@@ -115,13 +119,23 @@ void RsdCpuScriptIntrinsicBLAS::invokeForEach(uint32_t slot,
     int lda = 0, ldb = 0, ldc = 0;
 
 #ifdef RS_COMPATIBILITY_LIB
-    // Allow BNNM even without libblas
+    // Allow BNNM even without libblas, and fall back to the built-in
+    // routines for the most common functions.
     if (call->func != RsBlas_bnnm && !isBlasLibInitialized) {
-        if (!loadBLASLib()) {
-            ALOGE("Failed to load the BLAS lib, IntrinsicBLAS NOT supported!\n");
+        if (!useBuiltinBlas) {
+            if (loadBLASLib()) {
+                isBlasLibInitialized = true;
+            } else {
+                ALOGW("Failed to load the BLAS lib, using built-in BLAS routines");
+                useBuiltinBlas = true;
+            }
+        }
+        if (useBuiltinBlas) {
+            if (!invokeBuiltinBLAS(call, ain)) {
+                ALOGE("BLAS function %i is not supported without the BLAS lib", call->func);
+            }
             return;
         }
-        isBlasLibInitialized = true;
     }
 #endif
 
@@ -666,43 +680,127 @@ void RsdCpuScriptIntrinsicBLAS::invokeForEach(uint32_t slot,
 
 }
 
+#ifdef RS_COMPATIBILITY_LIB
+// Runs the calls the built-in routines cover.  Returns false for any other
+// function.
+bool RsdCpuScriptIntrinsicBLAS::invokeBuiltinBLAS(const RsBlasCall *call,
+                                                  const Allocation ** ain) {
+    const bool transA = call->transA != CblasNoTrans;
+    const bool transB = call->transB != CblasNoTrans;
+    const bool upper = call->uplo == CblasUpper;
+    const bool left = call->side == CblasLeft;
+    const bool unitDiag = call->diag == CblasUnit;
+
+    void *A = nullptr;
+    void *B = nullptr;
+    void *C = nullptr;
+    int lda = 0, ldb = 0, ldc = 0;
+
+    switch (call->func) {
+    case (RsBlas_sgemv):
+        initABC(ain, sizeof(float), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_sgemv(mCtx, transA, call->M, call->N, call->alpha.f, (float*)A, lda,
+                         (float*)B, call->incX, call->beta.f, (float*)C, call->incY);
+        return true;
+    case (RsBlas_dgemv):
+        initABC(ain, sizeof(double), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_dgemv(mCtx, transA, call->M, call->N, call->alpha.d, (double*)A, lda,
+                         (double*)B, call->incX, call->beta.d, (double*)C, call->incY);
+        return true;
+    case (RsBlas_sgemm):
+        initABC(ain, sizeof(float), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_sgemm(mCtx, transA, transB, call->M, call->N, call->K, call->alpha.f,
+                         (float*)A, lda, (float*)B, ldb, call->beta.f, (float*)C, ldc);
+        return true;
+    case (RsBlas_dgemm):
+        initABC(ain, sizeof(double), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_dgemm(mCtx, transA, transB, call->M, call->N, call->K, call->alpha.d,
+                         (double*)A, lda, (double*)B, ldb, call->beta.d, (double*)C, ldc);
+        return true;
+    case (RsBlas_ssymm):
+        initABC(ain, sizeof(float), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_ssymm(mCtx, left, upper, call->M, call->N, call->alpha.f, (float*)A, lda,
+                         (float*)B, ldb, call->beta.f, (float*)C, ldc);
+        return true;
+    case (RsBlas_dsymm):
+        initABC(ain, sizeof(double), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_dsymm(mCtx, left, upper, call->M, call->N, call->alpha.d, (double*)A, lda,
+                         (double*)B, ldb, call->beta.d, (double*)C, ldc);
+        return true;
+    case (RsBlas_ssyrk):
+        initABC(ain, sizeof(float), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_ssyrk(mCtx, upper, transA, call->N, call->K, call->alpha.f, (float*)A, lda,
+                         call->beta.f, (float*)C, ldc);
+        return true;
+    case (RsBlas_dsyrk):
+        initABC(ain, sizeof(double), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_dsyrk(mCtx, upper, transA, call->N, call->K, call->alpha.d, (double*)A, lda,
+                         call->beta.d, (double*)C, ldc);
+        return true;
+    case (RsBlas_strsm):
+        initABC(ain, sizeof(float), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_strsm(mCtx, left, upper, transA, unitDiag, call->M, call->N, call->alpha.f,
+                         (float*)A, lda, (float*)B, ldb);
+        return true;
+    case (RsBlas_dtrsm):
+        initABC(ain, sizeof(double), &A, &B, &C, &lda, &ldb, &ldc);
+        rsdBuiltin_dtrsm(mCtx, left, upper, transA, unitDiag, call->M, call->N, call->alpha.d,
+                         (double*)A, lda, (double*)B, ldb);
+        return true;
+    default:
+        return false;
+    }
+}
+#endif
+
+static void walk_bnnm(void *usr, uint32_t idx) {
+    MTLaunchStruct *mtls = (MTLaunchStruct *)usr;
+    const BNNMPlan *plan = (const BNNMPlan *)mtls->fep.usr;
+    uint32_t tile;
+
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &tile)) {
+        rsdBNNMRunTile(plan, tile);
+    }
+}
+
 void RsdCpuScriptIntrinsicBLAS::kernelBNNM(size_t m, size_t n, size_t k,
                                            const uint8_t* a, uint8_t a_offset, size_t lda,
                                            const uint8_t* b, uint8_t b_offset, size_t ldb,
                                            uint8_t* c, int32_t c_offset, size_t ldc,
                                            int32_t c_mult_int) {
-    // Calculations are done in 1.10.21 fixed-point format for the final output,
-    // just before there's a shift down to drop the fractional parts. The output
-    // values are gated to 0 to 255 to fit in a byte, but the 10-bit format
-    // gives some headroom to avoid wrapping around on small overflows.
-    const int c_shift = 21;
-    size_t i = 0, j = 0, l = 0;
-    for (j = 0; j < n; j++) {
-        for (i = 0; i < m; i++) {
-            int32_t total = 0;
-            for (l = 0; l < k; l++) {
-                const int a_index = ((i * lda) + l);
-                const uint8_t a_as_byte = a[a_index];
-                const int32_t a_as_int = (((int32_t)(a_as_byte)) - a_offset);
-                const int b_index = ((j * ldb) + l);
-                const uint8_t b_as_byte = b[b_index];
-                const int32_t b_as_int = (((int32_t)(b_as_byte)) - b_offset);
-                const int32_t mult_as_int = (a_as_int * b_as_int);
-                total += mult_as_int;
-            }
-            const int c_index = ((ldc * i) + j);
-            int32_t output =
-                ((((total + c_offset) * c_mult_int) + (1 << (c_shift - 1)))
-                 >> c_shift);
-            if (output > 255) {
-                output = 255;
-            }
-            if (output < 0) {
-                output = 0;
-            }
-            c[c_index] = (uint8_t)(output);
-        }
+    BNNMArgs args;
+    args.m = m;
+    args.n = n;
+    args.k = k;
+    args.a = a;
+    args.a_offset = a_offset;
+    args.lda = lda;
+    args.b = b;
+    args.b_offset = b_offset;
+    args.ldb = ldb;
+    args.c = c;
+    args.c_offset = c_offset;
+    args.ldc = ldc;
+    args.c_mult_int = c_mult_int;
+
+    BNNMPlan plan;
+    if (!rsdBNNMPrepare(&plan, &args)) {
+        // The packed copies could not be allocated; the unblocked loop
+        // needs no extra memory.
+        rsdBNNMReference(&args);
+        return;
     }
+
+    // Each output tile is one slice, so the tiles are spread over the
+    // worker pool and rebalanced by stealing like any other launch.
+    MTLaunchStruct mtls;
+    memset(&mtls, 0, sizeof(mtls));
+    mtls.rsc = mCtx;
+    mtls.fep.usr = &plan;
+    mtls.mSliceCount = rsdBNNMTileCount(&plan);
+    mCtx->launchThreads(walk_bnnm, &mtls);
+
+    rsdBNNMRelease(&plan);
 }
 
 
@@ -18,6 +18,10 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
 using namespace android;
 using namespace android::renderscript;
 
@@ -94,21 +98,6 @@ extern "C" int rsdIntrinsicBlend_K(uchar4 *out, uchar4 const *in, int slot,
                     uint32_t xstart, uint32_t xend);
 #endif
 
-#if defined(ARCH_X86_HAVE_SSSE3)
-extern void rsdIntrinsicBlendSrcOver_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendDstOver_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendSrcIn_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendDstIn_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendSrcOut_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendDstOut_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendSrcAtop_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendDstAtop_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendXor_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendMultiply_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendAdd_K(void *dst, const void *src, uint32_t count8);
-extern void rsdIntrinsicBlendSub_K(void *dst, const void *src, uint32_t count8);
-#endif
-
 void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
                                         uint32_t xstart, uint32_t xend,
                                         uint32_t outstep) {
@@ -147,7 +136,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendSrcOver_K(out, in, len);
+                gX86Kernels.blendSrcOver(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -166,7 +155,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendDstOver_K(out, in, len);
+                gX86Kernels.blendDstOver(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -185,7 +174,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendSrcIn_K(out, in, len);
+                gX86Kernels.blendSrcIn(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -203,7 +192,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendDstIn_K(out, in, len);
+                gX86Kernels.blendDstIn(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -221,7 +210,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendSrcOut_K(out, in, len);
+                gX86Kernels.blendSrcOut(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -239,7 +228,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendDstOut_K(out, in, len);
+                gX86Kernels.blendDstOut(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -257,7 +246,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendSrcAtop_K(out, in, len);
+                gX86Kernels.blendSrcAtop(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -280,7 +269,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendDstAtop_K(out, in, len);
+                gX86Kernels.blendDstAtop(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -302,7 +291,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendXor_K(out, in, len);
+                gX86Kernels.blendXor(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -326,7 +315,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if ((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendMultiply_K(out, in, len);
+                gX86Kernels.blendMultiply(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -419,7 +408,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendAdd_K(out, in, len);
+                gX86Kernels.blendAdd(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -440,7 +429,7 @@ void RsdCpuScriptIntrinsicBlend::kernel(const RsExpandKernelDriverInfo *info,
         if (gArchUseSIMD) {
             if((x1 + 8) < x2) {
                 uint32_t len = (x2 - x1) >> 3;
-                rsdIntrinsicBlendSub_K(out, in, len);
+                gX86Kernels.blendSub(out, in, len);
                 x1 += len << 3;
                 out += len << 3;
                 in += len << 3;
@@ -17,6 +17,10 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
 using namespace android;
 using namespace android::renderscript;
 
@@ -32,6 +36,10 @@ public:
     void setGlobalVar(uint32_t slot, const void *data, size_t dataLength) override;
     void setGlobalObj(uint32_t slot, ObjectBase *data) override;
 
+    void preLaunch(uint32_t slot, const Allocation ** ains,
+                   uint32_t inLen, Allocation * aout, const void * usr,
+                   uint32_t usrLen, const RsScriptCall *sc) override;
+
     ~RsdCpuScriptIntrinsicBlur() override;
     RsdCpuScriptIntrinsicBlur(RsdCpuReferenceImpl *ctx, const Script *s, const Element *e);
 
@@ -42,15 +50,34 @@ protected:
     size_t *mScratchSize;
     float mRadius;
     int mIradius;
+    RsBlurMode mMode;
     ObjectBaseRef<Allocation> mAlloc;
 
+    // Box filter mode.  mVertical holds the input blurred along y as floats,
+    // computed before each launch; the kernels then blur its rows along x.
+    bool mUseBoxes;
+    int mBoxRadius[3];
+    float mBoxScale[3];
+    float *mVertical;
+    size_t mVerticalSize;
+    uint32_t mVerticalStride;
+
     static void kernelU4(const RsExpandKernelDriverInfo *info,
                          uint32_t xstart, uint32_t xend,
                          uint32_t outstep);
     static void kernelU1(const RsExpandKernelDriverInfo *info,
                          uint32_t xstart, uint32_t xend,
                          uint32_t outstep);
+    template <typename T, typename O>
+    static void kernelBox(const RsExpandKernelDriverInfo *info,
+                          uint32_t xstart, uint32_t xend);
+    static void walkVertical(void *usr, uint32_t idx);
+    void blurBand(uint32_t band, uint32_t idx);
+
+    void * getScratch(uint32_t lid, size_t bytes);
+    void updateWeights();
     void ComputeGaussianWeights();
+    void ComputeBoxSizes();
 };
 
 }
@@ -100,15 +127,260 @@ void RsdCpuScriptIntrinsicBlur::ComputeGaussianWeights() {
     }
 }
 
+// Three box filters applied one after the other come within a few percent of
+// a Gaussian, and each costs the same per pixel whatever its width, using a
+// running sum.  The widths are odd so every box stays centered, and split
+// between two neighbouring sizes so the three add up to the variance of the
+// kernel ComputeGaussianWeights() builds for the same radius.  That kernel
+// stops at the radius, so its variance is below sigma squared.
+void RsdCpuScriptIntrinsicBlur::ComputeBoxSizes() {
+    const int n = 3;
+    float sigma = 0.4f * mRadius + 0.6f;
+    int iradius = (int)ceilf(mRadius);
+
+    double sum = 0.0;
+    double moment = 0.0;
+    for (int r = -iradius; r <= iradius; r++) {
+        double g = exp(-(double)(r * r) / (2.0 * sigma * sigma));
+        sum += g;
+        moment += g * r * r;
+    }
+    // Each box of width w adds (w * w - 1) / 12.
+    float variance = 12.f * (float)(moment / sum);
+
+    int wl = (int)floorf(sqrtf(variance / n + 1.f));
+    if (!(wl & 1)) {
+        wl--;
+    }
+    int m = (int)roundf((variance - n * wl * wl - 4 * n * wl - 3 * n) / (-4.f * wl - 4.f));
+    m = rsMax(rsMin(m, n), 0);
+
+    for (int i = 0; i < n; i++) {
+        int w = (i < m) ? wl : wl + 2;
+        mBoxRadius[i] = w >> 1;
+        mBoxScale[i] = 1.f / w;
+    }
+}
+
+void RsdCpuScriptIntrinsicBlur::updateWeights() {
+    // mFp and mIp hold the taps of radius 25 at most.
+    mUseBoxes = (mMode == RS_BLUR_MODE_BOX) || (mRadius > 25.f);
+    if (mUseBoxes) {
+        ComputeBoxSizes();
+    } else {
+        ComputeGaussianWeights();
+    }
+}
+
 void RsdCpuScriptIntrinsicBlur::setGlobalObj(uint32_t slot, ObjectBase *data) {
     rsAssert(slot == 1);
     mAlloc.set(static_cast<Allocation *>(data));
 }
 
 void RsdCpuScriptIntrinsicBlur::setGlobalVar(uint32_t slot, const void *data, size_t dataLength) {
-    rsAssert(slot == 0);
-    mRadius = ((const float *)data)[0];
-    ComputeGaussianWeights();
+    switch (slot) {
+    case 0:
+        mRadius = ((const float *)data)[0];
+        break;
+    case 2:
+        mMode = (RsBlurMode)((const int32_t *)data)[0];
+        break;
+    default:
+        ALOGE("Blur setGlobalVar unhandled slot %u", slot);
+        return;
+    }
+    updateWeights();
+}
+
+// Returns per-thread scratch memory of at least bytes, aligned to 16 bytes.
+void * RsdCpuScriptIntrinsicBlur::getScratch(uint32_t lid, size_t bytes) {
+    if ((bytes > mScratchSize[lid]) || !mScratch[lid]) {
+        // Pad by one unit, realloc only aligns to 8 bytes.
+        void *p = realloc(mScratch[lid], bytes + 16);
+        if (!p) {
+            ALOGE("Blur failed to allocate %zu bytes of scratch", bytes);
+            return nullptr;
+        }
+        mScratch[lid] = p;
+        mScratchSize[lid] = bytes;
+    }
+    return (void *) ((((intptr_t)mScratch[lid]) + 15) & ~0xf);
+}
+
+
+// Box filter mode.
+//
+// The vertical pass runs over the whole input before the launch, split into
+// bands of kBandWidth float columns, one band per slice.  A band is copied
+// to scratch, filtered there along y three times, and stored in mVertical.
+// Each kernel row then filters its row of mVertical along x three times.
+// Every pass keeps a running sum of the pixels under the box, adding the one
+// entering and subtracting the one leaving at each step, so the cost per
+// pixel does not depend on the radius.  Pixels outside the image repeat the
+// edge, like the Gaussian path.
+
+static const uint32_t kBandWidth = 64;
+static const uint32_t kBandVectors = kBandWidth / 4;
+
+// Filters h rows of a band along y.  The loops over the band are over
+// float4 vectors, which the compiler keeps in NEON or SSE registers.
+static void BoxBand(float4 *out, const float4 *in, int h, int r, float scale) {
+    float4 sum[kBandVectors];
+
+    for (uint32_t k = 0; k < kBandVectors; k++) {
+        sum[k] = in[k] * (float)(r + 1);
+    }
+    for (int y = 1; y <= r; y++) {
+        const float4 *row = in + rsMin(y, h - 1) * kBandVectors;
+        for (uint32_t k = 0; k < kBandVectors; k++) {
+            sum[k] += row[k];
+        }
+    }
+
+    for (int y = 0; y < h; y++) {
+        const float4 *add = in + rsMin(y + r + 1, h - 1) * kBandVectors;
+        const float4 *sub = in + rsMax(y - r, 0) * kBandVectors;
+        for (uint32_t k = 0; k < kBandVectors; k++) {
+            out[k] = sum[k] * scale;
+            sum[k] += add[k] - sub[k];
+        }
+        out += kBandVectors;
+    }
+}
+
+// Filters a line of w pixels along x, producing pixels [x1, x2).
+template <typename T>
+static T * BoxLine(T *out, const T *in, int w, int x1, int x2, int r, float scale) {
+    T sum = in[rsMax(x1 - r, 0)] * (float)rsMax(r - x1 + 1, 1);
+    for (int x = rsMax(x1 - r + 1, 1); x <= x1 + r; x++) {
+        sum += in[rsMin(x, w - 1)];
+    }
+
+    for (int x = x1; x < x2; x++) {
+        *out = sum * scale;
+        sum += in[rsMin(x + r + 1, w - 1)] - in[rsMax(x - r, 0)];
+        out++;
+    }
+    return out;
+}
+
+static inline void StoreBox(uchar4 *out, float4 v) {
+    *out = convert_uchar4(clamp(v + 0.5f, 0.f, 255.f));
+}
+
+static inline void StoreBox(uchar *out, float v) {
+    *out = (uchar)clamp(v + 0.5f, 0.f, 255.f);
+}
+
+void RsdCpuScriptIntrinsicBlur::blurBand(uint32_t band, uint32_t idx) {
+    const uchar *pin = (const uchar *)mAlloc->mHal.drvState.lod[0].mallocPtr;
+    const size_t stride = mAlloc->mHal.drvState.lod[0].stride;
+    const uint32_t h = mAlloc->mHal.drvState.lod[0].dimY;
+    const uint32_t rowSize = mAlloc->mHal.drvState.lod[0].dimX *
+                             mAlloc->mHal.state.elementSizeBytes;
+
+    const uint32_t x1 = band * kBandWidth;
+    const uint32_t len = rsMin(kBandWidth, rowSize - x1);
+
+    float *a = (float *)getScratch(idx, 2 * h * kBandWidth * sizeof(float));
+    if (!a) {
+        return;
+    }
+    float *b = a + h * kBandWidth;
+
+    // Columns past the end of the row are zero.
+    for (uint32_t y = 0; y < h; y++) {
+        const uchar *src = pin + y * stride + x1;
+        float *dst = a + y * kBandWidth;
+        uint32_t x = 0;
+        for (; x < len; x++) {
+            dst[x] = src[x];
+        }
+        for (; x < kBandWidth; x++) {
+            dst[x] = 0.f;
+        }
+    }
+
+    BoxBand((float4 *)b, (const float4 *)a, h, mBoxRadius[0], mBoxScale[0]);
+    BoxBand((float4 *)a, (const float4 *)b, h, mBoxRadius[1], mBoxScale[1]);
+    BoxBand((float4 *)b, (const float4 *)a, h, mBoxRadius[2], mBoxScale[2]);
+
+    for (uint32_t y = 0; y < h; y++) {
+        memcpy(mVertical + y * mVerticalStride + x1, b + y * kBandWidth,
+               kBandWidth * sizeof(float));
+    }
+}
+
+void RsdCpuScriptIntrinsicBlur::walkVertical(void *usr, uint32_t idx) {
+    MTLaunchStruct *mtls = (MTLaunchStruct *)usr;
+    RsdCpuScriptIntrinsicBlur *cp = (RsdCpuScriptIntrinsicBlur *)mtls->fep.usr;
+    uint32_t band;
+
+    while (RsdCpuReferenceImpl::nextSlice(mtls, idx, &band)) {
+        cp->blurBand(band, idx);
+    }
+}
+
+void RsdCpuScriptIntrinsicBlur::preLaunch(uint32_t slot, const Allocation ** ains,
+                                          uint32_t inLen, Allocation * aout,
+                                          const void * usr, uint32_t usrLen,
+                                          const RsScriptCall *sc) {
+    if (!mUseBoxes || !mAlloc.get()) {
+        return;
+    }
+
+    const uint32_t h = mAlloc->mHal.drvState.lod[0].dimY;
+    const uint32_t rowSize = mAlloc->mHal.drvState.lod[0].dimX *
+                             mAlloc->mHal.state.elementSizeBytes;
+    const uint32_t bands = (rowSize + kBandWidth - 1) / kBandWidth;
+
+    mVerticalStride = bands * kBandWidth;
+    size_t bytes = (size_t)mVerticalStride * h * sizeof(float);
+    if (bytes > mVerticalSize) {
+        free(mVertical);
+        mVertical = nullptr;
+        mVerticalSize = 0;
+        if (posix_memalign((void **)&mVertical, 16, bytes)) {
+            ALOGE("Blur failed to allocate %zu bytes for the vertical pass", bytes);
+            mVertical = nullptr;
+            return;
+        }
+        mVerticalSize = bytes;
+    }
+
+    MTLaunchStruct mtls;
+    memset(&mtls, 0, sizeof(mtls));
+    mtls.rsc = mCtx;
+    mtls.fep.usr = this;
+    mtls.mSliceCount = bands;
+    mCtx->launchThreads(walkVertical, &mtls);
+}
+
+template <typename T, typename O>
+void RsdCpuScriptIntrinsicBlur::kernelBox(const RsExpandKernelDriverInfo *info,
+                                          uint32_t xstart, uint32_t xend) {
+    RsdCpuScriptIntrinsicBlur *cp = (RsdCpuScriptIntrinsicBlur *)info->usr;
+    if (!cp->mVertical) {
+        return;
+    }
+    const int w = info->dim.x;
+    const T *row = (const T *)(cp->mVertical + info->current.y * cp->mVerticalStride);
+
+    T *a = (T *)cp->getScratch(info->lid, 2 * w * sizeof(T));
+    if (!a) {
+        return;
+    }
+    T *b = a + w;
+
+    // The last pass only needs the pixels of this slice.
+    BoxLine(a, row, w, 0, w, cp->mBoxRadius[0], cp->mBoxScale[0]);
+    BoxLine(b, a, w, 0, w, cp->mBoxRadius[1], cp->mBoxScale[1]);
+    BoxLine(a, b, w, xstart, xend, cp->mBoxRadius[2], cp->mBoxScale[2]);
+
+    O *out = (O *)info->outPtr[0];
+    for (uint32_t x = 0; x < xend - xstart; x++) {
+        StoreBox(out + x, a[x]);
+    }
 }
 
 
@@ -154,12 +426,6 @@ extern "C" void rsdIntrinsicBlurU1_K(uchar *out, uchar const *in, size_t w, size
 extern "C" void rsdIntrinsicBlurU4_K(uchar4 *out, uchar4 const *in, size_t w, size_t h,
                  size_t p, size_t x, size_t y, size_t count, size_t r, uint16_t const *tab);
 
-#if defined(ARCH_X86_HAVE_SSSE3)
-extern void rsdIntrinsicBlurVFU4_K(void *dst, const void *pin, int stride, const void *gptr, int rct, int x1, int ct);
-extern void rsdIntrinsicBlurHFU4_K(void *dst, const void *pin, const void *gptr, int rct, int x1, int ct);
-extern void rsdIntrinsicBlurHFU1_K(void *dst, const void *pin, const void *gptr, int rct, int x1, int ct);
-#endif
-
 static void OneVFU4(float4 *out,
                     const uchar *ptrIn, int iStride, const float* gPtr, int ct,
                     int x1, int x2) {
@@ -169,7 +435,7 @@ static void OneVFU4(float4 *out,
         int t = (x2 - x1);
         t &= ~1;
         if (t) {
-            rsdIntrinsicBlurVFU4_K(out, ptrIn, iStride, gPtr, ct, x1, x1 + t);
+            gX86Kernels.blurVFU4(out, ptrIn, iStride, gPtr, ct, x1, x1 + t);
         }
         x1 += t;
         out += t;
@@ -222,7 +488,7 @@ static void OneVFU1(float *out,
         int t = (x2 - x1) >> 2;
         t &= ~1;
         if (t) {
-            rsdIntrinsicBlurVFU4_K(out, ptrIn, iStride, gPtr, ct, 0, t );
+            gX86Kernels.blurVFU4(out, ptrIn, iStride, gPtr, ct, 0, t );
             len -= t << 2;
             ptrIn += t << 2;
             out += t << 2;
@@ -292,6 +558,11 @@ void RsdCpuScriptIntrinsicBlur::kernelU4(const RsExpandKernelDriverInfo *info,
     const uchar *pin = (const uchar *)cp->mAlloc->mHal.drvState.lod[0].mallocPtr;
     const size_t stride = cp->mAlloc->mHal.drvState.lod[0].stride;
 
+    if (cp->mUseBoxes) {
+        kernelBox<float4, uchar4>(info, xstart, xend);
+        return;
+    }
+
     uchar4 *out = (uchar4 *)info->outPtr[0];
     uint32_t x1 = xstart;
     uint32_t x2 = xend;
@@ -306,13 +577,10 @@ void RsdCpuScriptIntrinsicBlur::kernelU4(const RsExpandKernelDriverInfo *info,
 #endif
 
     if (info->dim.x > 2048) {
-        if ((info->dim.x > cp->mScratchSize[info->lid]) || !cp->mScratch[info->lid]) {
-            // Pad the side of the allocation by one unit to allow alignment later
-            cp->mScratch[info->lid] = realloc(cp->mScratch[info->lid], (info->dim.x + 1) * 16);
-            cp->mScratchSize[info->lid] = info->dim.x;
+        buf = (float4 *)cp->getScratch(info->lid, info->dim.x * sizeof(float4));
+        if (!buf) {
+            return;
         }
-        // realloc only aligns to 8 bytes so we manually align to 16.
-        buf = (float4 *) ((((intptr_t)cp->mScratch[info->lid]) + 15) & ~0xf);
     }
     float4 *fout = (float4 *)buf;
     int y = info->current.y;
@@ -337,8 +605,8 @@ void RsdCpuScriptIntrinsicBlur::kernelU4(const RsExpandKernelDriverInfo *info,
 #if defined(ARCH_X86_HAVE_SSSE3)
     if (gArchUseSIMD) {
         if ((x1 + cp->mIradius) < x2) {
-            rsdIntrinsicBlurHFU4_K(out, buf - cp->mIradius, cp->mFp,
-                                   cp->mIradius * 2 + 1, x1, x2 - cp->mIradius);
+            gX86Kernels.blurHFU4(out, buf - cp->mIradius, cp->mFp,
+                                 cp->mIradius * 2 + 1, x1, x2 - cp->mIradius);
             out += (x2 - cp->mIradius) - x1;
             x1 = x2 - cp->mIradius;
         }
@@ -363,6 +631,11 @@ void RsdCpuScriptIntrinsicBlur::kernelU1(const RsExpandKernelDriverInfo *info,
     const uchar *pin = (const uchar *)cp->mAlloc->mHal.drvState.lod[0].mallocPtr;
     const size_t stride = cp->mAlloc->mHal.drvState.lod[0].stride;
 
+    if (cp->mUseBoxes) {
+        kernelBox<float, uchar>(info, xstart, xend);
+        return;
+    }
+
     uchar *out = (uchar *)info->outPtr[0];
     uint32_t x1 = xstart;
     uint32_t x2 = xend;
@@ -402,8 +675,8 @@ void RsdCpuScriptIntrinsicBlur::kernelU1(const RsExpandKernelDriverInfo *info,
             uint32_t len = x2 - (x1 + cp->mIradius);
             len &= ~3;
             if (len > 0) {
-                rsdIntrinsicBlurHFU1_K(out, ((float *)buf) - cp->mIradius, cp->mFp,
-                                       cp->mIradius * 2 + 1, x1, x1 + len);
+                gX86Kernels.blurHFU1(out, ((float *)buf) - cp->mIradius, cp->mFp,
+                                     cp->mIradius * 2 + 1, x1, x1 + len);
                 out += len;
                 x1 += len;
             }
@@ -434,13 +707,18 @@ RsdCpuScriptIntrinsicBlur::RsdCpuScriptIntrinsicBlur(RsdCpuReferenceImpl *ctx,
     }
     rsAssert(mRootPtr);
     mRadius = 5;
+    mMode = RS_BLUR_MODE_DEFAULT;
+    mUseBoxes = false;
+    mVertical = nullptr;
+    mVerticalSize = 0;
+    mVerticalStride = 0;
 
     mScratch = new void *[mCtx->getThreadCount()];
     mScratchSize = new size_t[mCtx->getThreadCount()];
     memset(mScratch, 0, sizeof(void *) * mCtx->getThreadCount());
     memset(mScratchSize, 0, sizeof(size_t) * mCtx->getThreadCount());
 
-    ComputeGaussianWeights();
+    updateWeights();
 }
 
 RsdCpuScriptIntrinsicBlur::~RsdCpuScriptIntrinsicBlur() {
@@ -456,10 +734,11 @@ RsdCpuScriptIntrinsicBlur::~RsdCpuScriptIntrinsicBlur() {
     if (mScratchSize) {
         delete []mScratchSize;
     }
+    free(mVertical);
 }
 
 void RsdCpuScriptIntrinsicBlur::populateScript(Script *s) {
-    s->mHal.info.exportedVariableCount = 2;
+    s->mHal.info.exportedVariableCount = 3;
 }
 
 void RsdCpuScriptIntrinsicBlur::invokeFreeChildren() {
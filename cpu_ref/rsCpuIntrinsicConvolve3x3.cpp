@@ -18,6 +18,10 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
 using namespace android;
 using namespace android::renderscript;
 
@@ -33,6 +37,12 @@ public:
     void setGlobalVar(uint32_t slot, const void *data, size_t dataLength) override;
     void setGlobalObj(uint32_t slot, ObjectBase *data) override;
 
+    // Every output row reads its neighbours' rows, so walk in tiles narrow
+    // enough for those rows to stay cached between consecutive y.
+    RsForEachStrategy getForEachStrategy(uint32_t slot) const override {
+        return RS_FOR_EACH_STRATEGY_TILE_MEDIUM;
+    }
+
     ~RsdCpuScriptIntrinsicConvolve3x3() override;
     RsdCpuScriptIntrinsicConvolve3x3(RsdCpuReferenceImpl *ctx, const Script *s, const Element *);
 
@@ -215,7 +225,11 @@ void RsdCpuScriptIntrinsicConvolve3x3::kernelU4(const RsExpandKernelDriverInfo *
         if (gArchUseSIMD) {
             int32_t len = (x2 - x1 - 1) >> 1;
             if(len > 0) {
+#if defined(ARCH_X86_HAVE_SSSE3)
+                gX86Kernels.convolve3x3(out, &py0[x1-1], &py1[x1-1], &py2[x1-1], cp->mIp, len);
+#else
                 rsdIntrinsicConvolve3x3_K(out, &py0[x1-1], &py1[x1-1], &py2[x1-1], cp->mIp, len);
+#endif
                 x1 += len << 1;
                 out += len << 1;
             }
@@ -18,6 +18,10 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
 using namespace android;
 using namespace android::renderscript;
 
@@ -33,6 +37,12 @@ public:
     void setGlobalVar(uint32_t slot, const void *data, size_t dataLength) override;
     void setGlobalObj(uint32_t slot, ObjectBase *data) override;
 
+    // Every output row reads its neighbours' rows, so walk in tiles narrow
+    // enough for those rows to stay cached between consecutive y.
+    RsForEachStrategy getForEachStrategy(uint32_t slot) const override {
+        return RS_FOR_EACH_STRATEGY_TILE_MEDIUM;
+    }
+
     ~RsdCpuScriptIntrinsicConvolve5x5() override;
     RsdCpuScriptIntrinsicConvolve5x5(RsdCpuReferenceImpl *ctx, const Script *s, const Element *e);
 
@@ -384,7 +394,7 @@ void RsdCpuScriptIntrinsicConvolve5x5::kernelU4(const RsExpandKernelDriverInfo *
     if (gArchUseSIMD &&((x1 + 6) < x2)) {
         // subtract 3 for end boundary
         uint32_t len = (x2 - x1 - 3) >> 2;
-        rsdIntrinsicConvolve5x5_K(out, py0 + x1 - 2, py1 + x1 - 2, py2 + x1 - 2, py3 + x1 - 2, py4 + x1 - 2, cp->mIp, len);
+        gX86Kernels.convolve5x5(out, py0 + x1 - 2, py1 + x1 - 2, py2 + x1 - 2, py3 + x1 - 2, py4 + x1 - 2, cp->mIp, len);
         out += len << 2;
         x1 += len << 2;
     }
@@ -17,6 +17,8 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 
+#include <malloc.h>
+
 using namespace android;
 using namespace android::renderscript;
 
@@ -44,11 +46,22 @@ protected:
                     uint32_t usrLen, const RsScriptCall *sc);
 
 
+    // Bins filled by one thread.  Each thread owns whole cache lines, and the
+    // trailing line keeps neighbouring threads off each other's lines and
+    // their bins out of the same cache sets.
+    struct ThreadBins {
+        int mSums[256 * 4];
+        int mUsed;  // Non-zero once the thread has counted since the last merge.
+    } __attribute__((aligned(64)));
+
     float mDot[4];
     int mDotI[4];
-    int *mSums;
+    int mAccumulate;
+    ThreadBins *mBins;
     ObjectBaseRef<Allocation> mAllocOut;
 
+    static int * getSums(const RsExpandKernelDriverInfo *info);
+
     static void kernelP1U4(const RsExpandKernelDriverInfo *info,
                            uint32_t xstart, uint32_t xend,
                            uint32_t outstep);
@@ -86,6 +99,11 @@ void RsdCpuScriptIntrinsicHistogram::setGlobalObj(uint32_t slot, ObjectBase *dat
 }
 
 void RsdCpuScriptIntrinsicHistogram::setGlobalVar(uint32_t slot, const void *data, size_t dataLength) {
+    if (slot == 2) {
+        rsAssert(dataLength == 4);
+        mAccumulate = *((const int *)data);
+        return;
+    }
     rsAssert(slot == 0);
     rsAssert(dataLength == 16);
     memcpy(mDot, data, 16);
@@ -104,7 +122,6 @@ RsdCpuScriptIntrinsicHistogram::preLaunch(uint32_t slot,
                                           const void * usr, uint32_t usrLen,
                                           const RsScriptCall *sc) {
 
-    const uint32_t threads = mCtx->getThreadCount();
     uint32_t vSize = mAllocOut->getType()->getElement()->getVectorSize();
 
     switch (slot) {
@@ -118,7 +135,6 @@ RsdCpuScriptIntrinsicHistogram::preLaunch(uint32_t slot,
             break;
         case 3:
             mRootPtr = &kernelP1U3;
-            vSize = 4;
             break;
         case 4:
             mRootPtr = &kernelP1U4;
@@ -142,7 +158,6 @@ RsdCpuScriptIntrinsicHistogram::preLaunch(uint32_t slot,
         }
         break;
     }
-    memset(mSums, 0, 256 * sizeof(int32_t) * threads * vSize);
 }
 
 void
@@ -152,27 +167,48 @@ RsdCpuScriptIntrinsicHistogram::postLaunch(uint32_t slot,
                                            const void * usr, uint32_t usrLen,
                                            const RsScriptCall *sc) {
 
-    unsigned int *o = (unsigned int *)mAllocOut->mHal.drvState.lod[0].mallocPtr;
+    // The output may be backed by a user pointer with only element alignment.
+    typedef uint uint4_u __attribute__((ext_vector_type(4), aligned(4)));
+    uint4_u *o = (uint4_u *)mAllocOut->mHal.drvState.lod[0].mallocPtr;
     uint32_t threads = mCtx->getThreadCount();
     uint32_t vSize = mAllocOut->getType()->getElement()->getVectorSize();
 
     if (vSize == 3) vSize = 4;
 
-    for (uint32_t ct=0; ct < (256 * vSize); ct++) {
-        o[ct] = mSums[ct];
-        for (uint32_t t=1; t < threads; t++) {
-            o[ct] += mSums[ct + (256 * vSize * t)];
+    // The bins of a histogram with vSize channels fill 256 * vSize ints, a
+    // whole number of uint4s.  Each thread that took part is folded into the
+    // output and cleared in the same pass, so the next launch starts from
+    // zeroed bins without another sweep over every thread's memory.
+    const uint32_t count = 256 * vSize / 4;
+    if (!mAccumulate) {
+        memset(o, 0, count * sizeof(uint4_u));
+    }
+    for (uint32_t t = 0; t < threads; t++) {
+        if (!mBins[t].mUsed) {
+            continue;
         }
+        uint4 *sums = (uint4 *)mBins[t].mSums;
+        for (uint32_t ct = 0; ct < count; ct++) {
+            o[ct] += sums[ct];
+            sums[ct] = 0;
+        }
+        mBins[t].mUsed = 0;
     }
 }
 
+int * RsdCpuScriptIntrinsicHistogram::getSums(const RsExpandKernelDriverInfo *info) {
+    RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
+    ThreadBins *bins = &cp->mBins[info->lid];
+    bins->mUsed = 1;
+    return bins->mSums;
+}
+
 void RsdCpuScriptIntrinsicHistogram::kernelP1U4(const RsExpandKernelDriverInfo *info,
                                                 uint32_t xstart, uint32_t xend,
                                                 uint32_t outstep) {
 
-    RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
     uchar *in = (uchar *)info->inPtr[0];
-    int * sums = &cp->mSums[256 * 4 * info->lid];
+    int * sums = getSums(info);
 
     for (uint32_t x = xstart; x < xend; x++) {
         sums[(in[0] << 2)    ] ++;
@@ -187,9 +223,8 @@ void RsdCpuScriptIntrinsicHistogram::kernelP1U3(const RsExpandKernelDriverInfo *
                                                 uint32_t xstart, uint32_t xend,
                                                 uint32_t outstep) {
 
-    RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
     uchar *in = (uchar *)info->inPtr[0];
-    int * sums = &cp->mSums[256 * 4 * info->lid];
+    int * sums = getSums(info);
 
     for (uint32_t x = xstart; x < xend; x++) {
         sums[(in[0] << 2)    ] ++;
@@ -203,9 +238,8 @@ void RsdCpuScriptIntrinsicHistogram::kernelP1U2(const RsExpandKernelDriverInfo *
                                                 uint32_t xstart, uint32_t xend,
                                                 uint32_t outstep) {
 
-    RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
     uchar *in = (uchar *)info->inPtr[0];
-    int * sums = &cp->mSums[256 * 2 * info->lid];
+    int * sums = getSums(info);
 
     for (uint32_t x = xstart; x < xend; x++) {
         sums[(in[0] << 1)    ] ++;
@@ -220,7 +254,7 @@ void RsdCpuScriptIntrinsicHistogram::kernelP1L4(const RsExpandKernelDriverInfo *
 
     RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
     uchar *in = (uchar *)info->inPtr[0];
-    int * sums = &cp->mSums[256 * info->lid];
+    int * sums = getSums(info);
 
     for (uint32_t x = xstart; x < xend; x++) {
         int t = (cp->mDotI[0] * in[0]) +
@@ -238,7 +272,7 @@ void RsdCpuScriptIntrinsicHistogram::kernelP1L3(const RsExpandKernelDriverInfo *
 
     RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
     uchar *in = (uchar *)info->inPtr[0];
-    int * sums = &cp->mSums[256 * info->lid];
+    int * sums = getSums(info);
 
     for (uint32_t x = xstart; x < xend; x++) {
         int t = (cp->mDotI[0] * in[0]) +
@@ -255,7 +289,7 @@ void RsdCpuScriptIntrinsicHistogram::kernelP1L2(const RsExpandKernelDriverInfo *
 
     RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
     uchar *in = (uchar *)info->inPtr[0];
-    int * sums = &cp->mSums[256 * info->lid];
+    int * sums = getSums(info);
 
     for (uint32_t x = xstart; x < xend; x++) {
         int t = (cp->mDotI[0] * in[0]) +
@@ -271,7 +305,7 @@ void RsdCpuScriptIntrinsicHistogram::kernelP1L1(const RsExpandKernelDriverInfo *
 
     RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
     uchar *in = (uchar *)info->inPtr[0];
-    int * sums = &cp->mSums[256 * info->lid];
+    int * sums = getSums(info);
 
     for (uint32_t x = xstart; x < xend; x++) {
         int t = (cp->mDotI[0] * in[0]);
@@ -284,9 +318,8 @@ void RsdCpuScriptIntrinsicHistogram::kernelP1U1(const RsExpandKernelDriverInfo *
                                                 uint32_t xstart, uint32_t xend,
                                                 uint32_t outstep) {
 
-    RsdCpuScriptIntrinsicHistogram *cp = (RsdCpuScriptIntrinsicHistogram *)info->usr;
     uchar *in = (uchar *)info->inPtr[0];
-    int * sums = &cp->mSums[256 * info->lid];
+    int * sums = getSums(info);
 
     for (uint32_t x = xstart; x < xend; x++) {
         sums[in[0]] ++;
@@ -300,7 +333,10 @@ RsdCpuScriptIntrinsicHistogram::RsdCpuScriptIntrinsicHistogram(RsdCpuReferenceIm
             : RsdCpuScriptIntrinsic(ctx, s, e, RS_SCRIPT_INTRINSIC_ID_HISTOGRAM) {
 
     mRootPtr = nullptr;
-    mSums = new int[256 * 4 * mCtx->getThreadCount()];
+    mAccumulate = 0;
+    const uint32_t threads = mCtx->getThreadCount();
+    mBins = (ThreadBins *)memalign(sizeof(ThreadBins), threads * sizeof(ThreadBins));
+    memset(mBins, 0, threads * sizeof(ThreadBins));
     mDot[0] = 0.299f;
     mDot[1] = 0.587f;
     mDot[2] = 0.114f;
@@ -312,13 +348,11 @@ RsdCpuScriptIntrinsicHistogram::RsdCpuScriptIntrinsicHistogram(RsdCpuReferenceIm
 }
 
 RsdCpuScriptIntrinsicHistogram::~RsdCpuScriptIntrinsicHistogram() {
-    if (mSums) {
-        delete []mSums;
-    }
+    free(mBins);
 }
 
 void RsdCpuScriptIntrinsicHistogram::populateScript(Script *s) {
-    s->mHal.info.exportedVariableCount = 2;
+    s->mHal.info.exportedVariableCount = 3;
 }
 
 void RsdCpuScriptIntrinsicHistogram::invokeFreeChildren() {
@@ -18,18 +18,35 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
 using namespace android;
 using namespace android::renderscript;
 
 namespace android {
 namespace renderscript {
 
+// Separable filter along one axis for the area and Lanczos modes.  Output
+// index o is the sum of count[o] input pixels from start[o], weighted by
+// weights[o * taps + k].  The weights of each output sum to one.
+struct ResizeFilter {
+    int32_t *start;
+    int32_t *count;
+    float *weights;
+    uint32_t taps;
+    uint32_t srcSize;
+    uint32_t dstSize;
+    RsResizeMode mode;
+};
 
 class RsdCpuScriptIntrinsicResize : public RsdCpuScriptIntrinsic {
 public:
     void populateScript(Script *) override;
     void invokeFreeChildren() override;
 
+    void setGlobalVar(uint32_t slot, const void *data, size_t dataLength) override;
     void setGlobalObj(uint32_t slot, ObjectBase *data) override;
 
     ~RsdCpuScriptIntrinsicResize() override;
@@ -45,6 +62,35 @@ public:
 protected:
     ObjectBaseRef<const Allocation> mAlloc;
     ObjectBaseRef<const Element> mElement;
+    RsResizeMode mMode;
+
+    // Area and Lanczos modes.  The tables are built before the launch.
+    // Each thread filters input rows along x into a ring of mFilterY.taps
+    // rows, input row r in slot r % taps, so the rows shared by consecutive
+    // output rows are only filtered once.  The output row is then summed
+    // from the ring along y.
+    ResizeFilter mFilterX;
+    ResizeFilter mFilterY;
+
+    struct RowCache {
+        uint8_t *data;      // The ring, then one accumulator row.
+        size_t size;
+        int32_t *index;     // Input row held by each slot, -1 if none.
+        uint32_t slots;
+        uint32_t x1;
+        uint32_t x2;
+        size_t rowBytes;
+        bool valid;
+    };
+    RowCache *mRows;
+
+    void buildFilter(ResizeFilter *f, uint32_t srcSize, uint32_t dstSize);
+    uint8_t * prepareRows(uint32_t lid, uint32_t x1, uint32_t x2, size_t rowBytes);
+
+    template <typename P, typename V>
+    static void kernelFilter(const RsExpandKernelDriverInfo *info,
+                             uint32_t xstart, uint32_t xend,
+                             uint32_t outstep);
 
     static void kernelU1(const RsExpandKernelDriverInfo *info,
                          uint32_t xstart, uint32_t xend,
@@ -70,6 +116,15 @@ protected:
 }
 
 
+void RsdCpuScriptIntrinsicResize::setGlobalVar(uint32_t slot, const void *data,
+                                               size_t dataLength) {
+    if (slot != 1) {
+        ALOGE("Resize setGlobalVar unhandled slot %u", slot);
+        return;
+    }
+    mMode = (RsResizeMode)((const int32_t *)data)[0];
+}
+
 void RsdCpuScriptIntrinsicResize::setGlobalObj(uint32_t slot, ObjectBase *data) {
     rsAssert(slot == 0);
     mAlloc.set(static_cast<Allocation *>(data));
@@ -369,6 +424,15 @@ void RsdCpuScriptIntrinsicResize::kernelU4(const RsExpandKernelDriverInfo *info,
     }
 #endif
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+    if (gArchUseSIMD && gX86Kernels.resizeU4 && x2 > x1) {
+        uint32_t len = x2 - x1;
+        gX86Kernels.resizeU4(out, x1, len, cp->scaleX, yp0, yp1, yp2, yp3, srcWidth, yf);
+        out += len;
+        x1 += len;
+    }
+#endif
+
     while(x1 < x2) {
         float xf = (x1 + 0.5f) * cp->scaleX - 0.5f;
         *out = OneBiCubic(yp0, yp1, yp2, yp3, xf, yf, srcWidth);
@@ -631,13 +695,261 @@ void RsdCpuScriptIntrinsicResize::kernelF1(const RsExpandKernelDriverInfo *info,
     }
 }
 
+// Area and Lanczos modes.
+//
+// Both filters are separable, so each output pixel is a weighted sum along
+// y of input rows that were first filtered along x.  The weights depend
+// only on the output column or row, and come from the tables built in
+// preLaunch.  For area mode they are the overlap of each input pixel with
+// the output pixel's footprint.  For Lanczos mode the window is stretched by
+// the downscale factor so it covers every input pixel, and is cut off at the
+// image edges.  The sums run on float vectors of one pixel each, which the
+// compiler keeps in NEON or SSE registers.
+
+static float lanczos3(float x) {
+    if (x == 0.f) {
+        return 1.f;
+    }
+    if (x <= -3.f || x >= 3.f) {
+        return 0.f;
+    }
+    float px = (float)M_PI * x;
+    return 3.f * sinf(px) * sinf(px / 3.f) / (px * px);
+}
+
+void RsdCpuScriptIntrinsicResize::buildFilter(ResizeFilter *f, uint32_t srcSize,
+                                              uint32_t dstSize) {
+    if (f->weights && f->srcSize == srcSize && f->dstSize == dstSize && f->mode == mMode) {
+        return;
+    }
+
+    float scale = (float)srcSize / dstSize;
+    float filterScale = rsMax(scale, 1.f);
+    float support = 3.f * filterScale;
+    uint32_t taps;
+    if (mMode == RS_RESIZE_MODE_AREA) {
+        taps = (uint32_t)ceilf(scale) + 1;
+    } else {
+        taps = (uint32_t)ceilf(2.f * support) + 2;
+    }
+    taps = rsMin(taps, srcSize);
+
+    delete [] f->start;
+    delete [] f->count;
+    delete [] f->weights;
+    f->start = new int32_t[dstSize];
+    f->count = new int32_t[dstSize];
+    f->weights = new float[dstSize * taps];
+    f->taps = taps;
+    f->srcSize = srcSize;
+    f->dstSize = dstSize;
+    f->mode = mMode;
+
+    for (uint32_t o = 0; o < dstSize; o++) {
+        float *w = f->weights + o * taps;
+        int32_t first;
+        int32_t last;
+        float lo = 0.f;
+        float hi = 0.f;
+        float center = 0.f;
+        if (mMode == RS_RESIZE_MODE_AREA) {
+            lo = o * scale;
+            hi = lo + scale;
+            first = (int32_t)floorf(lo);
+            last = (int32_t)ceilf(hi);
+        } else {
+            center = (o + 0.5f) * scale;
+            first = (int32_t)floorf(center - support);
+            last = (int32_t)ceilf(center + support);
+        }
+        first = rsMax(first, 0);
+        last = rsMin(last, (int32_t)srcSize);
+        last = rsMin(last, first + (int32_t)taps);
+        if (last <= first) {
+            // Rounding pushed the footprint past the edge; repeat it.
+            first = rsMin(first, (int32_t)srcSize - 1);
+            last = first + 1;
+        }
+
+        float sum = 0.f;
+        for (int32_t i = first; i < last; i++) {
+            float v;
+            if (mMode == RS_RESIZE_MODE_AREA) {
+                v = rsMin((float)(i + 1), hi) - rsMax((float)i, lo);
+                v = rsMax(v, 0.f);
+            } else {
+                v = lanczos3((i + 0.5f - center) / filterScale);
+            }
+            w[i - first] = v;
+            sum += v;
+        }
+        if (sum == 0.f) {
+            for (int32_t i = first; i < last; i++) {
+                w[i - first] = 1.f / (last - first);
+            }
+        } else {
+            for (int32_t i = first; i < last; i++) {
+                w[i - first] /= sum;
+            }
+        }
+        f->start[o] = first;
+        f->count[o] = last - first;
+    }
+}
+
+// Returns the ring and accumulator of thread lid, sized for output columns
+// [x1, x2).  The ring is emptied when the columns change or a new launch
+// started, since the input may have changed in between.
+uint8_t * RsdCpuScriptIntrinsicResize::prepareRows(uint32_t lid, uint32_t x1, uint32_t x2,
+                                                   size_t rowBytes) {
+    RowCache &rc = mRows[lid];
+    uint32_t slots = mFilterY.taps;
+    if (rc.valid && rc.x1 == x1 && rc.x2 == x2 && rc.rowBytes == rowBytes &&
+        rc.slots == slots) {
+        return rc.data;
+    }
+
+    size_t bytes = (slots + 1) * rowBytes;
+    if (bytes > rc.size || !rc.data) {
+        free(rc.data);
+        rc.data = nullptr;
+        rc.size = 0;
+        void *p = nullptr;
+        if (posix_memalign(&p, 16, bytes)) {
+            ALOGE("Resize failed to allocate %zu bytes of row cache", bytes);
+            return nullptr;
+        }
+        rc.data = (uint8_t *)p;
+        rc.size = bytes;
+    }
+    if (slots != rc.slots || !rc.index) {
+        delete [] rc.index;
+        rc.index = new int32_t[slots];
+        rc.slots = slots;
+    }
+    for (uint32_t ct = 0; ct < slots; ct++) {
+        rc.index[ct] = -1;
+    }
+    rc.x1 = x1;
+    rc.x2 = x2;
+    rc.rowBytes = rowBytes;
+    rc.valid = true;
+    return rc.data;
+}
+
+static inline float4 loadPixel(uchar4 p) { return convert_float4(p); }
+static inline float2 loadPixel(uchar2 p) { return convert_float2(p); }
+static inline float loadPixel(uchar p) { return (float)p; }
+static inline float4 loadPixel(float4 p) { return p; }
+static inline float2 loadPixel(float2 p) { return p; }
+static inline float loadPixel(float p) { return p; }
+
+static inline void storePixel(uchar4 *out, float4 v) {
+    *out = convert_uchar4(clamp(v + 0.5f, 0.f, 255.f));
+}
+static inline void storePixel(uchar2 *out, float2 v) {
+    *out = convert_uchar2(clamp(v + 0.5f, 0.f, 255.f));
+}
+static inline void storePixel(uchar *out, float v) {
+    *out = (uchar)clamp(v + 0.5f, 0.f, 255.f);
+}
+static inline void storePixel(float4 *out, float4 v) { *out = v; }
+static inline void storePixel(float2 *out, float2 v) { *out = v; }
+static inline void storePixel(float *out, float v) { *out = v; }
+
+// Filters one input row along x into output columns [x1, x2).
+template <typename P, typename V>
+static void filterRow(V *dst, const P *src, const ResizeFilter &f, uint32_t x1, uint32_t x2) {
+    for (uint32_t x = x1; x < x2; x++) {
+        const P *s = src + f.start[x];
+        const float *w = f.weights + x * f.taps;
+        const int32_t n = f.count[x];
+        V sum = 0.f;
+        for (int32_t k = 0; k < n; k++) {
+            sum += w[k] * loadPixel(s[k]);
+        }
+        *dst++ = sum;
+    }
+}
+
+template <typename P, typename V>
+void RsdCpuScriptIntrinsicResize::kernelFilter(const RsExpandKernelDriverInfo *info,
+                                               uint32_t xstart, uint32_t xend,
+                                               uint32_t outstep) {
+    RsdCpuScriptIntrinsicResize *cp = (RsdCpuScriptIntrinsicResize *)info->usr;
+
+    if (!cp->mAlloc.get()) {
+        ALOGE("Resize executed without input, skipping");
+        return;
+    }
+    if (xend <= xstart) {
+        return;
+    }
+    const uchar *pin = (const uchar *)cp->mAlloc->mHal.drvState.lod[0].mallocPtr;
+    const size_t stride = cp->mAlloc->mHal.drvState.lod[0].stride;
+    const ResizeFilter &fx = cp->mFilterX;
+    const ResizeFilter &fy = cp->mFilterY;
+
+    const uint32_t len = xend - xstart;
+    const size_t rowBytes = len * sizeof(V);
+    uint8_t *rows = cp->prepareRows(info->lid, xstart, xend, rowBytes);
+    if (!rows) {
+        return;
+    }
+    int32_t *index = cp->mRows[info->lid].index;
+
+    const uint32_t y = info->current.y;
+    const int32_t first = fy.start[y];
+    const int32_t n = fy.count[y];
+    const float *wy = fy.weights + y * fy.taps;
+
+    V *acc = (V *)(rows + fy.taps * rowBytes);
+    for (uint32_t x = 0; x < len; x++) {
+        acc[x] = 0.f;
+    }
+    for (int32_t k = 0; k < n; k++) {
+        const int32_t r = first + k;
+        const uint32_t slot = r % fy.taps;
+        V *row = (V *)(rows + slot * rowBytes);
+        if (index[slot] != r) {
+            filterRow(row, (const P *)(pin + stride * r), fx, xstart, xend);
+            index[slot] = r;
+        }
+        const float w = wy[k];
+        for (uint32_t x = 0; x < len; x++) {
+            acc[x] += w * row[x];
+        }
+    }
+
+    P *out = ((P *)info->outPtr[0]) + xstart;
+    for (uint32_t x = 0; x < len; x++) {
+        storePixel(out + x, acc[x]);
+    }
+}
+
 RsdCpuScriptIntrinsicResize::RsdCpuScriptIntrinsicResize (
             RsdCpuReferenceImpl *ctx, const Script *s, const Element *e)
             : RsdCpuScriptIntrinsic(ctx, s, e, RS_SCRIPT_INTRINSIC_ID_RESIZE) {
 
+    mMode = RS_RESIZE_MODE_BICUBIC;
+    memset(&mFilterX, 0, sizeof(mFilterX));
+    memset(&mFilterY, 0, sizeof(mFilterY));
+    mRows = new RowCache[mCtx->getThreadCount()];
+    memset(mRows, 0, sizeof(RowCache) * mCtx->getThreadCount());
 }
 
 RsdCpuScriptIntrinsicResize::~RsdCpuScriptIntrinsicResize() {
+    delete [] mFilterX.start;
+    delete [] mFilterX.count;
+    delete [] mFilterX.weights;
+    delete [] mFilterY.start;
+    delete [] mFilterY.count;
+    delete [] mFilterY.weights;
+    for (uint32_t ct = 0; ct < mCtx->getThreadCount(); ct++) {
+        free(mRows[ct].data);
+        delete [] mRows[ct].index;
+    }
+    delete [] mRows;
 }
 
 void RsdCpuScriptIntrinsicResize::preLaunch(uint32_t slot,
@@ -686,10 +998,46 @@ void RsdCpuScriptIntrinsicResize::preLaunch(uint32_t slot,
     scaleX = (float)srcWidth / aout->mHal.drvState.lod[0].dimX;
     scaleY = (float)srcHeight / aout->mHal.drvState.lod[0].dimY;
 
+    if (mMode == RS_RESIZE_MODE_BICUBIC) {
+        return;
+    }
+    buildFilter(&mFilterX, srcWidth, aout->mHal.drvState.lod[0].dimX);
+    buildFilter(&mFilterY, srcHeight, aout->mHal.drvState.lod[0].dimY);
+    for (uint32_t ct = 0; ct < mCtx->getThreadCount(); ct++) {
+        mRows[ct].valid = false;
+    }
+
+    if (mAlloc->getType()->getElement()->getType() == RS_TYPE_UNSIGNED_8) {
+        switch(mAlloc->getType()->getElement()->getVectorSize()) {
+        case 1:
+            mRootPtr = &kernelFilter<uchar, float>;
+            break;
+        case 2:
+            mRootPtr = &kernelFilter<uchar2, float2>;
+            break;
+        case 3:
+        case 4:
+            mRootPtr = &kernelFilter<uchar4, float4>;
+            break;
+        }
+    } else {
+        switch(mAlloc->getType()->getElement()->getVectorSize()) {
+        case 1:
+            mRootPtr = &kernelFilter<float, float>;
+            break;
+        case 2:
+            mRootPtr = &kernelFilter<float2, float2>;
+            break;
+        case 3:
+        case 4:
+            mRootPtr = &kernelFilter<float4, float4>;
+            break;
+        }
+    }
 }
 
 void RsdCpuScriptIntrinsicResize::populateScript(Script *s) {
-    s->mHal.info.exportedVariableCount = 1;
+    s->mHal.info.exportedVariableCount = 2;
 }
 
 void RsdCpuScriptIntrinsicResize::invokeFreeChildren() {
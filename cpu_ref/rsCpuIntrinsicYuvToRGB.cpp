@@ -18,6 +18,10 @@
 #include "rsCpuIntrinsic.h"
 #include "rsCpuIntrinsicInlines.h"
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
 #ifdef RS_COMPATIBILITY_LIB
 #include "rsCompatibilityLib.h"
 #endif
@@ -101,6 +105,15 @@ extern "C" void rsdIntrinsicYuv_K(void *dst, const uchar *Y, const uchar *uv, ui
 extern "C" void rsdIntrinsicYuvR_K(void *dst, const uchar *Y, const uchar *uv, uint32_t xstart, size_t xend);
 extern "C" void rsdIntrinsicYuv2_K(void *dst, const uchar *Y, const uchar *u, const uchar *v, size_t xstart, size_t xend);
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+// The factors of rsYuvToRGBA_uchar4, laid out as the x86 kernels expect.
+static const short gYuvParam[17] = {
+    298, 409, -100, 516, -208, 0, 0, 0,
+    16, 0, 0, 0, 0, 0, 0, 0,
+    128
+};
+#endif
+
 void RsdCpuScriptIntrinsicYuvToRGB::kernel(const RsExpandKernelDriverInfo *info,
                                            uint32_t xstart, uint32_t xend,
                                            uint32_t outstep) {
@@ -187,6 +200,24 @@ void RsdCpuScriptIntrinsicYuvToRGB::kernel(const RsExpandKernelDriverInfo *info,
     }
 #endif
 
+#if defined(ARCH_X86_HAVE_SSSE3)
+    // Groups of eight pixels, the rest are left to the loop below.
+    if((x2 > x1) && gArchUseSIMD) {
+        uint32_t len = (x2 - x1) >> 3;
+        if (cstep == 1) {
+            gX86Kernels.yuv2(out, Y + x1, u + (x1 >> 1), v + (x1 >> 1), len, gYuvParam);
+        } else if (cstep == 2 && u == v + 1) {
+            gX86Kernels.yuv(out, Y + x1, v + x1, len, gYuvParam);
+        } else if (cstep == 2 && u == v - 1) {
+            gX86Kernels.yuvR(out, Y + x1, u + x1, len, gYuvParam);
+        } else {
+            len = 0;
+        }
+        x1 += len << 3;
+        out += len << 3;
+    }
+#endif
+
     if(x2 > x1) {
        // ALOGE("y %i  %i  %i", info->current.y, x1, x2);
         while(x1 < x2) {
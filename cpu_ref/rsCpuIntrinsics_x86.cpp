@@ -17,6 +17,8 @@
 #include <stdint.h>
 #include <x86intrin.h>
 
+#include "rsCpuIntrinsics_x86.h"
+
 /* Unsigned extend packed 8-bit integer (in LBS) into packed 32-bit integer */
 static inline __m128i cvtepu8_epi32(__m128i x) {
 #if defined(__SSE4_1__)
@@ -553,12 +555,15 @@ void rsdIntrinsicYuv2_K(void *dst,
 
     for (i = 0; i < (count << 1); ++i) {
         Y = cvtepu8_epi32(_mm_set1_epi32(*(const int *)pY));
-        U = cvtepu8_epi32(_mm_set1_epi32(*(const int *)pU));
-		V = cvtepu8_epi32(_mm_set1_epi32(*(const int *)pV));
+        /* Each U and V sample covers two pixels */
+        U = cvtepu8_epi32(_mm_set1_epi16(*(const short *)pU));
+        U = _mm_shuffle_epi32(U, 0x50);
+        V = cvtepu8_epi32(_mm_set1_epi16(*(const short *)pV));
+        V = _mm_shuffle_epi32(V, 0x50);
 
         Y = _mm_sub_epi32(Y, biasY);
         U = _mm_sub_epi32(U, biasUV);
-		V = _mm_sub_epi32(V, biasUV);
+        V = _mm_sub_epi32(V, biasUV);
 
         Y = mullo_epi32(Y, c0);
 
@@ -587,8 +592,8 @@ void rsdIntrinsicYuv2_K(void *dst,
         y4 = _mm_shuffle_epi8(y3, T4x4);
         _mm_storeu_si128((__m128i *)dst, y4);
         pY += 4;
-        pU += 4;
-		pV += 4;
+        pU += 2;
+        pV += 2;
         dst = (__m128i *)dst + 1;
     }
 }
@@ -1315,3 +1320,118 @@ void rsdIntrinsicBlendSub_K(void *dst, const void *src, uint32_t count8) {
         dst = (__m128i *)dst + 2;
     }
 }
+
+/* Versions for newer CPUs, in rsCpuIntrinsics_x86_avx2.cpp */
+extern void rsdIntrinsicConvolve3x3_AVX2(void *dst, const void *y0, const void *y1,
+                                         const void *y2, const short *coef, uint32_t count);
+extern void rsdIntrinsicConvolve5x5_AVX2(void *dst, const void *y0, const void *y1,
+                                         const void *y2, const void *y3, const void *y4,
+                                         const short *coef, uint32_t count);
+extern void rsdIntrinsicBlurVFU4_AVX2(void *dst, const void *pin, int stride,
+                                      const void *gptr, int rct, int x1, int x2);
+extern void rsdIntrinsicBlurHFU4_AVX2(void *dst, const void *pin, const void *gptr,
+                                      int rct, int x1, int x2);
+extern void rsdIntrinsicBlurHFU1_AVX2(void *dst, const void *pin, const void *gptr,
+                                      int rct, int x1, int x2);
+extern void rsdIntrinsicBlurVFU4_AVX512(void *dst, const void *pin, int stride,
+                                        const void *gptr, int rct, int x1, int x2);
+extern void rsdIntrinsicBlurHFU4_AVX512(void *dst, const void *pin, const void *gptr,
+                                        int rct, int x1, int x2);
+extern void rsdIntrinsicBlurHFU1_AVX512(void *dst, const void *pin, const void *gptr,
+                                        int rct, int x1, int x2);
+extern void rsdIntrinsicBlendSrcOver_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendDstOver_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendSrcIn_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendDstIn_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendSrcOut_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendDstOut_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendSrcAtop_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendDstAtop_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendXor_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendMultiply_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendAdd_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicBlendSub_AVX2(void *dst, const void *src, uint32_t count8);
+extern void rsdIntrinsicYuv_AVX2(void *dst, const unsigned char *pY,
+                                 const unsigned char *pUV, uint32_t count,
+                                 const short *param);
+extern void rsdIntrinsicYuvR_AVX2(void *dst, const unsigned char *pY,
+                                  const unsigned char *pUV, uint32_t count,
+                                  const short *param);
+extern void rsdIntrinsicYuv2_AVX2(void *dst, const unsigned char *pY,
+                                  const unsigned char *pU, const unsigned char *pV,
+                                  uint32_t count, const short *param);
+extern void rsdIntrinsic3DLUT_AVX2(void *dst, const void *in, size_t count,
+                                   const void *lut, size_t strideY, size_t strideZ,
+                                   const int32_t *coordMul);
+extern void rsdIntrinsicResizeU4_AVX2(void *dst, uint32_t x1, uint32_t count, float scaleX,
+                                      const void *yp0, const void *yp1, const void *yp2,
+                                      const void *yp3, int width, float yf);
+
+namespace android {
+namespace renderscript {
+
+RsdX86Kernels gX86Kernels = {
+    rsdIntrinsicConvolve3x3_K,
+    rsdIntrinsicConvolve5x5_K,
+    rsdIntrinsicBlurVFU4_K,
+    rsdIntrinsicBlurHFU4_K,
+    rsdIntrinsicBlurHFU1_K,
+    rsdIntrinsicBlendSrcOver_K,
+    rsdIntrinsicBlendDstOver_K,
+    rsdIntrinsicBlendSrcIn_K,
+    rsdIntrinsicBlendDstIn_K,
+    rsdIntrinsicBlendSrcOut_K,
+    rsdIntrinsicBlendDstOut_K,
+    rsdIntrinsicBlendSrcAtop_K,
+    rsdIntrinsicBlendDstAtop_K,
+    rsdIntrinsicBlendXor_K,
+    rsdIntrinsicBlendMultiply_K,
+    rsdIntrinsicBlendAdd_K,
+    rsdIntrinsicBlendSub_K,
+    rsdIntrinsicYuv_K,
+    rsdIntrinsicYuvR_K,
+    rsdIntrinsicYuv2_K,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+/* In rsCpuBNNM.cpp */
+extern void rsdBNNMDotPanels_AVX2(const uint8_t *a, const uint8_t *b, size_t chunks,
+                                  uint32_t *out);
+
+void rsdSelectX86Kernels(uint32_t features) {
+    if (features & RS_CPU_X86_AVX2) {
+        gX86Kernels.convolve3x3 = rsdIntrinsicConvolve3x3_AVX2;
+        gX86Kernels.convolve5x5 = rsdIntrinsicConvolve5x5_AVX2;
+        gX86Kernels.blurVFU4 = rsdIntrinsicBlurVFU4_AVX2;
+        gX86Kernels.blurHFU4 = rsdIntrinsicBlurHFU4_AVX2;
+        gX86Kernels.blurHFU1 = rsdIntrinsicBlurHFU1_AVX2;
+        gX86Kernels.blendSrcOver = rsdIntrinsicBlendSrcOver_AVX2;
+        gX86Kernels.blendDstOver = rsdIntrinsicBlendDstOver_AVX2;
+        gX86Kernels.blendSrcIn = rsdIntrinsicBlendSrcIn_AVX2;
+        gX86Kernels.blendDstIn = rsdIntrinsicBlendDstIn_AVX2;
+        gX86Kernels.blendSrcOut = rsdIntrinsicBlendSrcOut_AVX2;
+        gX86Kernels.blendDstOut = rsdIntrinsicBlendDstOut_AVX2;
+        gX86Kernels.blendSrcAtop = rsdIntrinsicBlendSrcAtop_AVX2;
+        gX86Kernels.blendDstAtop = rsdIntrinsicBlendDstAtop_AVX2;
+        gX86Kernels.blendXor = rsdIntrinsicBlendXor_AVX2;
+        gX86Kernels.blendMultiply = rsdIntrinsicBlendMultiply_AVX2;
+        gX86Kernels.blendAdd = rsdIntrinsicBlendAdd_AVX2;
+        gX86Kernels.blendSub = rsdIntrinsicBlendSub_AVX2;
+        gX86Kernels.yuv = rsdIntrinsicYuv_AVX2;
+        gX86Kernels.yuvR = rsdIntrinsicYuvR_AVX2;
+        gX86Kernels.yuv2 = rsdIntrinsicYuv2_AVX2;
+        gX86Kernels.lut3d = rsdIntrinsic3DLUT_AVX2;
+        gX86Kernels.resizeU4 = rsdIntrinsicResizeU4_AVX2;
+        gX86Kernels.bnnmDotPanels = rsdBNNMDotPanels_AVX2;
+    }
+    if (features & RS_CPU_X86_AVX512) {
+        gX86Kernels.blurVFU4 = rsdIntrinsicBlurVFU4_AVX512;
+        gX86Kernels.blurHFU4 = rsdIntrinsicBlurHFU4_AVX512;
+        gX86Kernels.blurHFU1 = rsdIntrinsicBlurHFU1_AVX512;
+    }
+}
+
+}
+}
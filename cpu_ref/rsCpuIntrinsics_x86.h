@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RSD_CPU_INTRINSICS_X86_H
+#define RSD_CPU_INTRINSICS_X86_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+namespace renderscript {
+
+// Instruction set extensions of the CPU, as reported by cpuid and enabled by
+// the operating system.
+enum {
+    RS_CPU_X86_SSSE3  = 0x0001,
+    RS_CPU_X86_SSE4_1 = 0x0002,
+    RS_CPU_X86_AVX2   = 0x0004,     // AVX2 and FMA
+    RS_CPU_X86_AVX512 = 0x0008      // AVX-512 F and BW
+};
+
+typedef void (*RsdBlendKernel_t)(void *dst, const void *src, uint32_t count8);
+
+// The SIMD kernels of the intrinsics, each pointing at the best version the
+// CPU can run.  Entries are null where only the C code exists for this CPU.
+struct RsdX86Kernels {
+    // count pairs of pixels.
+    void (*convolve3x3)(void *dst, const void *y0, const void *y1, const void *y2,
+                        const short *coef, uint32_t count);
+    // count groups of four pixels.
+    void (*convolve5x5)(void *dst, const void *y0, const void *y1, const void *y2,
+                        const void *y3, const void *y4, const short *coef, uint32_t count);
+
+    // Pixels [x1, x2), x2 - x1 even.
+    void (*blurVFU4)(void *dst, const void *pin, int stride, const void *gptr,
+                     int rct, int x1, int x2);
+    void (*blurHFU4)(void *dst, const void *pin, const void *gptr, int rct, int x1, int x2);
+    // Pixels [x1, x2), x2 - x1 a multiple of four.
+    void (*blurHFU1)(void *dst, const void *pin, const void *gptr, int rct, int x1, int x2);
+
+    // count8 groups of eight pixels.
+    RsdBlendKernel_t blendSrcOver;
+    RsdBlendKernel_t blendDstOver;
+    RsdBlendKernel_t blendSrcIn;
+    RsdBlendKernel_t blendDstIn;
+    RsdBlendKernel_t blendSrcOut;
+    RsdBlendKernel_t blendDstOut;
+    RsdBlendKernel_t blendSrcAtop;
+    RsdBlendKernel_t blendDstAtop;
+    RsdBlendKernel_t blendXor;
+    RsdBlendKernel_t blendMultiply;
+    RsdBlendKernel_t blendAdd;
+    RsdBlendKernel_t blendSub;
+
+    // count groups of eight pixels.  yuv reads interleaved V and U, yuvR
+    // interleaved U and V, yuv2 separate planes.  param[0-4] are the Y, V to
+    // R, U to G, U to B and V to G factors, param[8] the Y offset and
+    // param[16] the UV offset.
+    void (*yuv)(void *dst, const unsigned char *pY, const unsigned char *pUV,
+                uint32_t count, const short *param);
+    void (*yuvR)(void *dst, const unsigned char *pY, const unsigned char *pUV,
+                 uint32_t count, const short *param);
+    void (*yuv2)(void *dst, const unsigned char *pY, const unsigned char *pU,
+                 const unsigned char *pV, uint32_t count, const short *param);
+
+    // count pixels.  coordMul scales an input channel to a 17.15 fixed point
+    // LUT coordinate.
+    void (*lut3d)(void *dst, const void *in, size_t count, const void *lut,
+                  size_t strideY, size_t strideZ, const int32_t *coordMul);
+
+    // Bicubic resize of count RGBA pixels starting at output column x1.
+    void (*resizeU4)(void *dst, uint32_t x1, uint32_t count, float scaleX,
+                     const void *yp0, const void *yp1, const void *yp2, const void *yp3,
+                     int width, float yf);
+
+    // Dot products of two packed panels of four rows of the BNNM intrinsic,
+    // over chunks groups of 16 bytes, into out[4 * row + col].
+    void (*bnnmDotPanels)(const uint8_t *a, const uint8_t *b, size_t chunks, uint32_t *out);
+};
+
+extern RsdX86Kernels gX86Kernels;
+
+// Points gX86Kernels at the kernels for the given RS_CPU_X86_* features.
+void rsdSelectX86Kernels(uint32_t features);
+
+}
+}
+
+#endif
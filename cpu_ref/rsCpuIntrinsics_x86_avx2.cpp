@@ -0,0 +1,710 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * AVX2 and AVX-512 versions of the kernels in rsCpuIntrinsics_x86.cpp, plus
+ * the 3DLUT and Resize kernels which have no SSSE3 version.  The rest of the
+ * library is built for SSSE3, so every function here carries its own target
+ * attribute and is only reached through gX86Kernels once cpuid has reported
+ * the extension.
+ *
+ * Most 256-bit instructions work on two independent 128-bit lanes.  The
+ * kernels lay their data out so that each lane does what one SSSE3
+ * iteration did, which keeps the results identical to the SSSE3 kernels.
+ * The float kernels use FMA and may differ in the last bit.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <x86intrin.h>
+
+#define RS_AVX2 __attribute__((target("avx2,fma")))
+#define RS_AVX512 __attribute__((target("avx2,fma,avx512f,avx512bw")))
+
+/* The SSSE3 kernels finish the odd pixels */
+extern "C" void rsdIntrinsicConvolve3x3_K(void *dst, const void *y0,
+                                          const void *y1, const void *y2,
+                                          const short *coef, uint32_t count);
+extern void rsdIntrinsicBlurHFU4_K(void *dst, const void *pin, const void *gptr,
+                                   int rct, int x1, int x2);
+extern void rsdIntrinsicBlurHFU1_K(void *dst, const void *pin, const void *gptr,
+                                   int rct, int x1, int x2);
+
+/*
+ * Convolve
+ *
+ * Four output pixels per step.  Loading 16 bytes at input pixel x and
+ * widening them gives pixels x and x + 1 in lane 0 and x + 2 and x + 3 in
+ * lane 1, so the low halves of the lanes feed outputs 0 and 2 and, shifted
+ * by 8 bytes, outputs 1 and 3.  The taps are taken in pairs in row major
+ * order, matching the coefficient pairs of the SSSE3 kernels.
+ */
+
+template <int N>
+RS_AVX2 static inline void convolveQuad(uint8_t *dst, const uint8_t * const *rows,
+                                        const __m256i *coef) {
+    __m256i even = _mm256_setzero_si256();
+    __m256i odd = _mm256_setzero_si256();
+    __m256i prevEven = _mm256_setzero_si256();
+    __m256i prevOdd = _mm256_setzero_si256();
+
+    for (int t = 0; t < N * N; t++) {
+        const uint8_t *p = rows[t / N] + (t % N) * 4;
+        __m256i e = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+        __m256i o = _mm256_srli_si256(e, 8);
+
+        if (t & 1) {
+            const __m256i c = coef[t >> 1];
+            even = _mm256_add_epi32(even, _mm256_madd_epi16(_mm256_unpacklo_epi16(prevEven, e), c));
+            odd = _mm256_add_epi32(odd, _mm256_madd_epi16(_mm256_unpacklo_epi16(prevOdd, o), c));
+        } else if (t == N * N - 1) {
+            const __m256i c = coef[t >> 1];
+            const __m256i z = _mm256_setzero_si256();
+            even = _mm256_add_epi32(even, _mm256_madd_epi16(_mm256_unpacklo_epi16(e, z), c));
+            odd = _mm256_add_epi32(odd, _mm256_madd_epi16(_mm256_unpacklo_epi16(o, z), c));
+        } else {
+            prevEven = e;
+            prevOdd = o;
+        }
+    }
+
+    even = _mm256_srai_epi32(even, 8);
+    odd = _mm256_srai_epi32(odd, 8);
+
+    /* Lane 0 holds outputs 0 and 1, lane 1 outputs 2 and 3 */
+    __m256i o16 = _mm256_packus_epi32(even, odd);
+    __m256i o8 = _mm256_packus_epi16(o16, o16);
+    o8 = _mm256_permute4x64_epi64(o8, 0x08);
+    _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(o8));
+}
+
+template <int N>
+RS_AVX2 static inline void loadConvolveCoef(__m256i *coef, const short *c) {
+    for (int t = 0; t < N * N; t += 2) {
+        uint32_t lo = (uint16_t)c[t];
+        uint32_t hi = (t + 1 < N * N) ? (uint16_t)c[t + 1] : 0;
+        coef[t >> 1] = _mm256_set1_epi32((int)(lo | (hi << 16)));
+    }
+}
+
+RS_AVX2 void rsdIntrinsicConvolve3x3_AVX2(void *dst, const void *y0, const void *y1,
+                                          const void *y2, const short *coef,
+                                          uint32_t count) {
+    __m256i c[5];
+    loadConvolveCoef<3>(c, coef);
+
+    const uint8_t *rows[3] = {(const uint8_t *)y0, (const uint8_t *)y1, (const uint8_t *)y2};
+    uint8_t *out = (uint8_t *)dst;
+    for (; count >= 2; count -= 2) {
+        convolveQuad<3>(out, rows, c);
+        for (int r = 0; r < 3; r++) {
+            rows[r] += 16;
+        }
+        out += 16;
+    }
+    if (count) {
+        rsdIntrinsicConvolve3x3_K(out, rows[0], rows[1], rows[2], coef, count);
+    }
+}
+
+RS_AVX2 void rsdIntrinsicConvolve5x5_AVX2(void *dst, const void *y0, const void *y1,
+                                          const void *y2, const void *y3, const void *y4,
+                                          const short *coef, uint32_t count) {
+    __m256i c[13];
+    loadConvolveCoef<5>(c, coef);
+
+    const uint8_t *rows[5] = {(const uint8_t *)y0, (const uint8_t *)y1, (const uint8_t *)y2,
+                              (const uint8_t *)y3, (const uint8_t *)y4};
+    uint8_t *out = (uint8_t *)dst;
+    for (uint32_t i = 0; i < count; i++) {
+        convolveQuad<5>(out, rows, c);
+        for (int r = 0; r < 5; r++) {
+            rows[r] += 16;
+        }
+        out += 16;
+    }
+}
+
+/*
+ * Blur
+ */
+
+RS_AVX2 void rsdIntrinsicBlurVFU4_AVX2(void *dst, const void *pin, int stride,
+                                       const void *gptr, int rct, int x1, int x2) {
+    const float *g = (const float *)gptr;
+    float *out = (float *)dst;
+
+    for (; x1 + 4 <= x2; x1 += 4) {
+        const uint8_t *pi = (const uint8_t *)pin + (x1 << 2);
+        __m256 bp0 = _mm256_setzero_ps();
+        __m256 bp1 = _mm256_setzero_ps();
+
+        for (int r = 0; r < rct; ++r) {
+            __m256 x = _mm256_broadcast_ss(g + r);
+            __m128i p = _mm_loadu_si128((const __m128i *)pi);
+            __m256 pf0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(p));
+            __m256 pf1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(p, 8)));
+            bp0 = _mm256_fmadd_ps(pf0, x, bp0);
+            bp1 = _mm256_fmadd_ps(pf1, x, bp1);
+            pi += stride;
+        }
+
+        _mm256_storeu_ps(out, bp0);
+        _mm256_storeu_ps(out + 8, bp1);
+        out += 16;
+    }
+
+    for (; x1 < x2; x1 += 2) {
+        const uint8_t *pi = (const uint8_t *)pin + (x1 << 2);
+        __m256 bp = _mm256_setzero_ps();
+
+        for (int r = 0; r < rct; ++r) {
+            __m256 x = _mm256_broadcast_ss(g + r);
+            __m128i p = _mm_loadl_epi64((const __m128i *)pi);
+            bp = _mm256_fmadd_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(p)), x, bp);
+            pi += stride;
+        }
+
+        _mm256_storeu_ps(out, bp);
+        out += 8;
+    }
+}
+
+RS_AVX2 void rsdIntrinsicBlurHFU4_AVX2(void *dst, const void *pin, const void *gptr,
+                                       int rct, int x1, int x2) {
+    const float *g = (const float *)gptr;
+    const __m256i Mlo = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+    uint8_t *out = (uint8_t *)dst;
+
+    /* Two pixels, one per lane */
+    for (; x1 + 2 <= x2; x1 += 2) {
+        const float *pi = (const float *)pin + (x1 << 2);
+        __m256 pf = _mm256_setzero_ps();
+
+        for (int r = 0; r < rct; ++r) {
+            pf = _mm256_fmadd_ps(_mm256_broadcast_ss(g + r), _mm256_loadu_ps(pi + (r << 2)), pf);
+        }
+
+        __m256i o = _mm256_cvtps_epi32(pf);
+        o = _mm256_packus_epi32(o, o);
+        o = _mm256_packus_epi16(o, o);
+        o = _mm256_permutevar8x32_epi32(o, Mlo);
+        _mm_storel_epi64((__m128i *)out, _mm256_castsi256_si128(o));
+        out += 8;
+    }
+
+    if (x1 < x2) {
+        rsdIntrinsicBlurHFU4_K(out, pin, gptr, rct, x1, x2);
+    }
+}
+
+RS_AVX2 void rsdIntrinsicBlurHFU1_AVX2(void *dst, const void *pin, const void *gptr,
+                                       int rct, int x1, int x2) {
+    const float *g = (const float *)gptr;
+    uint8_t *out = (uint8_t *)dst;
+
+    for (; x1 + 8 <= x2; x1 += 8) {
+        const float *pi = (const float *)pin + x1;
+        __m256 pf = _mm256_setzero_ps();
+
+        for (int r = 0; r < rct; ++r) {
+            pf = _mm256_fmadd_ps(_mm256_broadcast_ss(g + r), _mm256_loadu_ps(pi + r), pf);
+        }
+
+        __m256i o = _mm256_cvtps_epi32(pf);
+        __m128i o16 = _mm_packus_epi32(_mm256_castsi256_si128(o),
+                                       _mm256_extracti128_si256(o, 1));
+        _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(o16, o16));
+        out += 8;
+    }
+
+    if (x1 < x2) {
+        rsdIntrinsicBlurHFU1_K(out, pin, gptr, rct, x1, x2);
+    }
+}
+
+RS_AVX512 void rsdIntrinsicBlurVFU4_AVX512(void *dst, const void *pin, int stride,
+                                           const void *gptr, int rct, int x1, int x2) {
+    const float *g = (const float *)gptr;
+    float *out = (float *)dst;
+
+    for (; x1 + 4 <= x2; x1 += 4) {
+        const uint8_t *pi = (const uint8_t *)pin + (x1 << 2);
+        __m512 bp = _mm512_setzero_ps();
+
+        for (int r = 0; r < rct; ++r) {
+            __m512i p = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i *)pi));
+            bp = _mm512_fmadd_ps(_mm512_cvtepi32_ps(p), _mm512_set1_ps(g[r]), bp);
+            pi += stride;
+        }
+
+        _mm512_storeu_ps(out, bp);
+        out += 16;
+    }
+
+    if (x1 < x2) {
+        rsdIntrinsicBlurVFU4_AVX2(out, (const uint8_t *)pin + (x1 << 2), stride,
+                                  gptr, rct, 0, x2 - x1);
+    }
+}
+
+RS_AVX512 void rsdIntrinsicBlurHFU4_AVX512(void *dst, const void *pin, const void *gptr,
+                                           int rct, int x1, int x2) {
+    const float *g = (const float *)gptr;
+    uint8_t *out = (uint8_t *)dst;
+
+    for (; x1 + 4 <= x2; x1 += 4) {
+        const float *pi = (const float *)pin + (x1 << 2);
+        __m512 pf = _mm512_setzero_ps();
+
+        for (int r = 0; r < rct; ++r) {
+            pf = _mm512_fmadd_ps(_mm512_set1_ps(g[r]), _mm512_loadu_ps(pi + (r << 2)), pf);
+        }
+
+        __m512i o = _mm512_max_epi32(_mm512_cvtps_epi32(pf), _mm512_setzero_si512());
+        _mm_storeu_si128((__m128i *)out, _mm512_cvtusepi32_epi8(o));
+        out += 16;
+    }
+
+    if (x1 < x2) {
+        rsdIntrinsicBlurHFU4_AVX2(out, pin, gptr, rct, x1, x2);
+    }
+}
+
+RS_AVX512 void rsdIntrinsicBlurHFU1_AVX512(void *dst, const void *pin, const void *gptr,
+                                           int rct, int x1, int x2) {
+    const float *g = (const float *)gptr;
+    uint8_t *out = (uint8_t *)dst;
+
+    for (; x1 + 16 <= x2; x1 += 16) {
+        const float *pi = (const float *)pin + x1;
+        __m512 pf = _mm512_setzero_ps();
+
+        for (int r = 0; r < rct; ++r) {
+            pf = _mm512_fmadd_ps(_mm512_set1_ps(g[r]), _mm512_loadu_ps(pi + r), pf);
+        }
+
+        __m512i o = _mm512_max_epi32(_mm512_cvtps_epi32(pf), _mm512_setzero_si512());
+        _mm_storeu_si128((__m128i *)out, _mm512_cvtusepi32_epi8(o));
+        out += 16;
+    }
+
+    if (x1 < x2) {
+        rsdIntrinsicBlurHFU1_AVX2(out, pin, gptr, rct, x1, x2);
+    }
+}
+
+/*
+ * Blend
+ *
+ * Eight pixels per step.  Each op works on the pixels widened to 16 bits,
+ * four per register, as the SSSE3 kernels do.
+ */
+
+RS_AVX2 static inline __m256i alpha16(__m256i x) {
+    x = _mm256_shufflelo_epi16(x, 0xFF);
+    return _mm256_shufflehi_epi16(x, 0xFF);
+}
+
+struct BlendSrcOver {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        __m256i t = _mm256_mullo_epi16(outs, _mm256_sub_epi16(_mm256_set1_epi16(255), alpha16(ins)));
+        return _mm256_add_epi16(_mm256_srai_epi16(t, 8), ins);
+    }
+    static const bool kKeepDstAlpha = false;
+};
+
+struct BlendDstOver {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        __m256i t = _mm256_mullo_epi16(ins, _mm256_sub_epi16(_mm256_set1_epi16(255), alpha16(outs)));
+        return _mm256_add_epi16(_mm256_srai_epi16(t, 8), outs);
+    }
+    static const bool kKeepDstAlpha = false;
+};
+
+struct BlendSrcIn {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        return _mm256_srai_epi16(_mm256_mullo_epi16(ins, alpha16(outs)), 8);
+    }
+    static const bool kKeepDstAlpha = false;
+};
+
+struct BlendDstIn {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        return _mm256_srai_epi16(_mm256_mullo_epi16(outs, alpha16(ins)), 8);
+    }
+    static const bool kKeepDstAlpha = false;
+};
+
+struct BlendSrcOut {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        __m256i t = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha16(outs));
+        return _mm256_srai_epi16(_mm256_mullo_epi16(ins, t), 8);
+    }
+    static const bool kKeepDstAlpha = false;
+};
+
+struct BlendDstOut {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        __m256i t = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha16(ins));
+        return _mm256_srai_epi16(_mm256_mullo_epi16(outs, t), 8);
+    }
+    static const bool kKeepDstAlpha = false;
+};
+
+struct BlendSrcAtop {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        __m256i t = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha16(ins));
+        t = _mm256_mullo_epi16(t, outs);
+        t = _mm256_adds_epu16(t, _mm256_mullo_epi16(alpha16(outs), ins));
+        return _mm256_srli_epi16(t, 8);
+    }
+    static const bool kKeepDstAlpha = true;
+};
+
+struct BlendDstAtop {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        __m256i t = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha16(outs));
+        t = _mm256_mullo_epi16(t, ins);
+        t = _mm256_adds_epu16(t, _mm256_mullo_epi16(alpha16(ins), outs));
+        return _mm256_srli_epi16(t, 8);
+    }
+    static const bool kKeepDstAlpha = true;
+};
+
+struct BlendMultiply {
+    RS_AVX2 static inline __m256i op(__m256i ins, __m256i outs) {
+        return _mm256_srli_epi16(_mm256_mullo_epi16(ins, outs), 8);
+    }
+    static const bool kKeepDstAlpha = false;
+};
+
+template <typename Op>
+RS_AVX2 static inline void blend(void *dst, const void *src, uint32_t count8) {
+    const __m256i M0001 = _mm256_set1_epi32(0xff000000);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (uint32_t i = 0; i < count8; ++i) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)src);
+        __m256i out = _mm256_loadu_si256((const __m256i *)dst);
+
+        __m256i t0 = Op::op(_mm256_unpacklo_epi8(in, zero), _mm256_unpacklo_epi8(out, zero));
+        __m256i t1 = Op::op(_mm256_unpackhi_epi8(in, zero), _mm256_unpackhi_epi8(out, zero));
+        t0 = _mm256_packus_epi16(t0, t1);
+        if (Op::kKeepDstAlpha) {
+            t0 = _mm256_blendv_epi8(t0, out, M0001);
+        }
+        _mm256_storeu_si256((__m256i *)dst, t0);
+
+        src = (const __m256i *)src + 1;
+        dst = (__m256i *)dst + 1;
+    }
+}
+
+RS_AVX2 void rsdIntrinsicBlendSrcOver_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendSrcOver>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendDstOver_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendDstOver>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendSrcIn_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendSrcIn>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendDstIn_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendDstIn>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendSrcOut_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendSrcOut>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendDstOut_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendDstOut>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendSrcAtop_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendSrcAtop>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendDstAtop_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendDstAtop>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendMultiply_AVX2(void *dst, const void *src, uint32_t count8) {
+    blend<BlendMultiply>(dst, src, count8);
+}
+
+RS_AVX2 void rsdIntrinsicBlendXor_AVX2(void *dst, const void *src, uint32_t count8) {
+    for (uint32_t i = 0; i < count8; ++i) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)src);
+        __m256i out = _mm256_loadu_si256((const __m256i *)dst);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_xor_si256(out, in));
+        src = (const __m256i *)src + 1;
+        dst = (__m256i *)dst + 1;
+    }
+}
+
+RS_AVX2 void rsdIntrinsicBlendAdd_AVX2(void *dst, const void *src, uint32_t count8) {
+    for (uint32_t i = 0; i < count8; ++i) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)src);
+        __m256i out = _mm256_loadu_si256((const __m256i *)dst);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_adds_epu8(out, in));
+        src = (const __m256i *)src + 1;
+        dst = (__m256i *)dst + 1;
+    }
+}
+
+RS_AVX2 void rsdIntrinsicBlendSub_AVX2(void *dst, const void *src, uint32_t count8) {
+    for (uint32_t i = 0; i < count8; ++i) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)src);
+        __m256i out = _mm256_loadu_si256((const __m256i *)dst);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_subs_epu8(out, in));
+        src = (const __m256i *)src + 1;
+        dst = (__m256i *)dst + 1;
+    }
+}
+
+/*
+ * YuvToRGB
+ *
+ * Eight pixels per step, four per lane.  U and V hold one sample for each
+ * pair of pixels.
+ */
+
+RS_AVX2 static inline void yuvToRGBA(void *dst, __m256i Y, __m256i U, __m256i V,
+                                     const short *param) {
+    const __m256i biasY = _mm256_set1_epi32(param[8]);
+    const __m256i biasUV = _mm256_set1_epi32(param[16]);
+    const __m256i T4x4 = _mm256_setr_epi8(0, 4,  8, 12, 1, 5,  9, 13,
+                                          2, 6, 10, 14, 3, 7, 11, 15,
+                                          0, 4,  8, 12, 1, 5,  9, 13,
+                                          2, 6, 10, 14, 3, 7, 11, 15);
+
+    Y = _mm256_mullo_epi32(_mm256_sub_epi32(Y, biasY), _mm256_set1_epi32(param[0]));
+    U = _mm256_sub_epi32(U, biasUV);
+    V = _mm256_sub_epi32(V, biasUV);
+
+    __m256i R = _mm256_add_epi32(Y, _mm256_mullo_epi32(V, _mm256_set1_epi32(param[1])));
+    R = _mm256_srai_epi32(_mm256_add_epi32(R, biasUV), 8);
+
+    __m256i G = _mm256_add_epi32(Y, _mm256_mullo_epi32(U, _mm256_set1_epi32(param[2])));
+    G = _mm256_add_epi32(G, _mm256_mullo_epi32(V, _mm256_set1_epi32(param[4])));
+    G = _mm256_srai_epi32(_mm256_add_epi32(G, biasUV), 8);
+
+    __m256i B = _mm256_add_epi32(Y, _mm256_mullo_epi32(U, _mm256_set1_epi32(param[3])));
+    B = _mm256_srai_epi32(_mm256_add_epi32(B, biasUV), 8);
+
+    __m256i RG = _mm256_packus_epi32(R, G);
+    __m256i BA = _mm256_packus_epi32(B, _mm256_set1_epi32(255));
+    __m256i o = _mm256_shuffle_epi8(_mm256_packus_epi16(RG, BA), T4x4);
+    _mm256_storeu_si256((__m256i *)dst, o);
+}
+
+RS_AVX2 void rsdIntrinsicYuv_AVX2(void *dst, const unsigned char *pY,
+                                  const unsigned char *pUV, uint32_t count,
+                                  const short *param) {
+    for (uint32_t i = 0; i < count; ++i) {
+        __m256i Y = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)pY));
+        __m256i VU = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)pUV));
+        yuvToRGBA(dst, Y, _mm256_shuffle_epi32(VU, 0xf5), _mm256_shuffle_epi32(VU, 0xa0), param);
+        pY += 8;
+        pUV += 8;
+        dst = (__m256i *)dst + 1;
+    }
+}
+
+RS_AVX2 void rsdIntrinsicYuvR_AVX2(void *dst, const unsigned char *pY,
+                                   const unsigned char *pUV, uint32_t count,
+                                   const short *param) {
+    for (uint32_t i = 0; i < count; ++i) {
+        __m256i Y = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)pY));
+        __m256i UV = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)pUV));
+        yuvToRGBA(dst, Y, _mm256_shuffle_epi32(UV, 0xa0), _mm256_shuffle_epi32(UV, 0xf5), param);
+        pY += 8;
+        pUV += 8;
+        dst = (__m256i *)dst + 1;
+    }
+}
+
+RS_AVX2 void rsdIntrinsicYuv2_AVX2(void *dst, const unsigned char *pY,
+                                   const unsigned char *pU, const unsigned char *pV,
+                                   uint32_t count, const short *param) {
+    const __m256i Mdup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    for (uint32_t i = 0; i < count; ++i) {
+        int32_t u, v;
+        memcpy(&u, pU, 4);
+        memcpy(&v, pV, 4);
+        __m256i Y = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)pY));
+        __m256i U = _mm256_cvtepu8_epi32(_mm_cvtsi32_si128(u));
+        __m256i V = _mm256_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+        yuvToRGBA(dst, Y, _mm256_permutevar8x32_epi32(U, Mdup),
+                  _mm256_permutevar8x32_epi32(V, Mdup), param);
+        pY += 8;
+        pU += 4;
+        pV += 4;
+        dst = (__m256i *)dst + 1;
+    }
+}
+
+/*
+ * 3DLUT
+ *
+ * One pixel per step.  The eight corners of the LUT cell are loaded as four
+ * pairs, one corner per lane, and reduced along x, y and z in turn with the
+ * same fixed point steps as the C kernel.
+ */
+
+RS_AVX2 static inline __m256i lutCorners(const uint8_t *p) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+}
+
+RS_AVX2 static inline __m256i lutWeights(int32_t w2) {
+    return _mm256_setr_epi32(0x8000 - w2, 0x8000 - w2, 0x8000 - w2, 0x8000 - w2,
+                             w2, w2, w2, w2);
+}
+
+/* Sum of the lanes of a and of b: [a.lo + a.hi | b.lo + b.hi] */
+RS_AVX2 static inline __m256i addLanes(__m256i a, __m256i b) {
+    return _mm256_add_epi32(_mm256_permute2x128_si256(a, b, 0x20),
+                            _mm256_permute2x128_si256(a, b, 0x31));
+}
+
+RS_AVX2 void rsdIntrinsic3DLUT_AVX2(void *dst, const void *in, size_t count,
+                                    const void *lut, size_t strideY, size_t strideZ,
+                                    const int32_t *coordMul) {
+    const uint8_t *pin = (const uint8_t *)in;
+    uint8_t *out = (uint8_t *)dst;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t bx = pin[0] * coordMul[0];
+        int32_t by = pin[1] * coordMul[1];
+        int32_t bz = pin[2] * coordMul[2];
+
+        const uint8_t *p = (const uint8_t *)lut + (bx >> 15) * 4 +
+                           (bz >> 15) * strideZ + (by >> 15) * strideY;
+
+        __m256i wx = lutWeights(bx & 0x7fff);
+        __m256i c00 = _mm256_mullo_epi32(lutCorners(p), wx);
+        __m256i c10 = _mm256_mullo_epi32(lutCorners(p + strideY), wx);
+        __m256i c01 = _mm256_mullo_epi32(lutCorners(p + strideZ), wx);
+        __m256i c11 = _mm256_mullo_epi32(lutCorners(p + strideY + strideZ), wx);
+
+        __m256i wy = lutWeights(by & 0x7fff);
+        __m256i yz0 = _mm256_srli_epi32(addLanes(c00, c10), 7);
+        __m256i yz1 = _mm256_srli_epi32(addLanes(c01, c11), 7);
+        yz0 = _mm256_mullo_epi32(yz0, wy);
+        yz1 = _mm256_mullo_epi32(yz1, wy);
+
+        __m256i z = _mm256_srli_epi32(addLanes(yz0, yz1), 15);
+        z = _mm256_mullo_epi32(z, lutWeights(bz & 0x7fff));
+
+        __m128i v = _mm_add_epi32(_mm256_castsi256_si128(z), _mm256_extracti128_si256(z, 1));
+        v = _mm_srli_epi32(v, 15);
+        v = _mm_srli_epi32(_mm_add_epi32(v, _mm_set1_epi32(0x7f)), 8);
+        v = _mm_packus_epi32(v, v);
+        v = _mm_packus_epi16(v, v);
+
+        uint32_t o = (uint32_t)_mm_cvtsi128_si32(v);
+        o = (o & 0x00ffffff) | ((uint32_t)pin[3] << 24);
+        memcpy(out, &o, 4);
+
+        pin += 4;
+        out += 4;
+    }
+}
+
+/*
+ * Resize
+ *
+ * Two RGBA pixels per step, one per lane, with the C kernel's bicubic
+ * arithmetic in the same order.
+ */
+
+RS_AVX2 static inline __m256 cubicInterpolate(__m256 p0, __m256 p1, __m256 p2, __m256 p3,
+                                              __m256 x) {
+    const __m256 c2 = _mm256_set1_ps(2.f);
+    const __m256 c3 = _mm256_set1_ps(3.f);
+    const __m256 c4 = _mm256_set1_ps(4.f);
+    const __m256 c5 = _mm256_set1_ps(5.f);
+
+    __m256 t = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(c3, _mm256_sub_ps(p1, p2)), p3), p0);
+    __m256 s = _mm256_sub_ps(_mm256_mul_ps(c2, p0), _mm256_mul_ps(c5, p1));
+    s = _mm256_sub_ps(_mm256_add_ps(s, _mm256_mul_ps(c4, p2)), p3);
+    s = _mm256_add_ps(s, _mm256_mul_ps(x, t));
+    s = _mm256_add_ps(_mm256_sub_ps(p2, p0), _mm256_mul_ps(x, s));
+    return _mm256_add_ps(p1, _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), x), s));
+}
+
+RS_AVX2 static inline __m256 loadTaps(const uint32_t *row, int a, int b) {
+    __m128i p = _mm_set_epi32(0, 0, (int)row[b], (int)row[a]);
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(p));
+}
+
+RS_AVX2 void rsdIntrinsicResizeU4_AVX2(void *dst, uint32_t x1, uint32_t count, float scaleX,
+                                       const void *yp0, const void *yp1, const void *yp2,
+                                       const void *yp3, int width, float yf) {
+    const uint32_t *rows[4] = {(const uint32_t *)yp0, (const uint32_t *)yp1,
+                               (const uint32_t *)yp2, (const uint32_t *)yp3};
+    const __m256 vyf = _mm256_set1_ps(yf);
+    const int maxx = width - 1;
+    uint8_t *out = (uint8_t *)dst;
+
+    for (uint32_t i = 0; i < count; i += 2) {
+        int xs[2][4];
+        float xf[2];
+
+        /* The second pixel repeats the first past the end */
+        for (int k = 0; k < 2; k++) {
+            uint32_t x = (i + k < count) ? x1 + i + k : x1 + i;
+            float f = (x + 0.5f) * scaleX - 0.5f;
+            int startx = (int) floorf(f - 1);
+            xf[k] = f - floorf(f);
+            xs[k][0] = startx < 0 ? 0 : startx;
+            xs[k][1] = startx + 1 < 0 ? 0 : startx + 1;
+            xs[k][2] = startx + 2 > maxx ? maxx : startx + 2;
+            xs[k][3] = startx + 3 > maxx ? maxx : startx + 3;
+        }
+        const __m256 vxf = _mm256_setr_ps(xf[0], xf[0], xf[0], xf[0],
+                                          xf[1], xf[1], xf[1], xf[1]);
+
+        __m256 p[4];
+        for (int r = 0; r < 4; r++) {
+            p[r] = cubicInterpolate(loadTaps(rows[r], xs[0][0], xs[1][0]),
+                                    loadTaps(rows[r], xs[0][1], xs[1][1]),
+                                    loadTaps(rows[r], xs[0][2], xs[1][2]),
+                                    loadTaps(rows[r], xs[0][3], xs[1][3]), vxf);
+        }
+        __m256 v = cubicInterpolate(p[0], p[1], p[2], p[3], vyf);
+        v = _mm256_add_ps(v, _mm256_set1_ps(0.5f));
+        v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(255.f));
+
+        __m256i o = _mm256_cvttps_epi32(v);
+        __m128i o16 = _mm_packus_epi32(_mm256_castsi256_si128(o), _mm256_extracti128_si256(o, 1));
+        __m128i o8 = _mm_packus_epi16(o16, o16);
+        if (i + 1 < count) {
+            _mm_storel_epi64((__m128i *)out, o8);
+            out += 8;
+        } else {
+            uint32_t px = (uint32_t)_mm_cvtsi128_si32(o8);
+            memcpy(out, &px, 4);
+            out += 4;
+        }
+    }
+}
@@ -24,6 +24,7 @@
     #include <unistd.h>
 #else
     #include "rsCppUtils.h"
+    #include "rsCpuScriptCache.h"
 
     #include <bcc/BCCContext.h>
     #include <bcc/Config/Config.h>
@@ -31,11 +32,12 @@
     #include <bcinfo/MetadataExtractor.h>
     #include <cutils/properties.h>
 
-    #include <zlib.h>
     #include <sys/file.h>
     #include <sys/types.h>
     #include <unistd.h>
 
+    #include <deque>
+    #include <memory>
     #include <string>
     #include <vector>
 #endif
@@ -125,10 +127,9 @@ static void setCompileArguments(std::vector<const char*>* args,
     args->push_back(nullptr);
 }
 
-static bool compileBitcode(const std::string &bcFileName,
-                           const char *bitcode,
-                           size_t bitcodeSize,
-                           std::vector<const char *> &compileArguments) {
+static bool writeBitcode(const std::string &bcFileName,
+                         const char *bitcode,
+                         size_t bitcodeSize) {
     rsAssert(bitcode && bitcodeSize);
 
     FILE *bcfile = fopen(bcFileName.c_str(), "w");
@@ -143,10 +144,87 @@ static bool compileBitcode(const std::string &bcFileName,
               bcFileName.c_str());
         return false;
     }
+    return true;
+}
+
+// Runs the compiles of scripts created with RS_CONTEXT_BACKGROUND_COMPILE.
+// One pool serves every context of the process.  It grows to one thread per
+// CPU; the threads mostly wait for bcc and the linker.
+typedef void (*CompileJob)(void *usr);
+
+static pthread_mutex_t gCompileQueueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gCompileQueueCond = PTHREAD_COND_INITIALIZER;
+static std::deque<std::pair<CompileJob, void *> > gCompileJobs;
+static int gCompileThreads = 0;
+static int gCompileThreadsIdle = 0;
+
+static void * compileThreadProc(void *) {
+    while (true) {
+        pthread_mutex_lock(&gCompileQueueLock);
+        while (gCompileJobs.empty()) {
+            gCompileThreadsIdle++;
+            pthread_cond_wait(&gCompileQueueCond, &gCompileQueueLock);
+            gCompileThreadsIdle--;
+        }
+        std::pair<CompileJob, void *> job = gCompileJobs.front();
+        gCompileJobs.pop_front();
+        pthread_mutex_unlock(&gCompileQueueLock);
+
+        job.first(job.second);
+    }
+    return nullptr;
+}
+
+static bool postCompileJob(CompileJob job, void *usr) {
+    pthread_mutex_lock(&gCompileQueueLock);
+    gCompileJobs.push_back(std::make_pair(job, usr));
+    if (gCompileThreadsIdle < (int)gCompileJobs.size() &&
+        gCompileThreads < sysconf(_SC_NPROCESSORS_CONF)) {
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&thread, &attr, compileThreadProc, nullptr) == 0) {
+            gCompileThreads++;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    if (gCompileThreads == 0) {
+        // Without a thread, the caller has to compile the script itself.
+        gCompileJobs.pop_back();
+        pthread_mutex_unlock(&gCompileQueueLock);
+        return false;
+    }
+    pthread_cond_signal(&gCompileQueueCond);
+    pthread_mutex_unlock(&gCompileQueueLock);
+    return true;
+}
+
+// Output paths, cacheDir/resName, that a background compile is writing.
+// init() no longer holds the init mutex across those compiles, so a script
+// with the same path waits here before reading or rewriting the files.
+static std::set<std::string> gCompilesInFlight;
+static pthread_cond_t gCompileDoneCond = PTHREAD_COND_INITIALIZER;
 
-    return android::renderscript::rsuExecuteCommand(
-                   android::renderscript::RsdCpuScriptImpl::BCC_EXE_PATH,
-                   compileArguments.size()-1, compileArguments.data());
+static void waitForCompileOf(const std::string &path) {
+    pthread_mutex_lock(&gCompileQueueLock);
+    while (gCompilesInFlight.count(path)) {
+        pthread_cond_wait(&gCompileDoneCond, &gCompileQueueLock);
+    }
+    pthread_mutex_unlock(&gCompileQueueLock);
+}
+
+static void beginCompileOf(const std::string &path) {
+    pthread_mutex_lock(&gCompileQueueLock);
+    gCompilesInFlight.insert(path);
+    pthread_mutex_unlock(&gCompileQueueLock);
+}
+
+static void endCompileOf(const std::string &path) {
+    pthread_mutex_lock(&gCompileQueueLock);
+    gCompilesInFlight.erase(path);
+    pthread_cond_broadcast(&gCompileDoneCond);
+    pthread_mutex_unlock(&gCompileQueueLock);
 }
 
 // The checksum is unnecessary under a few conditions, since the primary
@@ -168,31 +246,29 @@ bool isChecksumNeeded(const char *cacheDir) {
     return (buf[0] == '1');
 }
 
-bool addFileToChecksum(const char *fileName, uint32_t &checksum) {
-    int FD = open(fileName, O_RDONLY);
-    if (FD == -1) {
-        ALOGE("Cannot open file \'%s\' to compute checksum", fileName);
-        return false;
-    }
-
-    char buf[256];
-    while (true) {
-        ssize_t nread = read(FD, buf, sizeof(buf));
-        if (nread < 0) { // bail out on failed read
-            ALOGE("Error while computing checksum for file \'%s\'", fileName);
-            return false;
+// Join the compile arguments into the command line that identifies a
+// compile.  The paths of the bitcode and the output differ between cache
+// dirs without changing the generated code, so they are left out.
+static std::string getBuildCommandLine(const std::vector<const char*>& args,
+                                       const std::string& bcFileName,
+                                       const char* cacheDir, const char* resName) {
+    std::string cmdLine;
+    // The last argument is a nullptr.
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        const char* arg = args[i];
+        if (arg == bcFileName.c_str()) {
+            arg = "<bitcode>";
+        } else if (arg == cacheDir) {
+            arg = "<cacheDir>";
+        } else if (arg == resName) {
+            arg = "<resName>";
         }
-
-        checksum = adler32(checksum, (const unsigned char *) buf, nread);
-        if (static_cast<size_t>(nread) < sizeof(buf)) // EOF
-            break;
-    }
-
-    if (close(FD) != 0) {
-        ALOGE("Cannot close file \'%s\' after computing checksum", fileName);
-        return false;
+        if (i) {
+            cmdLine.push_back(' ');
+        }
+        cmdLine.append(arg);
     }
-    return true;
+    return cmdLine;
 }
 
 #endif  // !defined(RS_COMPATIBILITY_LIB)
@@ -206,27 +282,13 @@ namespace renderscript {
 uint32_t constructBuildChecksum(uint8_t const *bitcode, size_t bitcodeSize,
                                 const char *commandLine,
                                 const char** bccFiles, size_t numFiles) {
-    uint32_t checksum = adler32(0L, Z_NULL, 0);
-
-    // include checksum of bitcode
-    if (bitcode != nullptr && bitcodeSize > 0) {
-        checksum = adler32(checksum, bitcode, bitcodeSize);
-    }
-
-    // include checksum of command line arguments
-    checksum = adler32(checksum, (const unsigned char *) commandLine,
-                       strlen(commandLine));
-
-    // include checksum of bccFiles
-    for (size_t i = 0; i < numFiles; i++) {
-        const char* bccFile = bccFiles[i];
-        if (bccFile[0] != 0 && !addFileToChecksum(bccFile, checksum)) {
-            // return empty checksum instead of something partial/corrupt
-            return 0;
-        }
+    BuildDigest digest;
+    if (!constructBuildDigest(bitcode, bitcodeSize, commandLine, bccFiles,
+                              numFiles, nullptr, &digest)) {
+        // return empty checksum instead of something partial/corrupt
+        return 0;
     }
-
-    return checksum;
+    return digest.toChecksum();
 }
 
 #endif  // !RS_COMPATIBILITY_LIB
@@ -251,9 +313,20 @@ RsdCpuScriptImpl::RsdCpuScriptImpl(RsdCpuReferenceImpl *ctx, const Script *s) {
     mBoundAllocs = nullptr;
     mIntrinsicData = nullptr;
     mIsThreadable = true;
+    mSliceTuners = nullptr;
+    mSliceTunerCount = 0;
 
     mBuildChecksum = 0;
     mChecksumNeeded = false;
+
+    setCompileState(kCompileReady);
+    pthread_mutex_init(&mCompileLock, nullptr);
+    pthread_cond_init(&mCompileCond, nullptr);
+    mCompileErrorReported = false;
+    mInitPending = false;
+#ifndef RS_COMPATIBILITY_LIB
+    mBitcodeMetadata = nullptr;
+#endif
 }
 
 bool RsdCpuScriptImpl::storeRSInfoFromSO() {
@@ -293,6 +366,8 @@ bool RsdCpuScriptImpl::storeRSInfoFromSO() {
     mIsThreadable = mScriptExec->getThreadable();
     //ALOGE("Script isThreadable? %d", mIsThreadable);
 
+    allocSliceTuners(mScriptExec->getExportedForEachCount());
+
     if (kDebugGlobalVariables) {
         mScriptExec->dumpGlobalInfo();
     }
@@ -327,14 +402,15 @@ bool RsdCpuScriptImpl::init(char const *resName, char const *cacheDir,
         setupCompilerCallback(mCompilerDriver);
     }
 
-    bcinfo::MetadataExtractor bitcodeMetadata((const char *) bitcode, bitcodeSize);
-    if (!bitcodeMetadata.extract()) {
+    std::unique_ptr<bcinfo::MetadataExtractor> bitcodeMetadata(
+        new bcinfo::MetadataExtractor((const char *) bitcode, bitcodeSize));
+    if (!bitcodeMetadata->extract()) {
         ALOGE("Could not extract metadata from bitcode");
         mCtx->unlockMutex();
         return false;
     }
 
-    const char* core_lib = findCoreLib(bitcodeMetadata, (const char*)bitcode, bitcodeSize);
+    const char* core_lib = findCoreLib(*bitcodeMetadata, (const char*)bitcode, bitcodeSize);
 
     if (mCtx->getContext()->getContextType() == RS_CONTEXT_TYPE_DEBUG) {
         mCompilerDriver->setDebugContext(true);
@@ -353,80 +429,130 @@ bool RsdCpuScriptImpl::init(char const *resName, char const *cacheDir,
                         useRSDebugContext, bccPluginName, emitGlobalInfo,
                         emitGlobalInfoSkipConstant);
 
+    // Scripts are also kept in a cache shared between cache dirs, named by
+    // the digest of the compile.  Compiles that must not be reused stay out.
+    bool useCache = !is_force_recompile() && !useRSDebugContext;
     mChecksumNeeded = isChecksumNeeded(cacheDir);
-    if (mChecksumNeeded) {
+
+    std::string sharedCacheDir;
+    BuildDigest digest;
+    bool haveDigest = false;
+    if (useCache || mChecksumNeeded) {
+        if (useCache) {
+            sharedCacheDir = getSharedScriptCacheDir();
+        }
+
         std::vector<const char *> bccFiles = { BCC_EXE_PATH,
                                                core_lib,
+                                               bccPluginName ? bccPluginName : "",
                                              };
+        std::string commandLine = getBuildCommandLine(compileArguments, bcFileName,
+                                                      cacheDir, resName);
+        // Without a shared cache dir, the file digests are remembered in the
+        // script's own cache dir.
+        haveDigest = constructBuildDigest(bitcode, bitcodeSize, commandLine.c_str(),
+                                          bccFiles.data(), bccFiles.size(),
+                                          sharedCacheDir.empty() ? cacheDir
+                                                                 : sharedCacheDir.c_str(),
+                                          &digest);
+    }
 
-        // The last argument of compileArguments is a nullptr, so remove 1 from
-        // the size.
-        std::unique_ptr<const char> compileCommandLine(
-            rsuJoinStrings(compileArguments.size()-1, compileArguments.data()));
-
-        mBuildChecksum = constructBuildChecksum(bitcode, bitcodeSize,
-                                                compileCommandLine.get(),
-                                                bccFiles.data(), bccFiles.size());
-
-        if (mBuildChecksum == 0) {
+    if (mChecksumNeeded) {
+        if (!haveDigest) {
             // cannot compute checksum but verification is enabled
             mCtx->unlockMutex();
             return false;
         }
+        mBuildChecksum = digest.toChecksum();
     }
     else {
         // add a dummy/constant as a checksum if verification is disabled
         mBuildChecksum = 0xabadcafe;
     }
 
+    std::string cachedSOName;
+    if (haveDigest && !sharedCacheDir.empty()) {
+        cachedSOName = sharedCacheDir;
+        cachedSOName.append("/");
+        cachedSOName.append(digest.toString());
+        cachedSOName.append(".so");
+    }
+
     // Append build checksum to commandline
     // Handle the terminal nullptr in compileArguments
     compileArguments.pop_back();
     compileArguments.push_back("-build-checksum");
     std::stringstream ss;
     ss << std::hex << mBuildChecksum;
-    compileArguments.push_back(ss.str().c_str());
+    std::string checksumStr = ss.str();
+    compileArguments.push_back(checksumStr.c_str());
     compileArguments.push_back(nullptr);
 
-    if (!is_force_recompile() && !useRSDebugContext) {
+    // Let a background compile of the same script finish first.  The init
+    // mutex keeps anyone else from starting one until this init is done.
+    std::string outputPath(cacheDir);
+    outputPath.append("/");
+    outputPath.append(resName);
+    waitForCompileOf(outputPath);
+
+    if (useCache) {
         mScriptSO = SharedLibraryUtils::loadSharedLibrary(cacheDir, resName);
 
         // Read RS info from the shared object to detect checksum mismatch
         if (mScriptSO != nullptr && !storeRSInfoFromSO()) {
-            dlclose(mScriptSO);
+            SharedLibraryUtils::unloadSharedLibrary(mScriptSO);
             mScriptSO = nullptr;
         }
+
+        // Another cache dir may have compiled the same bitcode already.
+        if (mScriptSO == nullptr && !cachedSOName.empty() &&
+            isTrustedSharedScript(sharedCacheDir.c_str(), cachedSOName.c_str()) &&
+            SharedLibraryUtils::installSharedLibrary(cachedSOName.c_str(),
+                                                     cacheDir, resName)) {
+            mScriptSO = SharedLibraryUtils::loadSharedLibrary(cacheDir, resName);
+            if (mScriptSO != nullptr && !storeRSInfoFromSO()) {
+                SharedLibraryUtils::unloadSharedLibrary(mScriptSO);
+                mScriptSO = nullptr;
+            }
+            if (mScriptSO != nullptr) {
+                markSharedScriptUsed(cachedSOName.c_str());
+            }
+        }
     }
 
     // If we can't, it's either not there or out of date.  We compile the bit code and try loading
     // again.
     if (mScriptSO == nullptr) {
-        if (!compileBitcode(bcFileName, (const char*)bitcode, bitcodeSize,
-                            compileArguments))
-        {
-            ALOGE("bcc: FAILS to compile '%s'", resName);
+        if (!writeBitcode(bcFileName, (const char*)bitcode, bitcodeSize)) {
             mCtx->unlockMutex();
             return false;
         }
 
-        if (!SharedLibraryUtils::createSharedLibrary(mCtx->getContext()->getDriverName(),
-                                                     cacheDir, resName)) {
-            ALOGE("Linker: Failed to link object file '%s'", resName);
-            mCtx->unlockMutex();
-            return false;
+        // The last argument of compileArguments is a nullptr.
+        mCompileArguments.assign(compileArguments.begin(), compileArguments.end() - 1);
+        mResName = resName;
+        mCacheDir = cacheDir;
+        mCachedSOName = cachedSOName;
+        mSharedCacheDir = sharedCacheDir;
+
+        if (mCtx->getContext()->mHal.flags & RS_CONTEXT_BACKGROUND_COMPILE) {
+            // Until the code is loaded, the metadata describes the script.
+            mBitcodeMetadata = bitcodeMetadata.release();
+            setCompileState(kCompilePending);
+            beginCompileOf(outputPath);
+            if (postCompileJob(compileInBackground, this)) {
+                mBitcodeFilePath.setTo(bcFileName.c_str());
+                mCtx->unlockMutex();
+                return true;
+            }
+            endCompileOf(outputPath);
+            setCompileState(kCompileReady);
         }
 
-        mScriptSO = SharedLibraryUtils::loadSharedLibrary(cacheDir, resName);
-        if (mScriptSO == nullptr) {
-            ALOGE("Unable to load '%s'", resName);
+        if (!buildSharedLibrary() || !loadCompiledScript()) {
             mCtx->unlockMutex();
             return false;
         }
-
-        // Read RS symbol information from the .so.
-        if (!storeRSInfoFromSO()) {
-            goto error;
-        }
     }
 
     mBitcodeFilePath.setTo(bcFileName.c_str());
@@ -450,8 +576,122 @@ error:
 
     mCtx->unlockMutex();
     if (mScriptSO) {
-        dlclose(mScriptSO);
+        SharedLibraryUtils::unloadSharedLibrary(mScriptSO);
+        mScriptSO = nullptr;
+    }
+    return false;
+}
+
+#ifndef RS_COMPATIBILITY_LIB
+
+// Run bcc and the linker on the bitcode written by init().  Safe to call
+// from any thread, as it only reads state that init() left behind.
+bool RsdCpuScriptImpl::buildSharedLibrary() {
+    std::vector<const char *> args;
+    for (const std::string &arg : mCompileArguments) {
+        args.push_back(arg.c_str());
+    }
+    args.push_back(nullptr);
+
+    if (!rsuExecuteCommand(BCC_EXE_PATH, args.size() - 1, args.data())) {
+        ALOGE("bcc: FAILS to compile '%s'", mResName.c_str());
+        return false;
+    }
+
+    if (!SharedLibraryUtils::createSharedLibrary(mCtx->getContext()->getDriverName(),
+                                                 mCacheDir.c_str(), mResName.c_str())) {
+        ALOGE("Linker: Failed to link object file '%s'", mResName.c_str());
+        return false;
+    }
+
+    if (!mCachedSOName.empty()) {
+        if (SharedLibraryUtils::publishSharedLibrary(mCacheDir.c_str(), mResName.c_str(),
+                                                     mCachedSOName.c_str())) {
+            trimSharedScriptCache(mSharedCacheDir.c_str());
+        } else {
+            ALOGW("Could not add '%s' to the shared script cache", mResName.c_str());
+        }
+    }
+    return true;
+}
+
+bool RsdCpuScriptImpl::loadCompiledScript() {
+    mScriptSO = SharedLibraryUtils::loadSharedLibrary(mCacheDir.c_str(), mResName.c_str());
+    if (mScriptSO == nullptr) {
+        ALOGE("Unable to load '%s'", mResName.c_str());
+        return false;
+    }
+
+    // Read RS symbol information from the .so.
+    if (!storeRSInfoFromSO()) {
+        SharedLibraryUtils::unloadSharedLibrary(mScriptSO);
         mScriptSO = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void RsdCpuScriptImpl::compileInBackground(void *usr) {
+    RsdCpuScriptImpl *s = (RsdCpuScriptImpl *)usr;
+    std::string outputPath = s->mCacheDir + "/" + s->mResName;
+    bool built = s->buildSharedLibrary();
+
+    // The script may be gone as soon as its state changes.
+    pthread_mutex_lock(&s->mCompileLock);
+    s->setCompileState(built ? kCompileBuilt : kCompileFailed);
+    pthread_cond_broadcast(&s->mCompileCond);
+    pthread_mutex_unlock(&s->mCompileLock);
+
+    endCompileOf(outputPath);
+}
+
+#endif
+
+bool RsdCpuScriptImpl::waitForCompile() {
+    if (compileState() == kCompileReady) {
+        return true;
+    }
+
+    pthread_mutex_lock(&mCompileLock);
+    while (compileState() == kCompilePending) {
+        pthread_cond_wait(&mCompileCond, &mCompileLock);
+    }
+    pthread_mutex_unlock(&mCompileLock);
+
+#ifndef RS_COMPATIBILITY_LIB
+    if (compileState() == kCompileBuilt) {
+        // Loading updates the process-wide list of loaded libraries, which
+        // the init mutex guards.  Callers must not hold it already.
+        bool runInit = false;
+        mCtx->lockMutex();
+        if (compileState() == kCompileBuilt) {
+            if (loadCompiledScript()) {
+                // Swap the metadata for what the shared object says.
+                populateScript(const_cast<Script *>(mScript));
+                delete mBitcodeMetadata;
+                mBitcodeMetadata = nullptr;
+                runInit = mInitPending;
+                mInitPending = false;
+                setCompileState(kCompileReady);
+            } else {
+                setCompileState(kCompileFailed);
+            }
+        }
+        mCtx->unlockMutex();
+
+        if (runInit) {
+            invokeInit();
+        }
+        if (compileState() == kCompileReady) {
+            return true;
+        }
+    }
+#endif
+
+    if (!mCompileErrorReported) {
+        mCompileErrorReported = true;
+        mCtx->getContext()->setError(RS_ERROR_FATAL_DRIVER,
+                                     "Background compile of script failed");
     }
     return false;
 }
@@ -496,6 +736,21 @@ const char* RsdCpuScriptImpl::findCoreLib(const bcinfo::MetadataExtractor& ME, c
 #endif
 
 void RsdCpuScriptImpl::populateScript(Script *script) {
+#ifndef RS_COMPATIBILITY_LIB
+    if (compileState() != kCompileReady && mBitcodeMetadata) {
+        // Still compiling.  waitForCompile() fills in the rest once the code
+        // is loaded.
+        const bcinfo::MetadataExtractor *ME = mBitcodeMetadata;
+        script->mHal.info.exportedFunctionCount = ME->getExportFuncCount();
+        script->mHal.info.exportedVariableCount = ME->getExportVarCount();
+        script->mHal.info.exportedPragmaCount = ME->getPragmaCount();
+        script->mHal.info.exportedPragmaKeyList = ME->getPragmaKeyList();
+        script->mHal.info.exportedPragmaValueList = ME->getPragmaValueList();
+        script->mHal.info.root = nullptr;
+        return;
+    }
+#endif
+
     // Copy info over to runtime
     script->mHal.info.exportedFunctionCount = mScriptExec->getExportedFunctionCount();
     script->mHal.info.exportedVariableCount = mScriptExec->getExportedVariableCount();
@@ -514,13 +769,18 @@ void RsdCpuScriptImpl::populateScript(Script *script) {
 
 bool RsdCpuScriptImpl::forEachMtlsSetup(const Allocation ** ains,
                                         uint32_t inLen,
-                                        Allocation * aout,
+                                        Allocation ** aouts,
+                                        uint32_t outLen,
                                         const void * usr, uint32_t usrLen,
                                         const RsScriptCall *sc,
                                         MTLaunchStruct *mtls) {
 
     memset(mtls, 0, sizeof(MTLaunchStruct));
 
+    if (!waitForCompile()) {
+        return false;
+    }
+
     for (int index = inLen; --index >= 0;) {
         const Allocation* ain = ains[index];
 
@@ -534,14 +794,25 @@ bool RsdCpuScriptImpl::forEachMtlsSetup(const Allocation ** ains,
         }
     }
 
-    if (aout &&
-        (const uint8_t *)aout->mHal.drvState.lod[0].mallocPtr == nullptr) {
-
+    if (outLen > RS_KERNEL_INPUT_LIMIT) {
         mCtx->getContext()->setError(RS_ERROR_BAD_SCRIPT,
-                                     "rsForEach called with null out allocations");
+                                     "rsForEach called with too many out allocations");
         return false;
     }
 
+    for (uint32_t index = 0; index < outLen; index++) {
+        const Allocation* aout = aouts[index];
+
+        if (aout == nullptr ||
+            (const uint8_t *)aout->mHal.drvState.lod[0].mallocPtr == nullptr) {
+
+            mCtx->getContext()->setError(RS_ERROR_BAD_SCRIPT,
+                                         "rsForEach called with null out allocations");
+            return false;
+        }
+    }
+    Allocation * aout = outLen > 0 ? aouts[0] : nullptr;
+
     if (inLen > 0) {
         const Allocation *ain0   = ains[0];
         const Type       *inType = ain0->getType();
@@ -577,8 +848,11 @@ bool RsdCpuScriptImpl::forEachMtlsSetup(const Allocation ** ains,
         return false;
     }
 
-    if (inLen > 0 && aout != nullptr) {
-        if (!ains[0]->hasSameDims(aout)) {
+    // Every output has to match the first input, or the first output when
+    // there are no inputs.
+    const Allocation *dimsFrom = inLen > 0 ? ains[0] : aout;
+    for (uint32_t index = 0; index < outLen; index++) {
+        if (!dimsFrom->hasSameDims(aouts[index])) {
             mCtx->getContext()->setError(RS_ERROR_BAD_SCRIPT,
               "Failed to launch kernel; dimensions of input and output allocations do not match.");
 
@@ -679,11 +953,17 @@ bool RsdCpuScriptImpl::forEachMtlsSetup(const Allocation ** ains,
     if (ains) {
         memcpy(mtls->ains, ains, inLen * sizeof(ains[0]));
     }
-    mtls->aout[0]    = aout;
+    if (aouts) {
+        memcpy(mtls->aout, aouts, outLen * sizeof(aouts[0]));
+    }
     mtls->fep.usr    = usr;
     mtls->fep.usrLen = usrLen;
     mtls->mSliceSize = 1;
-    mtls->mSliceNum  = 0;
+    mtls->mSliceCount = 0;
+    mtls->mQueues = nullptr;
+    mtls->mQueueCount = 0;
+    mtls->mTuner = nullptr;
+    mtls->mTileWidth = 0;
 
     mtls->isThreadable  = mIsThreadable;
 
@@ -695,9 +975,10 @@ bool RsdCpuScriptImpl::forEachMtlsSetup(const Allocation ** ains,
         }
     }
 
-    if (aout != nullptr) {
-        mtls->fep.outPtr[0] = (uint8_t *)aout->mHal.drvState.lod[0].mallocPtr;
-        mtls->fep.outStride[0] = aout->getType()->getElementSizeBytes();
+    mtls->fep.outLen = outLen;
+    for (uint32_t index = 0; index < outLen; index++) {
+        mtls->fep.outPtr[index] = (uint8_t *)aouts[index]->mHal.drvState.lod[0].mallocPtr;
+        mtls->fep.outStride[index] = aouts[index]->getType()->getElementSizeBytes();
     }
 
     // All validation passed, ok to launch threads
@@ -713,26 +994,113 @@ void RsdCpuScriptImpl::invokeForEach(uint32_t slot,
                                      uint32_t usrLen,
                                      const RsScriptCall *sc) {
 
+    invokeForEachMultiOut(slot, ains, inLen, aout ? &aout : nullptr, aout ? 1 : 0,
+                          usr, usrLen, sc);
+}
+
+void RsdCpuScriptImpl::invokeForEachMultiOut(uint32_t slot,
+                                             const Allocation ** ains,
+                                             uint32_t inLen,
+                                             Allocation ** aouts,
+                                             uint32_t outLen,
+                                             const void * usr,
+                                             uint32_t usrLen,
+                                             const RsScriptCall *sc) {
+
+    MTLaunchStruct mtls;
+
+    if (forEachMtlsSetup(ains, inLen, aouts, outLen, usr, usrLen, sc, &mtls) &&
+        forEachKernelSetup(slot, &mtls)) {
+
+        RsdCpuScriptImpl * oldTLS = mCtx->setTLS(this);
+        mCtx->launchThreads(ains, inLen, mtls.aout[0], sc, &mtls);
+        mCtx->setTLS(oldTLS);
+    }
+}
+
+void RsdCpuScriptImpl::invokeReduce(uint32_t slot,
+                                    const Allocation ** ains,
+                                    uint32_t inLen,
+                                    Allocation * aout,
+                                    const RsScriptCall *sc) {
+
+    if (!waitForCompile()) {
+        return;
+    }
+
+    if (mScriptExec == nullptr || slot >= mScriptExec->getExportedReduceCount()) {
+        mCtx->getContext()->setError(RS_ERROR_BAD_SCRIPT,
+                                     "Calling reduce on bad script");
+        return;
+    }
+    const ReduceDescription *reduce = mScriptExec->getReduceDescription(slot);
+
+    if (inLen < 1 || inLen > RS_KERNEL_INPUT_LIMIT) {
+        mCtx->getContext()->setError(RS_ERROR_BAD_SCRIPT,
+                                     "rsReduce called with an invalid number of in allocations");
+        return;
+    }
+    if (aout == nullptr ||
+        (const uint8_t *)aout->mHal.drvState.lod[0].mallocPtr == nullptr) {
+        mCtx->getContext()->setError(RS_ERROR_BAD_SCRIPT,
+                                     "rsReduce called with null out allocation");
+        return;
+    }
+    if (!reduce->outFunc &&
+        aout->getType()->getElementSizeBytes() != reduce->accumSize) {
+        mCtx->getContext()->setError(RS_ERROR_BAD_SCRIPT,
+          "Failed to launch reduction; out allocation does not match the accumulator.");
+        return;
+    }
+
     MTLaunchStruct mtls;
 
-    if (forEachMtlsSetup(ains, inLen, aout, usr, usrLen, sc, &mtls)) {
-        forEachKernelSetup(slot, &mtls);
+    if (forEachMtlsSetup(ains, inLen, nullptr, nullptr, 0, sc, &mtls)) {
+        mtls.script = this;
+        mtls.fep.slot = slot;
+        mtls.mReduce = reduce;
 
         RsdCpuScriptImpl * oldTLS = mCtx->setTLS(this);
-        mCtx->launchThreads(ains, inLen, aout, sc, &mtls);
+        mCtx->launchReduce(aout, &mtls);
         mCtx->setTLS(oldTLS);
     }
 }
 
-void RsdCpuScriptImpl::forEachKernelSetup(uint32_t slot, MTLaunchStruct *mtls) {
+bool RsdCpuScriptImpl::forEachKernelSetup(uint32_t slot, MTLaunchStruct *mtls) {
+    // Script groups set up kernels of scripts other than the one that
+    // validated the launch.
+    if (!waitForCompile()) {
+        return false;
+    }
+
     mtls->script = this;
     mtls->fep.slot = slot;
+    mtls->mTuner = getSliceTuner(slot);
     mtls->kernel = mScriptExec->getForEachFunction(slot);
     rsAssert(mtls->kernel != nullptr);
     mtls->sig = mScriptExec->getForEachSignature(slot);
+    return true;
+}
+
+void RsdCpuScriptImpl::allocSliceTuners(uint32_t count) {
+    delete[] mSliceTuners;
+    mSliceTuners = new SliceTuner[count];
+    mSliceTunerCount = count;
+    for (uint32_t ct = 0; ct < count; ct++) {
+        mSliceTuners[ct].mNsPerCell = 0.f;
+        mSliceTuners[ct].mSlicesPerThread = 4;
+        mSliceTuners[ct].mTileWidth = 0;
+        mSliceTuners[ct].mTileSeed = 0;
+        mSliceTuners[ct].mBestTileWidth = 0;
+        mSliceTuners[ct].mBestTileNsPerCell = 0.f;
+        mSliceTuners[ct].mTileStep = kTileSearchIdle;
+    }
 }
 
 int RsdCpuScriptImpl::invokeRoot() {
+    if (!waitForCompile()) {
+        return 0;
+    }
     RsdCpuScriptImpl * oldTLS = mCtx->setTLS(this);
     int ret = mRoot();
     mCtx->setTLS(oldTLS);
@@ -740,12 +1108,21 @@ int RsdCpuScriptImpl::invokeRoot() {
 }
 
 void RsdCpuScriptImpl::invokeInit() {
+    if (compileState() != kCompileReady) {
+        // Run init() as soon as the code is there, before any other call.
+        mInitPending = true;
+        return;
+    }
     if (mInit) {
         mInit();
     }
 }
 
 void RsdCpuScriptImpl::invokeFreeChildren() {
+    // A script whose code never got loaded has no children.
+    if (compileState() != kCompileReady) {
+        return;
+    }
     if (mFreeChildren) {
         mFreeChildren();
     }
@@ -756,6 +1133,10 @@ void RsdCpuScriptImpl::invokeFunction(uint32_t slot, const void *params,
     //ALOGE("invoke %i %p %zu", slot, params, paramLength);
     void * ap = nullptr;
 
+    if (!waitForCompile()) {
+        return;
+    }
+
 #if defined(__x86_64__)
     // The invoked function could have input parameter of vector type for example float4 which
     // requires void* params to be 16 bytes aligned when using SSE instructions for x86_64 platform.
@@ -787,6 +1168,10 @@ void RsdCpuScriptImpl::setGlobalVar(uint32_t slot, const void *data, size_t data
         //return;
     //}
 
+    if (!waitForCompile()) {
+        return;
+    }
+
     int32_t *destPtr = reinterpret_cast<int32_t *>(mScriptExec->getFieldAddress(slot));
     if (!destPtr) {
         //ALOGV("Calling setVar on slot = %i which is null", slot);
@@ -800,6 +1185,10 @@ void RsdCpuScriptImpl::getGlobalVar(uint32_t slot, void *data, size_t dataLength
     //rsAssert(!script->mFieldIsObject[slot]);
     //ALOGE("getGlobalVar %i %p %zu", slot, data, dataLength);
 
+    if (!waitForCompile()) {
+        return;
+    }
+
     int32_t *srcPtr = reinterpret_cast<int32_t *>(mScriptExec->getFieldAddress(slot));
     if (!srcPtr) {
         //ALOGV("Calling setVar on slot = %i which is null", slot);
@@ -812,6 +1201,10 @@ void RsdCpuScriptImpl::getGlobalVar(uint32_t slot, void *data, size_t dataLength
 void RsdCpuScriptImpl::setGlobalVarWithElemDims(uint32_t slot, const void *data, size_t dataLength,
                                                 const Element *elem,
                                                 const uint32_t *dims, size_t dimLength) {
+    if (!waitForCompile()) {
+        return;
+    }
+
     int32_t *destPtr = reinterpret_cast<int32_t *>(mScriptExec->getFieldAddress(slot));
     if (!destPtr) {
         //ALOGV("Calling setVar on slot = %i which is null", slot);
@@ -849,6 +1242,10 @@ void RsdCpuScriptImpl::setGlobalBind(uint32_t slot, Allocation *data) {
     //rsAssert(!script->mFieldIsObject[slot]);
     //ALOGE("setGlobalBind %i %p", slot, data);
 
+    if (!waitForCompile()) {
+        return;
+    }
+
     int32_t *destPtr = reinterpret_cast<int32_t *>(mScriptExec->getFieldAddress(slot));
     if (!destPtr) {
         //ALOGV("Calling setVar on slot = %i which is null", slot);
@@ -868,6 +1265,10 @@ void RsdCpuScriptImpl::setGlobalObj(uint32_t slot, ObjectBase *data) {
     //rsAssert(script->mFieldIsObject[slot]);
     //ALOGE("setGlobalObj %i %p", slot, data);
 
+    if (!waitForCompile()) {
+        return;
+    }
+
     int32_t *destPtr = reinterpret_cast<int32_t *>(mScriptExec->getFieldAddress(slot));
     if (!destPtr) {
         //ALOGV("Calling setVar on slot = %i which is null", slot);
@@ -878,19 +1279,33 @@ void RsdCpuScriptImpl::setGlobalObj(uint32_t slot, ObjectBase *data) {
 }
 
 const char* RsdCpuScriptImpl::getFieldName(uint32_t slot) const {
+    if (!const_cast<RsdCpuScriptImpl *>(this)->waitForCompile()) {
+        return nullptr;
+    }
     return mScriptExec->getFieldName(slot);
 }
 
 RsdCpuScriptImpl::~RsdCpuScriptImpl() {
+    // A background compile still refers to this script.
+    pthread_mutex_lock(&mCompileLock);
+    while (compileState() == kCompilePending) {
+        pthread_cond_wait(&mCompileCond, &mCompileLock);
+    }
+    pthread_mutex_unlock(&mCompileLock);
+    pthread_mutex_destroy(&mCompileLock);
+    pthread_cond_destroy(&mCompileCond);
+
 #ifndef RS_COMPATIBILITY_LIB
     delete mCompilerDriver;
+    delete mBitcodeMetadata;
 #endif
 
     delete mScriptExec;
 
     delete[] mBoundAllocs;
+    delete[] mSliceTuners;
     if (mScriptSO) {
-        dlclose(mScriptSO);
+        SharedLibraryUtils::unloadSharedLibrary(mScriptSO);
     }
 }
 
@@ -911,22 +1326,37 @@ Allocation * RsdCpuScriptImpl::getAllocationForPointer(const void *ptr) const {
 }
 
 int RsdCpuScriptImpl::getGlobalEntries() const {
+    if (!const_cast<RsdCpuScriptImpl *>(this)->waitForCompile()) {
+        return 0;
+    }
     return mScriptExec->getGlobalEntries();
 }
 
 const char * RsdCpuScriptImpl::getGlobalName(int i) const {
+    if (!const_cast<RsdCpuScriptImpl *>(this)->waitForCompile()) {
+        return nullptr;
+    }
     return mScriptExec->getGlobalName(i);
 }
 
 const void * RsdCpuScriptImpl::getGlobalAddress(int i) const {
+    if (!const_cast<RsdCpuScriptImpl *>(this)->waitForCompile()) {
+        return nullptr;
+    }
     return mScriptExec->getGlobalAddress(i);
 }
 
 size_t RsdCpuScriptImpl::getGlobalSize(int i) const {
+    if (!const_cast<RsdCpuScriptImpl *>(this)->waitForCompile()) {
+        return 0;
+    }
     return mScriptExec->getGlobalSize(i);
 }
 
 uint32_t RsdCpuScriptImpl::getGlobalProperties(int i) const {
+    if (!const_cast<RsdCpuScriptImpl *>(this)->waitForCompile()) {
+        return 0;
+    }
     return mScriptExec->getGlobalProperties(i);
 }
 
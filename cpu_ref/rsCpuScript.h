@@ -20,8 +20,12 @@
 #include <rs_hal.h>
 #include <rsRuntime.h>
 
+#include <atomic>
+
 #ifndef RS_COMPATIBILITY_LIB
+#include <string>
 #include <utility>
+#include <vector>
 #endif
 
 #include "rsCpuCore.h"
@@ -77,6 +81,21 @@ public:
                        uint32_t usrLen,
                        const RsScriptCall* sc) override;
 
+    void invokeForEachMultiOut(uint32_t slot,
+                               const Allocation ** ains,
+                               uint32_t inLen,
+                               Allocation ** aouts,
+                               uint32_t outLen,
+                               const void* usr,
+                               uint32_t usrLen,
+                               const RsScriptCall* sc) override;
+
+    void invokeReduce(uint32_t slot,
+                      const Allocation ** ains,
+                      uint32_t inLen,
+                      Allocation* aout,
+                      const RsScriptCall* sc) override;
+
     void invokeInit() override;
     void invokeFreeChildren() override;
 
@@ -96,10 +115,32 @@ public:
     const Script * getScript() {return mScript;}
 
     bool forEachMtlsSetup(const Allocation ** ains, uint32_t inLen,
-                          Allocation * aout, const void * usr, uint32_t usrLen,
+                          Allocation ** aouts, uint32_t outLen,
+                          const void * usr, uint32_t usrLen,
                           const RsScriptCall *sc, MTLaunchStruct *mtls);
 
-    virtual void forEachKernelSetup(uint32_t slot, MTLaunchStruct *mtls);
+    bool forEachMtlsSetup(const Allocation ** ains, uint32_t inLen,
+                          Allocation * aout, const void * usr, uint32_t usrLen,
+                          const RsScriptCall *sc, MTLaunchStruct *mtls) {
+        return forEachMtlsSetup(ains, inLen, aout ? &aout : nullptr, aout ? 1 : 0,
+                                usr, usrLen, sc, mtls);
+    }
+
+    // Fills in the kernel of slot.  Returns false if the code of the script
+    // could not be loaded.
+    virtual bool forEachKernelSetup(uint32_t slot, MTLaunchStruct *mtls);
+
+    // Returns the walk order the kernel in slot prefers when the launch does
+    // not request one.  Stencil kernels ask for cache-sized tiles.
+    virtual RsForEachStrategy getForEachStrategy(uint32_t slot) const {
+        return RS_FOR_EACH_STRATEGY_DONT_CARE;
+    }
+
+    // Returns the slice size model for kernel slot, or nullptr if the slot is
+    // not tracked.
+    SliceTuner * getSliceTuner(uint32_t slot) {
+        return slot < mSliceTunerCount ? &mSliceTuners[slot] : nullptr;
+    }
 
 
     const RsdCpuReference::CpuSymbol * lookupSymbolMath(const char *sym);
@@ -137,14 +178,60 @@ protected:
     void * mIntrinsicData;
     bool mIsThreadable;
 
+    void allocSliceTuners(uint32_t count);
+    SliceTuner *mSliceTuners;
+    uint32_t mSliceTunerCount;
+
 public:
     static const char* BCC_EXE_PATH;
     const char* getBitcodeFilePath() const { return mBitcodeFilePath.string(); }
 
+    // Make sure the code of the script is loaded, waiting for a background
+    // compile if one is still running.  Returns false if the compile failed.
+    bool waitForCompile();
+
 private:
     String8 mBitcodeFilePath;
     uint32_t mBuildChecksum;
     bool mChecksumNeeded;
+
+    // State of the code of the script.  Scripts created with
+    // RS_CONTEXT_BACKGROUND_COMPILE start out kCompilePending and become
+    // kCompileBuilt when the shared object is on disk.  The first call that
+    // needs the code then loads it.
+    enum {
+        kCompileReady,
+        kCompilePending,
+        kCompileBuilt,
+        kCompileFailed
+    };
+    // Published with release semantics once the code and entry points it
+    // guards are in place, so lock-free readers on other threads, such as
+    // the helpers of a nested launch, see them.
+    std::atomic<int> mCompileState;
+    int compileState() const { return mCompileState.load(std::memory_order_acquire); }
+    void setCompileState(int state) { mCompileState.store(state, std::memory_order_release); }
+    pthread_mutex_t mCompileLock;
+    pthread_cond_t mCompileCond;
+    bool mCompileErrorReported;
+    // init() was called before the code was there; run it once it is.
+    bool mInitPending;
+
+#ifndef RS_COMPATIBILITY_LIB
+    bool buildSharedLibrary();
+    bool loadCompiledScript();
+    static void compileInBackground(void *usr);
+
+    // Describes the script until its code is loaded.
+    bcinfo::MetadataExtractor *mBitcodeMetadata;
+
+    // Everything the compile needs, as init() returns before it runs.
+    std::vector<std::string> mCompileArguments;
+    std::string mResName;
+    std::string mCacheDir;
+    std::string mCachedSOName;
+    std::string mSharedCacheDir;
+#endif
 };
 
 Allocation * rsdScriptGetAllocationForPointer(
@@ -0,0 +1,489 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsCpuScriptCache.h"
+#include "rsCpuExecutable.h"
+
+#include <cutils/properties.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace android {
+namespace renderscript {
+
+// Limits of the shared script cache.  Past either, the least recently used
+// objects are removed after each compile.
+static const size_t kMaxSharedScripts = 256;
+static const off_t kMaxSharedScriptBytes = 64 * 1024 * 1024;
+
+namespace {
+
+static const uint32_t kSha256Init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t rotr(uint32_t v, int n) {
+    return (v >> n) | (v << (32 - n));
+}
+
+class Sha256 {
+public:
+    Sha256() : mLength(0), mBufferLen(0) {
+        memcpy(mState, kSha256Init, sizeof(mState));
+    }
+
+    void update(const void *data, size_t len) {
+        const uint8_t *p = (const uint8_t *)data;
+        mLength += len;
+        if (mBufferLen) {
+            size_t n = 64 - mBufferLen;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(mBuffer + mBufferLen, p, n);
+            mBufferLen += n;
+            p += n;
+            len -= n;
+            if (mBufferLen < 64) {
+                return;
+            }
+            compress(mBuffer);
+            mBufferLen = 0;
+        }
+        while (len >= 64) {
+            compress(p);
+            p += 64;
+            len -= 64;
+        }
+        memcpy(mBuffer, p, len);
+        mBufferLen = len;
+    }
+
+    void finish(uint8_t out[32]) {
+        uint64_t bits = mLength * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (mBufferLen != 56) {
+            update(&pad, 1);
+        }
+        uint8_t len[8];
+        for (int ct = 0; ct < 8; ct++) {
+            len[ct] = (uint8_t)(bits >> (56 - 8 * ct));
+        }
+        update(len, 8);
+        for (int ct = 0; ct < 8; ct++) {
+            out[ct * 4 + 0] = (uint8_t)(mState[ct] >> 24);
+            out[ct * 4 + 1] = (uint8_t)(mState[ct] >> 16);
+            out[ct * 4 + 2] = (uint8_t)(mState[ct] >> 8);
+            out[ct * 4 + 3] = (uint8_t)mState[ct];
+        }
+    }
+
+private:
+    void compress(const uint8_t *block) {
+        uint32_t w[64];
+        for (int ct = 0; ct < 16; ct++) {
+            w[ct] = ((uint32_t)block[ct * 4] << 24) | ((uint32_t)block[ct * 4 + 1] << 16) |
+                    ((uint32_t)block[ct * 4 + 2] << 8) | block[ct * 4 + 3];
+        }
+        for (int ct = 16; ct < 64; ct++) {
+            uint32_t s0 = rotr(w[ct - 15], 7) ^ rotr(w[ct - 15], 18) ^ (w[ct - 15] >> 3);
+            uint32_t s1 = rotr(w[ct - 2], 17) ^ rotr(w[ct - 2], 19) ^ (w[ct - 2] >> 10);
+            w[ct] = w[ct - 16] + s0 + w[ct - 7] + s1;
+        }
+
+        uint32_t a = mState[0], b = mState[1], c = mState[2], d = mState[3];
+        uint32_t e = mState[4], f = mState[5], g = mState[6], h = mState[7];
+        for (int ct = 0; ct < 64; ct++) {
+            uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + kSha256K[ct] + w[ct];
+            uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        mState[0] += a; mState[1] += b; mState[2] += c; mState[3] += d;
+        mState[4] += e; mState[5] += f; mState[6] += g; mState[7] += h;
+    }
+
+    uint32_t mState[8];
+    uint64_t mLength;
+    uint8_t mBuffer[64];
+    size_t mBufferLen;
+};
+
+static void toHex(const uint8_t *bytes, size_t len, std::string *out) {
+    static const char kDigits[] = "0123456789abcdef";
+    out->reserve(out->size() + len * 2);
+    for (size_t ct = 0; ct < len; ct++) {
+        out->push_back(kDigits[bytes[ct] >> 4]);
+        out->push_back(kDigits[bytes[ct] & 0xf]);
+    }
+}
+
+// Identifies one version of a file.  A file rewritten in place gets a new
+// mtime, a replaced one a new inode.
+struct FileIdentity {
+    uint64_t mDev;
+    uint64_t mIno;
+    uint64_t mSize;
+    int64_t mMtimeSec;
+    int64_t mMtimeNsec;
+
+    bool operator==(const FileIdentity &o) const {
+        return mDev == o.mDev && mIno == o.mIno && mSize == o.mSize &&
+               mMtimeSec == o.mMtimeSec && mMtimeNsec == o.mMtimeNsec;
+    }
+};
+
+// On-disk form of a remembered file digest.
+struct FileDigestRecord {
+    uint32_t mMagic;
+    uint32_t mPad;
+    FileIdentity mId;
+    uint8_t mDigest[32];
+};
+
+static const uint32_t kFileDigestMagic = 0x47494452;  // "RDIG"
+
+struct FileDigest {
+    FileIdentity mId;
+    uint8_t mDigest[32];
+};
+
+static pthread_mutex_t gDigestMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::map<std::string, FileDigest> gFileDigests;
+
+static bool statFile(const char *path, FileIdentity *id) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+    memset(id, 0, sizeof(*id));
+    id->mDev = st.st_dev;
+    id->mIno = st.st_ino;
+    id->mSize = st.st_size;
+    id->mMtimeSec = st.st_mtim.tv_sec;
+    id->mMtimeNsec = st.st_mtim.tv_nsec;
+    return true;
+}
+
+static bool hashFile(const char *path, uint8_t digest[32]) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        ALOGE("Cannot open file \'%s\' to compute checksum", path);
+        return false;
+    }
+
+    Sha256 sha;
+    uint8_t buf[64 * 1024];
+    while (true) {
+        ssize_t nread = read(fd, buf, sizeof(buf));
+        if (nread < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("Error while computing checksum for file \'%s\'", path);
+            close(fd);
+            return false;
+        }
+        if (nread == 0) {
+            break;
+        }
+        sha.update(buf, nread);
+    }
+    close(fd);
+    sha.finish(digest);
+    return true;
+}
+
+// Name of the record for path in storeDir.  Paths are hashed so that the
+// name stays short and free of separators.
+static std::string digestRecordName(const char *storeDir, const char *path) {
+    uint8_t pathDigest[32];
+    Sha256 sha;
+    sha.update(path, strlen(path));
+    sha.finish(pathDigest);
+
+    std::string name(storeDir);
+    name.append("/digest.");
+    toHex(pathDigest, 8, &name);
+    return name;
+}
+
+static bool readDigestRecord(const std::string &name, const FileIdentity &id,
+                             uint8_t digest[32]) {
+    FILE *f = fopen(name.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+    FileDigestRecord rec;
+    bool ok = fread(&rec, sizeof(rec), 1, f) == 1 &&
+              rec.mMagic == kFileDigestMagic && rec.mId == id;
+    fclose(f);
+    if (ok) {
+        memcpy(digest, rec.mDigest, sizeof(rec.mDigest));
+    }
+    return ok;
+}
+
+static void writeDigestRecord(const std::string &name, const FileIdentity &id,
+                              const uint8_t digest[32]) {
+    FileDigestRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.mMagic = kFileDigestMagic;
+    rec.mId = id;
+    memcpy(rec.mDigest, digest, sizeof(rec.mDigest));
+
+    // Write aside and rename, so that readers never see a partial record.
+    std::string tmpName(name);
+    tmpName.append("#");
+    tmpName.append(SharedLibraryUtils::getRandomString(6).string());
+    FILE *f = fopen(tmpName.c_str(), "wb");
+    if (!f) {
+        return;
+    }
+    bool ok = fwrite(&rec, sizeof(rec), 1, f) == 1;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmpName.c_str(), name.c_str()) != 0) {
+        unlink(tmpName.c_str());
+    }
+}
+
+static bool getFileDigest(const char *path, const char *storeDir, uint8_t digest[32]) {
+    FileIdentity id;
+    if (!statFile(path, &id)) {
+        ALOGE("Cannot stat file \'%s\' to compute checksum", path);
+        return false;
+    }
+
+    pthread_mutex_lock(&gDigestMutex);
+    auto it = gFileDigests.find(path);
+    if (it != gFileDigests.end() && it->second.mId == id) {
+        memcpy(digest, it->second.mDigest, sizeof(it->second.mDigest));
+        pthread_mutex_unlock(&gDigestMutex);
+        return true;
+    }
+    pthread_mutex_unlock(&gDigestMutex);
+
+    std::string recordName;
+    bool found = false;
+    if (storeDir && storeDir[0]) {
+        recordName = digestRecordName(storeDir, path);
+        found = readDigestRecord(recordName, id, digest);
+    }
+    if (!found) {
+        if (!hashFile(path, digest)) {
+            return false;
+        }
+        // The file may have changed while it was read; only remember the
+        // digest if it still has the identity we started with.
+        FileIdentity after;
+        if (!statFile(path, &after) || !(after == id)) {
+            return true;
+        }
+        if (!recordName.empty()) {
+            writeDigestRecord(recordName, id, digest);
+        }
+    }
+
+    pthread_mutex_lock(&gDigestMutex);
+    FileDigest &entry = gFileDigests[path];
+    entry.mId = id;
+    memcpy(entry.mDigest, digest, sizeof(entry.mDigest));
+    pthread_mutex_unlock(&gDigestMutex);
+    return true;
+}
+
+}  // anonymous namespace
+
+std::string BuildDigest::toString() const {
+    std::string s;
+    toHex(mBytes, sizeof(mBytes), &s);
+    return s;
+}
+
+uint32_t BuildDigest::toChecksum() const {
+    uint32_t checksum = ((uint32_t)mBytes[0] << 24) | ((uint32_t)mBytes[1] << 16) |
+                        ((uint32_t)mBytes[2] << 8) | mBytes[3];
+    // 0 means "no checksum" to the callers.
+    return checksum ? checksum : 1;
+}
+
+bool constructBuildDigest(uint8_t const *bitcode, size_t bitcodeSize,
+                          const char *commandLine,
+                          const char **bccFiles, size_t numFiles,
+                          const char *storeDir, BuildDigest *digest) {
+    Sha256 sha;
+
+    // Each part is preceded by its length so that no two different sets of
+    // inputs run together into the same byte stream.
+    uint64_t len = (bitcode != nullptr) ? bitcodeSize : 0;
+    sha.update(&len, sizeof(len));
+    if (len) {
+        sha.update(bitcode, bitcodeSize);
+    }
+
+    len = strlen(commandLine);
+    sha.update(&len, sizeof(len));
+    sha.update(commandLine, len);
+
+    for (size_t i = 0; i < numFiles; i++) {
+        const char* bccFile = bccFiles[i];
+        if (bccFile[0] == 0) {
+            continue;
+        }
+        uint8_t fileDigest[32];
+        if (!getFileDigest(bccFile, storeDir, fileDigest)) {
+            return false;
+        }
+        sha.update(fileDigest, sizeof(fileDigest));
+    }
+
+    sha.finish(digest->mBytes);
+    return true;
+}
+
+// Everyone using the shared cache loads native code from it, so only root
+// may decide what goes in: the directory must be owned by root, and neither
+// it nor the objects in it may be writable by others.
+static bool isTrustedPath(const char *path, bool isDir) {
+    struct stat st;
+    if (lstat(path, &st) != 0) {
+        return false;
+    }
+    if (isDir ? !S_ISDIR(st.st_mode) : !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    if (st.st_mode & S_IWOTH) {
+        return false;
+    }
+    return !isDir || st.st_uid == 0;
+}
+
+std::string getSharedScriptCacheDir() {
+    char buf[PROPERTY_VALUE_MAX];
+    property_get("debug.rs.shared-cache-dir", buf, "");
+    if (buf[0] == '\0') {
+        return std::string();
+    }
+    if (!isTrustedPath(buf, true)) {
+        ALOGW("Ignoring shared script cache dir %s: not a root-owned directory "
+              "closed to other users", buf);
+        return std::string();
+    }
+    return std::string(buf);
+}
+
+bool isTrustedSharedScript(const char *dir, const char *path) {
+    return isTrustedPath(dir, true) && isTrustedPath(path, false);
+}
+
+void markSharedScriptUsed(const char *path) {
+    // May fail for objects published by another uid; they are then evicted
+    // by the age of their last compile instead.
+    utimes(path, nullptr);
+}
+
+void trimSharedScriptCache(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        return;
+    }
+
+    struct Entry {
+        std::string path;
+        time_t mtime;
+        off_t size;
+    };
+    std::vector<Entry> entries;
+    off_t total = 0;
+    while (struct dirent *e = readdir(d)) {
+        size_t len = strlen(e->d_name);
+        if (len < 4 || strcmp(e->d_name + len - 3, ".so") != 0) {
+            continue;
+        }
+        Entry entry;
+        entry.path = dir;
+        entry.path.append("/");
+        entry.path.append(e->d_name);
+        struct stat st;
+        if (lstat(entry.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        entry.mtime = st.st_mtime;
+        entry.size = st.st_size;
+        total += st.st_size;
+        entries.push_back(entry);
+    }
+    closedir(d);
+
+    size_t count = entries.size();
+    if (count <= kMaxSharedScripts && total <= kMaxSharedScriptBytes) {
+        return;
+    }
+
+    // Least recently used first.  Cache dirs that linked an object keep
+    // their own link, so removing it here only stops further sharing.
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.mtime < b.mtime;
+    });
+    for (const Entry &e : entries) {
+        if (count <= kMaxSharedScripts && total <= kMaxSharedScriptBytes) {
+            break;
+        }
+        if (unlink(e.path.c_str()) == 0) {
+            count--;
+            total -= e.size;
+        }
+    }
+}
+
+}
+}
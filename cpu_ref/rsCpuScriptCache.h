@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RSD_CPU_SCRIPT_CACHE_H
+#define RSD_CPU_SCRIPT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace android {
+namespace renderscript {
+
+// SHA-256 of everything that goes into a compiled script: the bitcode, the
+// compiler command line and the contents of the compiler and the libraries
+// it reads.  Two compiles with the same digest produce the same code, so the
+// digest names the shared object in the shared script cache.
+struct BuildDigest {
+    uint8_t mBytes[32];
+
+    // Lower-case hex, the file name of the cached shared object.
+    std::string toString() const;
+
+    // The 32-bit value passed to bcc as "-build-checksum".  Never 0.
+    uint32_t toChecksum() const;
+};
+
+// Compute the digest of a compile.  commandLine must not contain paths that
+// differ between cache dirs for the result to be shared across them.
+// Digests of bccFiles are computed once per process for each version of a
+// file; when storeDir is given they are also kept there for later processes.
+// Returns false if one of bccFiles cannot be read.
+bool constructBuildDigest(uint8_t const *bitcode, size_t bitcodeSize,
+                          const char *commandLine,
+                          const char **bccFiles, size_t numFiles,
+                          const char *storeDir, BuildDigest *digest);
+
+// Directory of compiled scripts named by digest, shared by every cacheDir:
+// debug.rs.shared-cache-dir.  Returns an empty string when the property is
+// not set, or names anything but a directory owned by root and not writable
+// by others.  There is no default; each cacheDir already caches its scripts.
+std::string getSharedScriptCacheDir();
+
+// Returns true if the object at path in the shared cache dir may be loaded.
+// Checked again before each use, as the directory may change at any time.
+bool isTrustedSharedScript(const char *dir, const char *path);
+
+// Records a use of a cached object, for eviction.
+void markSharedScriptUsed(const char *path);
+
+// Removes the least recently used objects of the shared cache dir until it
+// is within its limits.
+void trimSharedScriptCache(const char *dir);
+
+}
+}
+
+#endif
@@ -55,6 +55,7 @@ void CpuScriptGroupImpl::scriptGroupRoot(const RsExpandKernelDriverInfo *kinfo,
     RsExpandKernelDriverInfo *mkinfo = const_cast<RsExpandKernelDriverInfo *>(kinfo);
 
     const uint32_t oldInStride = mkinfo->inStride[0];
+    const uint32_t oldOutLen   = mkinfo->outLen;
 
     for (size_t ct = 0; ct < sl->count; ct++) {
         ScriptGroupRootFunc_t func;
@@ -87,8 +88,11 @@ void CpuScriptGroupImpl::scriptGroupRoot(const RsExpandKernelDriverInfo *kinfo,
         }
 
         uint32_t ostep;
+        // Each kernel of the group writes at most one output.  The launcher
+        // fills in outPtr[0] for as many outputs as outLen says on every row,
+        // so outLen is put back afterwards.
         if (sl->outs[ct]) {
-            rsAssert(kinfo->outLen == 1);
+            mkinfo->outLen = 1;
 
             mkinfo->outPtr[0] =
               (uint8_t *)sl->outs[ct]->mHal.drvState.lod[0].mallocPtr;
@@ -106,8 +110,7 @@ void CpuScriptGroupImpl::scriptGroupRoot(const RsExpandKernelDriverInfo *kinfo,
                   sl->outs[ct]->mHal.drvState.lod[0].stride * kinfo->lid;
             }
         } else {
-            rsAssert(kinfo->outLen == 0);
-
+            mkinfo->outLen    = 0;
             mkinfo->outPtr[0] = nullptr;
             ostep             = 0;
         }
@@ -118,6 +121,7 @@ void CpuScriptGroupImpl::scriptGroupRoot(const RsExpandKernelDriverInfo *kinfo,
     //ALOGE("script group root");
 
     mkinfo->inStride[0] = oldInStride;
+    mkinfo->outLen      = oldOutLen;
     mkinfo->usr         = sl;
 }
 
@@ -225,13 +229,14 @@ void CpuScriptGroupImpl::execute() {
 
             bool launchOK = si->forEachMtlsSetup(ains, inLen, outs[ct], nullptr, 0, nullptr, &mtls);
 
-            si->forEachKernelSetup(slot, &mtls);
+            // A script whose code failed to load has no kernel to set up.
+            if (!launchOK || !si->forEachKernelSetup(slot, &mtls)) {
+                continue;
+            }
             si->preLaunch(slot, ains, inLen, outs[ct], mtls.fep.usr,
                           mtls.fep.usrLen, nullptr);
 
-            if (launchOK) {
-                mCtx->launchThreads(ains, inLen, outs[ct], nullptr, &mtls);
-            }
+            mCtx->launchThreads(ains, inLen, outs[ct], nullptr, &mtls);
 
             si->postLaunch(slot, ains, inLen, outs[ct], nullptr, 0, nullptr);
         }
@@ -257,16 +262,21 @@ void CpuScriptGroupImpl::execute() {
         Vector<const void *> usrPtrs;
         Vector<const void *> fnPtrs;
         Vector<uint32_t> sigs;
+        // The fused kernel only runs if every kernel in it could be set up.
+        size_t ready = 0;
         for (size_t ct=0; ct < kernels.size(); ct++) {
             Script *s = kernels[ct]->mScript;
             RsdCpuScriptImpl *si = (RsdCpuScriptImpl *)mCtx->lookupScript(s);
 
-            si->forEachKernelSetup(kernels[ct]->mSlot, &mtls);
+            if (!si->forEachKernelSetup(kernels[ct]->mSlot, &mtls)) {
+                break;
+            }
             fnPtrs.add((void *)mtls.kernel);
             usrPtrs.add(mtls.fep.usr);
             sigs.add(mtls.fep.usrLen);
             si->preLaunch(kernels[ct]->mSlot, ains, inLen, outs[ct],
                           mtls.fep.usr, mtls.fep.usrLen, nullptr);
+            ready++;
         }
         sl.sigs = sigs.array();
         sl.usrPtrs = usrPtrs.array();
@@ -277,7 +287,8 @@ void CpuScriptGroupImpl::execute() {
         Script *s = kernels[0]->mScript;
         RsdCpuScriptImpl *si = (RsdCpuScriptImpl *)mCtx->lookupScript(s);
 
-        if (si->forEachMtlsSetup(ains, inLen, outs[0], nullptr, 0, nullptr, &mtls)) {
+        if (ready == kernels.size() &&
+            si->forEachMtlsSetup(ains, inLen, outs[0], nullptr, 0, nullptr, &mtls)) {
 
             mtls.script = nullptr;
             mtls.kernel = (void (*)())&scriptGroupRoot;
@@ -286,7 +297,7 @@ void CpuScriptGroupImpl::execute() {
             mCtx->launchThreads(ains, inLen, outs[0], nullptr, &mtls);
         }
 
-        for (size_t ct=0; ct < kernels.size(); ct++) {
+        for (size_t ct=0; ct < ready; ct++) {
             Script *s = kernels[ct]->mScript;
             RsdCpuScriptImpl *si = (RsdCpuScriptImpl *)mCtx->lookupScript(s);
             si->postLaunch(kernels[ct]->mSlot, ains, inLen, outs[ct], nullptr, 0,
@@ -40,10 +40,14 @@ void groupRoot(const RsExpandKernelDriverInfo *kinfo, uint32_t xstart,
     RsExpandKernelDriverInfo *mutable_kinfo = const_cast<RsExpandKernelDriverInfo *>(kinfo);
 
     const size_t oldInLen = mutable_kinfo->inLen;
+    const size_t oldOutLen = mutable_kinfo->outLen;
 
     decltype(mutable_kinfo->inStride) oldInStride;
     memcpy(&oldInStride, &mutable_kinfo->inStride, sizeof(oldInStride));
 
+    decltype(mutable_kinfo->outStride) oldOutStride;
+    memcpy(&oldOutStride, &mutable_kinfo->outStride, sizeof(oldOutStride));
+
     for (CPUClosure* cpuClosure : closures) {
         const Closure* closure = cpuClosure->mClosure;
 
@@ -64,22 +68,31 @@ void groupRoot(const RsExpandKernelDriverInfo *kinfo, uint32_t xstart,
         }
         mutable_kinfo->inLen = closure->mNumArg;
 
-        const Allocation* out = closure->mReturnValue;
-        const uint32_t ostep = out->mHal.state.elementSizeBytes;
-        const uint8_t* ptr = (uint8_t *)(out->mHal.drvState.lod[0].mallocPtr) +
-                ostep * xstart;
-        if (kinfo->dim.y > 1) {
-            ptr += out->mHal.drvState.lod[0].stride * kinfo->current.y;
-        }
+        rsAssert(closure->mNumOutput <= RS_KERNEL_INPUT_LIMIT);
 
-        rsAssert(kinfo->outLen <= 1);
-        mutable_kinfo->outPtr[0] = const_cast<uint8_t*>(ptr);
+        for (size_t i = 0; i < closure->mNumOutput; i++) {
+            const Allocation* out = closure->mOutputs[i];
+            const uint32_t eStride = out->mHal.state.elementSizeBytes;
+            const uint8_t* ptr = (uint8_t *)(out->mHal.drvState.lod[0].mallocPtr) +
+                    eStride * xstart;
+            if (kinfo->dim.y > 1) {
+                ptr += out->mHal.drvState.lod[0].stride * kinfo->current.y;
+            }
+            mutable_kinfo->outPtr[i] = const_cast<uint8_t*>(ptr);
+            mutable_kinfo->outStride[i] = eStride;
+        }
+        mutable_kinfo->outLen = closure->mNumOutput;
 
+        const uint32_t ostep = closure->mNumOutput ? mutable_kinfo->outStride[0] : 0;
         cpuClosure->mFunc(kinfo, xstart, xend, ostep);
     }
 
+    // The launcher recomputes the pointers of inLen inputs and outLen outputs
+    // on every row, so both have to describe the batch again.
     mutable_kinfo->inLen = oldInLen;
     memcpy(&mutable_kinfo->inStride, &oldInStride, sizeof(oldInStride));
+    mutable_kinfo->outLen = oldOutLen;
+    memcpy(&mutable_kinfo->outStride, &oldOutStride, sizeof(oldOutStride));
 }
 
 }  // namespace
@@ -155,6 +168,19 @@ CpuScriptGroup2Impl::CpuScriptGroup2Impl(RsdCpuReferenceImpl *cpuRefImpl,
     mCpuRefImpl(cpuRefImpl), mGroup((const ScriptGroup2*)(sg)),
     mExecutable(nullptr), mScriptObj(nullptr) {
     rsAssert(!mGroup->mClosures.empty());
+}
+
+bool CpuScriptGroup2Impl::init() {
+    // Loading a script compiled in the background takes the init mutex, so
+    // it has to happen before the group takes it.  A group with a script
+    // whose code failed to load is refused.
+    for (Closure* closure: mGroup->mClosures) {
+        RsdCpuScriptImpl* si = (RsdCpuScriptImpl *)mCpuRefImpl->lookupScript(
+                closure->mFunctionID.get()->mScript);
+        if (!si->waitForCompile()) {
+            return false;
+        }
+    }
 
     mCpuRefImpl->lockMutex();
     Batch* batch = new Batch(this, "Batch0");
@@ -166,7 +192,12 @@ CpuScriptGroup2Impl::CpuScriptGroup2Impl(RsdCpuReferenceImpl *cpuRefImpl,
                 (RsdCpuScriptImpl *)mCpuRefImpl->lookupScript(funcID->mScript);
         if (closure->mIsKernel) {
             MTLaunchStruct mtls;
-            si->forEachKernelSetup(funcID->mSlot, &mtls);
+            if (!si->forEachKernelSetup(funcID->mSlot, &mtls)) {
+                // The destructor frees the batches built so far.
+                mBatches.push_back(batch);
+                mCpuRefImpl->unlockMutex();
+                return false;
+            }
             cc = new CPUClosure(closure, si, (ExpandFuncTy)mtls.kernel);
         } else {
             cc = new CPUClosure(closure, si);
@@ -194,6 +225,7 @@ CpuScriptGroup2Impl::CpuScriptGroup2Impl(RsdCpuReferenceImpl *cpuRefImpl,
     }
 #endif  // RS_COMPATIBILITY_LIB
     mCpuRefImpl->unlockMutex();
+    return true;
 }
 
 void Batch::resolveFuncPtr(void* sharedObj) {
@@ -210,9 +242,9 @@ CpuScriptGroup2Impl::~CpuScriptGroup2Impl() {
         delete batch;
     }
     delete mExecutable;
-    // TODO: move this dlclose into ~ScriptExecutable().
+    // TODO: move this unload into ~ScriptExecutable().
     if (mScriptObj != nullptr) {
-        dlclose(mScriptObj);
+        SharedLibraryUtils::unloadSharedLibrary(mScriptObj);
     }
 }
 
@@ -330,6 +362,11 @@ void CpuScriptGroup2Impl::compile(const char* cacheDir) {
             return;
         }
 
+        // The fusion pass in bcc chains kernels through a single output.
+        if (closure->mNumOutput > 1) {
+            return;
+        }
+
         const RsdCpuScriptImpl *cpuScript =
             (const RsdCpuScriptImpl *)mCpuRefImpl->lookupScript(script);
 
@@ -436,7 +473,7 @@ void CpuScriptGroup2Impl::compile(const char* cacheDir) {
             arguments.push_back(cloneName.c_str());
         }
 
-        dlclose(mScriptObj);
+        SharedLibraryUtils::unloadSharedLibrary(mScriptObj);
         mScriptObj = nullptr;
     }
 
@@ -602,7 +639,8 @@ void Batch::run() {
 
     if (cpuClosure->mSi->forEachMtlsSetup((const Allocation**)closure->mArgs,
                                           closure->mNumArg,
-                                          closure->mReturnValue,
+                                          closure->mOutputs,
+                                          closure->mNumOutput,
                                           nullptr, 0, nullptr, &mtls)) {
 
         mtls.script = nullptr;
@@ -76,6 +76,25 @@ public:
                                    uint32_t usrLen,
                                    const RsScriptCall *sc) = 0;
 
+        // Like invokeForEach, for kernels that write outLen outputs.  aouts
+        // holds at most RS_KERNEL_INPUT_LIMIT allocations.
+        virtual void invokeForEachMultiOut(uint32_t slot,
+                                           const Allocation ** ains,
+                                           uint32_t inLen,
+                                           Allocation ** aouts,
+                                           uint32_t outLen,
+                                           const void * usr,
+                                           uint32_t usrLen,
+                                           const RsScriptCall *sc) = 0;
+
+        // Reduces the cells of ains to a single value, stored in the first
+        // cell of aout.
+        virtual void invokeReduce(uint32_t slot,
+                                  const Allocation ** ains,
+                                  uint32_t inLen,
+                                  Allocation * aout,
+                                  const RsScriptCall *sc) = 0;
+
         virtual void invokeInit() = 0;
         virtual void invokeFreeChildren() = 0;
 
@@ -132,8 +151,18 @@ public:
                                     RSSelectRTCallback pSelectRTCallback = nullptr,
                                     const char *pBccPluginName = nullptr
                                     );
+    // Placement of the helper threads on cores.  Can also be selected with
+    // the debug.rs.cpu-affinity property, using the same values.
+    enum AffinityPolicy {
+        AFFINITY_NONE = 0,     // Leave placement to the kernel scheduler.
+        AFFINITY_PIN = 1,      // Pin each helper to one core, fastest cluster first.
+        AFFINITY_CLUSTER = 2,  // Keep each helper within one cluster, fastest first.
+        AFFINITY_SPREAD = 3    // Pin helpers round-robin across clusters.
+    };
+
     virtual ~RsdCpuReference();
     virtual void setPriority(int32_t priority) = 0;
+    virtual void setAffinityPolicy(AffinityPolicy policy) = 0;
 
     virtual CpuScript * createScript(const ScriptC *s, char const *resName, char const *cacheDir,
                                      uint8_t const *bitcode, size_t bitcodeSize,
@@ -18,6 +18,7 @@
 #include "rsdAllocation.h"
 
 #include "rsAllocation.h"
+#include "rsCopy.h"
 
 #if !defined(RS_SERVER) && !defined(RS_COMPATIBILITY_LIB)
 #include "system/window.h"
@@ -100,6 +101,29 @@ uint8_t *GetOffsetPtr(const android::renderscript::Allocation *alloc,
 }
 
 
+static uint8_t* allocAlignedMemory(const Context *rsc, DrvAllocation *drv,
+                                   size_t allocSize, bool forceZero) {
+    // Backing stores come from the driver's pool, which aligns them to a
+    // 64-byte cache line (kAlignment in rsdAllocationPool.cpp), and large
+    // ones to a page.
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    uint8_t* ptr = (uint8_t *)dc->mAllocationPool->allocate(allocSize, forceZero);
+    if (ptr) {
+        drv->pooledSize = allocSize;
+    }
+    return ptr;
+}
+
+static void freeAlignedMemory(const Context *rsc, DrvAllocation *drv, void *ptr) {
+    RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+    if (drv->pooledSize) {
+        dc->mAllocationPool->release(ptr, drv->pooledSize);
+        drv->pooledSize = 0;
+    } else {
+        free(ptr);
+    }
+}
+
 static void Update2DTexture(const Context *rsc, const Allocation *alloc, const void *ptr,
                             uint32_t xoff, uint32_t yoff, uint32_t lod,
                             RsAllocationCubemapFace face, uint32_t w, uint32_t h) {
@@ -191,7 +215,7 @@ static void UploadToTexture(const Context *rsc, const Allocation *alloc) {
 
     if (!(alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_SCRIPT)) {
         if (alloc->mHal.drvState.lod[0].mallocPtr) {
-            free(alloc->mHal.drvState.lod[0].mallocPtr);
+            freeAlignedMemory(rsc, drv, alloc->mHal.drvState.lod[0].mallocPtr);
             alloc->mHal.drvState.lod[0].mallocPtr = nullptr;
         }
     }
@@ -359,18 +383,6 @@ static size_t AllocationBuildPointerTable(const Context *rsc, const Allocation *
     return allocSize;
 }
 
-static uint8_t* allocAlignedMemory(size_t allocSize, bool forceZero) {
-    // We align all allocations to a 16-byte boundary.
-    uint8_t* ptr = (uint8_t *)memalign(16, allocSize);
-    if (!ptr) {
-        return nullptr;
-    }
-    if (forceZero) {
-        memset(ptr, 0, allocSize);
-    }
-    return ptr;
-}
-
 bool rsdAllocationInit(const Context *rsc, Allocation *alloc, bool forceZero) {
     DrvAllocation *drv = (DrvAllocation *)calloc(1, sizeof(DrvAllocation));
     if (!drv) {
@@ -406,7 +418,7 @@ bool rsdAllocationInit(const Context *rsc, Allocation *alloc, bool forceZero) {
             ALOGV("User-backed allocation failed stride requirement, falling back to separate allocation");
             drv->useUserProvidedPtr = false;
 
-            ptr = allocAlignedMemory(allocSize, forceZero);
+            ptr = allocAlignedMemory(rsc, drv, allocSize, forceZero);
             if (!ptr) {
                 alloc->mHal.drv = nullptr;
                 free(drv);
@@ -418,7 +430,7 @@ bool rsdAllocationInit(const Context *rsc, Allocation *alloc, bool forceZero) {
             ptr = (uint8_t*)alloc->mHal.state.userProvidedPtr;
         }
     } else {
-        ptr = allocAlignedMemory(allocSize, forceZero);
+        ptr = allocAlignedMemory(rsc, drv, allocSize, forceZero);
         if (!ptr) {
             alloc->mHal.drv = nullptr;
             free(drv);
@@ -538,7 +550,7 @@ void rsdAllocationDestroy(const Context *rsc, Allocation *alloc) {
             if (!(drv->useUserProvidedPtr) &&
                 !(alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_IO_INPUT) &&
                 !(alloc->mHal.state.usageFlags & RS_ALLOCATION_USAGE_IO_OUTPUT)) {
-                    free(alloc->mHal.drvState.lod[0].mallocPtr);
+                    freeAlignedMemory(rsc, drv, alloc->mHal.drvState.lod[0].mallocPtr);
             }
             alloc->mHal.drvState.lod[0].mallocPtr = nullptr;
         }
@@ -581,10 +593,22 @@ void rsdAllocationResize(const Context *rsc, const Allocation *alloc,
         ALOGE("Resize cannot be called on a USAGE_SHARED allocation");
         return;
     }
+    DrvAllocation *drv = (DrvAllocation *)alloc->mHal.drv;
     void * oldPtr = alloc->mHal.drvState.lod[0].mallocPtr;
     // Calculate the object size
     size_t s = AllocationBuildPointerTable(rsc, alloc, newType, nullptr);
-    uint8_t *ptr = (uint8_t *)realloc(oldPtr, s);
+    // Bytes from zeroFrom onwards need no clearing when the store grows.
+    size_t zeroFrom = s;
+    uint8_t *ptr = nullptr;
+    if (drv->pooledSize) {
+        RsdHal *dc = (RsdHal *)rsc->mHal.drv;
+        ptr = (uint8_t *)dc->mAllocationPool->resize(oldPtr, drv->pooledSize, s, &zeroFrom);
+        if (ptr) {
+            drv->pooledSize = s;
+        }
+    } else {
+        ptr = (uint8_t *)realloc(oldPtr, s);
+    }
     // Build the relative pointer tables.
     size_t verifySize = AllocationBuildPointerTable(rsc, alloc, newType, ptr);
     if(s != verifySize) {
@@ -594,8 +618,11 @@ void rsdAllocationResize(const Context *rsc, const Allocation *alloc,
 
     if (dimX > oldDimX) {
         size_t stride = alloc->mHal.state.elementSizeBytes;
-        memset(((uint8_t *)alloc->mHal.drvState.lod[0].mallocPtr) + stride * oldDimX,
-                 0, stride * (dimX - oldDimX));
+        size_t start = stride * oldDimX;
+        size_t end = rsMin(stride * dimX, zeroFrom);
+        if (end > start) {
+            memset(((uint8_t *)alloc->mHal.drvState.lod[0].mallocPtr) + start, 0, end - start);
+        }
     }
 }
 
@@ -840,6 +867,26 @@ void rsdAllocationIoReceive(const Context *rsc, Allocation *alloc) {
 }
 
 
+// Copy h lines of w elements into alloc, taking references on the objects
+// they hold.  Lines with no gap between them on either side are handled as
+// one block.
+static void copyLinesIn(const Allocation *alloc, uint8_t *dst, size_t dstStride,
+                        const uint8_t *src, size_t srcStride, uint32_t w, uint32_t h) {
+    size_t lineSize = alloc->mHal.state.elementSizeBytes * w;
+    if (alloc->mHal.state.hasReferences) {
+        if (dstStride == lineSize && srcStride == lineSize) {
+            alloc->incRefs(src, (size_t)w * h);
+            alloc->decRefs(dst, (size_t)w * h);
+        } else {
+            for (uint32_t line = 0; line < h; line++) {
+                alloc->incRefs(src + line * srcStride, w);
+                alloc->decRefs(dst + line * dstStride, w);
+            }
+        }
+    }
+    rsCopyLines(dst, dstStride, src, srcStride, lineSize, h);
+}
+
 void rsdAllocationData1D(const Context *rsc, const Allocation *alloc,
                          uint32_t xoff, uint32_t lod, size_t count,
                          const void *data, size_t sizeBytes) {
@@ -855,7 +902,7 @@ void rsdAllocationData1D(const Context *rsc, const Allocation *alloc,
             alloc->incRefs(data, count);
             alloc->decRefs(ptr, count);
         }
-        memcpy(ptr, data, size);
+        rsCopyBytes(ptr, data, size);
     }
     drv->uploadDeferred = true;
 }
@@ -881,15 +928,8 @@ void rsdAllocationData2D(const Context *rsc, const Allocation *alloc,
             return;
         }
 
-        for (uint32_t line=yoff; line < (yoff+h); line++) {
-            if (alloc->mHal.state.hasReferences) {
-                alloc->incRefs(src, w);
-                alloc->decRefs(dst, w);
-            }
-            memcpy(dst, src, lineSize);
-            src += stride;
-            dst += alloc->mHal.drvState.lod[lod].stride;
-        }
+        copyLinesIn(alloc, dst, alloc->mHal.drvState.lod[lod].stride, src, stride, w, h);
+        src += stride * h;
         if (alloc->mHal.state.yuv) {
             size_t clineSize = lineSize;
             int lod = 1;
@@ -935,24 +975,25 @@ void rsdAllocationData3D(const Context *rsc, const Allocation *alloc,
 
     if (alloc->mHal.drvState.lod[0].mallocPtr) {
         const uint8_t *src = static_cast<const uint8_t *>(data);
-        for (uint32_t z = zoff; z < (d + zoff); z++) {
-            uint8_t *dst = GetOffsetPtr(alloc, xoff, yoff, z, lod,
-                                        RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
-            if (dst == src) {
-                // Skip the copy if we are the same allocation. This can arise from
-                // our Bitmap optimization, where we share the same storage.
-                drv->uploadDeferred = true;
-                return;
-            }
+        uint8_t *dst = GetOffsetPtr(alloc, xoff, yoff, zoff, lod,
+                                    RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+        if (dst == src) {
+            // Skip the copy if we are the same allocation. This can arise from
+            // our Bitmap optimization, where we share the same storage.
+            drv->uploadDeferred = true;
+            return;
+        }
 
-            for (uint32_t line=yoff; line < (yoff+h); line++) {
-                if (alloc->mHal.state.hasReferences) {
-                    alloc->incRefs(src, w);
-                    alloc->decRefs(dst, w);
-                }
-                memcpy(dst, src, lineSize);
-                src += stride;
-                dst += alloc->mHal.drvState.lod[lod].stride;
+        size_t dstStride = alloc->mHal.drvState.lod[lod].stride;
+        if (h == alloc->mHal.drvState.lod[lod].dimY) {
+            // Whole slices: the lines of consecutive slices are evenly spaced.
+            copyLinesIn(alloc, dst, dstStride, src, stride, w, h * d);
+        } else {
+            for (uint32_t z = zoff; z < (d + zoff); z++) {
+                dst = GetOffsetPtr(alloc, xoff, yoff, z, lod,
+                                   RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+                copyLinesIn(alloc, dst, dstStride, src, stride, w, h);
+                src += stride * h;
             }
         }
         drv->uploadDeferred = true;
@@ -967,7 +1008,7 @@ void rsdAllocationRead1D(const Context *rsc, const Allocation *alloc,
     if (data != ptr) {
         // Skip the copy if we are the same allocation. This can arise from
         // our Bitmap optimization, where we share the same storage.
-        memcpy(data, ptr, count * eSize);
+        rsCopyBytes(data, ptr, count * eSize);
     }
 }
 
@@ -989,11 +1030,7 @@ void rsdAllocationRead2D(const Context *rsc, const Allocation *alloc,
             return;
         }
 
-        for (uint32_t line=yoff; line < (yoff+h); line++) {
-            memcpy(dst, src, lineSize);
-            dst += stride;
-            src += alloc->mHal.drvState.lod[lod].stride;
-        }
+        rsCopyLines(dst, stride, src, alloc->mHal.drvState.lod[lod].stride, lineSize, h);
     } else {
         ALOGE("Add code to readback from non-script memory");
     }
@@ -1012,19 +1049,24 @@ void rsdAllocationRead3D(const Context *rsc, const Allocation *alloc,
 
     if (alloc->mHal.drvState.lod[0].mallocPtr) {
         uint8_t *dst = static_cast<uint8_t *>(data);
-        for (uint32_t z = zoff; z < (d + zoff); z++) {
-            const uint8_t *src = GetOffsetPtr(alloc, xoff, yoff, z, lod,
-                                              RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
-            if (dst == src) {
-                // Skip the copy if we are the same allocation. This can arise from
-                // our Bitmap optimization, where we share the same storage.
-                return;
-            }
+        const uint8_t *src = GetOffsetPtr(alloc, xoff, yoff, zoff, lod,
+                                          RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+        if (dst == src) {
+            // Skip the copy if we are the same allocation. This can arise from
+            // our Bitmap optimization, where we share the same storage.
+            return;
+        }
 
-            for (uint32_t line=yoff; line < (yoff+h); line++) {
-                memcpy(dst, src, lineSize);
-                dst += stride;
-                src += alloc->mHal.drvState.lod[lod].stride;
+        size_t srcStride = alloc->mHal.drvState.lod[lod].stride;
+        if (h == alloc->mHal.drvState.lod[lod].dimY) {
+            // Whole slices: the lines of consecutive slices are evenly spaced.
+            rsCopyLines(dst, stride, src, srcStride, lineSize, h * d);
+        } else {
+            for (uint32_t z = zoff; z < (d + zoff); z++) {
+                src = GetOffsetPtr(alloc, xoff, yoff, z, lod,
+                                   RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+                rsCopyLines(dst, stride, src, srcStride, lineSize, h);
+                dst += stride * h;
             }
         }
     }
@@ -1056,14 +1098,14 @@ void rsdAllocationData2D_alloc_script(const android::renderscript::Context *rsc,
                                       uint32_t srcXoff, uint32_t srcYoff, uint32_t srcLod,
                                       RsAllocationCubemapFace srcFace) {
     size_t elementSize = dstAlloc->getType()->getElementSizeBytes();
-    for (uint32_t i = 0; i < h; i ++) {
-        uint8_t *dstPtr = GetOffsetPtr(dstAlloc, dstXoff, dstYoff + i, 0, dstLod, dstFace);
-        uint8_t *srcPtr = GetOffsetPtr(srcAlloc, srcXoff, srcYoff + i, 0, srcLod, srcFace);
-        memcpy(dstPtr, srcPtr, w * elementSize);
-
-        //ALOGE("COPIED dstXoff(%u), dstYoff(%u), dstLod(%u), dstFace(%u), w(%u), h(%u), srcXoff(%u), srcYoff(%u), srcLod(%u), srcFace(%u)",
-        //     dstXoff, dstYoff, dstLod, dstFace, w, h, srcXoff, srcYoff, srcLod, srcFace);
-    }
+    uint8_t *dstPtr = GetOffsetPtr(dstAlloc, dstXoff, dstYoff, 0, dstLod, dstFace);
+    uint8_t *srcPtr = GetOffsetPtr(srcAlloc, srcXoff, srcYoff, 0, srcLod, srcFace);
+    rsCopyLines(dstPtr, dstAlloc->mHal.drvState.lod[dstLod].stride,
+                srcPtr, srcAlloc->mHal.drvState.lod[srcLod].stride,
+                w * elementSize, h);
+
+    //ALOGE("COPIED dstXoff(%u), dstYoff(%u), dstLod(%u), dstFace(%u), w(%u), h(%u), srcXoff(%u), srcYoff(%u), srcLod(%u), srcFace(%u)",
+    //     dstXoff, dstYoff, dstLod, dstFace, w, h, srcXoff, srcYoff, srcLod, srcFace);
 }
 
 void rsdAllocationData3D_alloc_script(const android::renderscript::Context *rsc,
@@ -1073,17 +1115,29 @@ void rsdAllocationData3D_alloc_script(const android::renderscript::Context *rsc,
                                       const android::renderscript::Allocation *srcAlloc,
                                       uint32_t srcXoff, uint32_t srcYoff, uint32_t srcZoff, uint32_t srcLod) {
     uint32_t elementSize = dstAlloc->getType()->getElementSizeBytes();
+    size_t dstStride = dstAlloc->mHal.drvState.lod[dstLod].stride;
+    size_t srcStride = srcAlloc->mHal.drvState.lod[srcLod].stride;
+    uint8_t *dstPtr = GetOffsetPtr(dstAlloc, dstXoff, dstYoff, dstZoff,
+                                   dstLod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+    uint8_t *srcPtr = GetOffsetPtr(srcAlloc, srcXoff, srcYoff, srcZoff,
+                                   srcLod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+
+    if (h == dstAlloc->mHal.drvState.lod[dstLod].dimY &&
+        h == srcAlloc->mHal.drvState.lod[srcLod].dimY) {
+        // Whole slices on both sides: one run of evenly spaced lines.
+        rsCopyLines(dstPtr, dstStride, srcPtr, srcStride, w * elementSize, h * d);
+        return;
+    }
+
     for (uint32_t j = 0; j < d; j++) {
-        for (uint32_t i = 0; i < h; i ++) {
-            uint8_t *dstPtr = GetOffsetPtr(dstAlloc, dstXoff, dstYoff + i, dstZoff + j,
-                                           dstLod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
-            uint8_t *srcPtr = GetOffsetPtr(srcAlloc, srcXoff, srcYoff + i, srcZoff + j,
-                                           srcLod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
-            memcpy(dstPtr, srcPtr, w * elementSize);
-
-            //ALOGE("COPIED dstXoff(%u), dstYoff(%u), dstLod(%u), dstFace(%u), w(%u), h(%u), srcXoff(%u), srcYoff(%u), srcLod(%u), srcFace(%u)",
-            //     dstXoff, dstYoff, dstLod, dstFace, w, h, srcXoff, srcYoff, srcLod, srcFace);
-        }
+        dstPtr = GetOffsetPtr(dstAlloc, dstXoff, dstYoff, dstZoff + j,
+                              dstLod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+        srcPtr = GetOffsetPtr(srcAlloc, srcXoff, srcYoff, srcZoff + j,
+                              srcLod, RS_ALLOCATION_CUBEMAP_FACE_POSITIVE_X);
+        rsCopyLines(dstPtr, dstStride, srcPtr, srcStride, w * elementSize, h);
+
+        //ALOGE("COPIED dstXoff(%u), dstYoff(%u), dstLod(%u), dstFace(%u), w(%u), h(%u), srcXoff(%u), srcYoff(%u), srcLod(%u), srcFace(%u)",
+        //     dstXoff, dstYoff, dstLod, dstFace, w, h, srcXoff, srcYoff, srcLod, srcFace);
     }
 }
 
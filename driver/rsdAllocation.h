@@ -68,6 +68,9 @@ struct DrvAllocation {
     bool useUserProvidedPtr;
     bool uploadDeferred;
 
+    // Size of the backing store when it came from the allocation pool, or 0.
+    size_t pooledSize;
+
     RsdFrameBufferObj * readBackFBO;
     ANativeWindow *wnd;
     ANativeWindow *wndSurface;
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsdAllocationPool.h"
+#include "rsUtils.h"
+
+#include <malloc.h>
+#include <string.h>
+#include <sys/mman.h>
+
+using namespace android::renderscript;
+
+// Buffers are aligned to a cache line so that kernels working on different
+// Allocations never share one.
+static const size_t kAlignment = 64;
+
+// Size classes at or above this are mapped directly, so that releasing them
+// returns the memory to the system rather than to the heap.
+static const size_t kMapThreshold = 256 * 1024;
+
+// Mapped buffers at least this large ask for transparent huge pages, which
+// cuts page faults and TLB misses on large images.
+static const size_t kHugePageThreshold = 2 * 1024 * 1024;
+
+static const size_t kDefaultRetainLimit = 64 * 1024 * 1024;
+
+RsdAllocationPool::RsdAllocationPool() {
+    mLock.init();
+    memset(mBuckets, 0, sizeof(mBuckets));
+    memset(&mStats, 0, sizeof(mStats));
+#ifdef RS_COMPATIBILITY_LIB
+    // The support IO library may destroy Allocations with its own copy of
+    // the driver, which frees their memory directly.  Keep every buffer a
+    // plain heap allocation there.
+    mRetainLimit = 0;
+#else
+    mRetainLimit = kDefaultRetainLimit;
+#endif
+}
+
+RsdAllocationPool::~RsdAllocationPool() {
+    dumpStats();
+    trim();
+}
+
+size_t RsdAllocationPool::classSize(size_t size, uint32_t *bucket) {
+    if (size <= 4096) {
+        size = size ? (size + 63) & ~(size_t)63 : 64;
+        *bucket = size / 64 - 1;
+        return size;
+    }
+
+    // Eight classes per power of two: 2^e * (8 + m) / 8 for m in [0, 8).
+    uint32_t e = 63 - __builtin_clzll((unsigned long long)size);
+    size_t step = (size_t)1 << (e - 3);
+    size_t rounded = (size + step - 1) & ~(step - 1);
+    if (rounded >> e >= 2) {
+        e++;
+    }
+    uint32_t m = rounded >> (e - 3);
+    *bucket = 64 + (e - 12) * 8 + (m - 8);
+    if (*bucket >= kBucketCount) {
+        *bucket = kBucketCount;
+        return size;
+    }
+    return rounded;
+}
+
+bool RsdAllocationPool::isMapped(size_t size) {
+#ifdef RS_COMPATIBILITY_LIB
+    return false;
+#else
+    return size >= kMapThreshold;
+#endif
+}
+
+void * RsdAllocationPool::allocateSystem(size_t size, bool *zeroed) {
+    if (isMapped(size)) {
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if (size >= kHugePageThreshold) {
+            madvise(ptr, size, MADV_HUGEPAGE);
+        }
+#endif
+        *zeroed = true;
+        return ptr;
+    }
+    *zeroed = false;
+    return memalign(kAlignment, size);
+}
+
+void RsdAllocationPool::freeSystem(void *ptr, size_t size) {
+    if (isMapped(size)) {
+        munmap(ptr, size);
+        return;
+    }
+    free(ptr);
+}
+
+void * RsdAllocationPool::allocate(size_t size, bool zero) {
+    uint32_t bucket;
+    size = classSize(size, &bucket);
+
+    void *ptr = nullptr;
+    mLock.lock();
+    if (bucket < kBucketCount && mBuckets[bucket]) {
+        FreeBuffer *b = mBuckets[bucket];
+        mBuckets[bucket] = b->mNext;
+        mStats.retainedBytes -= size;
+        mStats.hits++;
+        ptr = b;
+    } else {
+        mStats.misses++;
+    }
+    mStats.liveBytes += size;
+    mLock.unlock();
+
+    bool zeroed = false;
+    if (!ptr) {
+        ptr = allocateSystem(size, &zeroed);
+        if (!ptr) {
+            mLock.lock();
+            mStats.liveBytes -= size;
+            mLock.unlock();
+            return nullptr;
+        }
+    }
+    if (zero && !zeroed) {
+        // Dropping the pages of a recycled mapping is cheaper than writing
+        // them, and the kernel hands back zeroed pages as they are touched.
+        if (!isMapped(size) || madvise(ptr, size, MADV_DONTNEED)) {
+            memset(ptr, 0, size);
+        }
+    }
+    return ptr;
+}
+
+void RsdAllocationPool::release(void *ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    uint32_t bucket;
+    size = classSize(size, &bucket);
+
+    mLock.lock();
+    mStats.liveBytes -= size;
+    if (bucket < kBucketCount && mStats.retainedBytes + size <= mRetainLimit) {
+        FreeBuffer *b = (FreeBuffer *)ptr;
+        b->mNext = mBuckets[bucket];
+        mBuckets[bucket] = b;
+        mStats.retainedBytes += size;
+        if (mStats.retainedBytes > mStats.peakRetainedBytes) {
+            mStats.peakRetainedBytes = mStats.retainedBytes;
+        }
+        ptr = nullptr;
+    }
+    mLock.unlock();
+
+    if (ptr) {
+        freeSystem(ptr, size);
+    }
+}
+
+void * RsdAllocationPool::resize(void *ptr, size_t oldSize, size_t newSize,
+                                 size_t *zeroFrom) {
+    uint32_t oldBucket, newBucket;
+    size_t oldClass = classSize(oldSize, &oldBucket);
+    size_t newClass = classSize(newSize, &newBucket);
+
+    if (oldClass == newClass) {
+        *zeroFrom = newClass;
+        return ptr;
+    }
+
+#ifdef MREMAP_MAYMOVE
+    if (isMapped(oldClass) && isMapped(newClass)) {
+        // Growing only maps new pages after the old ones, which the kernel
+        // zero-fills, and moving the mapping never copies data.
+        void *newPtr = mremap(ptr, oldClass, newClass, MREMAP_MAYMOVE);
+        if (newPtr == MAP_FAILED) {
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if (newClass >= kHugePageThreshold) {
+            madvise(newPtr, newClass, MADV_HUGEPAGE);
+        }
+#endif
+        mLock.lock();
+        mStats.liveBytes += newClass - oldClass;
+        mLock.unlock();
+        *zeroFrom = rsMin(oldClass, newClass);
+        return newPtr;
+    }
+#endif
+
+    void *newPtr = allocate(newSize, false);
+    if (!newPtr) {
+        return nullptr;
+    }
+    memcpy(newPtr, ptr, rsMin(oldSize, newSize));
+    release(ptr, oldSize);
+    *zeroFrom = newClass;
+    return newPtr;
+}
+
+void RsdAllocationPool::trim() {
+    mLock.lock();
+    for (uint32_t ct = 0; ct < kBucketCount; ct++) {
+        FreeBuffer *b = mBuckets[ct];
+        mBuckets[ct] = nullptr;
+        while (b) {
+            FreeBuffer *next = b->mNext;
+            // Recover the class size from the bucket index.
+            size_t size = ct < 64 ? (ct + 1) * 64 :
+                    (size_t)(8 + (ct - 64) % 8) << ((ct - 64) / 8 + 12 - 3);
+            freeSystem(b, size);
+            mStats.retainedBytes -= size;
+            b = next;
+        }
+    }
+    mLock.unlock();
+}
+
+void RsdAllocationPool::setRetainLimit(size_t bytes) {
+    mLock.lock();
+    mRetainLimit = bytes;
+    bool over = mStats.retainedBytes > bytes;
+    mLock.unlock();
+    if (over) {
+        trim();
+    }
+}
+
+void RsdAllocationPool::getStats(Stats *stats) {
+    mLock.lock();
+    *stats = mStats;
+    mLock.unlock();
+}
+
+void RsdAllocationPool::dumpStats() {
+    Stats s;
+    getStats(&s);
+    uint64_t total = s.hits + s.misses;
+    ALOGV("Allocation pool: %llu requests, %.1f%% hits, %zu bytes retained (peak %zu), "
+          "%zu bytes live", (unsigned long long)total,
+          total ? 100.0 * s.hits / total : 0.0, s.retainedBytes, s.peakRetainedBytes,
+          s.liveBytes);
+}
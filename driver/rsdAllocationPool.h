@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RSD_ALLOCATION_POOL_H
+#define RSD_ALLOCATION_POOL_H
+
+#include "rsMutex.h"
+
+// Recycles the backing stores of Allocations.  Pipelines that create and
+// drop temporaries of the same Type every frame would otherwise pay for a
+// fresh allocation, and its page faults, each time.
+//
+// Requests are rounded up to a size class: a multiple of 64 bytes for small
+// buffers and one of eight steps per power of two above that, so buffers of
+// the same Type always share a class.  Released buffers are kept on a
+// per-class free list, most recently used first, until the pool holds
+// mRetainLimit bytes.  Large buffers are mapped directly from the kernel,
+// with transparent huge pages requested where available.  They are never
+// cleared with memset: fresh mappings are zero-filled by the kernel on first
+// touch, and recycled ones have their pages dropped so they fault back in as
+// zero.
+class RsdAllocationPool {
+public:
+    struct Stats {
+        uint64_t hits;            // Requests served from a free list.
+        uint64_t misses;          // Requests that needed new memory.
+        size_t retainedBytes;     // Bytes held on the free lists.
+        size_t peakRetainedBytes;
+        size_t liveBytes;         // Bytes handed out and not yet released.
+    };
+
+    RsdAllocationPool();
+    ~RsdAllocationPool();
+
+    // Returns a 64-byte aligned buffer of at least size bytes, zeroed if
+    // requested, or nullptr if memory is exhausted.
+    void * allocate(size_t size, bool zero);
+
+    // Returns a buffer from allocate() of the same size to the pool.
+    void release(void *ptr, size_t size);
+
+    // Moves the contents of a buffer from allocate() to one of newSize bytes
+    // and returns it, or nullptr with the old buffer intact on failure.
+    // Mapped buffers are grown or shrunk in place by remapping their pages.
+    // Bytes from *zeroFrom onwards are known to be zero.
+    void * resize(void *ptr, size_t oldSize, size_t newSize, size_t *zeroFrom);
+
+    // Frees every retained buffer.
+    void trim();
+
+    void setRetainLimit(size_t bytes);
+    void getStats(Stats *stats);
+    void dumpStats();
+
+private:
+    struct FreeBuffer {
+        FreeBuffer *mNext;
+    };
+
+    static const uint32_t kBucketCount = 64 + 52 * 8;
+
+    static size_t classSize(size_t size, uint32_t *bucket);
+    static void * allocateSystem(size_t size, bool *zeroed);
+    static void freeSystem(void *ptr, size_t size);
+    static bool isMapped(size_t size);
+
+    android::renderscript::Mutex mLock;
+    FreeBuffer *mBuckets[kBucketCount];
+    size_t mRetainLimit;
+    Stats mStats;
+};
+
+#endif
@@ -100,6 +100,33 @@ void rsdScriptInvokeForEachMulti(const Context *rsc,
     cs->invokeForEach(slot, ains, inLen, aout, usr, usrLen, sc);
 }
 
+void rsdScriptInvokeReduce(const Context *rsc,
+                           Script *s,
+                           uint32_t slot,
+                           const Allocation ** ains,
+                           size_t inLen,
+                           Allocation * aout,
+                           const RsScriptCall *sc) {
+
+    RsdCpuReference::CpuScript *cs = (RsdCpuReference::CpuScript *)s->mHal.drv;
+    cs->invokeReduce(slot, ains, inLen, aout, sc);
+}
+
+void rsdScriptInvokeForEachMultiOut(const Context *rsc,
+                                    Script *s,
+                                    uint32_t slot,
+                                    const Allocation ** ains,
+                                    size_t inLen,
+                                    Allocation ** aouts,
+                                    size_t outLen,
+                                    const void * usr,
+                                    size_t usrLen,
+                                    const RsScriptCall *sc) {
+
+    RsdCpuReference::CpuScript *cs = (RsdCpuReference::CpuScript *)s->mHal.drv;
+    cs->invokeForEachMultiOut(slot, ains, inLen, aouts, outLen, usr, usrLen, sc);
+}
+
 
 int rsdScriptInvokeRoot(const Context *dc, Script *s) {
     RsdCpuReference::CpuScript *cs = (RsdCpuReference::CpuScript *)s->mHal.drv;
@@ -53,6 +53,25 @@ void rsdScriptInvokeForEachMulti(const android::renderscript::Context *rsc,
                                  size_t usrLen,
                                  const RsScriptCall *sc);
 
+void rsdScriptInvokeReduce(const android::renderscript::Context *rsc,
+                           android::renderscript::Script *s,
+                           uint32_t slot,
+                           const android::renderscript::Allocation ** ains,
+                           size_t inLen,
+                           android::renderscript::Allocation * aout,
+                           const RsScriptCall *sc);
+
+void rsdScriptInvokeForEachMultiOut(const android::renderscript::Context *rsc,
+                                    android::renderscript::Script *s,
+                                    uint32_t slot,
+                                    const android::renderscript::Allocation ** ains,
+                                    size_t inLen,
+                                    android::renderscript::Allocation ** aouts,
+                                    size_t outLen,
+                                    const void * usr,
+                                    size_t usrLen,
+                                    const RsScriptCall *sc);
+
 int rsdScriptInvokeRoot(const android::renderscript::Context *dc,
                         android::renderscript::Script *script);
 void rsdScriptInvokeInit(const android::renderscript::Context *dc,
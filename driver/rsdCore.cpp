@@ -97,6 +97,10 @@ extern "C" bool rsdHalQueryHal(RsHalInitEnums entry, void **fnPtr) {
         fnPtr[0] = (void *)rsdScriptDestroy; break;
     case RS_HAL_SCRIPT_INVOKE_FOR_EACH_MULTI:
         fnPtr[0] = (void *)rsdScriptInvokeForEachMulti; break;
+    case RS_HAL_SCRIPT_INVOKE_REDUCE:
+        fnPtr[0] = (void *)rsdScriptInvokeReduce; break;
+    case RS_HAL_SCRIPT_INVOKE_FOR_EACH_MULTI_OUT:
+        fnPtr[0] = (void *)rsdScriptInvokeForEachMultiOut; break;
     case RS_HAL_SCRIPT_UPDATE_CACHED_OBJECT:
         fnPtr[0] = (void *)rsdScriptUpdateCachedObject; break;
 
@@ -331,6 +335,8 @@ extern "C" bool rsdHalInit(RsContext c, uint32_t version_major,
         return false;
     }
 
+    dc->mAllocationPool = new RsdAllocationPool();
+
 #ifndef RS_COMPATIBILITY_LIB
     // Set a callback for compiler setup here.
     if (false) {
@@ -357,6 +363,7 @@ void SetPriority(const Context *rsc, int32_t priority) {
 void Shutdown(Context *rsc) {
     RsdHal *dc = (RsdHal *)rsc->mHal.drv;
     delete dc->mCpuRef;
+    delete dc->mAllocationPool;
     free(dc);
     rsc->mHal.drv = nullptr;
 }
@@ -23,6 +23,7 @@
 
 #include "rsMutex.h"
 #include "rsSignal.h"
+#include "rsdAllocationPool.h"
 
 #ifndef RS_COMPATIBILITY_LIB
 #include "rsdGL.h"
@@ -40,6 +41,7 @@ typedef struct RsdHalRec {
 
     ScriptTLSStruct mTlsStruct;
     android::renderscript::RsdCpuReference *mCpuRef;
+    RsdAllocationPool *mAllocationPool;
 
 #ifndef RS_COMPATIBILITY_LIB
     RsdGL gl;
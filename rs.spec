@@ -108,6 +108,10 @@ ContextFinish {
     sync
     }
 
+ContextFlush {
+    direct
+}
+
 ContextDump {
     param int32_t bits
 }
@@ -170,6 +174,17 @@ Allocation1DData {
     param const void *data
     }
 
+Allocation1DDataAsync {
+    param RsAllocation va
+    param uint32_t xoff
+    param uint32_t lod
+    param uint32_t count
+    param const void *data
+    param RsUploadReleaseCallback release
+    param RsAsyncVoidPtr releaseData
+    asyncData
+    }
+
 Allocation1DElementData {
     param RsAllocation va
     param uint32_t x
@@ -200,6 +215,21 @@ Allocation2DData {
     param size_t stride
     }
 
+Allocation2DDataAsync {
+    param RsAllocation va
+    param uint32_t xoff
+    param uint32_t yoff
+    param uint32_t lod
+    param RsAllocationCubemapFace face
+    param uint32_t w
+    param uint32_t h
+    param const void *data
+    param size_t stride
+    param RsUploadReleaseCallback release
+    param RsAsyncVoidPtr releaseData
+    asyncData
+    }
+
 Allocation3DData {
     param RsAllocation va
     param uint32_t xoff
@@ -335,6 +365,12 @@ ClosureSetArg {
   param size_t valueSize
 }
 
+ClosureSetOutput {
+  param RsClosure closureID
+  param uint32_t index
+  param RsAllocation output
+}
+
 ClosureSetGlobal {
   param RsClosure closureID
   param RsScriptFieldID fieldID
@@ -399,6 +435,23 @@ ScriptForEachMulti {
     param const RsScriptCall * sc
 }
 
+ScriptForEachMultiOut {
+    param RsScript s
+    param uint32_t slot
+    param RsAllocation * ains
+    param RsAllocation * aouts
+    param const void * usr
+    param const RsScriptCall * sc
+}
+
+ScriptReduce {
+    param RsScript s
+    param uint32_t slot
+    param RsAllocation * ains
+    param RsAllocation aout
+    param const RsScriptCall * sc
+}
+
 ScriptSetVarI {
     param RsScript s
     param uint32_t slot
@@ -17,6 +17,7 @@
 #include "rsContext.h"
 #include "rsAllocation.h"
 #include "rsAdapter.h"
+#include "rsCopy.h"
 #include "rs_hal.h"
 
 #if !defined(RS_SERVER) && !defined(RS_COMPATIBILITY_LIB)
@@ -370,40 +371,53 @@ void Allocation::writePackedData(Context *rsc, const Type *type,
     // no sub-elements
     uint32_t fieldCount = elem->getFieldCount();
     if (fieldCount == 0) {
-        for (uint32_t i = 0; i < numItems; i ++) {
-            memcpy(dst, src, unpaddedBytes);
-            src += srcInc;
-            dst += dstInc;
+        if (unpaddedBytes == paddedBytes) {
+            rsCopyBytes(dst, src, numItems * paddedBytes);
+            return;
         }
+        // Only 3-component vectors have padding; the fourth component is it.
+        rsCopyVec3(dst, src, numItems, unpaddedBytes / 3, dstPadded);
         return;
     }
 
-    // Cache offsets
-    uint32_t *offsetsPadded = new uint32_t[fieldCount];
-    uint32_t *offsetsUnpadded = new uint32_t[fieldCount];
-    uint32_t *sizeUnpadded = new uint32_t[fieldCount];
+    // Cache offsets.  Fields that follow each other in both layouts are
+    // merged into one run, so that only the gaps split the copy.
+    uint32_t *runSrc = new uint32_t[fieldCount];
+    uint32_t *runDst = new uint32_t[fieldCount];
+    uint32_t *runSize = new uint32_t[fieldCount];
+    uint32_t runCount = 0;
 
     for (uint32_t i = 0; i < fieldCount; i++) {
-        offsetsPadded[i] = elem->getFieldOffsetBytes(i);
-        offsetsUnpadded[i] = elem->getFieldOffsetBytesUnpadded(i);
-        sizeUnpadded[i] = elem->getField(i)->getSizeBytesUnpadded();
+        uint32_t offsetPadded = elem->getFieldOffsetBytes(i);
+        uint32_t offsetUnpadded = elem->getFieldOffsetBytesUnpadded(i);
+        uint32_t srcOffset = !dstPadded ? offsetPadded : offsetUnpadded;
+        uint32_t dstOffset =  dstPadded ? offsetPadded : offsetUnpadded;
+        uint32_t size = elem->getField(i)->getSizeBytesUnpadded();
+
+        if (runCount &&
+            runSrc[runCount - 1] + runSize[runCount - 1] == srcOffset &&
+            runDst[runCount - 1] + runSize[runCount - 1] == dstOffset) {
+            runSize[runCount - 1] += size;
+            continue;
+        }
+        runSrc[runCount] = srcOffset;
+        runDst[runCount] = dstOffset;
+        runSize[runCount] = size;
+        runCount++;
     }
 
-    uint32_t *srcOffsets = !dstPadded ? offsetsPadded : offsetsUnpadded;
-    uint32_t *dstOffsets =  dstPadded ? offsetsPadded : offsetsUnpadded;
-
-    // complex elements, need to copy subelem after subelem
+    // complex elements, need to copy run after run
     for (uint32_t i = 0; i < numItems; i ++) {
-        for (uint32_t fI = 0; fI < fieldCount; fI++) {
-            memcpy(dst + dstOffsets[fI], src + srcOffsets[fI], sizeUnpadded[fI]);
+        for (uint32_t r = 0; r < runCount; r++) {
+            memcpy(dst + runDst[r], src + runSrc[r], runSize[r]);
         }
         src += srcInc;
         dst += dstInc;
     }
 
-    delete[] offsetsPadded;
-    delete[] offsetsUnpadded;
-    delete[] sizeUnpadded;
+    delete[] runSrc;
+    delete[] runDst;
+    delete[] runSize;
 }
 
 void Allocation::unpackVec3Allocation(Context *rsc, const void *data, size_t dataSize) {
@@ -666,6 +680,18 @@ void rsi_Allocation1DData(Context *rsc, RsAllocation va, uint32_t xoff, uint32_t
     a->data(rsc, xoff, lod, count, data, sizeBytes);
 }
 
+// Large payloads of the async variants are read straight from the caller's
+// memory, which stays valid until release is called.
+void rsi_Allocation1DDataAsync(Context *rsc, RsAllocation va, uint32_t xoff, uint32_t lod,
+                               uint32_t count, const void *data, size_t sizeBytes,
+                               RsUploadReleaseCallback release, RsAsyncVoidPtr releaseData) {
+    Allocation *a = static_cast<Allocation *>(va);
+    a->data(rsc, xoff, lod, count, data, sizeBytes);
+    if (release) {
+        release(releaseData);
+    }
+}
+
 void rsi_Allocation1DElementData(Context *rsc, RsAllocation va, uint32_t x,
                                  uint32_t lod, const void *data, size_t sizeBytes, size_t eoff) {
     Allocation *a = static_cast<Allocation *>(va);
@@ -684,6 +710,18 @@ void rsi_Allocation2DData(Context *rsc, RsAllocation va, uint32_t xoff, uint32_t
     a->data(rsc, xoff, yoff, lod, face, w, h, data, sizeBytes, stride);
 }
 
+void rsi_Allocation2DDataAsync(Context *rsc, RsAllocation va, uint32_t xoff, uint32_t yoff,
+                               uint32_t lod, RsAllocationCubemapFace face,
+                               uint32_t w, uint32_t h, const void *data, size_t sizeBytes,
+                               size_t stride, RsUploadReleaseCallback release,
+                               RsAsyncVoidPtr releaseData) {
+    Allocation *a = static_cast<Allocation *>(va);
+    a->data(rsc, xoff, yoff, lod, face, w, h, data, sizeBytes, stride);
+    if (release) {
+        release(releaseData);
+    }
+}
+
 void rsi_Allocation3DData(Context *rsc, RsAllocation va, uint32_t xoff, uint32_t yoff, uint32_t zoff, uint32_t lod,
                           uint32_t w, uint32_t h, uint32_t d, const void *data, size_t sizeBytes, size_t stride) {
     Allocation *a = static_cast<Allocation *>(va);
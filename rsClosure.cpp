@@ -48,6 +48,11 @@ void rsi_ClosureSetArg(Context* rsc, RsClosure closure, uint32_t index,
     ((Closure*)closure)->setArg(index, (const void*)value, size);
 }
 
+void rsi_ClosureSetOutput(Context* rsc, RsClosure closure, uint32_t index,
+                          RsAllocation output) {
+    ((Closure*)closure)->setOutput(index, (Allocation*)output);
+}
+
 void rsi_ClosureSetGlobal(Context* rsc, RsClosure closure,
                           RsScriptFieldID fieldID, uintptr_t value,
                           size_t size) {
@@ -69,6 +74,10 @@ Closure::Closure(Context* context,
     mParamLength(0) {
     size_t i;
 
+    mOutputs = new Allocation*[RS_KERNEL_INPUT_LIMIT]();
+    mOutputs[0] = returnValue;
+    mNumOutput = returnValue != nullptr ? 1 : 0;
+
     for (i = 0; i < (size_t)numValues && fieldIDs[i] == nullptr; i++);
 
     mNumArg = i;
@@ -113,7 +122,8 @@ Closure::Closure(Context* context, const ScriptInvokeID* invokeID,
                  const void** values, const int* sizes) :
     ObjectBase(context), mContext(context), mFunctionID((IDBase*)invokeID), mIsKernel(false),
     mArgs(nullptr), mNumArg(0),
-    mReturnValue(nullptr), mParamLength(paramLength) {
+    mReturnValue(nullptr), mOutputs(nullptr), mNumOutput(0),
+    mParamLength(paramLength) {
     mParams = new uint8_t[mParamLength];
     memcpy(mParams, params, mParamLength);
     for (size_t i = 0; i < numValues; i++) {
@@ -136,6 +146,7 @@ Closure::~Closure() {
     }
 
     delete[] mArgs;
+    delete[] mOutputs;
     delete[] mParams;
 }
 
@@ -143,6 +154,24 @@ void Closure::setArg(const uint32_t index, const void* value, const size_t size)
     mArgs[index] = value;
 }
 
+void Closure::setOutput(const uint32_t index, Allocation* output) {
+    if (!mIsKernel || index == 0 || index >= RS_KERNEL_INPUT_LIMIT) {
+        mContext->setError(RS_ERROR_BAD_VALUE, "Invalid closure output index");
+        return;
+    }
+    // Outputs are bound in order after the return value, so that outputs
+    // [0, mNumOutput) are never null when the group runs.
+    if (output == nullptr || mNumOutput == 0 || index > mNumOutput) {
+        mContext->setError(RS_ERROR_BAD_VALUE,
+                           "Closure outputs must follow the return value without gaps");
+        return;
+    }
+    mOutputs[index] = output;
+    if (index == mNumOutput) {
+        mNumOutput = index + 1;
+    }
+}
+
 void Closure::setGlobal(const ScriptFieldID* fieldID, const void* value,
                         const int size) {
     mGlobals[fieldID] = make_pair(value, size);
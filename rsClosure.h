@@ -44,6 +44,9 @@ class Closure : public ObjectBase {
     virtual RsA3DClassID getClassId() const { return RS_A3D_CLASS_ID_CLOSURE; }
 
     void setArg(const uint32_t index, const void* value, const size_t size);
+    // Binds output index of a kernel that writes more than one.  Output 0 is
+    // the return value; index may replace a bound output or bind the next.
+    void setOutput(const uint32_t index, Allocation* output);
     void setGlobal(const ScriptFieldID* fieldID, const void* value,
                    const int size);
 
@@ -66,6 +69,10 @@ class Closure : public ObjectBase {
 
     Allocation* mReturnValue;
 
+    // All the outputs of the kernel, starting with mReturnValue.
+    Allocation** mOutputs;
+    size_t mNumOutput;
+
     // All the other closures which this closure depends on for one of its
     // arguments, and the fields which it depends on.
     Map<const Closure*, Map<int, ObjectBaseRef<ScriptFieldID>>*> mArgDeps;
@@ -260,6 +260,7 @@ void * Context::threadProc(void *vrsc) {
     rsc->props.mLogShadersUniforms = getProp("debug.rs.shader.uniforms") != 0;
     rsc->props.mLogVisual = getProp("debug.rs.visual") != 0;
     rsc->props.mDebugMaxThreads = getProp("debug.rs.max-threads");
+    rsc->props.mDebugCpuAffinity = getProp("debug.rs.cpu-affinity");
 
     if (getProp("debug.rs.debug") != 0) {
         ALOGD("Forcing debug context due to debug.rs.debug.");
@@ -450,7 +451,6 @@ Context::Context() {
     mRunning = false;
     mExit = false;
     mPaused = false;
-    mObjHead = nullptr;
     mError = RS_ERROR_NONE;
     mTargetSdkVersion = 14;
     mDPI = 96;
@@ -520,9 +520,18 @@ Context * Context::createContextLite() {
 bool Context::initContext(Device *dev, const RsSurfaceConfig *sc) {
     pthread_mutex_lock(&gInitMutex);
 
-    mIO.init();
+    // The ring transport is only for compute contexts, as graphics contexts
+    // also wait on display events.
+    mIO.init((mHal.flags & RS_CONTEXT_SHARED_MEMORY_FIFO) && !sc,
+             (mHal.flags & RS_CONTEXT_BATCH_COMMANDS) != 0);
     mIO.setTimeoutCallback(printWatchdogInfo, this, 2e9);
 
+    // Graphics scripts run their root() every frame from the start, so they
+    // are always compiled before creation returns.
+    if (sc) {
+        mHal.flags &= ~RS_CONTEXT_BACKGROUND_COMPILE;
+    }
+
     dev->addContext(this);
     mDev = dev;
     if (sc) {
@@ -786,6 +795,10 @@ void rsi_ContextFinish(Context *rsc) {
     rsc->finish();
 }
 
+void rsi_ContextFlush(Context *rsc) {
+    rsc->mIO.coreFlush();
+}
+
 void rsi_ContextBindRootScript(Context *rsc, RsScript vs) {
 #ifndef RS_COMPATIBILITY_LIB
     Script *s = static_cast<Script *>(vs);
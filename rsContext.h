@@ -228,6 +228,7 @@ public:
         bool mLogShadersUniforms;
         bool mLogVisual;
         uint32_t mDebugMaxThreads;
+        uint32_t mDebugCpuAffinity;
     } props;
 
     mutable struct {
@@ -241,7 +242,8 @@ public:
     void dumpDebug() const;
     void setError(RsError e, const char *msg = nullptr) const;
 
-    mutable const ObjectBase * mObjHead;
+    // Every object created in this context.
+    mutable ObjectRegistry mObjects;
 
     uint32_t getDPI() const {return mDPI;}
     void setDPI(uint32_t dpi) {mDPI = dpi;}
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsCopy.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define RS_COPY_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RS_COPY_SSE2
+#endif
+
+namespace android {
+namespace renderscript {
+
+// Copies at least this large use non-temporal stores.  Chosen to be well
+// past the last level cache share of one core.
+static const size_t kStreamThreshold = 4 * 1024 * 1024;
+
+static void copyStream(uint8_t *dst, const uint8_t *src, size_t bytes) {
+#if defined(RS_COPY_SSE2)
+    // Non-temporal stores need an aligned destination.
+    size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+    if (head > bytes) {
+        head = bytes;
+    }
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    bytes -= head;
+
+    while (bytes >= 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + 0));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+        _mm_stream_si128((__m128i *)(dst + 0), a);
+        _mm_stream_si128((__m128i *)(dst + 16), b);
+        _mm_stream_si128((__m128i *)(dst + 32), c);
+        _mm_stream_si128((__m128i *)(dst + 48), d);
+        src += 64;
+        dst += 64;
+        bytes -= 64;
+    }
+    memcpy(dst, src, bytes);
+
+    // Make the streamed data visible before anyone is told about it.
+    _mm_sfence();
+#else
+    memcpy(dst, src, bytes);
+#endif
+}
+
+void rsCopyBytes(void *dst, const void *src, size_t bytes) {
+    if (bytes >= kStreamThreshold) {
+        copyStream((uint8_t *)dst, (const uint8_t *)src, bytes);
+    } else {
+        memcpy(dst, src, bytes);
+    }
+}
+
+void rsCopyLines(void *dst, size_t dstStride, const void *src, size_t srcStride,
+                 size_t lineSize, size_t lines) {
+    if (!lines || !lineSize) {
+        return;
+    }
+    if (dstStride == lineSize && srcStride == lineSize) {
+        rsCopyBytes(dst, src, lineSize * lines);
+        return;
+    }
+
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    bool stream = lineSize * lines >= kStreamThreshold;
+    for (size_t ct = 0; ct < lines; ct++) {
+        if (stream) {
+            copyStream(d, s, lineSize);
+        } else {
+            memcpy(d, s, lineSize);
+        }
+        d += dstStride;
+        s += srcStride;
+    }
+}
+
+// Element at a time.  The copy size is a constant, so the compiler turns
+// each memcpy into a few moves.
+template <size_t C>
+static void copyVec3Scalar(uint8_t *dst, const uint8_t *src, size_t count,
+                           bool dstPadded) {
+    if (dstPadded) {
+        for (size_t ct = 0; ct < count; ct++) {
+            memcpy(dst, src, 3 * C);
+            memset(dst + 3 * C, 0, C);
+            src += 3 * C;
+            dst += 4 * C;
+        }
+    } else {
+        for (size_t ct = 0; ct < count; ct++) {
+            memcpy(dst, src, 3 * C);
+            src += 4 * C;
+            dst += 3 * C;
+        }
+    }
+}
+
+#if defined(RS_COPY_NEON)
+
+// The structure loads and stores do the whole job: vld4 splits padded
+// elements into one register per component and vst3 interleaves the first
+// three again, or the other way around.
+static size_t copyVec3Neon(uint8_t *dst, const uint8_t *src, size_t count,
+                           size_t componentSize, bool dstPadded) {
+    size_t done = 0;
+    switch (componentSize) {
+    case 1:
+        for (; done + 16 <= count; done += 16) {
+            if (dstPadded) {
+                uint8x16x3_t v = vld3q_u8(src + done * 3);
+                uint8x16x4_t o = {{v.val[0], v.val[1], v.val[2], vdupq_n_u8(0)}};
+                vst4q_u8(dst + done * 4, o);
+            } else {
+                uint8x16x4_t v = vld4q_u8(src + done * 4);
+                uint8x16x3_t o = {{v.val[0], v.val[1], v.val[2]}};
+                vst3q_u8(dst + done * 3, o);
+            }
+        }
+        break;
+    case 2:
+        for (; done + 8 <= count; done += 8) {
+            if (dstPadded) {
+                uint16x8x3_t v = vld3q_u16((const uint16_t *)(src + done * 6));
+                uint16x8x4_t o = {{v.val[0], v.val[1], v.val[2], vdupq_n_u16(0)}};
+                vst4q_u16((uint16_t *)(dst + done * 8), o);
+            } else {
+                uint16x8x4_t v = vld4q_u16((const uint16_t *)(src + done * 8));
+                uint16x8x3_t o = {{v.val[0], v.val[1], v.val[2]}};
+                vst3q_u16((uint16_t *)(dst + done * 6), o);
+            }
+        }
+        break;
+    case 4:
+        for (; done + 4 <= count; done += 4) {
+            if (dstPadded) {
+                uint32x4x3_t v = vld3q_u32((const uint32_t *)(src + done * 12));
+                uint32x4x4_t o = {{v.val[0], v.val[1], v.val[2], vdupq_n_u32(0)}};
+                vst4q_u32((uint32_t *)(dst + done * 16), o);
+            } else {
+                uint32x4x4_t v = vld4q_u32((const uint32_t *)(src + done * 16));
+                uint32x4x3_t o = {{v.val[0], v.val[1], v.val[2]}};
+                vst3q_u32((uint32_t *)(dst + done * 12), o);
+            }
+        }
+        break;
+    }
+    return done;
+}
+
+#elif defined(RS_COPY_SSE2)
+
+// Four float3/int3 elements at a time: 64 padded bytes against 48 packed
+// ones, moved with byte shifts between the lanes.
+static size_t copyVec3Sse2(uint8_t *dst, const uint8_t *src, size_t count,
+                           size_t componentSize, bool dstPadded) {
+    size_t done = 0;
+    if (componentSize != 4) {
+        return done;
+    }
+
+    const __m128i lanes012 = _mm_set_epi32(0, -1, -1, -1);
+    const __m128i lane0 = _mm_set_epi32(0, 0, 0, -1);
+    for (; done + 4 <= count; done += 4) {
+        if (dstPadded) {
+            // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+            const uint8_t *s = src + done * 12;
+            __m128i i0 = _mm_loadu_si128((const __m128i *)(s + 0));
+            __m128i i1 = _mm_loadu_si128((const __m128i *)(s + 16));
+            __m128i i2 = _mm_loadu_si128((const __m128i *)(s + 32));
+
+            __m128i a = _mm_and_si128(i0, lanes012);
+            __m128i b = _mm_and_si128(_mm_or_si128(_mm_srli_si128(i0, 12),
+                                                   _mm_slli_si128(i1, 4)), lanes012);
+            __m128i c = _mm_and_si128(_mm_or_si128(_mm_srli_si128(i1, 8),
+                                                   _mm_slli_si128(i2, 8)), lanes012);
+            __m128i d = _mm_srli_si128(i2, 4);
+
+            uint8_t *o = dst + done * 16;
+            _mm_storeu_si128((__m128i *)(o + 0), a);
+            _mm_storeu_si128((__m128i *)(o + 16), b);
+            _mm_storeu_si128((__m128i *)(o + 32), c);
+            _mm_storeu_si128((__m128i *)(o + 48), d);
+        } else {
+            const uint8_t *s = src + done * 16;
+            __m128i a = _mm_loadu_si128((const __m128i *)(s + 0));
+            __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+            __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+            __m128i d = _mm_loadu_si128((const __m128i *)(s + 48));
+
+            __m128i o0 = _mm_or_si128(_mm_and_si128(a, lanes012), _mm_slli_si128(b, 12));
+            __m128i o1 = _mm_unpacklo_epi64(_mm_srli_si128(b, 4), c);
+            __m128i o2 = _mm_or_si128(_mm_and_si128(_mm_srli_si128(c, 8), lane0),
+                                      _mm_slli_si128(d, 4));
+
+            uint8_t *o = dst + done * 12;
+            _mm_storeu_si128((__m128i *)(o + 0), o0);
+            _mm_storeu_si128((__m128i *)(o + 16), o1);
+            _mm_storeu_si128((__m128i *)(o + 32), o2);
+        }
+    }
+    return done;
+}
+
+#endif
+
+void rsCopyVec3(void *dst, const void *src, size_t count, size_t componentSize,
+                bool dstPadded) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+
+    size_t done = 0;
+#if defined(RS_COPY_NEON)
+    done = copyVec3Neon(d, s, count, componentSize, dstPadded);
+#elif defined(RS_COPY_SSE2)
+    done = copyVec3Sse2(d, s, count, componentSize, dstPadded);
+#endif
+    d += done * componentSize * (dstPadded ? 4 : 3);
+    s += done * componentSize * (dstPadded ? 3 : 4);
+    count -= done;
+
+    switch (componentSize) {
+    case 1: copyVec3Scalar<1>(d, s, count, dstPadded); break;
+    case 2: copyVec3Scalar<2>(d, s, count, dstPadded); break;
+    case 4: copyVec3Scalar<4>(d, s, count, dstPadded); break;
+    case 8: copyVec3Scalar<8>(d, s, count, dstPadded); break;
+    default: {
+        size_t packed = 3 * componentSize;
+        size_t padded = 4 * componentSize;
+        for (size_t ct = 0; ct < count; ct++) {
+            memcpy(d, s, packed);
+            if (dstPadded) {
+                memset(d + packed, 0, componentSize);
+            }
+            d += dstPadded ? padded : packed;
+            s += dstPadded ? packed : padded;
+        }
+        break;
+    }
+    }
+}
+
+}
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RS_COPY_H
+#define ANDROID_RS_COPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ---------------------------------------------------------------------------
+namespace android {
+namespace renderscript {
+
+// Copies of Allocation data.  Large copies bypass the caches on the way out
+// where the CPU has non-temporal stores, since the data is rarely read again
+// right away and would otherwise evict everything else.
+
+// Copy bytes from src to dst.  The ranges must not overlap.
+void rsCopyBytes(void *dst, const void *src, size_t bytes);
+
+// Copy lines of lineSize bytes between two strided buffers.  When both
+// sides have no gap between lines, this is a single copy.
+void rsCopyLines(void *dst, size_t dstStride, const void *src, size_t srcStride,
+                 size_t lineSize, size_t lines);
+
+// Convert count 3-component vectors between their padded layout, with a
+// fourth component of padding, and the packed one.  componentSize is the
+// size of one component in bytes.  Padding written to dst is zero.
+void rsCopyVec3(void *dst, const void *src, size_t count, size_t componentSize,
+                bool dstPadded);
+
+}
+}
+
+#endif
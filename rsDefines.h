@@ -29,6 +29,10 @@ extern "C" {
 
 typedef void * RsAsyncVoidPtr;
 
+// Called on the RenderScript thread once an asynchronous upload no longer
+// needs its source data.
+typedef void (*RsUploadReleaseCallback)(void *usrData);
+
 typedef void * RsAdapter1D;
 typedef void * RsAdapter2D;
 typedef void * RsAllocation;
@@ -253,7 +257,29 @@ enum RsContextFlags {
     RS_CONTEXT_SYNCHRONOUS      = 0x0001,
     RS_CONTEXT_LOW_LATENCY      = 0x0002,
     RS_CONTEXT_LOW_POWER        = 0x0004,
-    RS_CONTEXT_WAIT_FOR_ATTACH  = 0x0008
+    RS_CONTEXT_WAIT_FOR_ATTACH  = 0x0008,
+    RS_CONTEXT_SHARED_MEMORY_FIFO = 0x0010,
+    RS_CONTEXT_BATCH_COMMANDS   = 0x0020,
+    RS_CONTEXT_BACKGROUND_COMPILE = 0x0040
+};
+
+// Algorithm of the blur intrinsic.  The default is a true Gaussian up to a
+// radius of 25 and RS_BLUR_MODE_BOX past it.  RS_BLUR_MODE_BOX approximates
+// the Gaussian with three box filters, at a cost that does not depend on
+// the radius.
+enum RsBlurMode {
+    RS_BLUR_MODE_DEFAULT = 0,
+    RS_BLUR_MODE_BOX = 1
+};
+
+// Filter of the resize intrinsic.  RS_RESIZE_MODE_AREA averages the input
+// pixels under each output pixel, RS_RESIZE_MODE_LANCZOS3 applies a Lanczos
+// window of three lobes widened by the downscale factor.  Both avoid the
+// aliasing of the bicubic filter when shrinking by large factors.
+enum RsResizeMode {
+    RS_RESIZE_MODE_BICUBIC = 0,
+    RS_RESIZE_MODE_AREA = 1,
+    RS_RESIZE_MODE_LANCZOS3 = 2
 };
 
 enum RsBlasTranspose {
@@ -483,6 +509,74 @@ static const char kRsGlobalNames[] = ".rs.global_names";
 static const char kRsGlobalAddresses[] = ".rs.global_addresses";
 static const char kRsGlobalSizes[] = ".rs.global_sizes";
 static const char kRsGlobalProperties[] = ".rs.global_properties";
+static const char kRsExportTable[] = ".rs.export_table";
+
+// Binary form of the export information in .rs.info.  The driver uses it in
+// place, without parsing and without a symbol lookup per export.  Symbol
+// addresses are stored as byte offsets from the start of the table, which
+// are link-time constants within one shared object; 0 marks a missing
+// symbol.  Names are offsets into the string block.  Version 2 appends the
+// reduction kernels; the driver still accepts version 1 tables.
+//
+// This header defines the format and the driver is its only reader.  The
+// compiler has to emit the table next to .rs.info, from bcc's
+// RSEmbedInfoPass, which does not do so yet.  Until it does, shared objects
+// carry only .rs.info and the driver parses that instead.
+#define RS_EXPORT_TABLE_MAGIC   0x54585352  // "RSXT"
+#define RS_EXPORT_TABLE_VERSION 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t varCount;
+    uint32_t funcCount;
+    uint32_t forEachCount;
+    uint32_t pragmaCount;
+    uint32_t isThreadable;
+    uint32_t checksum;
+    // Offsets of the arrays below from the start of the table.
+    uint32_t varsOffset;
+    uint32_t funcsOffset;
+    uint32_t forEachsOffset;
+    uint32_t pragmasOffset;
+    uint32_t stringsOffset;
+    uint32_t reserved;
+    // Version 2.
+    uint32_t reduceCount;
+    uint32_t reducesOffset;
+} RsExportTable;
+
+typedef struct {
+    int64_t address;
+    uint32_t name;
+    uint32_t isObject;
+} RsExportVar;
+
+typedef struct {
+    int64_t address;
+    uint32_t name;
+    uint32_t reserved;
+} RsExportFunc;
+
+typedef struct {
+    int64_t address;     // Of the expanded kernel.
+    uint32_t name;
+    uint32_t signature;
+} RsExportForEach;
+
+typedef struct {
+    uint32_t key;
+    uint32_t value;
+} RsExportPragma;
+
+typedef struct {
+    int64_t initializer;    // 0 if the accumulator starts from zeroes.
+    int64_t accumulator;    // Of the expanded accumulator.
+    int64_t combiner;
+    int64_t outConverter;   // 0 if the accumulator is the result.
+    uint32_t name;          // Of the accumulator.
+    uint32_t accumulatorSize;
+} RsExportReduce;
 
 static inline uint32_t getGlobalRsType(uint32_t properties) {
     return properties & RS_GLOBAL_TYPE;
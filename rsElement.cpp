@@ -27,6 +27,7 @@ Element::Element(Context *rsc) : ObjectBase(rsc) {
     mFields = nullptr;
     mFieldCount = 0;
     mHasReference = false;
+    mInternHash = 0;
     memset(&mHal, 0, sizeof(mHal));
 }
 
@@ -42,12 +43,7 @@ void Element::operator delete(void* ptr) {
 }
 
 void Element::preDestroy() const {
-    for (uint32_t ct = 0; ct < mRSC->mStateElement.mElements.size(); ct++) {
-        if (mRSC->mStateElement.mElements[ct] == this) {
-            mRSC->mStateElement.mElements.removeAt(ct);
-            break;
-        }
-    }
+    mRSC->mStateElement.mElements.remove(mInternHash, this);
 }
 
 void Element::clear() {
@@ -229,21 +225,20 @@ ObjectBaseRef<const Element> Element::createRef(Context *rsc, RsDataType dt, RsD
                                 bool isNorm, uint32_t vecSize) {
     ObjectBaseRef<const Element> returnRef;
     // Look for an existing match.
-    ObjectBase::asyncLock();
-    for (uint32_t ct=0; ct < rsc->mStateElement.mElements.size(); ct++) {
-        const Element *ee = rsc->mStateElement.mElements[ct];
-        if (!ee->getFieldCount() &&
-            (ee->getComponent().getType() == dt) &&
-            (ee->getComponent().getKind() == dk) &&
-            (ee->getComponent().getIsNormalized() == isNorm) &&
-            (ee->getComponent().getVectorSize() == vecSize)) {
-            // Match
-            returnRef.set(ee);
-            ObjectBase::asyncUnlock();
-            return ee;
-        }
+    size_t hash = rsHashCombine(0, dt);
+    hash = rsHashCombine(hash, dk);
+    hash = rsHashCombine(hash, isNorm ? 1 : 0);
+    hash = rsHashCombine(hash, vecSize);
+    auto match = [dt, dk, isNorm, vecSize](const Element *ee) {
+        return !ee->getFieldCount() &&
+               (ee->getComponent().getType() == dt) &&
+               (ee->getComponent().getKind() == dk) &&
+               (ee->getComponent().getIsNormalized() == isNorm) &&
+               (ee->getComponent().getVectorSize() == vecSize);
+    };
+    if (rsc->mStateElement.mElements.find(hash, match, &returnRef)) {
+        return returnRef;
     }
-    ObjectBase::asyncUnlock();
 
     // Element objects must use allocator specified by the driver
     void* allocMem = rsc->mHal.funcs.allocRuntimeMem(sizeof(Element), 0);
@@ -262,10 +257,8 @@ ObjectBaseRef<const Element> Element::createRef(Context *rsc, RsDataType dt, RsD
     ALOGE("pointer for element.drv: %p", &e->mHal.drv);
 #endif
 
-
-    ObjectBase::asyncLock();
-    rsc->mStateElement.mElements.push(e);
-    ObjectBase::asyncUnlock();
+    e->mInternHash = hash;
+    rsc->mStateElement.mElements.add(hash, e);
 
     return returnRef;
 }
@@ -275,39 +268,41 @@ ObjectBaseRef<const Element> Element::createRef(Context *rsc, size_t count, cons
 
     ObjectBaseRef<const Element> returnRef;
     // Look for an existing match.
-    ObjectBase::asyncLock();
-    for (uint32_t ct=0; ct < rsc->mStateElement.mElements.size(); ct++) {
-        const Element *ee = rsc->mStateElement.mElements[ct];
-        if (ee->getFieldCount() == count) {
-            bool match = true;
-            for (uint32_t i=0; i < count; i++) {
-                size_t len;
-                uint32_t asize = 1;
-                if (lengths) {
-                    len = lengths[i];
-                } else {
-                    len = strlen(nin[i]);
-                }
-                if (asin) {
-                    asize = asin[i];
-                }
-
-                if ((ee->mFields[i].e.get() != ein[i]) ||
-                    (strlen(ee->mFields[i].name) != len) ||
-                    strcmp(ee->mFields[i].name, nin[i]) ||
-                    (ee->mFields[i].arraySize != asize)) {
-                    match = false;
-                    break;
-                }
+    size_t hash = rsHashCombine(0, count);
+    for (uint32_t i=0; i < count; i++) {
+        size_t len = lengths ? lengths[i] : strlen(nin[i]);
+        hash = rsHashCombine(hash, (size_t)ein[i]);
+        hash = rsHashString(hash, nin[i], len);
+        hash = rsHashCombine(hash, asin ? asin[i] : 1);
+    }
+    auto match = [count, ein, nin, lengths, asin](const Element *ee) {
+        if (ee->getFieldCount() != count) {
+            return false;
+        }
+        for (uint32_t i=0; i < count; i++) {
+            size_t len;
+            uint32_t asize = 1;
+            if (lengths) {
+                len = lengths[i];
+            } else {
+                len = strlen(nin[i]);
             }
-            if (match) {
-                returnRef.set(ee);
-                ObjectBase::asyncUnlock();
-                return returnRef;
+            if (asin) {
+                asize = asin[i];
+            }
+
+            if ((ee->mFields[i].e.get() != ein[i]) ||
+                (strlen(ee->mFields[i].name) != len) ||
+                strncmp(ee->mFields[i].name, nin[i], len) ||
+                (ee->mFields[i].arraySize != asize)) {
+                return false;
             }
         }
+        return true;
+    };
+    if (rsc->mStateElement.mElements.find(hash, match, &returnRef)) {
+        return returnRef;
     }
-    ObjectBase::asyncUnlock();
 
     // Element objects must use allocator specified by the driver
     void* allocMem = rsc->mHal.funcs.allocRuntimeMem(sizeof(Element), 0);
@@ -338,9 +333,8 @@ ObjectBaseRef<const Element> Element::createRef(Context *rsc, size_t count, cons
     }
     e->compute();
 
-    ObjectBase::asyncLock();
-    rsc->mStateElement.mElements.push(e);
-    ObjectBase::asyncUnlock();
+    e->mInternHash = hash;
+    rsc->mStateElement.mElements.add(hash, e);
 
     return returnRef;
 }
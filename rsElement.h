@@ -21,6 +21,7 @@
 #include "rsUtils.h"
 #include "rsInternalDefines.h"
 #include "rsObjectBase.h"
+#include "rsInternTable.h"
 
 // ---------------------------------------------------------------------------
 namespace android {
@@ -161,6 +162,9 @@ protected:
     void compute();
 
     virtual void preDestroy() const;
+
+    // Key of this Element in ElementState::mElements.
+    size_t mInternHash;
 };
 
 
@@ -169,8 +173,8 @@ public:
     ElementState();
     ~ElementState();
 
-    // Cache of all existing elements.
-    Vector<Element *> mElements;
+    // Cache of all existing elements, keyed on their components or fields.
+    InternTable<Element> mElements;
 };
 
 
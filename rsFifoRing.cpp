@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rsFifoRing.h"
+
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+using namespace android;
+using namespace android::renderscript;
+
+// Number of times a side polls the ring before going to sleep.  Commands
+// usually arrive in bursts, so a short spin avoids most futex round trips.
+static const int kSpinCount = 1000;
+
+static size_t roundUpPow2(size_t v) {
+    size_t p = 64;
+    while (p < v) {
+        p <<= 1;
+    }
+    return p;
+}
+
+static inline uint32_t loadAcquire(volatile uint32_t *word) {
+    return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+}
+
+static inline void storeRelease(volatile uint32_t *word, uint32_t v) {
+    __atomic_store_n(word, v, __ATOMIC_RELEASE);
+}
+
+FifoRing::FifoRing() {
+    memset(&mToReader, 0, sizeof(mToReader));
+    memset(&mToWriter, 0, sizeof(mToWriter));
+    mMapping = nullptr;
+    mMappingSize = 0;
+    mShutdown = false;
+}
+
+FifoRing::~FifoRing() {
+    if (mMapping) {
+        munmap(mMapping, mMappingSize);
+    }
+}
+
+bool FifoRing::init(size_t dataSize, size_t returnSize) {
+    dataSize = roundUpPow2(dataSize);
+    returnSize = roundUpPow2(returnSize);
+
+    mMappingSize = 2 * sizeof(RingControl) + dataSize + returnSize;
+    void *m = mmap(nullptr, mMappingSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) {
+        ALOGE("FifoRing: failed to map %zu bytes", mMappingSize);
+        mMappingSize = 0;
+        return false;
+    }
+    mMapping = m;
+
+    // The mapping is zero-filled, which is the empty state of both rings.
+    uint8_t *p = (uint8_t *)m;
+    mToReader.mCtl = (RingControl *)p;
+    mToWriter.mCtl = (RingControl *)(p + sizeof(RingControl));
+    p += 2 * sizeof(RingControl);
+    mToReader.mData = p;
+    mToReader.mMask = dataSize - 1;
+    mToWriter.mData = p + dataSize;
+    mToWriter.mMask = returnSize - 1;
+    return true;
+}
+
+void FifoRing::shutdown() {
+    mShutdown = true;
+    __sync_synchronize();
+    RingControl *ctl[2] = {mToReader.mCtl, mToWriter.mCtl};
+    for (int ct = 0; ct < 2; ct++) {
+        if (ctl[ct]) {
+            syscall(__NR_futex, &ctl[ct]->mHead, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+            syscall(__NR_futex, &ctl[ct]->mTail, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+        }
+    }
+}
+
+// Blocks until *word no longer holds value.  Returns false on shutdown.
+bool FifoRing::waitFor(volatile uint32_t *word, uint32_t value, volatile uint32_t *waiting) {
+    for (int ct = 0; ct < kSpinCount; ct++) {
+        if (loadAcquire(word) != value || mShutdown) {
+            return !mShutdown;
+        }
+    }
+
+    while (loadAcquire(word) == value && !mShutdown) {
+        // Announce the sleep before checking the word a last time.  The other
+        // side publishes the word before checking the flag, so one of the two
+        // always sees the other.
+        *waiting = 1;
+        __sync_synchronize();
+        if (*word == value && !mShutdown) {
+            syscall(__NR_futex, word, FUTEX_WAIT, value, nullptr, nullptr, 0);
+        }
+        *waiting = 0;
+    }
+    return !mShutdown;
+}
+
+void FifoRing::wake(volatile uint32_t *word, volatile uint32_t *waiting) {
+    __sync_synchronize();
+    if (*waiting) {
+        syscall(__NR_futex, word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+}
+
+bool FifoRing::writeRing(Ring *r, const uint8_t *data, size_t bytes, bool waitForSpace) {
+    RingControl *ctl = r->mCtl;
+    const uint32_t capacity = r->mMask + 1;
+
+    if (!waitForSpace && bytes > capacity - (ctl->mHead - loadAcquire(&ctl->mTail))) {
+        return false;
+    }
+
+    while (bytes) {
+        uint32_t head = ctl->mHead;
+        uint32_t tail = loadAcquire(&ctl->mTail);
+        uint32_t space = capacity - (head - tail);
+        if (!space) {
+            if (!waitFor(&ctl->mTail, tail, &ctl->mWriterWaiting)) {
+                return false;
+            }
+            continue;
+        }
+
+        uint32_t len = bytes < space ? bytes : space;
+        uint32_t offset = head & r->mMask;
+        uint32_t first = rsMin(len, capacity - offset);
+        memcpy(r->mData + offset, data, first);
+        memcpy(r->mData, data + first, len - first);
+
+        storeRelease(&ctl->mHead, head + len);
+        wake(&ctl->mHead, &ctl->mReaderWaiting);
+        data += len;
+        bytes -= len;
+    }
+    return true;
+}
+
+size_t FifoRing::readRing(Ring *r, uint8_t *data, size_t bytes) {
+    RingControl *ctl = r->mCtl;
+    const uint32_t capacity = r->mMask + 1;
+    size_t total = 0;
+
+    while (total < bytes) {
+        uint32_t tail = ctl->mTail;
+        uint32_t head = loadAcquire(&ctl->mHead);
+        uint32_t avail = head - tail;
+        if (!avail) {
+            if (!waitFor(&ctl->mHead, head, &ctl->mReaderWaiting)) {
+                break;
+            }
+            continue;
+        }
+
+        size_t want = bytes - total;
+        uint32_t len = want < avail ? want : avail;
+        uint32_t offset = tail & r->mMask;
+        uint32_t first = rsMin(len, capacity - offset);
+        memcpy(data + total, r->mData + offset, first);
+        memcpy(data + total + first, r->mData, len - first);
+
+        storeRelease(&ctl->mTail, tail + len);
+        wake(&ctl->mTail, &ctl->mWriterWaiting);
+        total += len;
+    }
+    return total;
+}
+
+bool FifoRing::writeAsync(const void *data, size_t bytes, bool waitForSpace) {
+    if (bytes == 0) {
+        return true;
+    }
+    return writeRing(&mToReader, (const uint8_t *)data, bytes, waitForSpace);
+}
+
+void FifoRing::writeWaitReturn(void *retData, size_t retBytes) {
+    if (mShutdown) {
+        return;
+    }
+    size_t ret = readRing(&mToWriter, (uint8_t *)retData, retBytes);
+    rsAssert(ret == retBytes || mShutdown);
+}
+
+size_t FifoRing::read(void *data, size_t bytes) {
+    if (mShutdown) {
+        return 0;
+    }
+    size_t ret = readRing(&mToReader, (uint8_t *)data, bytes);
+    if (mShutdown) {
+        ret = 0;
+    }
+    return ret;
+}
+
+bool FifoRing::isEmpty() {
+    RingControl *ctl = mToReader.mCtl;
+    return loadAcquire(&ctl->mHead) == ctl->mTail;
+}
+
+void FifoRing::readReturn(const void *data, size_t bytes) {
+    writeRing(&mToWriter, (const uint8_t *)data, bytes, true);
+}
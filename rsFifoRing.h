@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RS_FIFO_RING_H
+#define ANDROID_RS_FIFO_RING_H
+
+
+#include "rsFifo.h"
+
+namespace android {
+namespace renderscript {
+
+
+// A drop-in replacement for FifoSocket that moves bytes through a ring in
+// shared memory instead of a socketpair.  There is exactly one writer and
+// one reader.  Neither side makes a system call while the ring has data or
+// space; a side only sleeps on a futex when it has to wait, and the other
+// side only wakes it when it is known to be sleeping.
+//
+// Like the socket, the ring is a byte stream: writes and reads of any size
+// are split into chunks that fit.  Return values travel back through a
+// second, smaller ring.
+class FifoRing {
+public:
+    FifoRing();
+    virtual ~FifoRing();
+
+    bool init(size_t dataSize = 256 * 1024, size_t returnSize = 4 * 1024);
+    void shutdown();
+
+    bool writeAsync(const void *data, size_t bytes, bool waitForSpace = true);
+    void writeWaitReturn(void *ret, size_t retSize);
+    size_t read(void *data, size_t bytes);
+    void readReturn(const void *data, size_t bytes);
+    bool isEmpty();
+
+protected:
+    // Control words of one direction.  The producer and consumer halves sit
+    // on separate cache lines so that the two threads do not share one.
+    struct RingControl {
+        volatile uint32_t mHead;          // Bytes ever written.
+        volatile uint32_t mReaderWaiting;
+        uint8_t mPad0[56];
+        volatile uint32_t mTail;          // Bytes ever read.
+        volatile uint32_t mWriterWaiting;
+        uint8_t mPad1[56];
+    };
+
+    struct Ring {
+        RingControl *mCtl;
+        uint8_t *mData;
+        uint32_t mMask;
+    };
+
+    bool writeRing(Ring *r, const uint8_t *data, size_t bytes, bool waitForSpace);
+    size_t readRing(Ring *r, uint8_t *data, size_t bytes);
+    bool waitFor(volatile uint32_t *word, uint32_t value, volatile uint32_t *waiting);
+    static void wake(volatile uint32_t *word, volatile uint32_t *waiting);
+
+    Ring mToReader;
+    Ring mToWriter;
+    void *mMapping;
+    size_t mMappingSize;
+    volatile bool mShutdown;
+};
+
+}
+}
+
+#endif
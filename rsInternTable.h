@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RS_INTERN_TABLE_H
+#define ANDROID_RS_INTERN_TABLE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+
+#include "rsObjectBase.h"
+
+// ---------------------------------------------------------------------------
+namespace android {
+namespace renderscript {
+
+// Mixes value into the running hash h.
+static inline size_t rsHashCombine(size_t h, size_t value) {
+    return h ^ (value + 0x9e3779b9 + (h << 6) + (h >> 2));
+}
+
+static inline size_t rsHashString(size_t h, const char *s, size_t len) {
+    for (size_t ct = 0; ct < len; ct++) {
+        h = rsHashCombine(h, (unsigned char)s[ct]);
+    }
+    return h;
+}
+
+// Objects of class T that are shared between everyone who asks for the same
+// description, such as Types and Elements.  Entries are plain pointers keyed
+// on a hash of the description; the objects remove themselves in preDestroy.
+//
+// The table is split into shards with their own lock, so creating objects
+// with different descriptions does not contend.  Lock order is the object
+// lock (ObjectBase::asyncLock) before a shard lock.
+template <class T>
+class InternTable {
+public:
+    InternTable() {
+        for (size_t ct = 0; ct < kShardCount; ct++) {
+            pthread_mutex_init(&mShards[ct].lock, nullptr);
+        }
+    }
+
+    ~InternTable() {
+        for (size_t ct = 0; ct < kShardCount; ct++) {
+            pthread_mutex_destroy(&mShards[ct].lock);
+        }
+    }
+
+    // Points ref at an entry with the given hash for which match returns
+    // true.  Returns false if there is none.
+    template <class R, class Match>
+    bool find(size_t hash, Match match, ObjectBaseRef<R> *ref) {
+        Shard &s = mShards[hash % kShardCount];
+        pthread_mutex_lock(&s.lock);
+        auto range = s.entries.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            T *obj = it->second;
+            // An object losing its last reference stays listed until its
+            // preDestroy, and must not be handed out again in between.
+            if (match(obj) && obj->tryIncSysRef()) {
+                ref->set(obj);
+                obj->decSysRef();
+                pthread_mutex_unlock(&s.lock);
+                return true;
+            }
+        }
+        pthread_mutex_unlock(&s.lock);
+        return false;
+    }
+
+    void add(size_t hash, T *obj) {
+        Shard &s = mShards[hash % kShardCount];
+        pthread_mutex_lock(&s.lock);
+        s.entries.insert(std::make_pair(hash, obj));
+        pthread_mutex_unlock(&s.lock);
+    }
+
+    void remove(size_t hash, const T *obj) {
+        Shard &s = mShards[hash % kShardCount];
+        pthread_mutex_lock(&s.lock);
+        auto range = s.entries.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == obj) {
+                s.entries.erase(it);
+                break;
+            }
+        }
+        pthread_mutex_unlock(&s.lock);
+    }
+
+    size_t size() {
+        size_t count = 0;
+        for (size_t ct = 0; ct < kShardCount; ct++) {
+            pthread_mutex_lock(&mShards[ct].lock);
+            count += mShards[ct].entries.size();
+            pthread_mutex_unlock(&mShards[ct].lock);
+        }
+        return count;
+    }
+
+private:
+    static const size_t kShardCount = 16;
+
+    struct Shard {
+        pthread_mutex_t lock;
+        std::unordered_multimap<size_t, T *> entries;
+    };
+    Shard mShards[kShardCount];
+
+    InternTable(const InternTable &);
+    InternTable & operator= (const InternTable &);
+};
+
+}
+}
+
+#endif
@@ -21,8 +21,6 @@
 using namespace android;
 using namespace android::renderscript;
 
-pthread_mutex_t ObjectBase::gObjectInitMutex = PTHREAD_MUTEX_INITIALIZER;
-
 ObjectBase::ObjectBase(Context *rsc) {
     mUserRefCount = 0;
     mSysRefCount = 0;
@@ -59,15 +57,11 @@ ObjectBase::~ObjectBase() {
 
     free(const_cast<char *>(mName));
 
-    if (mPrev || mNext) {
-        // While the normal practice is to call remove before we call
-        // delete.  Its possible for objects without a re-use list
-        // for avoiding duplication to be created on the stack.  In those
-        // cases we need to remove ourself here.
-        asyncLock();
-        remove();
-        asyncUnlock();
-    }
+    // While the normal practice is to call remove before we call
+    // delete.  Its possible for objects without a re-use list
+    // for avoiding duplication to be created on the stack.  In those
+    // cases we need to remove ourself here.
+    remove();
 
     rsAssert(!mUserRefCount);
     rsAssert(!mSysRefCount);
@@ -97,6 +91,34 @@ void ObjectBase::incSysRef() const {
     }
 }
 
+bool ObjectBase::tryIncSysRef() const {
+    for (;;) {
+        int32_t sys = mSysRefCount;
+        if (sys > 0) {
+            if (__sync_bool_compare_and_swap(&mSysRefCount, sys, sys + 1)) {
+                break;
+            }
+            continue;
+        }
+
+        int32_t user = mUserRefCount;
+        if (user <= 0) {
+            return false;
+        }
+        // Only user references are left.  Hold an extra one while adding the
+        // system reference so the total never touches zero.
+        if (__sync_bool_compare_and_swap(&mUserRefCount, user, user + 1)) {
+            __sync_fetch_and_add(&mSysRefCount, 1);
+            __sync_fetch_and_sub(&mUserRefCount, 1);
+            break;
+        }
+    }
+    if (gDebugReferences) {
+        ALOGV("ObjectBase %p tryIncS ref %i, %i", this, mUserRefCount, mSysRefCount);
+    }
+    return true;
+}
+
 void ObjectBase::preDestroy() const {
 }
 
@@ -109,12 +131,12 @@ bool ObjectBase::checkDelete(const ObjectBase *ref) {
         return false;
     }
 
-    asyncLock();
+    asyncLock(ref->mRSC);
     // This lock protects us against the non-RS threads changing
     // the ref counts.  At this point we should be the only thread
     // working on them.
     if (ref->mUserRefCount || ref->mSysRefCount) {
-        asyncUnlock();
+        asyncUnlock(ref->mRSC);
         return false;
     }
 
@@ -122,7 +144,7 @@ bool ObjectBase::checkDelete(const ObjectBase *ref) {
     // At this point we can unlock because there should be no possible way
     // for another thread to reference this object.
     ref->preDestroy();
-    asyncUnlock();
+    asyncUnlock(ref->mRSC);
     delete ref;
     return true;
 }
@@ -184,26 +206,18 @@ void ObjectBase::setName(const char *name, uint32_t len) {
     mName = c;
 }
 
-void ObjectBase::asyncLock() {
-    pthread_mutex_lock(&gObjectInitMutex);
+void ObjectBase::asyncLock(const Context *rsc) {
+    rsc->mObjects.lockLifetimes();
 }
 
-void ObjectBase::asyncUnlock() {
-    pthread_mutex_unlock(&gObjectInitMutex);
+void ObjectBase::asyncUnlock(const Context *rsc) {
+    rsc->mObjects.unlockLifetimes();
 }
 
 void ObjectBase::add() const {
-    asyncLock();
-
     rsAssert(!mNext);
     rsAssert(!mPrev);
-    mNext = mRSC->mObjHead;
-    if (mRSC->mObjHead) {
-        mRSC->mObjHead->mPrev = this;
-    }
-    mRSC->mObjHead = this;
-
-    asyncUnlock();
+    mRSC->mObjects.add(this);
 }
 
 void ObjectBase::remove() const {
@@ -212,18 +226,7 @@ void ObjectBase::remove() const {
         rsAssert(!mNext);
         return;
     }
-
-    if (mRSC->mObjHead == this) {
-        mRSC->mObjHead = mNext;
-    }
-    if (mPrev) {
-        mPrev->mNext = mNext;
-    }
-    if (mNext) {
-        mNext->mPrev = mPrev;
-    }
-    mPrev = nullptr;
-    mNext = nullptr;
+    mRSC->mObjects.remove(this);
 }
 
 void ObjectBase::zeroAllUserRef(Context *rsc) {
@@ -231,18 +234,14 @@ void ObjectBase::zeroAllUserRef(Context *rsc) {
         ALOGV("Forcing release of all outstanding user refs.");
     }
 
-    // This operation can be slow, only to be called during context cleanup.
-    const ObjectBase * o = rsc->mObjHead;
-    while (o) {
-        //ALOGE("o %p", o);
-        if (o->zeroUserRef()) {
-            // deleted the object and possibly others, restart from head.
-            o = rsc->mObjHead;
-            //ALOGE("o head %p", o);
-        } else {
-            o = o->mNext;
-            //ALOGE("o next %p", o);
-        }
+    // Releasing one object can release others further down the list.  The
+    // pins keep every object alive until the walk gets to it, so the walk
+    // never has to restart.
+    std::vector<const ObjectBase *> objs;
+    rsc->mObjects.pinAll(&objs);
+    for (const ObjectBase *o : objs) {
+        o->zeroUserRef();
+        o->decSysRef();
     }
 
     if (gDebugReferences || gDebugLeaks) {
@@ -256,15 +255,11 @@ void ObjectBase::freeAllChildren(Context *rsc) {
         ALOGV("Forcing release of all child objects.");
     }
 
-    // This operation can be slow, only to be called during context cleanup.
-    ObjectBase * o = (ObjectBase *)rsc->mObjHead;
-    while (o) {
-        if (o->freeChildren()) {
-            // deleted ref to self and possibly others, restart from head.
-            o = (ObjectBase *)rsc->mObjHead;
-        } else {
-            o = (ObjectBase *)o->mNext;
-        }
+    std::vector<const ObjectBase *> objs;
+    rsc->mObjects.pinAll(&objs);
+    for (const ObjectBase *o : objs) {
+        const_cast<ObjectBase *>(o)->freeChildren();
+        o->decSysRef();
     }
 
     if (gDebugReferences) {
@@ -274,35 +269,90 @@ void ObjectBase::freeAllChildren(Context *rsc) {
 }
 
 void ObjectBase::dumpAll(Context *rsc) {
-    asyncLock();
-
     ALOGV("Dumping all objects");
-    const ObjectBase * o = rsc->mObjHead;
-    while (o) {
+    rsc->mObjects.forEach([](const ObjectBase *o) {
         ALOGV(" Object %p", o);
         o->dumpLOGV("  ");
         if (o->mDH != nullptr) {
             o->mDH->dump();
         }
-        o = o->mNext;
+    });
+}
+
+bool ObjectBase::isValid(const Context *rsc, const ObjectBase *obj) {
+    return rsc->mObjects.contains(obj);
+}
+
+ObjectRegistry::ObjectRegistry() {
+    for (size_t ct = 0; ct < kShardCount; ct++) {
+        pthread_mutex_init(&mShards[ct].lock, nullptr);
+        mShards[ct].head = nullptr;
     }
+    pthread_mutex_init(&mLifetimeLock, nullptr);
+}
 
-    asyncUnlock();
+ObjectRegistry::~ObjectRegistry() {
+    for (size_t ct = 0; ct < kShardCount; ct++) {
+        pthread_mutex_destroy(&mShards[ct].lock);
+    }
+    pthread_mutex_destroy(&mLifetimeLock);
 }
 
-bool ObjectBase::isValid(const Context *rsc, const ObjectBase *obj) {
-    asyncLock();
+void ObjectRegistry::add(const ObjectBase *obj) {
+    Shard &s = shardFor(obj);
+    pthread_mutex_lock(&s.lock);
+    obj->mNext = s.head;
+    if (s.head) {
+        s.head->mPrev = obj;
+    }
+    s.head = obj;
+    pthread_mutex_unlock(&s.lock);
+}
+
+void ObjectRegistry::remove(const ObjectBase *obj) {
+    Shard &s = shardFor(obj);
+    pthread_mutex_lock(&s.lock);
+    if (s.head == obj) {
+        s.head = obj->mNext;
+    } else if (!obj->mPrev) {
+        // Not linked, or already removed.
+        pthread_mutex_unlock(&s.lock);
+        return;
+    }
+    if (obj->mPrev) {
+        obj->mPrev->mNext = obj->mNext;
+    }
+    if (obj->mNext) {
+        obj->mNext->mPrev = obj->mPrev;
+    }
+    obj->mPrev = nullptr;
+    obj->mNext = nullptr;
+    pthread_mutex_unlock(&s.lock);
+}
 
-    const ObjectBase * o = rsc->mObjHead;
-    while (o) {
+bool ObjectRegistry::contains(const ObjectBase *obj) {
+    Shard &s = shardFor(obj);
+    bool found = false;
+    pthread_mutex_lock(&s.lock);
+    for (const ObjectBase *o = s.head; o; o = o->mNext) {
         if (o == obj) {
-            asyncUnlock();
-            return true;
+            found = true;
+            break;
         }
-        o = o->mNext;
     }
-    asyncUnlock();
-    return false;
+    pthread_mutex_unlock(&s.lock);
+    return found;
+}
+
+void ObjectRegistry::pinAll(std::vector<const ObjectBase *> *objs) {
+    // Objects are only deleted under the lifetime lock, after they are
+    // unlinked, so everything still linked here is safe to reference.
+    lockLifetimes();
+    forEach([objs](const ObjectBase *o) {
+        o->incSysRef();
+        objs->push_back(o);
+    });
+    unlockLifetimes();
 }
 
 void ObjectBase::callUpdateCacheObject(const Context *rsc, void *dstObj) const {
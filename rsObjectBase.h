@@ -21,6 +21,9 @@
 #include "rsDefines.h"
 #include "rsInternalDefines.h"
 
+#include <pthread.h>
+#include <vector>
+
 namespace android {
 namespace renderscript {
 
@@ -39,6 +42,10 @@ public:
 
     void incSysRef() const;
     bool decSysRef() const;
+    // Adds a system reference unless both counts already dropped to zero,
+    // in which case the object may be on its way to deletion.  For lookups
+    // in caches that hold plain pointers.
+    bool tryIncSysRef() const;
 
     void incUserRef() const;
     bool decUserRef() const;
@@ -66,10 +73,11 @@ public:
 
     static bool isValid(const Context *rsc, const ObjectBase *obj);
 
-    // The async lock is taken during object creation in non-rs threads
-    // and object deletion in the rs thread.
-    static void asyncLock();
-    static void asyncUnlock();
+    // The async lock of a context is taken while deciding whether one of
+    // its objects is deleted, and around the object caches that hand out
+    // plain pointers.
+    static void asyncLock(const Context *rsc);
+    static void asyncUnlock(const Context *rsc);
 
     virtual void callUpdateCacheObject(const Context *rsc, void *dstObj) const;
 
@@ -82,7 +90,7 @@ protected:
     virtual ~ObjectBase();
 
 private:
-    static pthread_mutex_t gObjectInitMutex;
+    friend class ObjectRegistry;
 
     void add() const;
     void remove() const;
@@ -97,6 +105,63 @@ private:
     class DebugHelper *mDH;
 };
 
+// All the objects of one Context.  Objects are linked into one of several
+// lists picked by their address, each with its own lock, so threads creating
+// and releasing objects rarely wait for each other.  Lock order is the
+// lifetime lock before any list lock.
+class ObjectRegistry {
+public:
+    ObjectRegistry();
+    ~ObjectRegistry();
+
+    void add(const ObjectBase *obj);
+    // Unlinks obj.  Does nothing if it is not registered.
+    void remove(const ObjectBase *obj);
+    bool contains(const ObjectBase *obj);
+
+    // Calls fn on every registered object, holding the lock of its list.
+    template <class Fn>
+    void forEach(Fn fn) {
+        for (size_t ct = 0; ct < kShardCount; ct++) {
+            pthread_mutex_lock(&mShards[ct].lock);
+            for (const ObjectBase *o = mShards[ct].head; o; o = o->mNext) {
+                fn(o);
+            }
+            pthread_mutex_unlock(&mShards[ct].lock);
+        }
+    }
+
+    // Adds a system reference to every registered object and appends them
+    // to objs, so they outlive whatever the caller releases in between.
+    void pinAll(std::vector<const ObjectBase *> *objs);
+
+    // Serializes the decision to delete an object of this context.
+    void lockLifetimes() {
+        pthread_mutex_lock(&mLifetimeLock);
+    }
+    void unlockLifetimes() {
+        pthread_mutex_unlock(&mLifetimeLock);
+    }
+
+private:
+    static const size_t kShardCount = 16;
+
+    struct Shard {
+        pthread_mutex_t lock;
+        const ObjectBase *head;
+    };
+
+    Shard & shardFor(const ObjectBase *obj) {
+        return mShards[((uintptr_t)obj >> 4) % kShardCount];
+    }
+
+    Shard mShards[kShardCount];
+    pthread_mutex_t mLifetimeLock;
+
+    ObjectRegistry(const ObjectRegistry &);
+    ObjectRegistry & operator= (const ObjectRegistry &);
+};
+
 template<class T>
 class ObjectBaseRef {
 public:
@@ -90,7 +90,7 @@ ObjectBaseRef<ProgramStore> ProgramStore::getProgramStore(Context *rsc,
                                                           RsBlendDstFunc destFunc,
                                                           RsDepthFunc depthFunc) {
     ObjectBaseRef<ProgramStore> returnRef;
-    ObjectBase::asyncLock();
+    ObjectBase::asyncLock(rsc);
     for (uint32_t ct = 0; ct < rsc->mStateFragmentStore.mStorePrograms.size(); ct++) {
         ProgramStore *existing = rsc->mStateFragmentStore.mStorePrograms[ct];
         if (existing->mHal.state.ditherEnable != ditherEnable) continue;
@@ -104,10 +104,10 @@ ObjectBaseRef<ProgramStore> ProgramStore::getProgramStore(Context *rsc,
         if (existing->mHal.state.depthFunc != depthFunc) continue;
 
         returnRef.set(existing);
-        ObjectBase::asyncUnlock();
+        ObjectBase::asyncUnlock(rsc);
         return returnRef;
     }
-    ObjectBase::asyncUnlock();
+    ObjectBase::asyncUnlock(rsc);
 
     ProgramStore *pfs = new ProgramStore(rsc,
                                          colorMaskR, colorMaskG, colorMaskB, colorMaskA,
@@ -117,9 +117,9 @@ ObjectBaseRef<ProgramStore> ProgramStore::getProgramStore(Context *rsc,
 
     pfs->init();
 
-    ObjectBase::asyncLock();
+    ObjectBase::asyncLock(rsc);
     rsc->mStateFragmentStore.mStorePrograms.push(pfs);
-    ObjectBase::asyncUnlock();
+    ObjectBase::asyncUnlock(rsc);
 
     return returnRef;
 }
@@ -83,7 +83,7 @@ ObjectBaseRef<Sampler> Sampler::getSampler(Context *rsc,
                                            RsSamplerValue wrapR,
                                            float aniso) {
     ObjectBaseRef<Sampler> returnRef;
-    ObjectBase::asyncLock();
+    ObjectBase::asyncLock(rsc);
     for (uint32_t ct = 0; ct < rsc->mStateSampler.mAllSamplers.size(); ct++) {
         Sampler *existing = rsc->mStateSampler.mAllSamplers[ct];
         if (existing->mHal.state.magFilter != magFilter) continue;
@@ -93,10 +93,10 @@ ObjectBaseRef<Sampler> Sampler::getSampler(Context *rsc,
         if (existing->mHal.state.wrapR != wrapR) continue;
         if (existing->mHal.state.aniso != aniso) continue;
         returnRef.set(existing);
-        ObjectBase::asyncUnlock();
+        ObjectBase::asyncUnlock(rsc);
         return returnRef;
     }
-    ObjectBase::asyncUnlock();
+    ObjectBase::asyncUnlock(rsc);
 
     void* allocMem = rsc->mHal.funcs.allocRuntimeMem(sizeof(Sampler), 0);
     if (!allocMem) {
@@ -112,9 +112,9 @@ ObjectBaseRef<Sampler> Sampler::getSampler(Context *rsc,
     ALOGE("pointer for sampler.drv: %p", &s->mHal.drv);
 #endif
 
-    ObjectBase::asyncLock();
+    ObjectBase::asyncLock(rsc);
     rsc->mStateSampler.mAllSamplers.push(s);
-    ObjectBase::asyncUnlock();
+    ObjectBase::asyncUnlock(rsc);
 
     return returnRef;
 }
@@ -113,6 +113,21 @@ void Script::callUpdateCacheObject(const Context *rsc, void *dstObj) const {
     }
 }
 
+void Script::runForEachMultiOut(Context *rsc, uint32_t slot, const Allocation ** ains,
+                                size_t inLen, Allocation ** aouts, size_t outLen,
+                                const void *usr, size_t usrBytes, const RsScriptCall *sc) {
+    if (outLen > 1) {
+        rsc->setError(RS_ERROR_BAD_SCRIPT, "Script does not support multiple outputs");
+        return;
+    }
+    runForEach(rsc, slot, ains, inLen, outLen ? aouts[0] : nullptr, usr, usrBytes, sc);
+}
+
+void Script::runReduce(Context *rsc, uint32_t slot, const Allocation ** ains,
+                       size_t inLen, Allocation *aout, const RsScriptCall *sc) {
+    rsc->setError(RS_ERROR_BAD_SCRIPT, "Script has no reduction kernels");
+}
+
 bool Script::freeChildren() {
     incSysRef();
     mRSC->mHal.funcs.script.invokeFreeChildren(mRSC, this);
@@ -224,6 +239,34 @@ void rsi_ScriptForEach(Context *rsc, RsScript vs, uint32_t slot,
     }
 }
 
+void rsi_ScriptForEachMultiOut(Context *rsc, RsScript vs, uint32_t slot,
+                               RsAllocation *vains, size_t inLen,
+                               RsAllocation *vaouts, size_t outLen,
+                               const void *params, size_t paramLen,
+                               const RsScriptCall *sc, size_t scLen) {
+
+    Script      *s     = static_cast<Script *>(vs);
+    Allocation **ains  = (Allocation**)(vains);
+    Allocation **aouts = (Allocation**)(vaouts);
+
+    s->runForEachMultiOut(rsc, slot,
+                          const_cast<const Allocation **>(ains), inLen,
+                          aouts, outLen, params, paramLen, sc);
+}
+
+void rsi_ScriptReduce(Context *rsc, RsScript vs, uint32_t slot,
+                      RsAllocation *vains, size_t inLen,
+                      RsAllocation vaout, const RsScriptCall *sc,
+                      size_t scLen) {
+
+    Script      *s    = static_cast<Script *>(vs);
+    Allocation **ains = (Allocation**)(vains);
+
+    s->runReduce(rsc, slot,
+                 const_cast<const Allocation **>(ains), inLen,
+                 static_cast<Allocation *>(vaout), sc);
+}
+
 void rsi_ScriptInvoke(Context *rsc, RsScript vs, uint32_t slot) {
     Script *s = static_cast<Script *>(vs);
     s->Invoke(rsc, slot, nullptr, 0);
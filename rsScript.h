@@ -130,6 +130,27 @@ public:
                             size_t usrBytes,
                             const RsScriptCall *sc = nullptr) = 0;
 
+    // Runs kernel slot with outLen outputs.  Scripts that cannot write more
+    // than one output report an error for outLen > 1.
+    virtual void runForEachMultiOut(Context* rsc,
+                                    uint32_t slot,
+                                    const Allocation ** ains,
+                                    size_t inLen,
+                                    Allocation ** aouts,
+                                    size_t outLen,
+                                    const void* usr,
+                                    size_t usrBytes,
+                                    const RsScriptCall *sc = nullptr);
+
+    // Runs reduction kernel slot over ains and stores the result in aout.
+    // Only scripts that export reductions implement it.
+    virtual void runReduce(Context *rsc,
+                           uint32_t slot,
+                           const Allocation ** ains,
+                           size_t inLen,
+                           Allocation *aout,
+                           const RsScriptCall *sc = nullptr);
+
     virtual void Invoke(Context *rsc, uint32_t slot, const void *data, size_t len) = 0;
     virtual void setupScript(Context *rsc) = 0;
     virtual uint32_t run(Context *) = 0;
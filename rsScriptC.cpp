@@ -192,6 +192,19 @@ void ScriptC::runForEach(Context *rsc,
                          const void * usr,
                          size_t usrBytes,
                          const RsScriptCall *sc) {
+    runForEachMultiOut(rsc, slot, ains, inLen, aout ? &aout : nullptr, aout ? 1 : 0,
+                       usr, usrBytes, sc);
+}
+
+void ScriptC::runForEachMultiOut(Context *rsc,
+                                 uint32_t slot,
+                                 const Allocation ** ains,
+                                 size_t inLen,
+                                 Allocation ** aouts,
+                                 size_t outLen,
+                                 const void * usr,
+                                 size_t usrBytes,
+                                 const RsScriptCall *sc) {
     // Make a copy of RsScriptCall and zero out extra fields that are absent
     // in API levels below 23.
     RsScriptCall sc_copy;
@@ -215,12 +228,26 @@ void ScriptC::runForEach(Context *rsc,
     (void)String;
     if (mRSC->hadFatalError()) return;
 
+    if (outLen > 1 && rsc->mHal.funcs.script.invokeForEachMultiOut == nullptr) {
+        // Not fatal: the entry is optional and single-output kernels still work.
+        rsc->setError(RS_ERROR_BAD_SCRIPT,
+                      "Driver support for multi-output not present");
+        delete AString;
+        return;
+    }
+
     Context::PushState ps(rsc);
 
     setupGLState(rsc);
     setupScript(rsc);
 
-    if (rsc->mHal.funcs.script.invokeForEachMulti != nullptr) {
+    Allocation *aout = outLen ? aouts[0] : nullptr;
+
+    if (outLen > 1) {
+        rsc->mHal.funcs.script.invokeForEachMultiOut(rsc, this, slot, ains, inLen,
+                                                     aouts, outLen, usr, usrBytes, sc);
+
+    } else if (rsc->mHal.funcs.script.invokeForEachMulti != nullptr) {
         rsc->mHal.funcs.script.invokeForEachMulti(rsc, this, slot, ains, inLen,
                                                   aout, usr, usrBytes, sc);
 
@@ -238,6 +265,30 @@ void ScriptC::runForEach(Context *rsc,
     }
 }
 
+void ScriptC::runReduce(Context *rsc,
+                        uint32_t slot,
+                        const Allocation ** ains,
+                        size_t inLen,
+                        Allocation * aout,
+                        const RsScriptCall *sc) {
+    ATRACE_CALL();
+    if (mRSC->hadFatalError()) return;
+
+    if (rsc->mHal.funcs.script.invokeReduce == nullptr) {
+        // Not fatal: the context stays usable for everything else.
+        rsc->setError(RS_ERROR_BAD_SCRIPT,
+                      "Driver support for reduction kernels not present");
+        return;
+    }
+
+    Context::PushState ps(rsc);
+
+    setupGLState(rsc);
+    setupScript(rsc);
+
+    rsc->mHal.funcs.script.invokeReduce(rsc, this, slot, ains, inLen, aout, sc);
+}
+
 void ScriptC::Invoke(Context *rsc, uint32_t slot, const void *data, size_t len) {
     ATRACE_CALL();
 
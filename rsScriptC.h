@@ -51,6 +51,23 @@ public:
                             size_t usrBytes,
                             const RsScriptCall *sc = nullptr);
 
+    virtual void runForEachMultiOut(Context *rsc,
+                                    uint32_t slot,
+                                    const Allocation ** ains,
+                                    size_t inLen,
+                                    Allocation ** aouts,
+                                    size_t outLen,
+                                    const void * usr,
+                                    size_t usrBytes,
+                                    const RsScriptCall *sc = nullptr);
+
+    virtual void runReduce(Context *rsc,
+                           uint32_t slot,
+                           const Allocation ** ains,
+                           size_t inLen,
+                           Allocation * aout,
+                           const RsScriptCall *sc = nullptr);
+
     virtual void serialize(Context *rsc, OStream *stream) const {    }
     virtual RsA3DClassID getClassId() const { return RS_A3D_CLASS_ID_SCRIPT_C; }
     static Type *createFromStream(Context *rsc, IStream *stream) { return nullptr; }
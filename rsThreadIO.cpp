@@ -23,6 +23,7 @@
 #include <sys/socket.h>
 
 #include <fcntl.h>
+#include <malloc.h>
 #include <poll.h>
 
 
@@ -32,24 +33,65 @@ using namespace android::renderscript;
 ThreadIO::ThreadIO() {
     mRunning = true;
     mPureFifo = false;
+    mUseRing = false;
+    mBatching = false;
+    mBatchLen = 0;
+    mBatchBuffer = nullptr;
+    mBatchReadBuffer = nullptr;
     mMaxInlineSize = 1024;
 }
 
 ThreadIO::~ThreadIO() {
+    free(mBatchBuffer);
+    free(mBatchReadBuffer);
 }
 
-void ThreadIO::init() {
+void ThreadIO::init(bool useRing, bool batch) {
+    if (batch && !mPureFifo) {
+        mBatchBuffer = (uint8_t *)memalign(16, kBatchSize);
+        mBatchReadBuffer = (uint8_t *)memalign(16, kBatchSize);
+        if (mBatchBuffer && mBatchReadBuffer) {
+            mBatchLock.init();
+            mBatchLen = sizeof(CoreCmdHeader);
+            mBatching = true;
+        }
+    }
+
     mToClient.init();
-    mToCore.init();
+    if (useRing && mToCoreRing.init()) {
+        mUseRing = true;
+    } else {
+        mToCore.init();
+    }
 }
 
 void ThreadIO::shutdown() {
     mRunning = false;
-    mToCore.shutdown();
+    if (mUseRing) {
+        mToCoreRing.shutdown();
+    } else {
+        mToCore.shutdown();
+    }
 }
 
 void * ThreadIO::coreHeader(uint32_t cmdID, size_t dataLen) {
     //ALOGE("coreHeader %i %i", cmdID, dataLen);
+    if (mBatching) {
+        // The lock is held until coreCommit, so that a flush from another
+        // thread never sends a half-written command.
+        mBatchLock.lock();
+        size_t len = batchEntrySize(dataLen);
+        rsAssert(len <= kBatchSize - sizeof(CoreCmdHeader));
+        if (mBatchLen + len > kBatchSize) {
+            flushBatchLocked();
+        }
+        CoreCmdHeader *hdr = (CoreCmdHeader *)&mBatchBuffer[mBatchLen];
+        hdr->bytes = dataLen;
+        hdr->cmdID = cmdID;
+        mSendLen = len;
+        return &hdr[1];
+    }
+
     CoreCmdHeader *hdr = (CoreCmdHeader *)&mSendBuffer[0];
     hdr->bytes = dataLen;
     hdr->cmdID = cmdID;
@@ -60,7 +102,41 @@ void * ThreadIO::coreHeader(uint32_t cmdID, size_t dataLen) {
 }
 
 void ThreadIO::coreCommit() {
-    mToCore.writeAsync(&mSendBuffer, mSendLen);
+    if (mBatching) {
+        mBatchLen += mSendLen;
+        mBatchLock.unlock();
+        return;
+    }
+    if (mUseRing) {
+        mToCoreRing.writeAsync(&mSendBuffer, mSendLen);
+    } else {
+        mToCore.writeAsync(&mSendBuffer, mSendLen);
+    }
+}
+
+void ThreadIO::flushBatchLocked() {
+    if (mBatchLen == sizeof(CoreCmdHeader)) {
+        return;
+    }
+    // The batch travels as a single command whose payload is the commands
+    // themselves, so it costs one write and one wakeup of the core thread.
+    CoreCmdHeader *hdr = (CoreCmdHeader *)mBatchBuffer;
+    hdr->cmdID = kBatchCmdID;
+    hdr->bytes = mBatchLen - sizeof(CoreCmdHeader);
+    if (mUseRing) {
+        mToCoreRing.writeAsync(mBatchBuffer, mBatchLen);
+    } else {
+        mToCore.writeAsync(mBatchBuffer, mBatchLen);
+    }
+    mBatchLen = sizeof(CoreCmdHeader);
+}
+
+void ThreadIO::coreFlush() {
+    if (mBatching) {
+        mBatchLock.lock();
+        flushBatchLocked();
+        mBatchLock.unlock();
+    }
 }
 
 void ThreadIO::clientShutdown() {
@@ -69,12 +145,21 @@ void ThreadIO::clientShutdown() {
 
 void ThreadIO::coreWrite(const void *data, size_t len) {
     //ALOGV("core write %p %i", data, (int)len);
-    mToCore.writeAsync(data, len, true);
+    coreFlush();
+    if (mUseRing) {
+        mToCoreRing.writeAsync(data, len, true);
+    } else {
+        mToCore.writeAsync(data, len, true);
+    }
 }
 
 void ThreadIO::coreRead(void *data, size_t len) {
     //ALOGV("core read %p %i", data, (int)len);
-    mToCore.read(data, len);
+    if (mUseRing) {
+        mToCoreRing.read(data, len);
+    } else {
+        mToCore.read(data, len);
+    }
 }
 
 void ThreadIO::coreSetReturn(const void *data, size_t dataLen) {
@@ -84,7 +169,11 @@ void ThreadIO::coreSetReturn(const void *data, size_t dataLen) {
         dataLen = sizeof(buf);
     }
 
-    mToCore.readReturn(data, dataLen);
+    if (mUseRing) {
+        mToCoreRing.readReturn(data, dataLen);
+    } else {
+        mToCore.readReturn(data, dataLen);
+    }
 }
 
 void ThreadIO::coreGetReturn(void *data, size_t dataLen) {
@@ -94,14 +183,95 @@ void ThreadIO::coreGetReturn(void *data, size_t dataLen) {
         dataLen = sizeof(buf);
     }
 
-    mToCore.writeWaitReturn(data, dataLen);
+    // Anything that waits for the core thread is a sync point.
+    coreFlush();
+
+    if (mUseRing) {
+        mToCoreRing.writeWaitReturn(data, dataLen);
+    } else {
+        mToCore.writeWaitReturn(data, dataLen);
+    }
 }
 
 void ThreadIO::setTimeoutCallback(void (*cb)(void *), void *dat, uint64_t timeout) {
     //mToCore.setTimeoutCallback(cb, dat, timeout);
 }
 
+void ThreadIO::playBatch(Context *con, const uint8_t *batch, size_t len) {
+    size_t offset = 0;
+    while (offset + sizeof(CoreCmdHeader) <= len) {
+        const CoreCmdHeader *cmd = (const CoreCmdHeader *)&batch[offset];
+        if (cmd->cmdID >= (sizeof(gPlaybackFuncs) / sizeof(void *))) {
+            rsAssert(cmd->cmdID < (sizeof(gPlaybackFuncs) / sizeof(void *)));
+            ALOGE("playCoreCommands error con %p, batched cmd %i", con, cmd->cmdID);
+            return;
+        }
+        gPlaybackFuncs[cmd->cmdID](con, &cmd[1], cmd->bytes);
+        offset += batchEntrySize(cmd->bytes);
+    }
+}
+
+bool ThreadIO::playCoreCommandsRing(Context *con) {
+    bool ret = false;
+    const bool isLocal = !isPureFifo();
+
+    uint8_t buf[2 * 1024];
+    const CoreCmdHeader *cmd = (const CoreCmdHeader *)&buf[0];
+    const void * data = (const void *)&buf[sizeof(CoreCmdHeader)];
+
+    if (con->props.mLogTimes) {
+        con->timerSet(Context::RS_TIMER_IDLE);
+    }
+
+    // Block for the first command, then drain whatever else is queued
+    // without sleeping, as the socket path does with a zero poll timeout.
+    while (mRunning && (!ret || !mToCoreRing.isEmpty())) {
+        if (isLocal) {
+            size_t r = mToCoreRing.read(&buf[0], sizeof(CoreCmdHeader));
+            if (r != sizeof(CoreCmdHeader)) {
+                // Shutdown occurred.
+                break;
+            }
+            if (cmd->cmdID == kBatchCmdID) {
+                mToCoreRing.read(mBatchReadBuffer, cmd->bytes);
+            } else {
+                mToCoreRing.read(&buf[sizeof(CoreCmdHeader)], cmd->bytes);
+            }
+        } else {
+            if (!mToCoreRing.read((void *)&cmd->cmdID, sizeof(cmd->cmdID))) {
+                break;
+            }
+        }
+
+        ret = true;
+        if (con->props.mLogTimes) {
+            con->timerSet(Context::RS_TIMER_INTERNAL);
+        }
+
+        if (isLocal && cmd->cmdID == kBatchCmdID) {
+            playBatch(con, mBatchReadBuffer, cmd->bytes);
+        } else if (cmd->cmdID >= (sizeof(gPlaybackFuncs) / sizeof(void *))) {
+            rsAssert(cmd->cmdID < (sizeof(gPlaybackFuncs) / sizeof(void *)));
+            ALOGE("playCoreCommands error con %p, cmd %i", con, cmd->cmdID);
+        } else if (isLocal) {
+            gPlaybackFuncs[cmd->cmdID](con, data, cmd->bytes);
+        } else {
+            gPlaybackRemoteFuncs[cmd->cmdID](con, this);
+        }
+
+        if (con->props.mLogTimes) {
+            con->timerSet(Context::RS_TIMER_IDLE);
+        }
+    }
+    return ret;
+}
+
 bool ThreadIO::playCoreCommands(Context *con, int waitFd) {
+    if (mUseRing) {
+        rsAssert(waitFd < 0);
+        return playCoreCommandsRing(con);
+    }
+
     bool ret = false;
     const bool isLocal = !isPureFifo();
 
@@ -136,7 +306,11 @@ bool ThreadIO::playCoreCommands(Context *con, int waitFd) {
             size_t r = 0;
             if (isLocal) {
                 r = mToCore.read(&buf[0], sizeof(CoreCmdHeader));
-                mToCore.read(&buf[sizeof(CoreCmdHeader)], cmd->bytes);
+                if (r == sizeof(CoreCmdHeader) && cmd->cmdID == kBatchCmdID) {
+                    mToCore.read(mBatchReadBuffer, cmd->bytes);
+                } else {
+                    mToCore.read(&buf[sizeof(CoreCmdHeader)], cmd->bytes);
+                }
                 if (r != sizeof(CoreCmdHeader)) {
                     // exception or timeout occurred.
                     break;
@@ -152,12 +326,12 @@ bool ThreadIO::playCoreCommands(Context *con, int waitFd) {
             }
             //ALOGV("playCoreCommands 3 %i %i", cmd->cmdID, cmd->bytes);
 
-            if (cmd->cmdID >= (sizeof(gPlaybackFuncs) / sizeof(void *))) {
+            if (isLocal && cmd->cmdID == kBatchCmdID) {
+                playBatch(con, mBatchReadBuffer, cmd->bytes);
+            } else if (cmd->cmdID >= (sizeof(gPlaybackFuncs) / sizeof(void *))) {
                 rsAssert(cmd->cmdID < (sizeof(gPlaybackFuncs) / sizeof(void *)));
                 ALOGE("playCoreCommands error con %p, cmd %i", con, cmd->cmdID);
-            }
-
-            if (isLocal) {
+            } else if (isLocal) {
                 gPlaybackFuncs[cmd->cmdID](con, data, cmd->bytes);
             } else {
                 gPlaybackRemoteFuncs[cmd->cmdID](con, this);
@@ -19,6 +19,8 @@
 
 #include "rsUtils.h"
 #include "rsFifoSocket.h"
+#include "rsFifoRing.h"
+#include "rsMutex.h"
 
 // ---------------------------------------------------------------------------
 namespace android {
@@ -31,7 +33,15 @@ public:
     ThreadIO();
     ~ThreadIO();
 
-    void init();
+    // useRing selects the shared-memory ring instead of the socketpair for
+    // commands to the core.  The ring cannot be polled alongside another
+    // file descriptor, so it is only for contexts that pass no waitFd to
+    // playCoreCommands.
+    //
+    // batch makes coreCommit queue asynchronous commands in a local buffer.
+    // The buffer is sent to the core thread as one block when it fills, on
+    // coreFlush, and before any call that waits for a reply.
+    void init(bool useRing = false, bool batch = false);
     void shutdown();
 
     size_t getMaxInlineSize() {
@@ -49,6 +59,7 @@ public:
 
     void * coreHeader(uint32_t, size_t dataLen);
     void coreCommit();
+    void coreFlush();
 
     void coreSetReturn(const void *data, size_t dataLen);
     void coreGetReturn(void *data, size_t dataLen);
@@ -79,12 +90,35 @@ protected:
     } ClientCmdHeader;
     ClientCmdHeader mLastClientHeader;
 
+    // Command ID of a block of batched commands.  It lies outside the range
+    // of generated command IDs.
+    static const uint32_t kBatchCmdID = 0xffffffff;
+    static const size_t kBatchSize = 16 * 1024;
+
+    // Commands in a batch start on 8-byte boundaries, like the payload of a
+    // single command in mSendBuffer.
+    static size_t batchEntrySize(size_t dataLen) {
+        return (sizeof(CoreCmdHeader) + dataLen + 7) & ~(size_t)7;
+    }
+
+    bool playCoreCommandsRing(Context *con);
+    void playBatch(Context *con, const uint8_t *batch, size_t len);
+    void flushBatchLocked();
+
     bool mRunning;
     bool mPureFifo;
     size_t mMaxInlineSize;
 
     FifoSocket mToClient;
     FifoSocket mToCore;
+    FifoRing mToCoreRing;
+    bool mUseRing;
+
+    bool mBatching;
+    Mutex mBatchLock;
+    size_t mBatchLen;
+    uint8_t *mBatchBuffer;
+    uint8_t *mBatchReadBuffer;
 
     intptr_t mToCoreRet;
 
@@ -30,15 +30,11 @@ using namespace android::renderscript;
 Type::Type(Context *rsc) : ObjectBase(rsc) {
     memset(&mHal, 0, sizeof(mHal));
     mDimLOD = false;
+    mInternHash = 0;
 }
 
 void Type::preDestroy() const {
-    for (uint32_t ct = 0; ct < mRSC->mStateType.mTypes.size(); ct++) {
-        if (mRSC->mStateType.mTypes[ct] == this) {
-            mRSC->mStateType.mTypes.removeAt(ct);
-            break;
-        }
-    }
+    mRSC->mStateType.mTypes.remove(mInternHash, this);
 }
 
 Type::~Type() {
@@ -222,31 +218,43 @@ bool Type::getIsNp2() const {
     return false;
 }
 
+static size_t hashTypeParams(const Element *e, const RsTypeCreateParams *params) {
+    size_t h = (size_t)e;
+    h = rsHashCombine(h, params->dimX);
+    h = rsHashCombine(h, params->dimY);
+    h = rsHashCombine(h, params->dimZ);
+    h = rsHashCombine(h, (params->mipmaps ? 1 : 0) | (params->faces ? 2 : 0));
+    h = rsHashCombine(h, params->yuv);
+    h = rsHashCombine(h, params->array0);
+    h = rsHashCombine(h, params->array1);
+    h = rsHashCombine(h, params->array2);
+    h = rsHashCombine(h, params->array3);
+    return h;
+}
+
 ObjectBaseRef<Type> Type::getTypeRef(Context *rsc, const Element *e,
                                      const RsTypeCreateParams *params, size_t len) {
     ObjectBaseRef<Type> returnRef;
 
     TypeState * stc = &rsc->mStateType;
 
-    ObjectBase::asyncLock();
-    for (uint32_t ct=0; ct < stc->mTypes.size(); ct++) {
-        Type *t = stc->mTypes[ct];
-        if (t->getElement() != e) continue;
-        if (t->getDimX() != params->dimX) continue;
-        if (t->getDimY() != params->dimY) continue;
-        if (t->getDimZ() != params->dimZ) continue;
-        if (t->getDimLOD() != params->mipmaps) continue;
-        if (t->getDimFaces() != params->faces) continue;
-        if (t->getDimYuv() != params->yuv) continue;
-        if (t->getArray(0) != params->array0) continue;
-        if (t->getArray(1) != params->array1) continue;
-        if (t->getArray(2) != params->array2) continue;
-        if (t->getArray(3) != params->array3) continue;
-        returnRef.set(t);
-        ObjectBase::asyncUnlock();
+    const size_t hash = hashTypeParams(e, params);
+    auto match = [e, params](const Type *t) {
+        return t->getElement() == e &&
+               t->getDimX() == params->dimX &&
+               t->getDimY() == params->dimY &&
+               t->getDimZ() == params->dimZ &&
+               t->getDimLOD() == params->mipmaps &&
+               t->getDimFaces() == params->faces &&
+               t->getDimYuv() == params->yuv &&
+               t->getArray(0) == params->array0 &&
+               t->getArray(1) == params->array1 &&
+               t->getArray(2) == params->array2 &&
+               t->getArray(3) == params->array3;
+    };
+    if (stc->mTypes.find(hash, match, &returnRef)) {
         return returnRef;
     }
-    ObjectBase::asyncUnlock();
 
     // Type objects must use allocator specified by the driver
     void* allocMem = rsc->mHal.funcs.allocRuntimeMem(sizeof(Type), 0);
@@ -286,9 +294,8 @@ ObjectBaseRef<Type> Type::getTypeRef(Context *rsc, const Element *e,
 
     nt->compute();
 
-    ObjectBase::asyncLock();
-    stc->mTypes.push(nt);
-    ObjectBase::asyncUnlock();
+    nt->mInternHash = hash;
+    stc->mTypes.add(hash, nt);
 
     return returnRef;
 }
@@ -18,6 +18,7 @@
 #define ANDROID_STRUCTURED_TYPE_H
 
 #include "rsElement.h"
+#include "rsInternTable.h"
 
 // ---------------------------------------------------------------------------
 namespace android {
@@ -145,6 +146,9 @@ protected:
     // count of mipmap levels, 0 indicates no mipmapping
 
     size_t mCellCount;
+
+    // Key of this Type in TypeState::mTypes.
+    size_t mInternHash;
 protected:
     virtual void preDestroy() const;
     virtual ~Type();
@@ -160,8 +164,8 @@ public:
     TypeState();
     ~TypeState();
 
-    // Cache of all existing types.
-    Vector<Type *> mTypes;
+    // Cache of all existing types, keyed on their element and dimensions.
+    InternTable<Type> mTypes;
 };
 
 
@@ -186,6 +186,23 @@ typedef struct {
                                    size_t usrLen,
                                    const RsScriptCall *sc);
         void (*updateCachedObject)(const Context *rsc, const Script *, rs_script *obj);
+        void (*invokeReduce)(const Context *rsc,
+                             Script *s,
+                             uint32_t slot,
+                             const Allocation ** ains,
+                             size_t inLen,
+                             Allocation * aout,
+                             const RsScriptCall *sc);
+        void (*invokeForEachMultiOut)(const Context *rsc,
+                                      Script *s,
+                                      uint32_t slot,
+                                      const Allocation ** ains,
+                                      size_t inLen,
+                                      Allocation ** aouts,
+                                      size_t outLen,
+                                      const void * usr,
+                                      size_t usrLen,
+                                      const RsScriptCall *sc);
     } script;
 
     struct {
@@ -378,6 +395,8 @@ enum RsHalInitEnums {
     RS_HAL_SCRIPT_DESTROY                                   = 1012,
     RS_HAL_SCRIPT_INVOKE_FOR_EACH_MULTI                     = 1013,
     RS_HAL_SCRIPT_UPDATE_CACHED_OBJECT                      = 1014,
+    RS_HAL_SCRIPT_INVOKE_REDUCE                             = 1015,
+    RS_HAL_SCRIPT_INVOKE_FOR_EACH_MULTI_OUT                 = 1016,
 
     RS_HAL_ALLOCATION_INIT                                  = 2000,
     RS_HAL_ALLOCATION_INIT_ADAPTER                          = 2001,
@@ -315,7 +315,13 @@ void printApiCpp(FILE *f) {
             }
 
             fprintf(f, "    io->coreCommit();\n");
-            if (hasInlineDataPointers(api)) {
+            if (hasInlineDataPointers(api) && api->asyncData) {
+                // The caller keeps the data alive until the core thread
+                // releases it, so only make sure the command goes out now.
+                fprintf(f, "    if (dataSize >= io->getMaxInlineSize()) {\n");
+                fprintf(f, "        io->coreFlush();\n");
+                fprintf(f, "    }\n");
+            } else if (hasInlineDataPointers(api)) {
                 fprintf(f, "    if (dataSize >= io->getMaxInlineSize()) {\n");
                 fprintf(f, "        io->coreGetReturn(NULL, 0);\n");
                 fprintf(f, "    }\n");
@@ -499,7 +505,9 @@ void printPlaybackCpp(FILE *f) {
         }
         fprintf(f, ");\n");
 
-        if (hasInlineDataPointers(api)) {
+        if (hasInlineDataPointers(api) && api->asyncData) {
+            // No reply; the API releases the data itself.
+        } else if (hasInlineDataPointers(api)) {
             fprintf(f, "    size_t totalSize = 0;\n");
             for (ct2=0; ct2 < api->paramCount; ct2++) {
                 if (api->params[ct2].ptrLevel) {
@@ -0,0 +1,24 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	blas.cpp
+
+LOCAL_SHARED_LIBRARIES := libRS libRSCpuRef
+
+LOCAL_CFLAGS := -std=c++11 -O2
+
+LOCAL_MODULE:= rstest-blas
+
+LOCAL_MODULE_TAGS := tests
+
+intermediates := $(call intermediates-dir-for,STATIC_LIBRARIES,libRS,TARGET,)
+
+LOCAL_C_INCLUDES += frameworks/rs
+LOCAL_C_INCLUDES += frameworks/rs/cpu_ref
+LOCAL_C_INCLUDES += frameworks/compile/libbcc/include
+LOCAL_C_INCLUDES += $(intermediates)
+
+LOCAL_CLANG := true
+
+include $(BUILD_EXECUTABLE)
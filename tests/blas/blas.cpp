@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the built-in BLAS routines of the CPU driver against reference
+// loops, for correctness, and times the built-in SGEMM against the loops.
+//
+// usage: rstest-blas [m n k [threads]]
+
+#include "rsContext.h"
+#include "rsCpuCore.h"
+#include "rsCpuBLASBuiltin.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace android::renderscript;
+
+static RsdCpuReferenceImpl *gCtx;
+static int gFailures;
+
+static double now() {
+    struct timeval t;
+    gettimeofday(&t, nullptr);
+    return t.tv_sec * 1000.0 + t.tv_usec / 1000.0;
+}
+
+template <typename T>
+static T * randomMatrix(size_t count) {
+    T *m = new T[count];
+    for (size_t ct = 0; ct < count; ct++) {
+        m[ct] = (T)(rand() % 200 - 100) / 50;
+    }
+    return m;
+}
+
+template <typename T>
+static double * toDouble(const T *m, size_t count) {
+    double *d = new double[count];
+    for (size_t ct = 0; ct < count; ct++) {
+        d[ct] = m[ct];
+    }
+    return d;
+}
+
+// Element tolerance relative to the magnitude of the expected value.
+template <typename T> static double tolerance();
+template <> double tolerance<float>() { return 1e-3; }
+template <> double tolerance<double>() { return 1e-9; }
+
+// Checks rows x cols elements of got, ld apart, against want, with the
+// tolerance of the precision the routine ran in.
+template <typename T, typename G>
+static void compare(const char *name, const G *got, const double *want,
+                    size_t rows, size_t cols, size_t ld) {
+    int mismatches = 0;
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            double g = got[i * ld + j], w = want[i * ld + j];
+            if (!(fabs(g - w) <= tolerance<T>() * (1 + fabs(w)))) {
+                if (mismatches++ < 5) {
+                    printf("%s: mismatch at (%zu, %zu): %g != %g\n", name, i, j, g, w);
+                }
+            }
+        }
+    }
+    if (mismatches) {
+        printf("%s: %d mismatches\n", name, mismatches);
+        gFailures++;
+    }
+}
+
+static void builtinGemm(bool transA, bool transB, int M, int N, int K, float alpha,
+                        const float *A, int lda, const float *B, int ldb, float beta,
+                        float *C, int ldc) {
+    rsdBuiltin_sgemm(gCtx, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+static void builtinGemm(bool transA, bool transB, int M, int N, int K, double alpha,
+                        const double *A, int lda, const double *B, int ldb, double beta,
+                        double *C, int ldc) {
+    rsdBuiltin_dgemm(gCtx, transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+static void builtinGemv(bool transA, int M, int N, float alpha, const float *A, int lda,
+                        const float *X, int incX, float beta, float *Y, int incY) {
+    rsdBuiltin_sgemv(gCtx, transA, M, N, alpha, A, lda, X, incX, beta, Y, incY);
+}
+static void builtinGemv(bool transA, int M, int N, double alpha, const double *A, int lda,
+                        const double *X, int incX, double beta, double *Y, int incY) {
+    rsdBuiltin_dgemv(gCtx, transA, M, N, alpha, A, lda, X, incX, beta, Y, incY);
+}
+static void builtinSymm(bool left, bool upper, int M, int N, float alpha,
+                        const float *A, int lda, const float *B, int ldb, float beta,
+                        float *C, int ldc) {
+    rsdBuiltin_ssymm(gCtx, left, upper, M, N, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+static void builtinSymm(bool left, bool upper, int M, int N, double alpha,
+                        const double *A, int lda, const double *B, int ldb, double beta,
+                        double *C, int ldc) {
+    rsdBuiltin_dsymm(gCtx, left, upper, M, N, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+static void builtinSyrk(bool upper, bool trans, int N, int K, float alpha,
+                        const float *A, int lda, float beta, float *C, int ldc) {
+    rsdBuiltin_ssyrk(gCtx, upper, trans, N, K, alpha, A, lda, beta, C, ldc);
+}
+static void builtinSyrk(bool upper, bool trans, int N, int K, double alpha,
+                        const double *A, int lda, double beta, double *C, int ldc) {
+    rsdBuiltin_dsyrk(gCtx, upper, trans, N, K, alpha, A, lda, beta, C, ldc);
+}
+static void builtinTrsm(bool left, bool upper, bool transA, bool unitDiag, int M, int N,
+                        float alpha, const float *A, int lda, float *B, int ldb) {
+    rsdBuiltin_strsm(gCtx, left, upper, transA, unitDiag, M, N, alpha, A, lda, B, ldb);
+}
+static void builtinTrsm(bool left, bool upper, bool transA, bool unitDiag, int M, int N,
+                        double alpha, const double *A, int lda, double *B, int ldb) {
+    rsdBuiltin_dtrsm(gCtx, left, upper, transA, unitDiag, M, N, alpha, A, lda, B, ldb);
+}
+
+// C = alpha * op(A) * op(B) + beta * C, in double.
+static void referenceGemm(bool transA, bool transB, size_t M, size_t N, size_t K,
+                          double alpha, const double *A, size_t lda,
+                          const double *B, size_t ldb, double beta, double *C, size_t ldc) {
+    for (size_t i = 0; i < M; i++) {
+        for (size_t j = 0; j < N; j++) {
+            double sum = 0;
+            for (size_t p = 0; p < K; p++) {
+                sum += (transA ? A[p * lda + i] : A[i * lda + p]) *
+                       (transB ? B[j * ldb + p] : B[p * ldb + j]);
+            }
+            C[i * ldc + j] = alpha * sum + (beta == 0 ? 0 : beta * C[i * ldc + j]);
+        }
+    }
+}
+
+template <typename T>
+static void testGemm(bool transA, bool transB, size_t M, size_t N, size_t K,
+                     T alpha, T beta) {
+    // Pad the leading dimensions so the rows are not conveniently aligned.
+    size_t lda = (transA ? M : K) + 3, ldb = (transB ? K : N) + 1, ldc = N + 2;
+    size_t sizeA = (transA ? K : M) * lda, sizeB = (transB ? N : K) * ldb, sizeC = M * ldc;
+    T *A = randomMatrix<T>(sizeA);
+    T *B = randomMatrix<T>(sizeB);
+    T *C = randomMatrix<T>(sizeC);
+    double *dA = toDouble(A, sizeA), *dB = toDouble(B, sizeB), *dC = toDouble(C, sizeC);
+
+    referenceGemm(transA, transB, M, N, K, alpha, dA, lda, dB, ldb, beta, dC, ldc);
+    builtinGemm(transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+
+    char name[64];
+    snprintf(name, sizeof(name), "%cgemm %c%c %zux%zux%zu", sizeof(T) == 4 ? 's' : 'd',
+             transA ? 'T' : 'N', transB ? 'T' : 'N', M, N, K);
+    compare<T>(name, C, dC, M, N, ldc);
+
+    delete[] A; delete[] B; delete[] C;
+    delete[] dA; delete[] dB; delete[] dC;
+}
+
+template <typename T>
+static void testGemv(bool transA, size_t M, size_t N, size_t incX, size_t incY, T beta) {
+    size_t lda = N + 1;
+    size_t lenX = transA ? M : N, lenY = transA ? N : M;
+    T *A = randomMatrix<T>(M * lda);
+    T *X = randomMatrix<T>(lenX * incX);
+    T *Y = randomMatrix<T>(lenY * incY);
+    double *dA = toDouble(A, M * lda), *dX = toDouble(X, lenX * incX);
+    double *dY = toDouble(Y, lenY * incY);
+
+    // y is a lenY x 1 matrix with a leading dimension of incY.
+    referenceGemm(transA, false, lenY, 1, lenX, 0.5, dA, lda, dX, incX, beta, dY, incY);
+    builtinGemv(transA, M, N, (T)0.5, A, lda, X, incX, beta, Y, incY);
+
+    char name[64];
+    snprintf(name, sizeof(name), "%cgemv %c %zux%zu inc %zu/%zu", sizeof(T) == 4 ? 's' : 'd',
+             transA ? 'T' : 'N', M, N, incX, incY);
+    compare<T>(name, Y, dY, lenY, 1, incY);
+
+    delete[] A; delete[] X; delete[] Y;
+    delete[] dA; delete[] dX; delete[] dY;
+}
+
+template <typename T>
+static void testSymm(bool left, bool upper, size_t M, size_t N) {
+    size_t ka = left ? M : N, lda = ka + 1, ldb = N + 2, ldc = N + 3;
+    // Only the selected triangle of A may be read; the other holds garbage.
+    T *A = randomMatrix<T>(ka * lda);
+    T *B = randomMatrix<T>(M * ldb);
+    T *C = randomMatrix<T>(M * ldc);
+    double *full = new double[ka * ka];
+    for (size_t i = 0; i < ka; i++) {
+        for (size_t j = 0; j < ka; j++) {
+            bool stored = upper ? j >= i : j <= i;
+            full[i * ka + j] = stored ? A[i * lda + j] : A[j * lda + i];
+        }
+    }
+    double *dB = toDouble(B, M * ldb), *dC = toDouble(C, M * ldc);
+
+    if (left) {
+        referenceGemm(false, false, M, N, M, 1.5, full, ka, dB, ldb, 0.5, dC, ldc);
+    } else {
+        referenceGemm(false, false, M, N, N, 1.5, dB, ldb, full, ka, 0.5, dC, ldc);
+    }
+    builtinSymm(left, upper, M, N, (T)1.5, A, lda, B, ldb, (T)0.5, C, ldc);
+
+    char name[64];
+    snprintf(name, sizeof(name), "%csymm %c%c %zux%zu", sizeof(T) == 4 ? 's' : 'd',
+             left ? 'L' : 'R', upper ? 'U' : 'L', M, N);
+    compare<T>(name, C, dC, M, N, ldc);
+
+    delete[] A; delete[] B; delete[] C;
+    delete[] full; delete[] dB; delete[] dC;
+}
+
+template <typename T>
+static void testSyrk(bool upper, bool trans, size_t N, size_t K, T alpha, T beta) {
+    size_t rowsA = trans ? K : N, lda = (trans ? N : K) + 2, ldc = N + 1;
+    T *A = randomMatrix<T>(rowsA * lda);
+    T *C = randomMatrix<T>(N * ldc);
+    double *dA = toDouble(A, rowsA * lda), *dC = toDouble(C, N * ldc);
+
+    // Compute the full product, then keep the original C outside the
+    // triangle, which must not be written.
+    double *want = toDouble(C, N * ldc);
+    referenceGemm(trans, !trans, N, N, K, alpha, dA, lda, dA, lda, beta, want, ldc);
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = 0; j < N; j++) {
+            if (upper ? j >= i : j <= i) {
+                dC[i * ldc + j] = want[i * ldc + j];
+            }
+        }
+    }
+    builtinSyrk(upper, trans, N, K, alpha, A, lda, beta, C, ldc);
+
+    char name[64];
+    snprintf(name, sizeof(name), "%csyrk %c%c %zux%zu", sizeof(T) == 4 ? 's' : 'd',
+             upper ? 'U' : 'L', trans ? 'T' : 'N', N, K);
+    compare<T>(name, C, dC, N, N, ldc);
+
+    delete[] A; delete[] C;
+    delete[] dA; delete[] dC; delete[] want;
+}
+
+template <typename T>
+static void testTrsm(bool left, bool upper, bool transA, bool unitDiag, size_t M, size_t N) {
+    size_t ka = left ? M : N, lda = ka + 1, ldb = N + 3;
+    // Keep op(A) well conditioned: small off-diagonal entries and a dominant
+    // diagonal.  The unused triangle holds garbage that must not be read.
+    T *A = randomMatrix<T>(ka * lda);
+    for (size_t i = 0; i < ka; i++) {
+        for (size_t j = 0; j < ka; j++) {
+            A[i * lda + j] = i == j ? (T)(4 + i % 3) : A[i * lda + j] / (2 * ka);
+        }
+    }
+    T *B = randomMatrix<T>(M * ldb);
+    double *dB = toDouble(B, M * ldb);
+
+    builtinTrsm(left, upper, transA, unitDiag, M, N, (T)2, A, lda, B, ldb);
+
+    // Multiply the solution back by op(A) and compare with alpha * B.
+    double *opA = new double[ka * ka];
+    for (size_t i = 0; i < ka; i++) {
+        for (size_t j = 0; j < ka; j++) {
+            size_t si = transA ? j : i, sj = transA ? i : j;
+            bool stored = upper ? sj >= si : sj <= si;
+            opA[i * ka + j] = !stored ? 0 : (i == j && unitDiag) ? 1 : A[si * lda + sj];
+        }
+    }
+    double *X = toDouble(B, M * ldb);
+    double *got = new double[M * ldb];
+    if (left) {
+        referenceGemm(false, false, M, N, M, 1, opA, ka, X, ldb, 0, got, ldb);
+    } else {
+        referenceGemm(false, false, M, N, N, 1, X, ldb, opA, ka, 0, got, ldb);
+    }
+    for (size_t ct = 0; ct < M * ldb; ct++) {
+        dB[ct] *= 2;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%ctrsm %c%c%c%c %zux%zu", sizeof(T) == 4 ? 's' : 'd',
+             left ? 'L' : 'R', upper ? 'U' : 'L', transA ? 'T' : 'N', unitDiag ? 'U' : 'N',
+             M, N);
+    compare<T>(name, got, dB, M, N, ldb);
+
+    delete[] A; delete[] B;
+    delete[] dB; delete[] opA; delete[] X; delete[] got;
+}
+
+template <typename T>
+static void testAll() {
+    // Sizes straddling the GEMM block sizes, plus degenerate ones.
+    static const size_t kSizes[][3] = {
+        {1, 1, 1}, {5, 7, 3}, {64, 128, 256}, {70, 130, 300}, {129, 65, 257}, {3, 200, 600}
+    };
+    for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); s++) {
+        for (int ta = 0; ta < 2; ta++) {
+            for (int tb = 0; tb < 2; tb++) {
+                testGemm<T>(ta, tb, kSizes[s][0], kSizes[s][1], kSizes[s][2], 1.25, 0.5);
+                testGemm<T>(ta, tb, kSizes[s][0], kSizes[s][1], kSizes[s][2], -0.75, 0);
+            }
+        }
+    }
+    testGemm<T>(false, false, 10, 10, 0, 1, 2);
+
+    for (int ta = 0; ta < 2; ta++) {
+        testGemv<T>(ta, 1, 1, 1, 1, 0);
+        testGemv<T>(ta, 100, 37, 1, 1, 0.5);
+        testGemv<T>(ta, 37, 300, 2, 3, 0);
+        testGemv<T>(ta, 300, 600, 1, 2, -1);
+    }
+
+    for (int left = 0; left < 2; left++) {
+        for (int upper = 0; upper < 2; upper++) {
+            testSymm<T>(left, upper, 70, 45);
+            testSymm<T>(left, upper, 5, 140);
+        }
+    }
+
+    for (int upper = 0; upper < 2; upper++) {
+        for (int trans = 0; trans < 2; trans++) {
+            testSyrk<T>(upper, trans, 150, 70, 1, 0.5);
+            testSyrk<T>(upper, trans, 7, 300, 2, 1);
+            testSyrk<T>(upper, trans, 130, 3, 2, 0);
+        }
+    }
+
+    for (int mask = 0; mask < 16; mask++) {
+        testTrsm<T>(mask & 1, mask & 2, mask & 4, mask & 8, 40, 150);
+        testTrsm<T>(mask & 1, mask & 2, mask & 4, mask & 8, 90, 17);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t m = 256, n = 256, k = 256;
+    int threads = 4;
+
+    if (argc >= 4) {
+        m = atoi(argv[1]);
+        n = atoi(argv[2]);
+        k = atoi(argv[3]);
+    }
+    if (argc >= 5) {
+        threads = atoi(argv[4]);
+    }
+    if (!m || !n || !k || threads <= 0) {
+        printf("usage: %s [m n k [threads]]\n", argv[0]);
+        return 1;
+    }
+
+    // The built-in routines only need the worker pool of the CPU driver,
+    // which runs off a lite context.
+    Context *rsc = Context::createContextLite();
+    rsc->props.mDebugMaxThreads = threads;
+    rsc->props.mDebugCpuAffinity = RsdCpuReference::AFFINITY_NONE;
+    gCtx = (RsdCpuReferenceImpl *)RsdCpuReference::create(rsc, 23, 0, nullptr, nullptr);
+    if (!gCtx) {
+        printf("failed to create the CPU driver\n");
+        return 1;
+    }
+
+    srand(1);
+    testAll<float>();
+    testAll<double>();
+
+    float *a = randomMatrix<float>(m * k);
+    float *b = randomMatrix<float>(k * n);
+    float *c = new float[m * n];
+    double *da = toDouble(a, m * k), *db = toDouble(b, k * n);
+    double *dc = new double[m * n];
+
+    printf("sgemm m = %zu, n = %zu, k = %zu, threads = %d\n", m, n, k, threads);
+
+    double start = now();
+    referenceGemm(false, false, m, n, k, 1, da, k, db, n, 0, dc, n);
+    double reference = now() - start;
+
+    start = now();
+    rsdBuiltin_sgemm(gCtx, false, false, m, n, k, 1, a, k, b, n, 0, c, n);
+    double builtin = now() - start;
+    compare<float>("sgemm timed", c, dc, m, n, n);
+
+    double gflops = 2.0 * m * n * k / 1e6;
+    printf("reference: %8.2f ms  %6.2f GFLOPS\n", reference, gflops / reference);
+    printf("builtin:   %8.2f ms  %6.2f GFLOPS\n", builtin, gflops / builtin);
+
+    delete[] a; delete[] b; delete[] c;
+    delete[] da; delete[] db; delete[] dc;
+
+    if (gFailures) {
+        printf("FAILED: %d checks\n", gFailures);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
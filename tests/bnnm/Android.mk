@@ -0,0 +1,30 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	bnnm.cpp \
+	../../cpu_ref/rsCpuBNNM.cpp
+
+LOCAL_CFLAGS := -std=c++11 -O2
+LOCAL_CFLAGS_arm64 += -DARCH_ARM64_HAVE_NEON
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+    LOCAL_CFLAGS_arm += -DARCH_ARM_HAVE_NEON -mfpu=neon
+endif
+
+# The runtime-selected AVX2 panels live behind gX86Kernels.
+ifeq ($(ARCH_X86_HAVE_SSSE3),true)
+    LOCAL_CFLAGS += -DARCH_X86_HAVE_SSSE3
+    LOCAL_SRC_FILES += \
+	../../cpu_ref/rsCpuIntrinsics_x86.cpp \
+	../../cpu_ref/rsCpuIntrinsics_x86_avx2.cpp
+endif
+
+LOCAL_MODULE:= rstest-bnnm
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_C_INCLUDES += frameworks/rs/cpu_ref
+
+LOCAL_CLANG := true
+
+include $(BUILD_EXECUTABLE)
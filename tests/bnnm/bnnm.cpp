@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the blocked BNNM kernel of the CPU driver against the reference
+// triple loop, for correctness and speed.  On x86 CPUs with AVX2 it also
+// checks the AVX2 panel kernel against the portable one.
+//
+// usage: rstest-bnnm [m n k [iters [threads]]]
+
+#include "rsCpuBNNM.h"
+#if defined(ARCH_X86_HAVE_SSSE3)
+#include "rsCpuIntrinsics_x86.h"
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace android::renderscript;
+
+struct TileRunner {
+    const BNNMPlan *plan;
+    volatile size_t next;
+};
+
+static void * runTiles(void *data) {
+    TileRunner *runner = (TileRunner *)data;
+    size_t count = rsdBNNMTileCount(runner->plan);
+    while (true) {
+        size_t tile = __sync_fetch_and_add(&runner->next, 1);
+        if (tile >= count) {
+            return nullptr;
+        }
+        rsdBNNMRunTile(runner->plan, tile);
+    }
+}
+
+static void runBlocked(const BNNMArgs *args, int threads) {
+    BNNMPlan plan;
+    if (!rsdBNNMPrepare(&plan, args)) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    TileRunner runner;
+    runner.plan = &plan;
+    runner.next = 0;
+
+    pthread_t *tids = new pthread_t[threads];
+    for (int ct = 1; ct < threads; ct++) {
+        pthread_create(&tids[ct], nullptr, runTiles, &runner);
+    }
+    runTiles(&runner);
+    for (int ct = 1; ct < threads; ct++) {
+        pthread_join(tids[ct], nullptr);
+    }
+    delete[] tids;
+
+    rsdBNNMRelease(&plan);
+}
+
+static double now() {
+    struct timeval t;
+    gettimeofday(&t, nullptr);
+    return t.tv_sec * 1000.0 + t.tv_usec / 1000.0;
+}
+
+int main(int argc, char** argv)
+{
+    size_t m = 256, n = 1152, k = 576;
+    int iters = 5;
+    int threads = 4;
+
+    if (argc >= 4) {
+        m = atoi(argv[1]);
+        n = atoi(argv[2]);
+        k = atoi(argv[3]);
+    }
+    if (argc >= 5) {
+        iters = atoi(argv[4]);
+    }
+    if (argc >= 6) {
+        threads = atoi(argv[5]);
+    }
+    if (!m || !n || !k || iters <= 0 || threads <= 0) {
+        printf("usage: %s [m n k [iters [threads]]]\n", argv[0]);
+        return 1;
+    }
+
+    // Pad the leading dimensions so the rows are not conveniently aligned.
+    size_t lda = k + 3, ldb = k + 5, ldc = n + 7;
+    uint8_t *a = new uint8_t[m * lda];
+    uint8_t *b = new uint8_t[n * ldb];
+    uint8_t *cRef = new uint8_t[m * ldc];
+    uint8_t *cBlocked = new uint8_t[m * ldc];
+
+    srand(1);
+    for (size_t ct = 0; ct < m * lda; ct++) a[ct] = rand();
+    for (size_t ct = 0; ct < n * ldb; ct++) b[ct] = rand();
+    memset(cRef, 0, m * ldc);
+    memset(cBlocked, 0, m * ldc);
+
+    BNNMArgs args;
+    args.m = m;
+    args.n = n;
+    args.k = k;
+    args.a = a;
+    args.a_offset = 127;
+    args.lda = lda;
+    args.b = b;
+    args.b_offset = 131;
+    args.ldb = ldb;
+    args.c_offset = 3000;
+    args.ldc = ldc;
+    args.c_mult_int = 1 << 10;
+
+    printf("m = %zu, n = %zu, k = %zu, iters = %d, threads = %d\n", m, n, k, iters, threads);
+
+    args.c = cRef;
+    double start = now();
+    for (int i = 0; i < iters; i++) {
+        rsdBNNMReference(&args);
+    }
+    double reference = (now() - start) / iters;
+
+    args.c = cBlocked;
+    start = now();
+    for (int i = 0; i < iters; i++) {
+        runBlocked(&args, 1);
+    }
+    double blocked = (now() - start) / iters;
+
+    start = now();
+    for (int i = 0; i < iters; i++) {
+        runBlocked(&args, threads);
+    }
+    double threaded = (now() - start) / iters;
+
+    double gops = 2.0 * m * n * k / 1e6;
+    printf("reference: %8.2f ms  %6.2f GOPS\n", reference, gops / reference);
+    printf("blocked:   %8.2f ms  %6.2f GOPS\n", blocked, gops / blocked);
+    printf("threaded:  %8.2f ms  %6.2f GOPS\n", threaded, gops / threaded);
+
+    int mismatches = 0;
+
+#if defined(ARCH_X86_HAVE_SSSE3)
+    // The portable panels ran above, as no x86 kernels are selected yet.
+    // The AVX2 panels have to give the same bits.
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        uint8_t *cAvx2 = new uint8_t[m * ldc];
+        memset(cAvx2, 0, m * ldc);
+        rsdSelectX86Kernels(RS_CPU_X86_AVX2);
+
+        args.c = cAvx2;
+        start = now();
+        for (int i = 0; i < iters; i++) {
+            runBlocked(&args, 1);
+        }
+        double avx2 = (now() - start) / iters;
+        printf("avx2:      %8.2f ms  %6.2f GOPS\n", avx2, gops / avx2);
+
+        for (size_t i = 0; i < m; i++) {
+            for (size_t j = 0; j < n; j++) {
+                if (cBlocked[i * ldc + j] != cAvx2[i * ldc + j]) {
+                    if (mismatches++ < 10) {
+                        printf("avx2 mismatch at (%zu, %zu): %u != %u\n", i, j,
+                               cBlocked[i * ldc + j], cAvx2[i * ldc + j]);
+                    }
+                }
+            }
+        }
+        delete[] cAvx2;
+    } else {
+        printf("avx2:      not supported by this CPU\n");
+    }
+#endif
+
+    for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) {
+            if (cRef[i * ldc + j] != cBlocked[i * ldc + j]) {
+                if (mismatches++ < 10) {
+                    printf("mismatch at (%zu, %zu): %u != %u\n", i, j,
+                           cRef[i * ldc + j], cBlocked[i * ldc + j]);
+                }
+            }
+        }
+    }
+
+    delete[] a;
+    delete[] b;
+    delete[] cRef;
+    delete[] cBlocked;
+
+    if (mismatches) {
+        printf("FAILED: %d mismatches\n", mismatches);
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+
+#include "RenderScript.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace android;
+using namespace RSC;
+
+static const uint32_t kDimX = 301;
+static const uint32_t kDimY = 257;
+
+// Blurs in with the given radius and mode into out.
+static void blur(sp<RS> rs, sp<const Element> e, sp<Allocation> ain, sp<Allocation> aout,
+                 float radius, RsBlurMode mode, uint8_t *out) {
+    sp<ScriptIntrinsicBlur> sc = ScriptIntrinsicBlur::create(rs, e);
+    sc->setMode(mode);
+    sc->setRadius(radius);
+    sc->setInput(ain);
+    sc->forEach(aout);
+    aout->copy2DRangeTo(0, 0, kDimX, kDimY, out);
+}
+
+int main(int argc, char** argv)
+{
+    sp<RS> rs = new RS();
+
+    bool r = rs->init("/system/bin");
+
+    sp<const Element> e = Element::U8_4(rs);
+
+    Type::Builder tb(rs, e);
+    tb.setX(kDimX);
+    tb.setY(kDimY);
+    sp<const Type> t = tb.create();
+
+    sp<Allocation> ain = Allocation::createTyped(rs, t);
+    sp<Allocation> aout = Allocation::createTyped(rs, t);
+
+    size_t count = kDimX * kDimY * 4;
+    uint8_t *in = new uint8_t[count];
+    uint8_t *exact = new uint8_t[count];
+    uint8_t *box = new uint8_t[count];
+
+    // Smooth gradients, hard edges and some noise.
+    srand(1);
+    for (uint32_t y = 0; y < kDimY; y++) {
+        for (uint32_t x = 0; x < kDimX; x++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                float v = 127.f + 100.f * sinf(x * 0.05f * (c + 1)) * cosf(y * 0.07f);
+                if (((x / 40) + (y / 40)) & 1) {
+                    v = v * 0.5f + 100.f;
+                }
+                v += (rand() % 40) - 20;
+                in[((y * kDimX) + x) * 4 + c] = (uint8_t)fminf(fmaxf(v, 0.f), 255.f);
+            }
+        }
+    }
+    ain->copy2DRangeFrom(0, 0, kDimX, kDimY, in);
+
+    // Box mode approximates the Gaussian of the same radius.  The largest
+    // differences are next to hard edges.
+    for (int radius = 1; radius <= 25; radius++) {
+        blur(rs, e, ain, aout, radius, RS_BLUR_MODE_DEFAULT, exact);
+        blur(rs, e, ain, aout, radius, RS_BLUR_MODE_BOX, box);
+
+        int maxDiff = 0;
+        double meanDiff = 0.0;
+        for (size_t ct = 0; ct < count; ct++) {
+            int diff = abs((int)exact[ct] - (int)box[ct]);
+            maxDiff = diff > maxDiff ? diff : maxDiff;
+            meanDiff += diff;
+        }
+        meanDiff /= count;
+        if (maxDiff > 16 || meanDiff > 1.5) {
+            printf("Radius %d: box mode differs by up to %d, %.2f on average\n",
+                   radius, maxDiff, meanDiff);
+            return 1;
+        }
+    }
+
+    // Past 25 only box mode exists.  A flat image must stay flat.
+    memset(in, 200, count);
+    ain->copy2DRangeFrom(0, 0, kDimX, kDimY, in);
+    blur(rs, e, ain, aout, 400.f, RS_BLUR_MODE_DEFAULT, box);
+    for (size_t ct = 0; ct < count; ct++) {
+        if (box[ct] != 200) {
+            printf("Mismatch at location %zu: %u\n", ct, box[ct]);
+            return 1;
+        }
+    }
+
+    printf("Test successful!\n");
+
+    delete [] in;
+    delete [] exact;
+    delete [] box;
+    t.clear();
+    e.clear();
+    ain.clear();
+    aout.clear();
+}
@@ -0,0 +1,114 @@
+
+#include "RenderScript.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace android;
+using namespace RSC;
+
+static const uint32_t kDimX = 640;
+static const uint32_t kDimY = 480;
+static const uint32_t kFactor = 8;
+
+// Resizes ain into an allocation of outX by outY pixels.
+static void resize(sp<RS> rs, sp<const Element> e, sp<Allocation> ain,
+                   uint32_t outX, uint32_t outY, RsResizeMode mode, uint8_t *out) {
+    Type::Builder tb(rs, e);
+    tb.setX(outX);
+    tb.setY(outY);
+    sp<Allocation> aout = Allocation::createTyped(rs, tb.create());
+
+    sp<ScriptIntrinsicResize> sc = ScriptIntrinsicResize::create(rs);
+    sc->setMode(mode);
+    sc->setInput(ain);
+    sc->forEach_bicubic(aout);
+    aout->copy2DRangeTo(0, 0, outX, outY, out);
+}
+
+int main(int argc, char** argv)
+{
+    sp<RS> rs = new RS();
+
+    bool r = rs->init("/system/bin");
+
+    sp<const Element> e = Element::U8_4(rs);
+
+    Type::Builder tb(rs, e);
+    tb.setX(kDimX);
+    tb.setY(kDimY);
+    sp<const Type> t = tb.create();
+
+    sp<Allocation> ain = Allocation::createTyped(rs, t);
+
+    size_t count = kDimX * kDimY * 4;
+    uint8_t *in = new uint8_t[count];
+    uint8_t *out = new uint8_t[count];
+
+    srand(1);
+    for (size_t ct = 0; ct < count; ct++) {
+        in[ct] = rand() & 0xff;
+    }
+    ain->copy2DRangeFrom(0, 0, kDimX, kDimY, in);
+
+    // Shrinking by a whole factor in area mode averages each block.
+    uint32_t outX = kDimX / kFactor;
+    uint32_t outY = kDimY / kFactor;
+    resize(rs, e, ain, outX, outY, RS_RESIZE_MODE_AREA, out);
+    for (uint32_t y = 0; y < outY; y++) {
+        for (uint32_t x = 0; x < outX; x++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t sum = 0;
+                for (uint32_t j = 0; j < kFactor; j++) {
+                    for (uint32_t i = 0; i < kFactor; i++) {
+                        sum += in[(((y * kFactor + j) * kDimX) + x * kFactor + i) * 4 + c];
+                    }
+                }
+                int expect = (int)floorf((float)sum / (kFactor * kFactor) + 0.5f);
+                int got = out[((y * outX) + x) * 4 + c];
+                if (abs(expect - got) > 1) {
+                    printf("Area mismatch at %u, %u: %d, expected %d\n", x, y, got, expect);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // Lanczos weights are zero at whole pixel offsets, so the same size
+    // copies the input.
+    resize(rs, e, ain, kDimX, kDimY, RS_RESIZE_MODE_LANCZOS3, out);
+    for (size_t ct = 0; ct < count; ct++) {
+        if (abs((int)in[ct] - (int)out[ct]) > 1) {
+            printf("Lanczos mismatch at location %zu: %u, expected %u\n", ct, out[ct], in[ct]);
+            return 1;
+        }
+    }
+
+    // A flat image stays flat at any scale.
+    memset(in, 200, count);
+    ain->copy2DRangeFrom(0, 0, kDimX, kDimY, in);
+    static const RsResizeMode modes[] = {RS_RESIZE_MODE_AREA, RS_RESIZE_MODE_LANCZOS3};
+    static const uint32_t sizes[][2] = {{100, 75}, {37, 211}, {kDimX + 13, 201}};
+    for (size_t m = 0; m < 2; m++) {
+        for (size_t s = 0; s < 3; s++) {
+            resize(rs, e, ain, sizes[s][0], sizes[s][1], modes[m], out);
+            for (size_t ct = 0; ct < sizes[s][0] * sizes[s][1] * 4; ct++) {
+                if (out[ct] != 200) {
+                    printf("Mode %d, %ux%u: mismatch at location %zu: %u\n", modes[m],
+                           sizes[s][0], sizes[s][1], ct, out[ct]);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    printf("Test successful!\n");
+
+    delete [] in;
+    delete [] out;
+    t.clear();
+    e.clear();
+    ain.clear();
+}
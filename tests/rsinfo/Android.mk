@@ -0,0 +1,27 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	rsinfo.cpp
+
+LOCAL_CFLAGS := -std=c++11 -O2
+
+# The benchmark looks its own exports up with dlsym, as the driver does for
+# a compiled script.
+LOCAL_LDFLAGS += -rdynamic
+
+LOCAL_SHARED_LIBRARIES := libRS libRSCpuRef libdl
+
+LOCAL_MODULE:= rstest-rsinfo
+
+LOCAL_MODULE_TAGS := tests
+
+intermediates := $(call intermediates-dir-for,STATIC_LIBRARIES,libRS,TARGET,)
+
+LOCAL_C_INCLUDES += frameworks/rs/cpu_ref
+LOCAL_C_INCLUDES += frameworks/rs
+LOCAL_C_INCLUDES += $(intermediates)
+
+LOCAL_CLANG := true
+
+include $(BUILD_EXECUTABLE)
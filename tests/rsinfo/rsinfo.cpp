@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how long the CPU driver takes to build a ScriptExecutable from the
+// text .rs.info block and from the binary export table, for a script with
+// 256 exported variables, functions and kernels and a few reductions.  The
+// exports live in this executable, which stands in for a compiled script.
+//
+// usage: rstest-rsinfo [iters]
+
+#include "rsCpuExecutable.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+using namespace android::renderscript;
+
+#define REPEAT4(M, n)   M(n##0) M(n##1) M(n##2) M(n##3)
+#define REPEAT16(M, n)  REPEAT4(M, n##0) REPEAT4(M, n##1) REPEAT4(M, n##2) REPEAT4(M, n##3)
+#define REPEAT64(M, n)  REPEAT16(M, n##0) REPEAT16(M, n##1) REPEAT16(M, n##2) REPEAT16(M, n##3)
+#define REPEAT256(M)    REPEAT64(M, 0) REPEAT64(M, 1) REPEAT64(M, 2) REPEAT64(M, 3)
+
+static const size_t kExports = 256;
+static const size_t kReduces = 4;
+
+// Names are the base-4 digits of the index, so "var0123" is variable 27.
+#define DEFINE_EXPORT(n)                                                        \
+    int var##n = 0;                                                             \
+    void func##n(const void *, size_t) {}                                       \
+    void kernel##n##_expand(const RsExpandKernelDriverInfo *,                   \
+                            uint32_t, uint32_t, uint32_t)                       \
+            __asm__("kernel" #n ".expand");                                     \
+    void kernel##n##_expand(const RsExpandKernelDriverInfo *,                   \
+                            uint32_t, uint32_t, uint32_t) {}
+extern "C" {
+REPEAT256(DEFINE_EXPORT)
+}
+
+// Reductions 0 and 2 have no initializer, 1 and 3 no outconverter.
+#define DEFINE_REDUCE(n)                                                        \
+    void init##n(uint8_t *) {}                                                  \
+    void accum##n##_expand(const RsExpandKernelDriverInfo *,                    \
+                           uint32_t, uint32_t, uint8_t *)                       \
+            __asm__("accum" #n ".expand");                                      \
+    void accum##n##_expand(const RsExpandKernelDriverInfo *,                    \
+                           uint32_t, uint32_t, uint8_t *) {}                    \
+    void comb##n(uint8_t *, const uint8_t *) {}                                 \
+    void out##n(uint8_t *, const uint8_t *) {}
+extern "C" {
+REPEAT4(DEFINE_REDUCE, )
+}
+
+static bool hasInit(size_t i) { return i & 1; }
+static bool hasOut(size_t i) { return !(i & 1); }
+
+static std::string reduceName(const char *prefix, size_t i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s%zu", prefix, i);
+    return buf;
+}
+
+static std::string exportName(const char *prefix, size_t i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s%zu%zu%zu%zu", prefix,
+             (i >> 6) & 3, (i >> 4) & 3, (i >> 2) & 3, i & 3);
+    return buf;
+}
+
+static std::string buildRSInfo() {
+    std::string info;
+    char buf[64];
+    snprintf(buf, sizeof(buf), "exportVarCount: %zu\n", kExports);
+    info += buf;
+    for (size_t i = 0; i < kExports; i++) {
+        info += exportName("var", i) + "\n";
+    }
+    snprintf(buf, sizeof(buf), "exportFuncCount: %zu\n", kExports);
+    info += buf;
+    for (size_t i = 0; i < kExports; i++) {
+        info += exportName("func", i) + "\n";
+    }
+    snprintf(buf, sizeof(buf), "exportForEachCount: %zu\n", kExports);
+    info += buf;
+    for (size_t i = 0; i < kExports; i++) {
+        info += "49 - " + exportName("kernel", i) + "\n";
+    }
+    snprintf(buf, sizeof(buf), "exportReduceCount: %zu\n", kReduces);
+    info += buf;
+    for (size_t i = 0; i < kReduces; i++) {
+        snprintf(buf, sizeof(buf), "%zu - ", 4 * (i + 1));
+        info += buf;
+        info += (hasInit(i) ? reduceName("init", i) : ".") + " - ";
+        info += reduceName("accum", i) + " - ";
+        info += reduceName("comb", i) + " - ";
+        info += hasOut(i) ? reduceName("out", i) : ".";
+        info += "\n";
+    }
+    info += "objectSlotCount: 0\n";
+    info += "pragmaCount: 0\n";
+    info += "isThreadable: yes\n";
+    info += "buildChecksum: abcd1234\n";
+    return info;
+}
+
+// Builds the table the compiler would emit, with offsets relative to the
+// table in this process.
+static std::vector<uint64_t> buildExportTable(void *handle) {
+    std::string strings;
+    std::vector<uint32_t> varNames, funcNames, kernelNames, reduceNames;
+    for (size_t i = 0; i < kExports; i++) {
+        varNames.push_back(strings.size());
+        strings += exportName("var", i) + '\0';
+        funcNames.push_back(strings.size());
+        strings += exportName("func", i) + '\0';
+        kernelNames.push_back(strings.size());
+        strings += exportName("kernel", i) + '\0';
+    }
+    for (size_t i = 0; i < kReduces; i++) {
+        reduceNames.push_back(strings.size());
+        strings += reduceName("accum", i) + '\0';
+    }
+
+    size_t varsOffset = sizeof(RsExportTable);
+    size_t funcsOffset = varsOffset + kExports * sizeof(RsExportVar);
+    size_t forEachsOffset = funcsOffset + kExports * sizeof(RsExportFunc);
+    size_t reducesOffset = forEachsOffset + kExports * sizeof(RsExportForEach);
+    size_t stringsOffset = reducesOffset + kReduces * sizeof(RsExportReduce);
+    size_t size = stringsOffset + strings.size();
+
+    std::vector<uint64_t> storage((size + 7) / 8);
+    char *base = (char *) storage.data();
+    RsExportTable *table = (RsExportTable *) base;
+    memset(table, 0, sizeof(*table));
+    table->magic = RS_EXPORT_TABLE_MAGIC;
+    table->version = RS_EXPORT_TABLE_VERSION;
+    table->varCount = kExports;
+    table->funcCount = kExports;
+    table->forEachCount = kExports;
+    table->isThreadable = 1;
+    table->checksum = 0xabcd1234;
+    table->varsOffset = varsOffset;
+    table->funcsOffset = funcsOffset;
+    table->forEachsOffset = forEachsOffset;
+    table->reduceCount = kReduces;
+    table->reducesOffset = reducesOffset;
+    table->pragmasOffset = stringsOffset;
+    table->stringsOffset = stringsOffset;
+
+    RsExportVar *vars = (RsExportVar *) (base + varsOffset);
+    RsExportFunc *funcs = (RsExportFunc *) (base + funcsOffset);
+    RsExportForEach *forEachs = (RsExportForEach *) (base + forEachsOffset);
+    for (size_t i = 0; i < kExports; i++) {
+        vars[i].address = (char *) dlsym(handle, exportName("var", i).c_str()) - base;
+        vars[i].name = varNames[i];
+        vars[i].isObject = 0;
+        funcs[i].address = (char *) dlsym(handle, exportName("func", i).c_str()) - base;
+        funcs[i].name = funcNames[i];
+        std::string expand = exportName("kernel", i) + ".expand";
+        forEachs[i].address = (char *) dlsym(handle, expand.c_str()) - base;
+        forEachs[i].name = kernelNames[i];
+        forEachs[i].signature = 49;
+    }
+    RsExportReduce *reduces = (RsExportReduce *) (base + reducesOffset);
+    for (size_t i = 0; i < kReduces; i++) {
+        std::string expand = reduceName("accum", i) + ".expand";
+        reduces[i].initializer = hasInit(i) ?
+                (char *) dlsym(handle, reduceName("init", i).c_str()) - base : 0;
+        reduces[i].accumulator = (char *) dlsym(handle, expand.c_str()) - base;
+        reduces[i].combiner = (char *) dlsym(handle, reduceName("comb", i).c_str()) - base;
+        reduces[i].outConverter = hasOut(i) ?
+                (char *) dlsym(handle, reduceName("out", i).c_str()) - base : 0;
+        reduces[i].name = reduceNames[i];
+        reduces[i].accumulatorSize = 4 * (i + 1);
+    }
+    memcpy(base + stringsOffset, strings.data(), strings.size());
+    return storage;
+}
+
+static double now() {
+    struct timeval t;
+    gettimeofday(&t, nullptr);
+    return t.tv_sec * 1000.0 + t.tv_usec / 1000.0;
+}
+
+static bool same(const ScriptExecutable *a, const ScriptExecutable *b) {
+    if (a->getExportedVariableCount() != b->getExportedVariableCount() ||
+        a->getExportedFunctionCount() != b->getExportedFunctionCount() ||
+        a->getExportedForEachCount() != b->getExportedForEachCount() ||
+        a->getExportedReduceCount() != b->getExportedReduceCount() ||
+        a->getBuildChecksum() != b->getBuildChecksum() ||
+        a->getThreadable() != b->getThreadable()) {
+        return false;
+    }
+    for (size_t i = 0; i < a->getExportedVariableCount(); i++) {
+        if (a->getFieldAddress(i) == nullptr ||
+            a->getFieldAddress(i) != b->getFieldAddress(i) ||
+            strcmp(a->getFieldName(i), b->getFieldName(i))) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a->getExportedFunctionCount(); i++) {
+        if (a->getInvokeFunction(i) != b->getInvokeFunction(i)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a->getExportedForEachCount(); i++) {
+        if (a->getForEachFunction(i) != b->getForEachFunction(i) ||
+            a->getForEachSignature(i) != b->getForEachSignature(i)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a->getExportedReduceCount(); i++) {
+        const ReduceDescription *ra = a->getReduceDescription(i);
+        const ReduceDescription *rb = b->getReduceDescription(i);
+        if (ra->accumFunc == nullptr || ra->combFunc == nullptr ||
+            (ra->initFunc == nullptr) == hasInit(i) ||
+            (ra->outFunc == nullptr) == hasOut(i) ||
+            ra->initFunc != rb->initFunc || ra->accumFunc != rb->accumFunc ||
+            ra->combFunc != rb->combFunc || ra->outFunc != rb->outFunc ||
+            ra->accumSize != rb->accumSize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int iters = 1000;
+    if (argc >= 2) {
+        iters = atoi(argv[1]);
+    }
+    if (iters <= 0) {
+        printf("usage: %s [iters]\n", argv[0]);
+        return 1;
+    }
+
+    void *handle = dlopen(nullptr, RTLD_NOW);
+    std::string info = buildRSInfo();
+    std::vector<uint64_t> storage = buildExportTable(handle);
+    const RsExportTable *table = (const RsExportTable *) storage.data();
+
+    ScriptExecutable *text = ScriptExecutable::createFromRSInfo(nullptr, handle, info.c_str());
+    ScriptExecutable *binary = ScriptExecutable::createFromExportTable(nullptr, handle, table);
+    if (!text || !binary || text->getExportedReduceCount() != kReduces ||
+        !same(text, binary)) {
+        printf("FAILED: the two formats describe different scripts\n");
+        return 1;
+    }
+    delete text;
+    delete binary;
+
+    double start = now();
+    for (int i = 0; i < iters; i++) {
+        delete ScriptExecutable::createFromRSInfo(nullptr, handle, info.c_str());
+    }
+    double textTime = (now() - start) / iters;
+
+    start = now();
+    for (int i = 0; i < iters; i++) {
+        delete ScriptExecutable::createFromExportTable(nullptr, handle, table);
+    }
+    double binaryTime = (now() - start) / iters;
+
+    printf("%zu vars, %zu funcs, %zu kernels, %d iters\n",
+           kExports, kExports, kExports, iters);
+    printf("text .rs.info:  %8.1f us\n", textTime * 1000.0);
+    printf("export table:   %8.1f us\n", binaryTime * 1000.0);
+    printf("PASSED\n");
+    return 0;
+}